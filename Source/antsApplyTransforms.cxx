@@ -1,27 +1,51 @@
 #include "antsCommandLineParser.h"
-
-#include "itkAffineTransform.h"
+#include "antsMetaImageStitcher.h"
+#include "antsResidentObjectCache.h"
+#include "antsThreadAffinity.h"
+#include "antsTimingReport.h"
+#include "antsTransformPrecision.h"
+#include "antsWarpService.h"
+
+#include "itkANTSResampleImageFilter.h"
+#include "itkAntiAliasedImagePyramid.h"
 #include "itkCompositeTransform.h"
+#include "itkCompositeTransformPointMapper.h"
 #include "itkDisplacementFieldTransform.h"
+#include "itkFixedPointDisplacementFieldInverter.h"
 #include "itkIdentityTransform.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
-#include "itkMatrixOffsetTransformBase.h"
-#include "itkResampleImageFilter.h"
-#include "itkTransformFactory.h"
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkMemoryMappedImageFileWriter.h"
+#include "itkMemoryMappedImportImageContainer.h"
+#include "itkParallelGzipImageFileWriter.h"
+#include "itkStreamingVTKPolyDataTransformer.h"
 #include "itkTransformFileReader.h"
 
-#include "itkBSplineInterpolateImageFunction.h"
+#include "itkCachedBSplineInterpolateImageFunction.h"
 #include "itkLinearInterpolateImageFunction.h"
 #include "itkGaussianInterpolateImageFunction.h"
 #include "itkNearestNeighborInterpolateImageFunction.h"
-#include "itkWindowedSincInterpolateImageFunction.h"
+#include "itkSeparableWindowedSincInterpolateImageFunction.h"
 #include "itkLabelImageGaussianInterpolateImageFunction.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <deque>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <typeinfo>
 #include <vector>
 
+#if !defined( _WIN32 )
+#include <unistd.h>
+#endif
+
 void ConvertToLowerCase( std::string& str )
 {
   std::transform( str.begin(), str.end(), str.begin(), tolower );
@@ -53,33 +77,529 @@ public:
     }
 };
 
+/**
+ * Point sets are kept as separate coordinate arrays, the layout used by
+ * itk::CompositeTransformPointMapper.  Points are read from and written to
+ *   - CSV files (.csv/.txt):  one point per line with the coordinates in the
+ *     first columns.  A header line and any additional columns (labels,
+ *     comments, ...) are passed through unchanged.
+ *   - binary files (.f32/.f64):  the interleaved coordinates of all points as
+ *     single/double precision floats in native byte order.
+ * Coordinates are physical (ITK, i.e. LPS) coordinates.
+ */
+template<class TScalar, unsigned int Dimension>
+class PointSetBuffer
+{
+public:
+  std::vector<TScalar>       m_Coordinates[Dimension];
+
+  // CSV pass-through:  header line and the remainder of each line.
+  std::string                m_Header;
+  std::string                m_Tails;
+  std::vector<std::size_t>   m_TailOffsets;
+
+  std::size_t GetNumberOfPoints() const
+    {
+    return this->m_Coordinates[0].size();
+    }
+};
+
+bool IsCSVPointSetFileName( const std::string & filename )
+{
+  return ( itk::ants::MemoryMappedFile::HasExtension( filename, ".csv" ) ||
+    itk::ants::MemoryMappedFile::HasExtension( filename, ".txt" ) );
+}
+
+bool IsBinaryPointSetFileName( const std::string & filename )
+{
+  return ( itk::ants::MemoryMappedFile::HasExtension( filename, ".f32" ) ||
+    itk::ants::MemoryMappedFile::HasExtension( filename, ".f64" ) );
+}
+
+template<class TScalar, unsigned int Dimension>
+bool ReadCSVPointSet( const std::string & filename, PointSetBuffer<TScalar, Dimension> & points )
+{
+  std::ifstream is( filename.c_str() );
+  if( !is )
+    {
+    return false;
+    }
+
+  bool hasTails = false;
+  std::string line;
+  while( std::getline( is, line ) )
+    {
+    if( !line.empty() && line[line.length() - 1] == '\r' )
+      {
+      line.erase( line.length() - 1 );
+      }
+    if( line.empty() )
+      {
+      continue;
+      }
+
+    const char *begin = line.c_str();
+    char *end = const_cast<char *>( begin );
+    TScalar coordinates[Dimension];
+    bool isNumeric = true;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      if( d > 0 )
+        {
+        while( *end == ' ' || *end == '\t' )
+          {
+          end++;
+          }
+        if( *end != ',' )
+          {
+          isNumeric = false;
+          break;
+          }
+        end++;
+        }
+      const char *field = end;
+      coordinates[d] = static_cast<TScalar>( std::strtod( field, &end ) );
+      if( end == field )
+        {
+        isNumeric = false;
+        break;
+        }
+      }
+    if( !isNumeric )
+      {
+      // Only the first line may be a header.
+      if( points.GetNumberOfPoints() == 0 && points.m_Header.empty() )
+        {
+        points.m_Header = line;
+        continue;
+        }
+      std::cerr << "Unable to parse the point \"" << line << "\" in "
+        << filename << std::endl;
+      return false;
+      }
+
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      points.m_Coordinates[d].push_back( coordinates[d] );
+      }
+    points.m_TailOffsets.push_back( points.m_Tails.length() );
+    if( *end != '\0' )
+      {
+      points.m_Tails.append( end );
+      hasTails = true;
+      }
+    }
+  points.m_TailOffsets.push_back( points.m_Tails.length() );
+  if( !hasTails )
+    {
+    std::vector<std::size_t>().swap( points.m_TailOffsets );
+    }
+  return true;
+}
+
+template<class TScalar, unsigned int Dimension>
+bool WriteCSVPointSet( const std::string & filename, const PointSetBuffer<TScalar, Dimension> & points )
+{
+  std::ofstream os( filename.c_str() );
+  if( !os )
+    {
+    return false;
+    }
+  os << std::setprecision( std::numeric_limits<TScalar>::digits10 + 2 );
+
+  if( !points.m_Header.empty() )
+    {
+    os << points.m_Header << std::endl;
+    }
+  const bool hasTails = !points.m_TailOffsets.empty();
+  for( std::size_t n = 0; n < points.GetNumberOfPoints(); n++ )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      if( d > 0 )
+        {
+        os << ",";
+        }
+      os << points.m_Coordinates[d][n];
+      }
+    if( hasTails )
+      {
+      os.write( points.m_Tails.data() + points.m_TailOffsets[n],
+        points.m_TailOffsets[n+1] - points.m_TailOffsets[n] );
+      }
+    os << "\n";
+    }
+  return os.good();
+}
+
+template<class TFileScalar, class TScalar, unsigned int Dimension>
+bool ReadBinaryPointSet( const std::string & filename, PointSetBuffer<TScalar, Dimension> & points )
+{
+  itk::ants::MemoryMappedFile::Pointer file = itk::ants::MemoryMappedFile::New();
+  if( !file->OpenForReading( filename ) )
+    {
+    // Empty files can not be mapped.
+    return ( itk::ants::MemoryMappedFile::FileExists( filename ) &&
+      itk::ants::MemoryMappedFile::GetFileSize( filename ) == 0 );
+    }
+  if( file->GetSize() % ( Dimension * sizeof( TFileScalar ) ) != 0 )
+    {
+    std::cerr << "The size of " << filename << " is not a multiple of the size of a "
+      << Dimension << "-D point." << std::endl;
+    return false;
+    }
+
+  const std::size_t numberOfPoints = file->GetSize() / ( Dimension * sizeof( TFileScalar ) );
+  const TFileScalar *buffer = reinterpret_cast<const TFileScalar *>( file->GetBuffer() );
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    points.m_Coordinates[d].resize( numberOfPoints );
+    }
+  for( std::size_t n = 0; n < numberOfPoints; n++ )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      points.m_Coordinates[d][n] = static_cast<TScalar>( buffer[n * Dimension + d] );
+      }
+    }
+  return true;
+}
+
+template<class TFileScalar, class TScalar, unsigned int Dimension>
+bool WriteBinaryPointSet( const std::string & filename, const PointSetBuffer<TScalar, Dimension> & points )
+{
+  std::ofstream os( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+  if( !os )
+    {
+    return false;
+    }
+
+  // Interleave the coordinates in blocks to keep the number of writes low.
+  const std::size_t blockSize = 65536;
+  std::vector<TFileScalar> block( blockSize * Dimension );
+  for( std::size_t first = 0; first < points.GetNumberOfPoints(); first += blockSize )
+    {
+    const std::size_t count = std::min( blockSize, points.GetNumberOfPoints() - first );
+    for( std::size_t n = 0; n < count; n++ )
+      {
+      for( unsigned int d = 0; d < Dimension; d++ )
+        {
+        block[n * Dimension + d] = static_cast<TFileScalar>( points.m_Coordinates[d][first + n] );
+        }
+      }
+    os.write( reinterpret_cast<const char *>( &block[0] ), count * Dimension * sizeof( TFileScalar ) );
+    }
+  return os.good();
+}
+
+/** <stem>_level<k><extension>, where ".gz" is kept with the extension
+ * before it. */
+std::string GetPyramidLevelFileName( const std::string & filename, unsigned int level )
+{
+  std::string stem = filename;
+  std::string extension( "" );
+  std::string::size_type dot = stem.find_last_of( '.' );
+  if( dot != std::string::npos && stem.find_first_of( "/\\", dot ) == std::string::npos )
+    {
+    extension = stem.substr( dot );
+    stem = stem.substr( 0, dot );
+    if( extension == ".gz" )
+      {
+      dot = stem.find_last_of( '.' );
+      if( dot != std::string::npos && stem.find_first_of( "/\\", dot ) == std::string::npos )
+        {
+        extension = stem.substr( dot ) + extension;
+        stem = stem.substr( 0, dot );
+        }
+      }
+    }
+
+  std::ostringstream oss;
+  oss << stem << "_level" << level << extension;
+  return oss.str();
+}
+
+template<class TScalar, unsigned int Dimension>
+bool ReadPointSet( const std::string & filename, PointSetBuffer<TScalar, Dimension> & points )
+{
+  if( IsCSVPointSetFileName( filename ) )
+    {
+    return ReadCSVPointSet<TScalar, Dimension>( filename, points );
+    }
+  else if( itk::ants::MemoryMappedFile::HasExtension( filename, ".f32" ) )
+    {
+    return ReadBinaryPointSet<float, TScalar, Dimension>( filename, points );
+    }
+  else if( itk::ants::MemoryMappedFile::HasExtension( filename, ".f64" ) )
+    {
+    return ReadBinaryPointSet<double, TScalar, Dimension>( filename, points );
+    }
+  std::cerr << "Unsupported point set file type: " << filename << std::endl;
+  return false;
+}
+
+template<class TScalar, unsigned int Dimension>
+bool WritePointSet( const std::string & filename, const PointSetBuffer<TScalar, Dimension> & points )
+{
+  if( IsCSVPointSetFileName( filename ) )
+    {
+    return WriteCSVPointSet<TScalar, Dimension>( filename, points );
+    }
+  else if( itk::ants::MemoryMappedFile::HasExtension( filename, ".f32" ) )
+    {
+    return WriteBinaryPointSet<float, TScalar, Dimension>( filename, points );
+    }
+  else if( itk::ants::MemoryMappedFile::HasExtension( filename, ".f64" ) )
+    {
+    return WriteBinaryPointSet<double, TScalar, Dimension>( filename, points );
+    }
+  std::cerr << "Unsupported point set file type: " << filename << std::endl;
+  return false;
+}
+
+/** Key of a file in the resident cache of the service (empty if the
+ * program does not run as a service). */
+std::string GetResidentObjectKey( const std::string & filename, const std::string & type )
+{
+  if( !itk::ants::ResidentObjectCache::GetGlobalCache() )
+    {
+    return std::string( "" );
+    }
+  return itk::ants::ResidentObjectCache::GetFileKey( filename, type );
+}
+
+/**
+ * First-touch copy (see --bind) of an image that was read, unless its
+ * buffer is memory mapped:  the mapping is used in place, since copying it
+ * into anonymous memory would undo the zero-copy load of --memory-map.
+ */
+template<class TImage>
+typename TImage::Pointer FirstTouchCopyUnlessMapped( TImage *image, unsigned int numberOfThreads )
+{
+  typedef itk::MemoryMappedImportImageContainer<
+    typename TImage::PixelContainer::ElementIdentifier, typename TImage::PixelType> MappedContainerType;
+  if( dynamic_cast<const MappedContainerType *>( image->GetPixelContainer() ) )
+    {
+    return image;
+    }
+  return itk::ants::ThreadAffinity::FirstTouchCopy( image, numberOfThreads );
+}
+
+template<class TImage>
+double GetImageSizeInBytes( const TImage *image )
+{
+  return static_cast<double>( image->GetBufferedRegion().GetNumberOfPixels() ) *
+    sizeof( typename TImage::PixelType );
+}
 
-template <unsigned int Dimension>
-int antsApplyTransforms( itk::ants::CommandLineParser *parser )
+template <class TComputeType, unsigned int Dimension>
+int antsApplyTransforms( itk::ants::CommandLineParser *parser,
+  itk::ants::TimingReport *report )
 {
-  typedef double RealType;
-  typedef double PixelType;
+  typedef TComputeType RealType;
+  typedef TComputeType PixelType;
 
   typedef itk::Image<PixelType, Dimension> ImageType;
 
-  typedef itk::ResampleImageFilter<ImageType, ImageType, RealType> ResamplerType;
+  typedef itk::ANTSResampleImageFilter<ImageType, ImageType, RealType> ResamplerType;
   typename ResamplerType::Pointer resampleFilter = ResamplerType::New();
 
+  typename itk::ants::CommandLineParser::OptionType::Pointer timingOption =
+    parser->GetOption( "timing-report" );
+  if( timingOption && timingOption->GetNumberOfValues() > 0 &&
+    timingOption->GetValue() != std::string( "0" ) )
+    {
+    resampleFilter->SetMeasurePhaseTimes( true );
+    }
+
+  /**
+   * Memory mapped input/output and cache of decompressed inputs
+   */
+  bool useMemoryMapping = false;
+  typename itk::ants::CommandLineParser::OptionType::Pointer memoryMapOption =
+    parser->GetOption( "memory-map" );
+  if( memoryMapOption && memoryMapOption->GetNumberOfValues() > 0 )
+    {
+    useMemoryMapping = parser->Convert<bool>( memoryMapOption->GetValue() );
+    }
+
+  std::string cacheDirectory( "" );
+  typename itk::ants::CommandLineParser::OptionType::Pointer cacheOption =
+    parser->GetOption( "cache-directory" );
+  if( cacheOption && cacheOption->GetNumberOfValues() > 0 )
+    {
+    cacheDirectory = cacheOption->GetValue();
+    useMemoryMapping = true;
+    }
+
+  /**
+   * Inversion of displacement fields given as [fieldFileName,1]
+   */
+  double inverseFieldTolerance = 0.01;
+  unsigned int inverseFieldMaximumNumberOfIterations = 20;
+  unsigned int inverseFieldNumberOfLevels = 3;
+  typename itk::ants::CommandLineParser::OptionType::Pointer inverseFieldOption =
+    parser->GetOption( "field-inversion" );
+  if( inverseFieldOption && inverseFieldOption->GetNumberOfValues() > 0 )
+    {
+    if( inverseFieldOption->GetNumberOfParameters() > 0 )
+      {
+      inverseFieldTolerance = parser->Convert<double>( inverseFieldOption->GetParameter( 0 ) );
+      }
+    if( inverseFieldOption->GetNumberOfParameters() > 1 )
+      {
+      inverseFieldMaximumNumberOfIterations =
+        parser->Convert<unsigned int>( inverseFieldOption->GetParameter( 1 ) );
+      }
+    if( inverseFieldOption->GetNumberOfParameters() > 2 )
+      {
+      inverseFieldNumberOfLevels = parser->Convert<unsigned int>( inverseFieldOption->GetParameter( 2 ) );
+      }
+    if( inverseFieldTolerance <= 0.0 || inverseFieldNumberOfLevels < 1 )
+      {
+      std::cerr << "The field inversion requires a positive tolerance and at least one level."
+        << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  /**
+   * Jacobian determinant option
+   */
+  std::string jacobianFileName( "" );
+  bool useLogJacobian = false;
+  typename itk::ants::CommandLineParser::OptionType::Pointer jacobianOption =
+    parser->GetOption( "jacobian-determinant" );
+  if( jacobianOption && jacobianOption->GetNumberOfValues() > 0 )
+    {
+    if( jacobianOption->GetNumberOfParameters( 0 ) > 0 )
+      {
+      jacobianFileName = jacobianOption->GetParameter( 0, 0 );
+      if( jacobianOption->GetNumberOfParameters( 0 ) > 1 )
+        {
+        useLogJacobian = parser->Convert<bool>( jacobianOption->GetParameter( 0, 1 ) );
+        }
+      }
+    else
+      {
+      jacobianFileName = jacobianOption->GetValue( 0 );
+      }
+    resampleFilter->SetComputeJacobianDeterminant( true );
+    resampleFilter->SetUseLogJacobianDeterminant( useLogJacobian );
+    }
+
+  /**
+   * Input object type option
+   */
+  std::string inputObjectType( "image" );
+  typename itk::ants::CommandLineParser::OptionType::Pointer inputObjectTypeOption =
+    parser->GetOption( "input-object-type" );
+  if( inputObjectTypeOption && inputObjectTypeOption->GetNumberOfValues() > 0 )
+    {
+    inputObjectType = inputObjectTypeOption->GetValue();
+    ConvertToLowerCase( inputObjectType );
+    if( inputObjectType != "image" && inputObjectType != "points" &&
+      inputObjectType != "mesh" )
+      {
+      std::cerr << "Error:  Unrecognized input object type: " << inputObjectType << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  const bool isMesh = ( inputObjectType == "mesh" );
+  const bool isPointSet = ( inputObjectType == "points" || isMesh );
+
+  typename itk::ants::CommandLineParser::OptionType::Pointer referenceOption =
+    parser->GetOption( "reference-image" );
+
   /**
-   * Input object option - for now, we're limiting this to images.
+   * Input object option - images or point sets.
    */
+  PointSetBuffer<RealType, Dimension> points;
+
   typename itk::ants::CommandLineParser::OptionType::Pointer inputOption =
     parser->GetOption( "input" );
-  if( inputOption && inputOption->GetNumberOfValues() > 0 )
+  if( inputOption && inputOption->GetNumberOfValues() > 0 && isMesh )
+    {
+    // The mesh is streamed once the transforms are known.
+    std::cout << "Input mesh: " << inputOption->GetValue() << std::endl;
+    report->AddFileRead( inputOption->GetValue() );
+    }
+  else if( inputOption && inputOption->GetNumberOfValues() > 0 && isPointSet )
+    {
+    std::cout << "Input points: " << inputOption->GetValue() << std::endl;
+    report->StartPhase( "input reading" );
+    if( !ReadPointSet<RealType, Dimension>( inputOption->GetValue(), points ) )
+      {
+      std::cerr << "Error:  Unable to read the points from " << inputOption->GetValue() << std::endl;
+      return EXIT_FAILURE;
+      }
+    report->StopPhase();
+    report->AddFileRead( inputOption->GetValue() );
+    std::cout << "  number of points = " << points.GetNumberOfPoints() << std::endl;
+    }
+  else if( inputOption && inputOption->GetNumberOfValues() > 0 )
     {
     std::cout << "Input object: " << inputOption->GetValue() << std::endl;
 
-    typedef itk::ImageFileReader<ImageType> ReaderType;
-    typename ReaderType::Pointer reader = ReaderType::New();
-    reader->SetFileName( ( inputOption->GetValue() ).c_str() );
-    reader->Update();
+    const std::string inputKey = GetResidentObjectKey( inputOption->GetValue(),
+      typeid( ImageType ).name() );
+    typename ImageType::Pointer inputImage =
+      itk::ants::ResidentObjectCache::FindGlobal<ImageType>( inputKey );
+    if( inputImage )
+      {
+      std::cout << "  (resident)" << std::endl;
+      }
+    else
+      {
+      // Includes the decompression of gzipped inputs (unless cached).
+      report->StartPhase( "input reading" );
+      typedef itk::MemoryMappedImageFileReader<ImageType> ReaderType;
+      typename ReaderType::Pointer reader = ReaderType::New();
+      reader->SetFileName( inputOption->GetValue() );
+      reader->SetUseMemoryMapping( useMemoryMapping );
+      reader->SetCacheDirectory( cacheDirectory );
+      reader->Update();
+      report->StopPhase();
+      report->AddFileRead( inputOption->GetValue() );
+      if( reader->GetIsMemoryMapped() )
+        {
+        std::cout << "  (memory mapped" << ( reader->GetIsCached() ? " from the cache)" : ")" )
+          << std::endl;
+        }
+
+      inputImage = FirstTouchCopyUnlessMapped(
+        reader->GetOutput(), resampleFilter->GetNumberOfThreads() );
+      inputImage->DisconnectPipeline();
+      itk::ants::ResidentObjectCache::InsertGlobal( inputKey, inputImage,
+        GetImageSizeInBytes( inputImage.GetPointer() ) );
+      }
+
+    resampleFilter->SetInput( inputImage );
+    }
+  else if( !jacobianFileName.empty() && !isPointSet )
+    {
+    // Standalone Jacobian determinant:  the filter requires an input, so a
+    // single voxel placeholder is used and the resampling is switched off.
+    typename ImageType::RegionType region;
+    region.SetSize( 0, 1 );
+    for( unsigned int d = 1; d < Dimension; d++ )
+      {
+      region.SetSize( d, 1 );
+      }
+    typename ImageType::Pointer placeholder = ImageType::New();
+    placeholder->SetRegions( region );
+    placeholder->Allocate();
+    placeholder->FillBuffer( itk::NumericTraits<PixelType>::Zero );
+
+    resampleFilter->SetInput( placeholder );
+    resampleFilter->SetResampleInput( false );
 
-    resampleFilter->SetInput( reader->GetOutput() );
+    if( !referenceOption || referenceOption->GetNumberOfValues() == 0 )
+      {
+      std::cerr << "Error:  A reference image is required to compute the Jacobian "
+        << "determinant without an input image." << std::endl;
+      return EXIT_FAILURE;
+      }
     }
   else
     {
@@ -90,84 +610,262 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
   /**
    * Reference image option
    */
-  typename itk::ants::CommandLineParser::OptionType::Pointer referenceOption =
-    parser->GetOption( "reference-image" );
-  if( referenceOption && referenceOption->GetNumberOfValues() > 0 )
+  if( referenceOption && referenceOption->GetNumberOfValues() > 0 && !isPointSet )
     {
     std::cout << "Reference image: " << referenceOption->GetValue() << std::endl;
 
     // read in the image as char since we only need the header information.
     typedef itk::Image<char, Dimension> ReferenceImageType;
-    typedef itk::ImageFileReader<ReferenceImageType> ReferenceReaderType;
-    typename ReferenceReaderType::Pointer referenceReader =
-      ReferenceReaderType::New();
-    referenceReader->SetFileName( ( referenceOption->GetValue() ).c_str() );
-    referenceReader->Update();
+    const std::string referenceKey = GetResidentObjectKey( referenceOption->GetValue(),
+      typeid( ReferenceImageType ).name() );
+    typename ReferenceImageType::Pointer referenceImage =
+      itk::ants::ResidentObjectCache::FindGlobal<ReferenceImageType>( referenceKey );
+    if( !referenceImage )
+      {
+      typedef itk::ImageFileReader<ReferenceImageType> ReferenceReaderType;
+      typename ReferenceReaderType::Pointer referenceReader =
+        ReferenceReaderType::New();
+      report->StartPhase( "reference reading" );
+      referenceReader->SetFileName( ( referenceOption->GetValue() ).c_str() );
+      referenceReader->Update();
+      report->StopPhase();
+      report->AddFileRead( referenceOption->GetValue() );
+
+      referenceImage = referenceReader->GetOutput();
+      referenceImage->DisconnectPipeline();
+      itk::ants::ResidentObjectCache::InsertGlobal( referenceKey, referenceImage,
+        GetImageSizeInBytes( referenceImage.GetPointer() ) );
+      }
+
+    resampleFilter->SetOutputParametersFromImage( referenceImage );
+
+    /**
+     * Output region and shard options:  crop the output to a region of the
+     * reference and/or to one of N slabs along its last axis.
+     */
+    typename ReferenceImageType::RegionType outputRegion =
+      referenceImage->GetLargestPossibleRegion();
+    bool isOutputCropped = false;
+
+    typename itk::ants::CommandLineParser::OptionType::Pointer regionOption =
+      parser->GetOption( "output-region" );
+    if( regionOption && regionOption->GetNumberOfValues() > 0 )
+      {
+      if( regionOption->GetNumberOfParameters( 0 ) < 2 )
+        {
+        std::cerr << "Error:  The output region is specified as [startIndex,size]." << std::endl;
+        return EXIT_FAILURE;
+        }
+      std::vector<long> start = parser->ConvertVector<long>( regionOption->GetParameter( 0, 0 ) );
+      std::vector<unsigned long> size = parser->ConvertVector<unsigned long>(
+        regionOption->GetParameter( 0, 1 ) );
+      if( start.size() != Dimension || size.size() != Dimension )
+        {
+        std::cerr << "Error:  The output region has to be " << Dimension
+          << "-dimensional." << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      for( unsigned int d = 0; d < Dimension; d++ )
+        {
+        outputRegion.SetIndex( d, start[d] );
+        outputRegion.SetSize( d, size[d] );
+        }
+      if( !referenceImage->GetLargestPossibleRegion().IsInside( outputRegion ) )
+        {
+        std::cerr << "Error:  The output region " << outputRegion.GetIndex() << " "
+          << outputRegion.GetSize() << " is not inside the reference image." << std::endl;
+        return EXIT_FAILURE;
+        }
+      isOutputCropped = true;
+      }
+
+    typename itk::ants::CommandLineParser::OptionType::Pointer shardOption =
+      parser->GetOption( "shard" );
+    if( shardOption && shardOption->GetNumberOfValues() > 0 )
+      {
+      unsigned long shard = 0;
+      unsigned long numberOfShards = 0;
+      unsigned long shardStart = 0;
+      unsigned long shardSize = 0;
+      const unsigned int last = Dimension - 1;
+      if( std::sscanf( shardOption->GetValue().c_str(), "%lu/%lu", &shard, &numberOfShards ) != 2 ||
+        !itk::ants::MetaImageStitcher::GetShardRange( outputRegion.GetSize()[last], shard,
+        numberOfShards, shardStart, shardSize ) )
+        {
+        std::cerr << "Error:  The shard " << shardOption->GetValue() << " is not one of "
+          << "k/N with 0 <= k < N and N at most the output size along the last axis." << std::endl;
+        return EXIT_FAILURE;
+        }
+      outputRegion.SetIndex( last, outputRegion.GetIndex()[last] + static_cast<long>( shardStart ) );
+      outputRegion.SetSize( last, shardSize );
+      isOutputCropped = true;
+      }
+
+    if( isOutputCropped )
+      {
+
+      // The cropped output starts at index 0 so that it can be stored in
+      // any file format.
+      typename ReferenceImageType::PointType outputOrigin;
+      referenceImage->TransformIndexToPhysicalPoint( outputRegion.GetIndex(), outputOrigin );
+      typename ResamplerType::OriginPointType resampleOrigin;
+      for( unsigned int d = 0; d < Dimension; d++ )
+        {
+        resampleOrigin[d] = outputOrigin[d];
+        }
+      typename ImageType::IndexType startIndex;
+      startIndex.Fill( 0 );
+      resampleFilter->SetOutputOrigin( resampleOrigin );
+      resampleFilter->SetOutputStartIndex( startIndex );
+      resampleFilter->SetSize( outputRegion.GetSize() );
+
+      std::cout << "Output region: " << outputRegion.GetIndex() << " "
+        << outputRegion.GetSize() << std::endl;
+      }
+    }
+
+  /**
+   * Output mask option
+   */
+  typename itk::ants::CommandLineParser::OptionType::Pointer maskOption =
+    parser->GetOption( "output-mask" );
+  if( maskOption && maskOption->GetNumberOfValues() > 0 && !isPointSet )
+    {
+    std::cout << "Output mask: " << maskOption->GetValue() << std::endl;
+
+    typedef typename ResamplerType::MaskImageType MaskImageType;
+    const std::string maskKey = GetResidentObjectKey( maskOption->GetValue(),
+      typeid( MaskImageType ).name() );
+    typename MaskImageType::Pointer maskImage =
+      itk::ants::ResidentObjectCache::FindGlobal<MaskImageType>( maskKey );
+    if( !maskImage )
+      {
+      typedef itk::MemoryMappedImageFileReader<MaskImageType> MaskReaderType;
+      typename MaskReaderType::Pointer maskReader = MaskReaderType::New();
+      maskReader->SetFileName( maskOption->GetValue() );
+      maskReader->SetUseMemoryMapping( useMemoryMapping );
+      maskReader->SetCacheDirectory( cacheDirectory );
+      report->StartPhase( "mask reading" );
+      maskReader->Update();
+      report->StopPhase();
+      report->AddFileRead( maskOption->GetValue() );
+
+      maskImage = maskReader->GetOutput();
+      maskImage->DisconnectPipeline();
+      itk::ants::ResidentObjectCache::InsertGlobal( maskKey, maskImage,
+        GetImageSizeInBytes( maskImage.GetPointer() ) );
+      }
 
-    resampleFilter->SetOutputParametersFromImage( referenceReader->GetOutput() );
+    resampleFilter->SetOutputMask( maskImage );
     }
 
   /**
    * Transform option
    */
-  // Register the matrix offset transform base class to the
-  // transform factory for compatibility with the current ANTs.
-  typedef itk::MatrixOffsetTransformBase
-    <PixelType, Dimension, Dimension> MatrixOffsetTransformType;
-  itk::TransformFactory<MatrixOffsetTransformType>::RegisterTransform();
-  typedef itk::AffineTransform<PixelType, Dimension> AffineTransformType;
-  itk::TransformFactory<AffineTransformType>::RegisterTransform();
+  // Register the matrix offset transform base class (for compatibility
+  // with the current ANTs) and the other linear transforms to the
+  // transform factory.  Both precisions are registered so that double
+  // precision transform files can be converted when running in single
+  // precision.
+  itk::ants::TransformTypeRegistration<RealType, Dimension>::RegisterTransforms();
+  itk::ants::TransformTypeRegistration<double, Dimension>::RegisterTransforms();
 
   /**
    * Load an identity transform in case no transforms are loaded.
    */
-  typedef itk::IdentityTransform<double, Dimension> IdentityTransformType;
+  typedef itk::IdentityTransform<RealType, Dimension> IdentityTransformType;
   typename IdentityTransformType::Pointer identityTransform =
     IdentityTransformType::New();
   identityTransform->SetIdentity();
 
-  typedef itk::CompositeTransform<double, Dimension> CompositeTransformType;
+  typedef itk::CompositeTransform<RealType, Dimension> CompositeTransformType;
   typename CompositeTransformType::Pointer compositeTransform =
     CompositeTransformType::New();
   compositeTransform->AddTransform( identityTransform );
 
+  report->StartPhase( "transform loading" );
   typename itk::ants::CommandLineParser::OptionType::Pointer transformOption =
     parser->GetOption( "transform" );
-  if( transformOption && transformOption->GetNumberOfValues() > 0 )
-    {
-    std::deque<std::string> transformNames;
-    std::deque<std::string> transformTypes;
 
+  // Key of the whole composite in the resident cache:  the transform files
+  // in order with their inverse flags and, if a field is inverted, the
+  // inversion settings.
+  std::string compositeKey( "" );
+  if( itk::ants::ResidentObjectCache::GetGlobalCache() &&
+    transformOption && transformOption->GetNumberOfValues() > 0 )
+    {
+    compositeKey = std::string( typeid( CompositeTransformType ).name() );
+    bool hasInverse = false;
     for( unsigned int n = 0; n < transformOption->GetNumberOfValues(); n++ )
       {
-      std::string transformName;
-      std::string transformType;
-
-      typedef itk::Transform<double, Dimension, Dimension> TransformType;
-      typename TransformType::Pointer transform;
-
-      bool hasTransformBeenRead = false;
-      try
+      const bool hasParameters = ( transformOption->GetNumberOfParameters( n ) > 0 );
+      const std::string fileKey = GetResidentObjectKey( hasParameters ?
+        transformOption->GetParameter( n, 0 ) : transformOption->GetValue( n ), "transform" );
+      if( fileKey.empty() )
         {
-        transformName = transformOption->GetValue( n );
+        compositeKey = std::string( "" );
+        break;
+        }
+      const bool useInverse = ( transformOption->GetNumberOfParameters( n ) > 1 &&
+        parser->Convert<bool>( transformOption->GetParameter( n, 1 ) ) );
+      compositeKey += std::string( "|" ) + fileKey + ( useInverse ? ":inverse" : "" );
+      hasInverse = hasInverse || useInverse;
+      }
+    if( hasInverse && !compositeKey.empty() )
+      {
+      std::ostringstream oss;
+      oss << std::setprecision( 17 ) << "|inversion:" << inverseFieldTolerance << ","
+        << inverseFieldMaximumNumberOfIterations << "," << inverseFieldNumberOfLevels;
+      compositeKey += oss.str();
+      }
+    }
+  typename CompositeTransformType::Pointer residentComposite =
+    itk::ants::ResidentObjectCache::FindGlobal<CompositeTransformType>( compositeKey );
 
-        typedef itk::DisplacementFieldTransform<PixelType, Dimension>
-          DisplacementFieldTransformType;
+  if( residentComposite )
+    {
+    compositeTransform = residentComposite;
+    std::cout << "The composite transform of " << transformOption->GetNumberOfValues()
+      << " transforms is resident." << std::endl;
+    }
+  else if( transformOption && transformOption->GetNumberOfValues() > 0 )
+    {
+    std::deque<std::string> transformNames;
+    std::deque<std::string> transformTypes;
+    double compositeSize = 0.0;
 
-        typedef typename DisplacementFieldTransformType::DisplacementFieldType
-          DisplacementFieldType;
+    for( unsigned int n = 0; n < transformOption->GetNumberOfValues(); n++ )
+      {
+      std::string transformName;
+      std::string transformType;
 
-        typedef itk::ImageFileReader<DisplacementFieldType> DisplacementFieldReaderType;
-        typename DisplacementFieldReaderType::Pointer fieldReader =
-          DisplacementFieldReaderType::New();
-        fieldReader->SetFileName( transformName.c_str() );
-        fieldReader->Update();
+      typedef itk::Transform<RealType, Dimension, Dimension> TransformType;
+      typename TransformType::Pointer transform;
 
-        typename DisplacementFieldTransformType::Pointer displacementFieldTransform =
-          DisplacementFieldTransformType::New();
-        displacementFieldTransform->SetDisplacementField( fieldReader->GetOutput() );
-        transform = dynamic_cast<TransformType *>( displacementFieldTransform.GetPointer() );
+      transformName = ( transformOption->GetNumberOfParameters( n ) > 0 ) ?
+        transformOption->GetParameter( n, 0 ) : transformOption->GetValue( n );
+
+      // The field is stored with the compute precision, i.e. a float
+      // field is read (and converted, if necessary) with --float.
+      typedef itk::DisplacementFieldTransform<RealType, Dimension>
+        DisplacementFieldTransformType;
 
+      typedef typename DisplacementFieldTransformType::DisplacementFieldType
+        DisplacementFieldType;
+
+      typedef itk::MemoryMappedImageFileReader<DisplacementFieldType> DisplacementFieldReaderType;
+      typename DisplacementFieldReaderType::Pointer fieldReader =
+        DisplacementFieldReaderType::New();
+      fieldReader->SetFileName( transformName );
+      fieldReader->SetUseMemoryMapping( useMemoryMapping );
+      fieldReader->SetCacheDirectory( cacheDirectory );
+
+      // Files that are not images are read by the transform reader below.
+      bool hasTransformBeenRead = false;
+      try
+        {
+        fieldReader->Update();
         hasTransformBeenRead = true;
         }
       catch( ... )
@@ -175,6 +873,55 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
         hasTransformBeenRead = false;
         }
 
+      if( hasTransformBeenRead )
+        {
+        typename DisplacementFieldType::Pointer displacementField = fieldReader->GetOutput();
+        if( ( transformOption->GetNumberOfParameters( n ) > 1 ) &&
+          parser->Convert<bool>( transformOption->GetParameter( n, 1 ) ) )
+          {
+          typedef itk::FixedPointDisplacementFieldInverter<DisplacementFieldType> InverterType;
+          typename InverterType::Pointer inverter = InverterType::New();
+          inverter->SetInput( displacementField );
+          inverter->SetTolerance( inverseFieldTolerance );
+          inverter->SetMaximumNumberOfIterations( inverseFieldMaximumNumberOfIterations );
+          inverter->SetNumberOfLevels( inverseFieldNumberOfLevels );
+          inverter->SetCacheDirectory( cacheDirectory );
+          try
+            {
+            inverter->Update();
+            }
+          catch( const itk::ExceptionObject & e )
+            {
+            std::cerr << "Error:  Unable to invert the displacement field " << transformName
+              << ":" << std::endl;
+            e.Print( std::cerr );
+            return EXIT_FAILURE;
+            }
+          catch( const std::exception & e )
+            {
+            std::cerr << "Error:  Unable to invert the displacement field " << transformName
+              << ":" << std::endl;
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+            }
+          displacementField = inverter->GetOutput();
+
+          std::cout << ( inverter->GetIsCached() ? "Cached inverse of " : "Inverted " )
+            << transformName << ": maximum residual = "
+            << inverter->GetMaximumResidual() << ", mean residual = "
+            << inverter->GetMeanResidual() << ", unconverged voxels = "
+            << inverter->GetNumberOfUnconvergedVoxels() << std::endl;
+          transformName = std::string( "inverse of " ) + transformName;
+          }
+
+        // No first-touch copy:  the point mapper of the resampler reads the
+        // field through its planes, which are first-touched when built.
+        typename DisplacementFieldTransformType::Pointer displacementFieldTransform =
+          DisplacementFieldTransformType::New();
+        displacementFieldTransform->SetDisplacementField( displacementField );
+        transform = dynamic_cast<TransformType *>( displacementFieldTransform.GetPointer() );
+        }
+
       if( !hasTransformBeenRead )
         {
         try
@@ -183,34 +930,32 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
           typename TransformReaderType::Pointer transformReader
             = TransformReaderType::New();
 
-          if( transformOption->GetNumberOfParameters( n ) == 0 )
+          transformName = ( transformOption->GetNumberOfParameters( n ) == 0 ) ?
+            transformOption->GetValue( n ) : transformOption->GetParameter( n, 0 );
+          transformReader->SetFileName( transformName.c_str() );
+          transformReader->Update();
+          transform = itk::ants::ConvertTransformPrecision<TransformType>(
+            ( ( transformReader->GetTransformList() )->front() ).GetPointer() );
+          if( !transform )
             {
-            transformName = transformOption->GetValue( n );
-            transformReader->SetFileName( transformName.c_str() );
-            transformReader->Update();
-            transform = dynamic_cast<TransformType *>(
-              ( ( transformReader->GetTransformList() )->front() ).GetPointer() );
+            std::cerr << "Error:  Cannot convert " << transformName << " ("
+              << transformReader->GetTransformList()->front()->GetTransformTypeAsString()
+              << ") to " << ( ( typeid( RealType ) == typeid( float ) ) ? "float" : "double" )
+              << "." << std::endl;
+            return EXIT_FAILURE;
             }
-          else
+          if( ( transformOption->GetNumberOfParameters( n ) > 1 ) &&
+            parser->Convert<bool>( transformOption->GetParameter( n, 1 ) ) )
             {
-            transformName = transformOption->GetParameter( n, 0 );
-            transformReader->SetFileName( transformName.c_str() );
-            transformReader->Update();
             transform = dynamic_cast<TransformType *>(
-              ( ( transformReader->GetTransformList() )->front() ).GetPointer() );
-            if( ( transformOption->GetNumberOfParameters( n ) > 1 ) &&
-              parser->Convert<bool>( transformOption->GetParameter( n, 1 ) ) )
+              transform->GetInverseTransform().GetPointer() );
+            if( !transform )
               {
-              transform = dynamic_cast<TransformType *>(
-                transform->GetInverseTransform().GetPointer() );
-              if( !transform )
-                {
-                std::cerr << "Inverse does not exist for " << transformName
-                  << std::endl;
-                return EXIT_FAILURE;
-                }
-              transformName = std::string( "inverse of " ) + transformName;
+              std::cerr << "Inverse does not exist for " << transformName
+                << std::endl;
+              return EXIT_FAILURE;
               }
+            transformName = std::string( "inverse of " ) + transformName;
             }
           }
         catch( const itk::ExceptionObject & e )
@@ -238,7 +983,10 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
 
       transformNames.push_back( transformName );
       transformTypes.push_back( transform->GetNameOfClass() );
+      report->AddFileRead( transformName );
+      compositeSize += static_cast<double>( transform->GetNumberOfParameters() ) * sizeof( RealType );
       }
+    itk::ants::ResidentObjectCache::InsertGlobal( compositeKey, compositeTransform, compositeSize );
     std::cout << "The composite transform is comprised of the following transforms "
       << "(in order): " << std::endl;
     for( unsigned int n = 0; n < transformNames.size(); n++ )
@@ -248,6 +996,77 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
       }
     }
   resampleFilter->SetTransform( compositeTransform );
+  report->StopPhase();
+
+  /**
+   * Meshes and point sets are mapped through the composite directly, in the
+   * same direction as the output voxels of an image.
+   */
+  if( isMesh )
+    {
+    typename itk::ants::CommandLineParser::OptionType::Pointer outputOption =
+      parser->GetOption( "output" );
+    if( !outputOption || outputOption->GetNumberOfValues() == 0 )
+      {
+      std::cerr << "Error:  No output mesh specified." << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::cout << "Output mesh: " << outputOption->GetValue() << std::endl;
+
+    typedef itk::StreamingVTKPolyDataTransformer<RealType, Dimension> MeshTransformerType;
+    typename MeshTransformerType::Pointer meshTransformer = MeshTransformerType::New();
+    meshTransformer->SetInputFileName( inputOption->GetValue() );
+    meshTransformer->SetOutputFileName( outputOption->GetValue() );
+    meshTransformer->SetTransform( compositeTransform );
+    report->StartPhase( "mesh warping" );
+    try
+      {
+      meshTransformer->Update();
+      }
+    catch( const itk::ExceptionObject & e )
+      {
+      std::cerr << "Error:  Unable to warp the mesh." << std::endl;
+      e.Print( std::cerr );
+      return EXIT_FAILURE;
+      }
+    report->StopPhase();
+    report->AddFileWritten( outputOption->GetValue() );
+    report->SetThroughput( static_cast<double>( meshTransformer->GetNumberOfPoints() ), "mesh warping" );
+    std::cout << "  number of vertices = " << meshTransformer->GetNumberOfPoints() << std::endl;
+    return EXIT_SUCCESS;
+    }
+  else if( isPointSet )
+    {
+    typedef itk::CompositeTransformPointMapper<RealType, Dimension> PointMapperType;
+    typename PointMapperType::Pointer pointMapper = PointMapperType::New();
+    pointMapper->SetTransform( compositeTransform );
+
+    RealType *coordinates[Dimension];
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      coordinates[d] = points.GetNumberOfPoints() > 0 ? &points.m_Coordinates[d][0] : NULL;
+      }
+    report->StartPhase( "point mapping" );
+    pointMapper->MapPoints( coordinates, points.GetNumberOfPoints() );
+    report->StopPhase();
+    report->SetThroughput( static_cast<double>( points.GetNumberOfPoints() ), "point mapping" );
+
+    typename itk::ants::CommandLineParser::OptionType::Pointer outputOption =
+      parser->GetOption( "output" );
+    if( outputOption && outputOption->GetNumberOfValues() > 0 )
+      {
+      std::cout << "Output points: " << outputOption->GetValue() << std::endl;
+      report->StartPhase( "writing" );
+      if( !WritePointSet<RealType, Dimension>( outputOption->GetValue(), points ) )
+        {
+        std::cerr << "Error:  Unable to write the points to " << outputOption->GetValue() << std::endl;
+        return EXIT_FAILURE;
+        }
+      report->StopPhase();
+      report->AddFileWritten( outputOption->GetValue() );
+      }
+    return EXIT_SUCCESS;
+    }
 
   /**
    * Interpolation option
@@ -262,7 +1081,7 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
   typename NearestNeighborInterpolatorType::Pointer nearestNeighborInterpolator
     = NearestNeighborInterpolatorType::New();
 
-  typedef itk::BSplineInterpolateImageFunction<ImageType, RealType>
+  typedef itk::CachedBSplineInterpolateImageFunction<ImageType, RealType>
     BSplineInterpolatorType;
   typename BSplineInterpolatorType::Pointer bSplineInterpolator
     = BSplineInterpolatorType::New();
@@ -272,38 +1091,46 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
   typename GaussianInterpolatorType::Pointer gaussianInterpolator
     = GaussianInterpolatorType::New();
 
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3>
+  typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+    itk::Function::HammingWindowFunction<3>, RealType>
     HammingInterpolatorType;
   typename HammingInterpolatorType::Pointer hammingInterpolator =
     HammingInterpolatorType::New();
 
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::CosineWindowFunction<3> > CosineInterpolatorType;
+  typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+    itk::Function::CosineWindowFunction<3>, RealType>
+    CosineInterpolatorType;
   typename CosineInterpolatorType::Pointer cosineInterpolator =
     CosineInterpolatorType::New();
 
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::WelchWindowFunction<3> > WelchInterpolatorType;
+  typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+    itk::Function::WelchWindowFunction<3>, RealType>
+    WelchInterpolatorType;
   typename WelchInterpolatorType::Pointer welchInterpolator =
     WelchInterpolatorType::New();
 
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::LanczosWindowFunction<3> > LanczosInterpolatorType;
+  typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+    itk::Function::LanczosWindowFunction<3>, RealType>
+    LanczosInterpolatorType;
   typename LanczosInterpolatorType::Pointer lanczosInterpolator =
     LanczosInterpolatorType::New();
 
-  typedef itk::WindowedSincInterpolateImageFunction<ImageType, 3,
-    itk::Function::BlackmanWindowFunction<3> > BlackmanInterpolatorType;
+  typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+    itk::Function::BlackmanWindowFunction<3>, RealType>
+    BlackmanInterpolatorType;
   typename BlackmanInterpolatorType::Pointer blackmanInterpolator =
     BlackmanInterpolatorType::New();
 
   const unsigned int NVectorComponents = 1;
-  typedef VectorPixelCompare<RealType, NVectorComponents> CompareType;
+  typedef VectorPixelCompare<typename itk::NumericTraits<PixelType>::RealType,
+    NVectorComponents> CompareType;
   typedef typename itk::LabelImageGaussianInterpolateImageFunction<ImageType,
     RealType, CompareType> MultiLabelInterpolatorType;
   typename MultiLabelInterpolatorType::Pointer multiLabelInterpolator =
     MultiLabelInterpolatorType::New();
 
+  // Includes the computation of B-spline coefficients.
+  report->StartPhase( "interpolator setup" );
   std::string whichInterpolator( "linear" );
 
   typename itk::ants::CommandLineParser::OptionType::Pointer interpolationOption =
@@ -318,6 +1145,12 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
       linearInterpolator->SetInputImage( resampleFilter->GetInput() );
       resampleFilter->SetInterpolator( linearInterpolator );
       }
+    else if( !std::strcmp( whichInterpolator.c_str(), "antialiased" ) )
+      {
+      linearInterpolator->SetInputImage( resampleFilter->GetInput() );
+      resampleFilter->SetInterpolator( linearInterpolator );
+      resampleFilter->SetUseAntiAliasing( true );
+      }
     else if( !std::strcmp( whichInterpolator.c_str(), "nearestneighbor" ) )
       {
       nearestNeighborInterpolator->SetInputImage( resampleFilter->GetInput() );
@@ -325,13 +1158,26 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
       }
     else if( !std::strcmp( whichInterpolator.c_str(), "bspline" ) )
       {
-      bSplineInterpolator->SetInputImage( resampleFilter->GetInput() );
+      // The order has to be known before the coefficients are computed
+      // (or looked up) when the input is set.
       if( interpolationOption->GetNumberOfParameters() > 0 )
         {
         unsigned int bsplineOrder = parser->Convert<unsigned int>(
           interpolationOption->GetParameter( 0, 0 ) );
         bSplineInterpolator->SetSplineOrder( bsplineOrder );
         }
+      typename itk::ants::CommandLineParser::OptionType::Pointer coefficientsOption =
+        parser->GetOption( "bspline-coefficients" );
+      if( coefficientsOption && coefficientsOption->GetNumberOfValues() > 0 )
+        {
+        bSplineInterpolator->SetCoefficientFileName( coefficientsOption->GetValue() );
+        }
+      bSplineInterpolator->SetCacheDirectory( cacheDirectory );
+      bSplineInterpolator->SetInputImage( resampleFilter->GetInput() );
+      if( bSplineInterpolator->GetIsCached() )
+        {
+        std::cout << "  Reusing the stored B-spline coefficients." << std::endl;
+        }
       resampleFilter->SetInterpolator( bSplineInterpolator );
       }
     else if( !std::strcmp( whichInterpolator.c_str(), "gaussian" ) )
@@ -376,6 +1222,11 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
       cosineInterpolator->SetInputImage( resampleFilter->GetInput() );
       resampleFilter->SetInterpolator( cosineInterpolator );
       }
+    else if( !std::strcmp( whichInterpolator.c_str(), "welchwindowedsinc" ) )
+      {
+      welchInterpolator->SetInputImage( resampleFilter->GetInput() );
+      resampleFilter->SetInterpolator( welchInterpolator );
+      }
     else if( !std::strcmp( whichInterpolator.c_str(), "hammingwindowedsinc" ) )
       {
       hammingInterpolator->SetInputImage( resampleFilter->GetInput() );
@@ -422,172 +1273,845 @@ int antsApplyTransforms( itk::ants::CommandLineParser *parser )
           }
         }
 
-      multiLabelInterpolator->SetParameters( sigma, alpha );
-      resampleFilter->SetInterpolator( multiLabelInterpolator );
-      }
-    else
-      {
-      std::cerr << "Error:  Unrecognized interpolation option." << std::endl;
-      return EXIT_FAILURE;
-      }
-    }
-  std::cout << "Interpolation type: " <<
-    resampleFilter->GetInterpolator()->GetNameOfClass() << std::endl;
+      multiLabelInterpolator->SetParameters( sigma, alpha );
+      resampleFilter->SetInterpolator( multiLabelInterpolator );
+      }
+    else
+      {
+      std::cerr << "Error:  Unrecognized interpolation option." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+  report->StopPhase();
+  std::cout << "Interpolation type: " <<
+    resampleFilter->GetInterpolator()->GetNameOfClass() << std::endl;
+
+  /**
+   * Default voxel value
+   */
+  typename itk::ants::CommandLineParser::OptionType::Pointer defaultOption =
+    parser->GetOption( "default-value" );
+  if( defaultOption )
+    {
+    PixelType defaultValue =
+      parser->Convert<PixelType>( defaultOption->GetValue() );
+    resampleFilter->SetDefaultPixelValue( defaultValue );
+    }
+  std::cout << "Default pixel value: " <<
+    resampleFilter->GetDefaultPixelValue() << std::endl;
+
+  /**
+   * Coordinate lattice option:  approximate smooth transforms from a
+   * lattice of exactly mapped points.
+   */
+  typename itk::ants::CommandLineParser::OptionType::Pointer latticeOption =
+    parser->GetOption( "coordinate-lattice" );
+  if( latticeOption && latticeOption->GetNumberOfValues() > 0 )
+    {
+    unsigned int latticeSpacing = 4;
+    double coordinateTolerance = 0.05;
+    if( latticeOption->GetNumberOfParameters( 0 ) > 0 )
+      {
+      latticeSpacing = parser->Convert<unsigned int>( latticeOption->GetParameter( 0, 0 ) );
+      if( latticeOption->GetNumberOfParameters( 0 ) > 1 )
+        {
+        coordinateTolerance = parser->Convert<double>( latticeOption->GetParameter( 0, 1 ) );
+        }
+      }
+    else
+      {
+      latticeSpacing = parser->Convert<unsigned int>( latticeOption->GetValue() );
+      }
+    if( latticeSpacing < 1 || coordinateTolerance < 0.0 )
+      {
+      std::cerr << "Error:  The coordinate lattice requires a spacing of at least 1 "
+        << "and a non-negative tolerance." << std::endl;
+      return EXIT_FAILURE;
+      }
+    resampleFilter->SetCoordinateLatticeSpacing( latticeSpacing );
+    resampleFilter->SetCoordinateTolerance( coordinateTolerance );
+    std::cout << "Coordinate lattice: every " << latticeSpacing << " voxels, tolerance "
+      << coordinateTolerance << std::endl;
+    }
+
+  /**
+   * Tiling option:  traverse the output in tiles and store the input of
+   * the linear interpolation in bricks.
+   */
+  typename itk::ants::CommandLineParser::OptionType::Pointer tilingOption =
+    parser->GetOption( "tiling" );
+  if( tilingOption && tilingOption->GetNumberOfValues() > 0 )
+    {
+    unsigned int tileSize = 16;
+    bool brickedInput = true;
+    if( tilingOption->GetNumberOfParameters( 0 ) > 0 )
+      {
+      tileSize = parser->Convert<unsigned int>( tilingOption->GetParameter( 0, 0 ) );
+      if( tilingOption->GetNumberOfParameters( 0 ) > 1 )
+        {
+        brickedInput = parser->Convert<bool>( tilingOption->GetParameter( 0, 1 ) );
+        }
+      }
+    else
+      {
+      tileSize = parser->Convert<unsigned int>( tilingOption->GetValue() );
+      }
+    if( tileSize < 1 )
+      {
+      std::cerr << "Error:  The tile size must be at least 1." << std::endl;
+      return EXIT_FAILURE;
+      }
+    resampleFilter->SetOutputTileSize( tileSize );
+    resampleFilter->SetUseBrickedInput( brickedInput );
+    std::cout << "Tiling: output tiles of " << tileSize << "^" << Dimension << " voxels";
+    if( brickedInput )
+      {
+      std::cout << ", input in bricks";
+      }
+    std::cout << std::endl;
+    }
+
+  /**
+   * Work stealing option:  schedule small work units dynamically over the
+   * threads.
+   */
+  typename itk::ants::CommandLineParser::OptionType::Pointer workStealingOption =
+    parser->GetOption( "work-stealing" );
+  if( workStealingOption && workStealingOption->GetNumberOfValues() > 0 &&
+    parser->Convert<bool>( workStealingOption->GetValue() ) )
+    {
+    resampleFilter->SetUseWorkStealing( true );
+    std::cout << "Work stealing: output scheduled in work units over the threads." << std::endl;
+    }
+
+  /**
+   * Polyphase zoom option:  filter axis aligned resamplings separably.
+   */
+  typename itk::ants::CommandLineParser::OptionType::Pointer polyphaseZoomOption =
+    parser->GetOption( "polyphase-zoom" );
+  if( polyphaseZoomOption && polyphaseZoomOption->GetNumberOfValues() > 0 )
+    {
+    resampleFilter->SetUsePolyphaseZoom( parser->Convert<bool>( polyphaseZoomOption->GetValue() ) );
+    }
+
+  /**
+   * Coordinate map of the resident service:  the points mapped through the
+   * same composite onto the same output grid are reused.
+   */
+  typedef typename ResamplerType::CoordinateMapType CoordinateMapType;
+  std::string coordinateMapKey( "" );
+  if( !compositeKey.empty() )
+    {
+    resampleFilter->UpdateOutputInformation();
+    const ImageType *output = resampleFilter->GetOutput();
+
+    std::ostringstream oss;
+    oss << std::setprecision( 17 ) << typeid( CoordinateMapType ).name() << "|" << compositeKey;
+    if( resampleFilter->GetCoordinateLatticeSpacing() > 1 )
+      {
+      oss << "|lattice" << resampleFilter->GetCoordinateLatticeSpacing() << ","
+        << resampleFilter->GetCoordinateTolerance();
+      }
+    for( unsigned int i = 0; i < Dimension; i++ )
+      {
+      oss << "|" << output->GetOrigin()[i] << "," << output->GetSpacing()[i] << ","
+        << output->GetLargestPossibleRegion().GetIndex()[i] << ","
+        << output->GetLargestPossibleRegion().GetSize()[i];
+      for( unsigned int j = 0; j < Dimension; j++ )
+        {
+        oss << "," << output->GetDirection()[i][j];
+        }
+      }
+    coordinateMapKey = oss.str();
+
+    typename CoordinateMapType::Pointer coordinateMap =
+      itk::ants::ResidentObjectCache::FindGlobal<CoordinateMapType>( coordinateMapKey );
+    if( coordinateMap )
+      {
+      std::cout << "Coordinate map: resident" << std::endl;
+      resampleFilter->SetCoordinateMap( coordinateMap );
+      }
+    else
+      {
+      resampleFilter->SetRecordCoordinateMap( true );
+      }
+    }
+
+  /**
+   * output
+   */
+  int compressionLevel = 6;
+  typename itk::ants::CommandLineParser::OptionType::Pointer compressionOption =
+    parser->GetOption( "compression-level" );
+  if( compressionOption && compressionOption->GetNumberOfValues() > 0 )
+    {
+    compressionLevel = itk::ants::ParallelGzipCompressor::ParseCompressionLevel(
+      compressionOption->GetValue() );
+    if( compressionLevel < 0 )
+      {
+      std::cerr << "Unrecognized compression level: "
+        << compressionOption->GetValue() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  unsigned int numberOfPyramidLevels = 1;
+  typename itk::ants::CommandLineParser::OptionType::Pointer pyramidOption =
+    parser->GetOption( "output-pyramid" );
+  if( pyramidOption && pyramidOption->GetNumberOfValues() > 0 )
+    {
+    numberOfPyramidLevels = parser->Convert<unsigned int>( pyramidOption->GetValue() );
+    if( numberOfPyramidLevels < 1 )
+      {
+      std::cerr << "The output pyramid needs at least one level." << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Whether the resampler has run, i.e. the Jacobian determinant only
+  // needs to be written.
+  bool isResampled = false;
+
+  typename itk::ants::CommandLineParser::OptionType::Pointer outputOption =
+    parser->GetOption( "output" );
+  if( outputOption && outputOption->GetNumberOfValues() > 0 &&
+    resampleFilter->GetResampleInput() )
+    {
+    std::cout << "Output object: " << outputOption->GetValue() << std::endl;
+
+    // The first reduction of the pyramid is done row by row by the
+    // resampler.
+    resampleFilter->SetComputeRowReducedOutput( numberOfPyramidLevels > 1 );
+
+    // Uncompressed MetaImage outputs are resampled directly into the
+    // mapped output file.
+    typedef itk::MemoryMappedImageFileWriter<ImageType> MappedWriterType;
+    typename MappedWriterType::Pointer mappedWriter = MappedWriterType::New();
+    mappedWriter->SetFileName( outputOption->GetValue() );
+
+    typename MappedWriterType::MappedPixelContainerType *outputContainer = NULL;
+    if( useMemoryMapping && MappedWriterType::CanWriteFile( outputOption->GetValue() ) )
+      {
+      resampleFilter->UpdateOutputInformation();
+      outputContainer = mappedWriter->CreatePixelContainer( resampleFilter->GetOutput() );
+      }
+
+    if( outputContainer )
+      {
+      std::cout << "  (memory mapped)" << std::endl;
+      resampleFilter->SetOutputPixelContainer( outputContainer );
+      report->StartPhase( "resampling" );
+      resampleFilter->Update();
+      isResampled = true;
+      report->StartPhase( "writing" );
+      mappedWriter->Flush();
+      report->StopPhase();
+      }
+    else
+      {
+      report->StartPhase( "resampling" );
+      resampleFilter->Update();
+      isResampled = true;
+      report->StartPhase( "writing" );
+
+      typedef  itk::ParallelGzipImageFileWriter<ImageType> WriterType;
+      typename WriterType::Pointer writer = WriterType::New();
+      writer->SetInput( resampleFilter->GetOutput() );
+      writer->SetFileName( outputOption->GetValue() );
+      writer->SetCompressionLevel( compressionLevel );
+      writer->Update();
+      report->StopPhase();
+      }
+    report->AddFileWritten( outputOption->GetValue() );
+
+    if( numberOfPyramidLevels > 1 )
+      {
+      report->StartPhase( "pyramid" );
+      typedef itk::AntiAliasedImagePyramid<ImageType> PyramidType;
+      typename PyramidType::Pointer pyramid = PyramidType::New();
+      pyramid->SetInput( resampleFilter->GetOutput() );
+      pyramid->SetRowReducedInput( resampleFilter->GetRowReducedOutput() );
+      pyramid->SetNumberOfLevels( numberOfPyramidLevels );
+      pyramid->Update();
+
+      typedef  itk::ParallelGzipImageFileWriter<ImageType> WriterType;
+      for( unsigned int level = 1; level < numberOfPyramidLevels; level++ )
+        {
+        std::string levelFileName = GetPyramidLevelFileName( outputOption->GetValue(), level );
+        std::cout << "  Level " << level << " (1/" << ( 1u << level ) << " resolution): "
+          << levelFileName << std::endl;
+
+        typename WriterType::Pointer writer = WriterType::New();
+        writer->SetInput( pyramid->GetOutput( level ) );
+        writer->SetFileName( levelFileName );
+        writer->SetCompressionLevel( compressionLevel );
+        writer->Update();
+        report->AddFileWritten( levelFileName );
+        }
+      report->StopPhase();
+      }
+    }
+
+  /**
+   * Jacobian determinant, computed in the same pass as the output.
+   */
+  if( !jacobianFileName.empty() )
+    {
+    std::cout << ( useLogJacobian ? "Log Jacobian" : "Jacobian" ) << " determinant: "
+      << jacobianFileName << std::endl;
+
+    if( !isResampled )
+      {
+      report->StartPhase( "resampling" );
+      resampleFilter->Update();
+      }
+    report->StartPhase( "jacobian writing" );
+
+    typedef typename ResamplerType::JacobianDeterminantImageType JacobianImageType;
+    typedef  itk::ParallelGzipImageFileWriter<JacobianImageType> JacobianWriterType;
+    typename JacobianWriterType::Pointer jacobianWriter = JacobianWriterType::New();
+    jacobianWriter->SetInput( resampleFilter->GetJacobianDeterminantImage() );
+    jacobianWriter->SetFileName( jacobianFileName );
+    jacobianWriter->SetCompressionLevel( compressionLevel );
+    jacobianWriter->Update();
+    report->StopPhase();
+    report->AddFileWritten( jacobianFileName );
+    }
+
+  if( resampleFilter->GetNumberOfLatticeCells() > 0 )
+    {
+    std::cout << "Coordinate lattice: " << resampleFilter->GetNumberOfExactLatticeCells()
+      << " of " << resampleFilter->GetNumberOfLatticeCells()
+      << " cells exceeded the tolerance and were mapped exactly." << std::endl;
+    }
+
+  if( resampleFilter->GetIsZooming() )
+    {
+    std::cout << "Axis aligned resampling: filtered separably with tabulated kernels." << std::endl;
+    }
+
+  if( resampleFilter->GetUseAntiAliasing() )
+    {
+    std::cout << "Anti-aliasing: " << resampleFilter->GetNumberOfAntiAliasingLevels()
+      << " input pyramid levels used." << std::endl;
+    }
+
+  if( resampleFilter->GetRecordCoordinateMap() && resampleFilter->GetCoordinateMap() )
+    {
+    itk::ants::ResidentObjectCache::InsertGlobal( coordinateMapKey,
+      resampleFilter->GetCoordinateMap(), GetImageSizeInBytes( resampleFilter->GetCoordinateMap() ) );
+    }
+
+  if( resampleFilter->GetMeasurePhaseTimes() )
+    {
+    report->AddPhaseTime( "coordinate mapping", resampleFilter->GetMappingTime(), true );
+    report->AddPhaseTime( "interpolation", resampleFilter->GetInterpolationTime(), true );
+    report->SetThroughput( static_cast<double>(
+      resampleFilter->GetOutput()->GetRequestedRegion().GetNumberOfPixels() ), "resampling" );
+    }
+
+  return EXIT_SUCCESS;
+}
+
+void InitializeCommandLineOptions( itk::ants::CommandLineParser *parser )
+{
+  typedef itk::ants::CommandLineParser::OptionType OptionType;
+
+  {
+  std::string description =
+    std::string( "This option forces the image to be treated as a specified-" ) +
+    std::string( "dimensional image.  If not specified, antsWarp tries to " ) +
+    std::string( "infer the dimensionality from the input image." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "dimensionality" );
+  option->SetShortName( 'd' );
+  option->SetUsageOption( 0, "2/3" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "The input object is an image (default) or a point set " ) +
+    std::string( "(see --input-object-type).  The framework allows for " ) +
+    std::string( "warping of other objects such as meshes." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "input" );
+  option->SetShortName( 'i' );
+  option->SetUsageOption( 0, "inputFileName" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Type of the input object.  Point sets are read from CSV " ) +
+    std::string( "files (.csv/.txt, one point per line, the coordinates in " ) +
+    std::string( "the first columns, an optional header line and additional " ) +
+    std::string( "columns are passed through) or from binary files of " ) +
+    std::string( "interleaved single (.f32) or double (.f64) precision " ) +
+    std::string( "coordinates.  The output format is chosen by the extension " ) +
+    std::string( "of the output file.  Coordinates are physical (LPS) " ) +
+    std::string( "coordinates.  Each point is mapped like an output voxel of " ) +
+    std::string( "a warped image, i.e. from the reference space to the input " ) +
+    std::string( "space, so the transforms that map points the other way are " ) +
+    std::string( "the inverses in reverse order.  The dimensionality has to " ) +
+    std::string( "be given for point sets.  Meshes are legacy VTK PolyData " ) +
+    std::string( "files (.vtk, ASCII or BINARY):  the vertices are warped " ) +
+    std::string( "in chunks and the connectivity and attributes are copied " ) +
+    std::string( "to the output unchanged.  Meshes are 3-D unless specified " ) +
+    std::string( "otherwise." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "input-object-type" );
+  option->SetShortName( 'e' );
+  option->SetUsageOption( 0, "image" );
+  option->SetUsageOption( 1, "points" );
+  option->SetUsageOption( 2, "mesh" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "For warping input images, the reference image defines the " ) +
+    std::string( "spacing, origin, size, and direction of the output warped " ) +
+    std::string( "image. ");
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "reference-image" );
+  option->SetShortName( 'r' );
+  option->SetUsageOption( 0, "imageFileName" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "The warped object (image or point set)." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "output" );
+  option->SetShortName( 'o' );
+  option->SetUsageOption( 0, "warpedOutputFileName" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Several interpolation options are available in ITK. " ) +
+    std::string( "These have all been made available.  AntiAliased interpolates " ) +
+    std::string( "linearly in a smoothed, decimated copy of the input whose " ) +
+    std::string( "resolution matches the local spacing of the warped output " ) +
+    std::string( "grid, which avoids aliasing when downsampling at about the " ) +
+    std::string( "cost of Linear." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "interpolation" );
+  option->SetShortName( 'n' );
+  option->SetUsageOption( 0, "Linear" );
+  option->SetUsageOption( 1, "NearestNeighbor" );
+  option->SetUsageOption( 2, "MultiLabel[<sigma=imageSpacing>,<alpha=4.0>]" );
+  option->SetUsageOption( 3, "Gaussian[<sigma=imageSpacing>,<alpha=1.0>]" );
+  option->SetUsageOption( 4, "BSpline[<order=3>]" );
+  option->SetUsageOption( 5, "CosineWindowedSinc" );
+  option->SetUsageOption( 6, "WelchWindowedSinc" );
+  option->SetUsageOption( 7, "HammingWindowedSinc" );
+  option->SetUsageOption( 8, "LanczosWindowedSinc" );
+  option->SetUsageOption( 9, "AntiAliased" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Several transform options are supported including all " ) +
+    std::string( "those defined in the ITK library in addition to " ) +
+    std::string( "a deformation field transform.  The ordering of " ) +
+    std::string( "the transformations follows the ordering specified " ) +
+    std::string( "on the command line.  An identity transform is pushed " ) +
+    std::string( "onto the transformation stack. Each new transform " ) +
+    std::string( "encountered on the command line is also pushed onto " ) +
+    std::string( "the transformation stack. Then, to warp the input object, " ) +
+    std::string( "each point comprising the input object is warped first " ) +
+    std::string( "according to the last transform pushed onto the stack " ) +
+    std::string( "followed by the second to last transform, etc. until " ) +
+    std::string( "the last transform encountered which is the identity " ) +
+    std::string( "transform. " ) +
+    std::string( "Also, it should be noted that the inverse transform can " ) +
+    std::string( "be accommodated with the usual caveat that such an inverse " ) +
+    std::string( "must be defined by the specified transform class " );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "transform" );
+  option->SetShortName( 't' );
+  option->SetUsageOption( 0, "transformFileName" );
+  option->SetUsageOption( 1, "[transformFileName,useInverse]" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Only output voxels inside the (non-zero part of the) mask " ) +
+    std::string( "are mapped and interpolated.  The other voxels are set to " ) +
+    std::string( "the default value.  The mask does not need to share the " ) +
+    std::string( "grid of the reference image." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "output-mask" );
+  option->SetShortName( 'x' );
+  option->SetUsageOption( 0, "maskFileName" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Crop the output to a region of the reference image given " ) +
+    std::string( "by its start index and size (e.g. [10x20x5,100x120x80]). " ) +
+    std::string( "The origin of the output is moved such that the cropped " ) +
+    std::string( "output starts at index 0 and overlays the reference." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "output-region" );
+  option->SetUsageOption( 0, "[startIndex,size]" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Compute only the k-th (0 <= k < N) of N slabs of the output " ) +
+    std::string( "(or of the output region) along its last axis, e.g. one per " ) +
+    std::string( "task of a cluster job array.  As for --output-region, the " ) +
+    std::string( "origin of the slab places it in the reference.  Written as " ) +
+    std::string( "uncompressed MetaImage (.mha) files, the shards are assembled " ) +
+    std::string( "with --stitch." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "shard" );
+  option->SetUsageOption( 0, "k/N" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Assemble shards (see --shard) stored as uncompressed " ) +
+    std::string( "MetaImage (.mha) files into the output (.mha) file and exit. " ) +
+    std::string( "The shards may be given in any order; their voxel data is " ) +
+    std::string( "copied block by block without decoding.  No other option is " ) +
+    std::string( "needed." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "stitch" );
+  option->SetUsageOption( 0, "[outputFileName,shardFileName1,shardFileName2,...]" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Approximate smooth transforms:  the composite transform is " ) +
+    std::string( "evaluated exactly on a lattice of every latticeSpacing-th " ) +
+    std::string( "output voxel along each axis and multilinearly interpolated " ) +
+    std::string( "in between.  Each lattice cell is checked at its centre; " ) +
+    std::string( "cells where the interpolated point is off by more than the " ) +
+    std::string( "tolerance (in mm) are mapped exactly.  Meant for outputs " ) +
+    std::string( "much finer than the transforms, e.g. upsampled warps " ) +
+    std::string( "through B-spline or smooth displacement fields.  Not used " ) +
+    std::string( "for purely affine transforms, which are mapped " ) +
+    std::string( "incrementally anyway." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "coordinate-lattice" );
+  option->SetUsageOption( 0, "latticeSpacing" );
+  option->SetUsageOption( 1, "[latticeSpacing,<tolerance=0.05>]" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Traverse the output in tiles of tileSize voxels along " ) +
+    std::string( "each axis instead of whole rows.  With linear " ) +
+    std::string( "interpolation the input is also stored in bricks of 8 " ) +
+    std::string( "voxels along each axis unless brickedInput is 0.  Helps " ) +
+    std::string( "when the output is rotated or warped with respect to " ) +
+    std::string( "large inputs, since the voxels read for a tile then stay " ) +
+    std::string( "in cache.  Not used with the Jacobian determinant or the " ) +
+    std::string( "output pyramid." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "tiling" );
+  option->SetUsageOption( 0, "tileSize" );
+  option->SetUsageOption( 1, "[tileSize,<brickedInput=1>]" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Cut the output part of each thread into small work units " ) +
+    std::string( "of whole rows.  A thread that has finished its own units " ) +
+    std::string( "takes the remaining ones of other threads.  Useful when " ) +
+    std::string( "the cost per voxel varies strongly across the output, " ) +
+    std::string( "e.g. MultiLabel or Gaussian interpolation, masked outputs " ) +
+    std::string( "or warps that leave much of the output outside the input. " ) +
+    std::string( "Not used with the Jacobian determinant." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "work-stealing" );
+  option->SetUsageOption( 0, "(0)/1" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "If the transforms reduce to an affine map that only scales " ) +
+    std::string( "and translates along the axes of the input (e.g. an integer " ) +
+    std::string( "zoom onto an aligned grid), tabulate the 1-D kernels of the " ) +
+    std::string( "Linear, BSpline, Gaussian or windowed sinc interpolator once " ) +
+    std::string( "per axis and filter the input separably instead of " ) +
+    std::string( "interpolating voxel by voxel.  The result equals the one of " ) +
+    std::string( "the interpolator up to rounding.  On by default; 0 " ) +
+    std::string( "interpolates voxel by voxel." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "polyphase-zoom" );
+  option->SetUsageOption( 0, "0/(1)" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Also write the output at 1/2, 1/4, ... resolution, up to " ) +
+    std::string( "numberOfLevels levels including the full resolution output. " ) +
+    std::string( "Each level is smoothed with a [1 2 1]/4 kernel and " ) +
+    std::string( "subsampled by 2 from the previous one, keeping the " ) +
+    std::string( "position of voxel 0.  Level k is written to " ) +
+    std::string( "<output>_level<k> with the extension of the output." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "output-pyramid" );
+  option->SetUsageOption( 0, "numberOfLevels" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Compute the Jacobian determinant of the composite " ) +
+    std::string( "transform (or its logarithm) on the output grid.  It is " ) +
+    std::string( "computed from finite differences of the mapped voxel " ) +
+    std::string( "positions in the same pass as the warped image.  If no " ) +
+    std::string( "input image is given, only the Jacobian determinant is " ) +
+    std::string( "computed on the grid of the reference image." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "jacobian-determinant" );
+  option->SetShortName( 'j' );
+  option->SetUsageOption( 0, "jacobianFileName" );
+  option->SetUsageOption( 1, "[jacobianFileName,<useLog=0>]" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Default voxel value to be used with input images only. " ) +
+    std::string( "Specifies the voxel value when the input point maps outside " ) +
+    std::string( "the output domain" );
 
-  /**
-   * Default voxel value
-   */
-  typename itk::ants::CommandLineParser::OptionType::Pointer defaultOption =
-    parser->GetOption( "default-value" );
-  if( defaultOption )
-    {
-    PixelType defaultValue =
-      parser->Convert<PixelType>( defaultOption->GetValue() );
-    resampleFilter->SetDefaultPixelValue( defaultValue );
-    }
-  std::cout << "Default pixel value: " <<
-    resampleFilter->GetDefaultPixelValue() << std::endl;
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "default-value" );
+  option->SetShortName( 'v' );
+  option->SetUsageOption( 0, "value" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
 
-  /**
-   * output
-   */
-  typename itk::ants::CommandLineParser::OptionType::Pointer outputOption =
-    parser->GetOption( "output" );
-  if( outputOption )
-    {
-    std::cout << "Output object: " << outputOption->GetValue() << std::endl;
 
-    typedef  itk::ImageFileWriter<ImageType> WriterType;
-    typename WriterType::Pointer writer = WriterType::New();
-    writer->SetInput( resampleFilter->GetOutput() );
-    writer->SetFileName( ( outputOption->GetValue() ).c_str() );
-    writer->Update();
-    }
+  {
+  std::string description =
+    std::string( "Memory map the input image and displacement fields instead " ) +
+    std::string( "of reading them into newly allocated buffers.  This applies " ) +
+    std::string( "to uncompressed NIfTI (.nii) and MetaImage (.mha/.mhd) files " ) +
+    std::string( "stored with the pixel type used for the computations.  " ) +
+    std::string( "Uncompressed MetaImage (.mha) outputs are resampled directly " ) +
+    std::string( "into the mapped output file.  Other files are read and " ) +
+    std::string( "written as usual." );
 
-  return EXIT_SUCCESS;
-}
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "memory-map" );
+  option->SetUsageOption( 0, "0/(1)" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
 
-void InitializeCommandLineOptions( itk::ants::CommandLineParser *parser )
-{
-  typedef itk::ants::CommandLineParser::OptionType OptionType;
+  {
+  std::string description =
+    std::string( "Directory used to cache decompressed copies of gzipped " ) +
+    std::string( "(.nii.gz) inputs.  The cached copies are named after a hash " ) +
+    std::string( "of the compressed file and are memory mapped on subsequent " ) +
+    std::string( "runs, i.e. repeated warps of the same template and fields " ) +
+    std::string( "skip the decompression.  Implies --memory-map." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "cache-directory" );
+  option->SetUsageOption( 0, "directory" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
 
   {
   std::string description =
-    std::string( "This option forces the image to be treated as a specified-" ) +
-    std::string( "dimensional image.  If not specified, antsWarp tries to " ) +
-    std::string( "infer the dimensionality from the input image." );
+    std::string( "Parameters of the inversion of displacement fields given " ) +
+    std::string( "as [fieldFileName,1].  At each voxel the inverse v is " ) +
+    std::string( "iterated as v <- -u(x+v) until the residual is below the " ) +
+    std::string( "tolerance (in units of the smallest spacing of the field) " ) +
+    std::string( "or the maximum number of iterations is reached, starting " ) +
+    std::string( "from the inverse on a grid coarsened by 2^(numberOfLevels-1). " ) +
+    std::string( "The residuals are reported; they remain large where the " ) +
+    std::string( "field folds.  With --cache-directory, the inverse is cached " ) +
+    std::string( "there by content hash and parameters." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "dimensionality" );
-  option->SetShortName( 'd' );
-  option->SetUsageOption( 0, "2/3" );
+  option->SetLongName( "field-inversion" );
+  option->SetUsageOption( 0, "[<tolerance=0.01>,<maximumNumberOfIterations=20>,<numberOfLevels=3>]" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
   {
   std::string description =
-    std::string( "Currently, the only input objects supported are image " ) +
-    std::string( "objects.  However, the current framework allows for " ) +
-    std::string( "warping of other objects such as meshes and point sets. ");
+    std::string( "File in which the coefficients of the B-spline interpolator " ) +
+    std::string( "are stored (in single precision), e.g. next to the input " ) +
+    std::string( "image.  If the file exists and matches the input and spline " ) +
+    std::string( "order it is loaded instead of recomputing the coefficients.  " ) +
+    std::string( "With --cache-directory, the coefficients are also cached " ) +
+    std::string( "there by content hash and spline order." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "input" );
-  option->SetShortName( 'i' );
-  option->SetUsageOption( 0, "inputFileName" );
+  option->SetLongName( "bspline-coefficients" );
+  option->SetUsageOption( 0, "coefficientFileName" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
   {
   std::string description =
-    std::string( "For warping input images, the reference image defines the " ) +
-    std::string( "spacing, origin, size, and direction of the output warped " ) +
-    std::string( "image. ");
+    std::string( "Use 'float' instead of 'double' for the computations, i.e. " ) +
+    std::string( "the input and output images, the transforms and the " ) +
+    std::string( "displacement fields are stored in single precision.  This " ) +
+    std::string( "halves the memory and bandwidth required by the " ) +
+    std::string( "displacement fields." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "reference-image" );
-  option->SetShortName( 'r' );
-  option->SetUsageOption( 0, "imageFileName" );
+  option->SetLongName( "float" );
+  option->SetUsageOption( 0, "0/(1)" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
   {
   std::string description =
-    std::string( "The warped object---currently only valid for images." );
+    std::string( "Compression level (0-9) used for gzipped (.nii.gz) outputs. " ) +
+    std::string( "The output is compressed in independent blocks on all " ) +
+    std::string( "threads.  Use 'fast' (= 1) for scratch outputs and 'best' " ) +
+    std::string( "(= 9) for archival.  Default = 6." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "output" );
-  option->SetShortName( 'o' );
-  option->SetUsageOption( 0, "warpedOutputFileName" );
+  option->SetLongName( "compression-level" );
+  option->SetUsageOption( 0, "0-9/fast/best/(default)" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
   {
   std::string description =
-    std::string( "Several interpolation options are available in ITK. " ) +
-    std::string( "These have all been made available." );
+    std::string( "Time the phases of the run (header and input reading " ) +
+    std::string( "including decompression, transform loading, coordinate " ) +
+    std::string( "mapping, interpolation, writing including compression) and " ) +
+    std::string( "report them with the bytes read and written and the " ) +
+    std::string( "voxels per second.  If a file name is given, the report is " ) +
+    std::string( "also appended to it as a single line JSON record." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "interpolation" );
-  option->SetShortName( 'n' );
-  option->SetUsageOption( 0, "Linear" );
-  option->SetUsageOption( 1, "NearestNeighbor" );
-  option->SetUsageOption( 2, "MultiLabel[<sigma=imageSpacing>,<alpha=4.0>]" );
-  option->SetUsageOption( 3, "Gaussian[<sigma=imageSpacing>,<alpha=1.0>]" );
-  option->SetUsageOption( 4, "BSpline[<order=3>]" );
-  option->SetUsageOption( 5, "CosineWindowedSinc" );
-  option->SetUsageOption( 6, "WelchWindowedSinc" );
-  option->SetUsageOption( 7, "HammingWindowedSinc" );
-  option->SetUsageOption( 8, "LanczosWindowedSinc" );
+  option->SetLongName( "timing-report" );
+  option->SetUsageOption( 0, "(0)/1/jsonFileName" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
   {
   std::string description =
-    std::string( "Several transform options are supported including all " ) +
-    std::string( "those defined in the ITK library in addition to " ) +
-    std::string( "a deformation field transform.  The ordering of " ) +
-    std::string( "the transformations follows the ordering specified " ) +
-    std::string( "on the command line.  An identity transform is pushed " ) +
-    std::string( "onto the transformation stack. Each new transform " ) +
-    std::string( "encountered on the command line is also pushed onto " ) +
-    std::string( "the transformation stack. Then, to warp the input object, " ) +
-    std::string( "each point comprising the input object is warped first " ) +
-    std::string( "according to the last transform pushed onto the stack " ) +
-    std::string( "followed by the second to last transform, etc. until " ) +
-    std::string( "the last transform encountered which is the identity " ) +
-    std::string( "transform. " ) +
-    std::string( "Also, it should be noted that the inverse transform can " ) +
-    std::string( "be accommodated with the usual caveat that such an inverse " ) +
-    std::string( "must be defined by the specified transform class " );
+    std::string( "Run as a resident service which listens on a local (Unix) " ) +
+    std::string( "socket for requests of antsApplyTransformsClient, given in " ) +
+    std::string( "the syntax of antsApplyTransforms.  Decoded input, reference " ) +
+    std::string( "and mask images, composite transforms and the mapped points " ) +
+    std::string( "of recent requests are kept in memory (least recently used " ) +
+    std::string( "first out) and reused if their files have not changed.  " ) +
+    std::string( "Requests are run one at a time with the threads of the " ) +
+    std::string( "service; their thread options are ignored.  The service " ) +
+    std::string( "stops on SIGINT or SIGTERM." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "transform" );
-  option->SetShortName( 't' );
-  option->SetUsageOption( 0, "transformFileName" );
-  option->SetUsageOption( 1, "[transformFileName,useInverse]" );
+  option->SetLongName( "daemon" );
+  option->SetUsageOption( 0, "socketFile" );
+  option->SetUsageOption( 1, "[socketFile,<cacheSizeInMB=4096>]" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
   {
   std::string description =
-    std::string( "Default voxel value to be used with input images only. " ) +
-    std::string( "Specifies the voxel value when the input point maps outside " ) +
-    std::string( "the output domain" );
+    std::string( "Number of threads.  Default is the number of CPUs (of the " ) +
+    std::string( "NUMA node given by --numa-node), or ITK_GLOBAL_DEFAULT_NUMBER_OF_THREADS." );
 
   OptionType::Pointer option = OptionType::New();
-  option->SetLongName( "default-value" );
-  option->SetShortName( 'v' );
-  option->SetUsageOption( 0, "value" );
+  option->SetLongName( "threads" );
+  option->SetUsageOption( 0, "numberOfThreads" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description =
+    std::string( "Run all threads on the CPUs of the given NUMA node (and " ) +
+    std::string( "allocate the images in its memory)." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "numa-node" );
+  option->SetUsageOption( 0, "node" );
   option->SetDescription( description );
   parser->AddOption( option );
   }
 
+  {
+  std::string description =
+    std::string( "Bind each resampling thread to a CPU, in the order of the " ) +
+    std::string( "NUMA nodes.  The output is split into slabs in thread " ) +
+    std::string( "order, so each node computes (and first-touches) a " ) +
+    std::string( "contiguous part of the output.  The input image is copied " ) +
+    std::string( "slab by slab by the same threads such that its pages are " ) +
+    std::string( "spread over the nodes in the same way, unless it is memory " ) +
+    std::string( "mapped (see --memory-map), in which case the mapping is used " ) +
+    std::string( "in place.  The per-component planes of the displacement " ) +
+    std::string( "fields are built by the same threads as well." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "bind" );
+  option->SetUsageOption( 0, "(0)/1" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
 
   {
   std::string description = std::string( "Print the help menu (short version)." );
@@ -610,11 +2134,12 @@ void InitializeCommandLineOptions( itk::ants::CommandLineParser *parser )
   }
 }
 
-int main( int argc, char *argv[] )
+itk::ants::CommandLineParser::Pointer CreateCommandLineParser(
+  const std::vector<std::string> & args )
 {
   itk::ants::CommandLineParser::Pointer parser =
     itk::ants::CommandLineParser::New();
-  parser->SetCommand( argv[0] );
+  parser->SetCommand( args[0].c_str() );
 
   std::string commandDescription =
     std::string( "antsApplyTransforms, applied to an input image, transforms it " ) +
@@ -624,19 +2149,114 @@ int main( int argc, char *argv[] )
   parser->SetCommandDescription( commandDescription );
   InitializeCommandLineOptions( parser );
 
-  parser->Parse( argc, argv );
+  std::vector<char *> argv;
+  for( std::size_t n = 0; n < args.size(); n++ )
+    {
+    argv.push_back( const_cast<char *>( args[n].c_str() ) );
+    }
+  parser->Parse( static_cast<unsigned int>( argv.size() ), &argv[0] );
+
+  return parser;
+}
+
+/** Threads and their placement.  Returns false if the NUMA node does not
+ * exist. */
+bool InitializeThreads( itk::ants::CommandLineParser *parser )
+{
+  int numaNode = -1;
+  itk::ants::CommandLineParser::OptionType::Pointer numaOption =
+    parser->GetOption( "numa-node" );
+  if( numaOption && numaOption->GetNumberOfValues() > 0 )
+    {
+    numaNode = parser->Convert<int>( numaOption->GetValue() );
+    }
+  int numberOfThreads = 0;
+  itk::ants::CommandLineParser::OptionType::Pointer threadsOption =
+    parser->GetOption( "threads" );
+  if( threadsOption && threadsOption->GetNumberOfValues() > 0 )
+    {
+    numberOfThreads = parser->Convert<int>( threadsOption->GetValue() );
+    }
+  if( !itk::ants::ThreadAffinity::InitializeThreads( numaNode, numberOfThreads ) )
+    {
+    std::cerr << "Unable to run on NUMA node " << numaNode << " (the machine has "
+      << itk::ants::ThreadAffinity::GetNumberOfNodes() << " nodes)." << std::endl;
+    return false;
+    }
+
+  itk::ants::CommandLineParser::OptionType::Pointer bindOption =
+    parser->GetOption( "bind" );
+  if( bindOption && bindOption->GetNumberOfValues() > 0 )
+    {
+    itk::ants::ThreadAffinity::SetBindThreads( parser->Convert<bool>( bindOption->GetValue() ) );
+    }
+  return true;
+}
 
-  if( argc < 2 || ( parser->GetOption( "help" ) &&
+/** Run antsApplyTransforms for a parsed command line. */
+int antsApplyTransformsMain( itk::ants::CommandLineParser *parser,
+  const std::vector<std::string> & args )
+{
+  if( args.size() < 2 || ( parser->GetOption( "help" ) &&
     ( parser->Convert<bool>( parser->GetOption( "help" )->GetValue() ) ) ) )
     {
     parser->PrintMenu( std::cout, 5, false );
-    exit( EXIT_FAILURE );
+    return EXIT_FAILURE;
     }
   else if( parser->GetOption( 'h' ) &&
     ( parser->Convert<bool>( parser->GetOption( 'h' )->GetValue() ) ) )
     {
     parser->PrintMenu( std::cout, 5, true );
-    exit( EXIT_FAILURE );
+    return EXIT_FAILURE;
+    }
+
+  itk::ants::CommandLineParser::OptionType::Pointer stitchOption =
+    parser->GetOption( "stitch" );
+  if( stitchOption && stitchOption->GetNumberOfValues() > 0 )
+    {
+    if( stitchOption->GetNumberOfParameters( 0 ) < 2 )
+      {
+      std::cerr << "Error:  Stitching requires [outputFileName,shardFileName1,...]." << std::endl;
+      return EXIT_FAILURE;
+      }
+    const std::string stitchedFileName = stitchOption->GetParameter( 0, 0 );
+    std::vector<std::string> shardFileNames;
+    for( unsigned int n = 1; n < stitchOption->GetNumberOfParameters( 0 ); n++ )
+      {
+      shardFileNames.push_back( stitchOption->GetParameter( 0, n ) );
+      }
+    std::string errorMessage;
+    if( !itk::ants::MetaImageStitcher::Stitch( stitchedFileName, shardFileNames, errorMessage ) )
+      {
+      std::cerr << "Error:  " << errorMessage << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::cout << "Stitched " << shardFileNames.size() << " shards into " << stitchedFileName
+      << "." << std::endl;
+    return EXIT_SUCCESS;
+    }
+
+  // Timing report:  "1" prints it, a file name also appends it as a JSON
+  // record to that file.
+  itk::ants::TimingReport::Pointer report = itk::ants::TimingReport::New();
+  std::string timingFileName( "" );
+  bool printTimingReport = false;
+  itk::ants::CommandLineParser::OptionType::Pointer timingOption =
+    parser->GetOption( "timing-report" );
+  if( timingOption && timingOption->GetNumberOfValues() > 0 &&
+    timingOption->GetValue() != std::string( "0" ) )
+    {
+    printTimingReport = true;
+    if( timingOption->GetValue() != std::string( "1" ) )
+      {
+      timingFileName = timingOption->GetValue();
+      }
+    std::ostringstream command;
+    for( std::size_t n = 0; n < args.size(); n++ )
+      {
+      command << ( n > 0 ? " " : "" ) << args[n];
+      }
+    report->SetCommand( command.str() );
     }
 
   // Read in the first intensity image to get the image dimension.
@@ -655,6 +2275,13 @@ int main( int argc, char *argv[] )
 	     filename = inputOption->GetValue( 0 );
       }
     }
+  else if( parser->GetOption( "jacobian-determinant" ) &&
+    parser->GetOption( "jacobian-determinant" )->GetNumberOfValues() > 0 &&
+    parser->GetOption( "reference-image" ) &&
+    parser->GetOption( "reference-image" )->GetNumberOfValues() > 0 )
+    {
+    filename = parser->GetOption( "reference-image" )->GetValue( 0 );
+    }
   else
     {
     std::cerr << "No inputs were specified.  Specify an input"
@@ -663,9 +2290,15 @@ int main( int argc, char *argv[] )
     }
 
   unsigned int dimension = 3;
-  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
-    filename.c_str(), itk::ImageIOFactory::ReadMode );
-  dimension = imageIO->GetNumberOfDimensions();
+
+  std::string inputObjectType( "image" );
+  itk::ants::CommandLineParser::OptionType::Pointer inputObjectTypeOption =
+    parser->GetOption( "input-object-type" );
+  if( inputObjectTypeOption && inputObjectTypeOption->GetNumberOfValues() > 0 )
+    {
+    inputObjectType = inputObjectTypeOption->GetValue();
+    ConvertToLowerCase( inputObjectType );
+    }
 
   itk::ants::CommandLineParser::OptionType::Pointer dimOption =
     parser->GetOption( "dimensionality" );
@@ -673,20 +2306,240 @@ int main( int argc, char *argv[] )
     {
     dimension = parser->Convert<unsigned int>( dimOption->GetValue() );
     }
+  else if( inputObjectType == "mesh" )
+    {
+    dimension = 3;
+    }
+  else
+    {
+    itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(
+      filename.c_str(), itk::ImageIOFactory::ReadMode );
+    if( !imageIO )
+      {
+      std::cerr << "Unable to infer the dimensionality from " << filename
+        << ".  Specify it with the -d option." << std::endl;
+      return( EXIT_FAILURE );
+      }
+    report->StartPhase( "header reading" );
+    imageIO->SetFileName( filename.c_str() );
+    imageIO->ReadImageInformation();
+    dimension = imageIO->GetNumberOfDimensions();
+    report->StopPhase();
+    }
+
+  bool useFloatPrecision = false;
+  itk::ants::CommandLineParser::OptionType::Pointer floatOption =
+    parser->GetOption( "float" );
+  if( floatOption && floatOption->GetNumberOfValues() > 0 )
+    {
+    useFloatPrecision = parser->Convert<bool>( floatOption->GetValue() );
+    }
 
+  int exitStatus = EXIT_FAILURE;
   switch( dimension )
    {
    case 2:
-     antsApplyTransforms<2>( parser );
+     if( useFloatPrecision )
+       {
+       exitStatus = antsApplyTransforms<float, 2>( parser, report );
+       }
+     else
+       {
+       exitStatus = antsApplyTransforms<double, 2>( parser, report );
+       }
      break;
    case 3:
-     antsApplyTransforms<3>( parser );
+     if( useFloatPrecision )
+       {
+       exitStatus = antsApplyTransforms<float, 3>( parser, report );
+       }
+     else
+       {
+       exitStatus = antsApplyTransforms<double, 3>( parser, report );
+       }
      break;
    case 4:
-     antsApplyTransforms<4>( parser );
+     if( useFloatPrecision )
+       {
+       exitStatus = antsApplyTransforms<float, 4>( parser, report );
+       }
+     else
+       {
+       exitStatus = antsApplyTransforms<double, 4>( parser, report );
+       }
      break;
    default:
       std::cerr << "Unsupported dimension" << std::endl;
-      exit( EXIT_FAILURE );
+      return EXIT_FAILURE;
    }
+
+  if( printTimingReport && exitStatus == EXIT_SUCCESS )
+    {
+    report->Print( std::cout );
+    if( !timingFileName.empty() && !report->AppendJSONRecord( timingFileName ) )
+      {
+      std::cerr << "Unable to write the timing report to " << timingFileName << std::endl;
+      }
+    }
+  return exitStatus;
+}
+
+/** Run a request of the service in the working directory of the client,
+ * with the output of the request going to the given stream. */
+int RunWarpServiceRequest( const std::vector<std::string> & request,
+  const std::string & serviceDirectory, std::ostream & output )
+{
+  std::streambuf *coutBuffer = std::cout.rdbuf( output.rdbuf() );
+  std::streambuf *cerrBuffer = std::cerr.rdbuf( output.rdbuf() );
+
+  int exitStatus = EXIT_FAILURE;
+#if !defined( _WIN32 )
+  if( chdir( request[0].c_str() ) != 0 )
+    {
+    std::cerr << "Error:  Unable to change to the directory " << request[0] << std::endl;
+    }
+  else
+#endif
+    {
+    std::vector<std::string> args( request.begin() + 1, request.end() );
+    try
+      {
+      itk::ants::CommandLineParser::Pointer parser = CreateCommandLineParser( args );
+      if( parser->GetOption( "daemon" ) && parser->GetOption( "daemon" )->GetNumberOfValues() > 0 )
+        {
+        std::cerr << "Error:  A request cannot start another service." << std::endl;
+        }
+      else
+        {
+        exitStatus = antsApplyTransformsMain( parser, args );
+        }
+      }
+    catch( const itk::ExceptionObject & e )
+      {
+      std::cerr << "Error:  The request caught an ITK exception:" << std::endl;
+      e.Print( std::cerr );
+      }
+    catch( const std::exception & e )
+      {
+      std::cerr << "Error:  The request caught an exception:" << std::endl;
+      std::cerr << e.what() << std::endl;
+      }
+    catch( ... )
+      {
+      // The service and its resident objects outlive a failed request.
+      std::cerr << "Error:  The request caught an unknown exception." << std::endl;
+      }
+    }
+#if !defined( _WIN32 )
+  if( chdir( serviceDirectory.c_str() ) != 0 )
+    {
+    std::cerr << "Error:  Unable to change back to " << serviceDirectory << std::endl;
+    }
+#endif
+
+  std::cout.rdbuf( coutBuffer );
+  std::cerr.rdbuf( cerrBuffer );
+  return exitStatus;
+}
+
+/** Serve requests of antsApplyTransformsClient on a local socket, keeping
+ * the decoded inputs, composites and coordinate maps of recent requests
+ * in memory. */
+int RunWarpService( const std::string & socketFileName, double cacheSize )
+{
+  itk::ants::ResidentObjectCache::Pointer cache = itk::ants::ResidentObjectCache::New();
+  cache->SetMaximumSize( cacheSize * 1048576.0 );
+  itk::ants::ResidentObjectCache::SetGlobalCache( cache );
+
+  const int serviceSocket = itk::ants::WarpService::Listen( socketFileName );
+  if( serviceSocket < 0 )
+    {
+    std::cerr << "Unable to listen on " << socketFileName
+      << " (is another service running on it?)" << std::endl;
+    return EXIT_FAILURE;
+    }
+  itk::ants::WarpService::InstallStopHandler();
+
+  std::string serviceDirectory( "" );
+#if !defined( _WIN32 )
+  char workingDirectory[PATH_MAX];
+  if( getcwd( workingDirectory, sizeof( workingDirectory ) ) )
+    {
+    serviceDirectory = workingDirectory;
+    }
+#endif
+
+  std::cout << "Serving requests on " << socketFileName << " (cache size "
+    << cacheSize << " MB)" << std::endl;
+
+  unsigned long numberOfRequests = 0;
+  while( !itk::ants::WarpService::IsStopRequested() )
+    {
+    const int connection = itk::ants::WarpService::Accept( serviceSocket );
+    if( connection < 0 )
+      {
+      continue;
+      }
+    std::vector<std::string> request;
+    if( !itk::ants::WarpService::ReceiveStrings( connection, request ) || request.size() < 2 )
+      {
+      itk::ants::WarpService::Close( connection );
+      continue;
+      }
+
+    itk::TimeProbe requestProbe;
+    requestProbe.Start();
+    std::ostringstream output;
+    const int exitStatus = RunWarpServiceRequest( request, serviceDirectory, output );
+    requestProbe.Stop();
+
+    std::ostringstream status;
+    status << exitStatus;
+    std::vector<std::string> reply;
+    reply.push_back( status.str() );
+    reply.push_back( output.str() );
+    itk::ants::WarpService::SendStrings( connection, reply );
+    itk::ants::WarpService::Close( connection );
+
+    std::cout << "Request " << ++numberOfRequests << ":  exit status " << exitStatus
+      << ", " << requestProbe.GetTotal() << " s, " << cache->GetNumberOfObjects()
+      << " resident objects (" << cache->GetSize() / 1048576.0 << " MB)" << std::endl;
+    }
+
+  itk::ants::WarpService::Close( serviceSocket );
+  itk::ants::WarpService::RemoveSocketFile( socketFileName );
+  itk::ants::ResidentObjectCache::SetGlobalCache( NULL );
+  std::cout << "Stopped after " << numberOfRequests << " requests." << std::endl;
+  return EXIT_SUCCESS;
+}
+
+int main( int argc, char *argv[] )
+{
+  std::vector<std::string> args( argv, argv + argc );
+  itk::ants::CommandLineParser::Pointer parser = CreateCommandLineParser( args );
+
+  // The thread options of the service apply to all of its requests.
+  if( !InitializeThreads( parser ) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  itk::ants::CommandLineParser::OptionType::Pointer daemonOption =
+    parser->GetOption( "daemon" );
+  if( daemonOption && daemonOption->GetNumberOfValues() > 0 )
+    {
+    std::string socketFileName = daemonOption->GetValue();
+    double cacheSize = 4096.0;
+    if( daemonOption->GetNumberOfParameters( 0 ) > 0 )
+      {
+      socketFileName = daemonOption->GetParameter( 0, 0 );
+      if( daemonOption->GetNumberOfParameters( 0 ) > 1 )
+        {
+        cacheSize = parser->Convert<double>( daemonOption->GetParameter( 0, 1 ) );
+        }
+      }
+    return RunWarpService( socketFileName, cacheSize );
+    }
+
+  return antsApplyTransformsMain( parser, args );
 }
@@ -0,0 +1,80 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsApplyTransformsClient.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsWarpService.h"
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <unistd.h>
+#endif
+
+// Submits a request to an antsApplyTransforms running with --daemon and
+// prints its output.  The arguments are those of antsApplyTransforms;
+// relative file names refer to the working directory of the client.
+int main( int argc, char *argv[] )
+{
+  if( argc < 3 )
+    {
+    std::cout << "Usage:  " << argv[0] << " socketFile antsApplyTransformsArguments" << std::endl;
+    std::cout << "  Runs antsApplyTransforms in the service started with" << std::endl;
+    std::cout << "  antsApplyTransforms --daemon socketFile" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::vector<std::string> request;
+#if !defined( _WIN32 )
+  char workingDirectory[PATH_MAX];
+  if( !getcwd( workingDirectory, sizeof( workingDirectory ) ) )
+    {
+    std::cerr << "Unable to determine the working directory." << std::endl;
+    return EXIT_FAILURE;
+    }
+  request.push_back( workingDirectory );
+#else
+  request.push_back( "" );
+#endif
+  request.push_back( "antsApplyTransforms" );
+  for( int n = 2; n < argc; n++ )
+    {
+    request.push_back( argv[n] );
+    }
+
+  int socket = itk::ants::WarpService::Connect( argv[1] );
+  if( socket < 0 )
+    {
+    std::cerr << "Unable to connect to the service at " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::vector<std::string> reply;
+  if( !itk::ants::WarpService::SendStrings( socket, request ) ||
+    !itk::ants::WarpService::ReceiveStrings( socket, reply ) || reply.size() != 2 )
+    {
+    std::cerr << "The request to the service at " << argv[1] << " failed." << std::endl;
+    itk::ants::WarpService::Close( socket );
+    return EXIT_FAILURE;
+    }
+  itk::ants::WarpService::Close( socket );
+
+  std::cout << reply[1] << std::flush;
+  return std::atoi( reply[0].c_str() );
+}
@@ -0,0 +1,394 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsApplyTransformsPrecisionTest.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+/**
+ * Checks the single precision path of antsApplyTransforms (--float)
+ * against the double precision one:  the same image is warped through the
+ * same [affine, displacement field] composite built once with float and
+ * once with double, and the same points are mapped through both
+ * composites.  The float warp must stay within IntensityTolerance of the
+ * double warp (the image ranges over about 100 units) and the mapped
+ * points within PointTolerance mm.
+ *
+ * Also checks the conversion of transforms read in double precision to
+ * float (antsTransformPrecision.h):  every linear transform registered by
+ * TransformTypeRegistration in 2-D and 3-D is built in double with
+ * non-trivial parameters, converted with ConvertTransformPrecision() and
+ * must come back as the float variant of the same class, mapping points
+ * within PointTolerance mm of the double transform.
+ */
+
+#include "antsTransformPrecision.h"
+
+#include "itkANTSResampleImageFilter.h"
+#include "itkAffineTransform.h"
+#include "itkCompositeTransform.h"
+#include "itkCompositeTransformPointMapper.h"
+#include "itkDisplacementFieldTransform.h"
+#include "itkImage.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkLinearInterpolateImageFunction.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const unsigned int Dimension = 3;
+const double IntensityTolerance = 1e-3;
+const double PointTolerance = 1e-4;
+
+template<class TReal>
+class WarpPipeline
+{
+public:
+  typedef itk::Image<TReal, Dimension>                              ImageType;
+  typedef itk::DisplacementFieldTransform<TReal, Dimension>         FieldTransformType;
+  typedef typename FieldTransformType::DisplacementFieldType        FieldType;
+  typedef itk::AffineTransform<TReal, Dimension>                    AffineTransformType;
+  typedef itk::CompositeTransform<TReal, Dimension>                 CompositeTransformType;
+  typedef itk::ANTSResampleImageFilter<ImageType, ImageType, TReal> ResamplerType;
+  typedef itk::LinearInterpolateImageFunction<ImageType, TReal>     InterpolatorType;
+  typedef itk::CompositeTransformPointMapper<TReal, Dimension>      PointMapperType;
+
+  WarpPipeline()
+    {
+    // Input and field:  32^3 voxels of 2 mm.
+    typename ImageType::RegionType region;
+    typename ImageType::SpacingType spacing;
+    typename ImageType::PointType origin;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      region.SetIndex( d, 0 );
+      region.SetSize( d, 32 );
+      spacing[d] = 2.0;
+      origin[d] = -31.0;
+      }
+
+    this->m_Input = ImageType::New();
+    this->m_Input->SetRegions( region );
+    this->m_Input->SetSpacing( spacing );
+    this->m_Input->SetOrigin( origin );
+    this->m_Input->Allocate();
+
+    typename FieldType::Pointer field = FieldType::New();
+    field->SetRegions( region );
+    field->SetSpacing( spacing );
+    field->SetOrigin( origin );
+    field->Allocate();
+
+    itk::ImageRegionIteratorWithIndex<ImageType> imageIt( this->m_Input, region );
+    itk::ImageRegionIteratorWithIndex<FieldType> fieldIt( field, region );
+    for( ; !imageIt.IsAtEnd(); ++imageIt, ++fieldIt )
+      {
+      typename ImageType::PointType point;
+      this->m_Input->TransformIndexToPhysicalPoint( imageIt.GetIndex(), point );
+      const double x = point[0];
+      const double y = point[1];
+      const double z = point[2];
+      imageIt.Set( static_cast<TReal>( 100.0 + 50.0 * std::sin( 0.2 * x ) * std::cos( 0.15 * y ) + 0.5 * z ) );
+
+      typename FieldType::PixelType displacement;
+      displacement[0] = static_cast<TReal>( 2.0 * std::sin( 0.1 * y ) );
+      displacement[1] = static_cast<TReal>( 1.5 * std::cos( 0.12 * z ) );
+      displacement[2] = static_cast<TReal>( 1.0 * std::sin( 0.08 * x + 0.05 * y ) );
+      fieldIt.Set( displacement );
+      }
+
+    typename FieldTransformType::Pointer fieldTransform = FieldTransformType::New();
+    fieldTransform->SetDisplacementField( field );
+
+    // Small rotation about z with anisotropic scaling.
+    typename AffineTransformType::Pointer affineTransform = AffineTransformType::New();
+    typename AffineTransformType::MatrixType matrix;
+    typename AffineTransformType::OutputVectorType offset;
+    const double angle = 0.05;
+    matrix.SetIdentity();
+    matrix[0][0] = 1.02 * std::cos( angle );
+    matrix[0][1] = -std::sin( angle );
+    matrix[1][0] = std::sin( angle );
+    matrix[1][1] = 0.98 * std::cos( angle );
+    offset[0] = 0.7;
+    offset[1] = -0.4;
+    offset[2] = 0.3;
+    affineTransform->SetMatrix( matrix );
+    affineTransform->SetOffset( offset );
+
+    this->m_Composite = CompositeTransformType::New();
+    this->m_Composite->AddTransform( affineTransform );
+    this->m_Composite->AddTransform( fieldTransform );
+
+    // Output:  the central 20^3 voxels, which map inside the input.
+    this->m_Reference = ImageType::New();
+    typename ImageType::RegionType referenceRegion;
+    typename ImageType::PointType referenceOrigin;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      referenceRegion.SetIndex( d, 0 );
+      referenceRegion.SetSize( d, 20 );
+      referenceOrigin[d] = origin[d] + 12.0;
+      }
+    this->m_Reference->SetRegions( referenceRegion );
+    this->m_Reference->SetSpacing( spacing );
+    this->m_Reference->SetOrigin( referenceOrigin );
+    }
+
+  typename ImageType::Pointer Warp() const
+    {
+    typename ResamplerType::Pointer resampler = ResamplerType::New();
+    resampler->SetInput( this->m_Input );
+    resampler->SetTransform( this->m_Composite );
+    resampler->SetInterpolator( InterpolatorType::New() );
+    resampler->SetOutputParametersFromImage( this->m_Reference );
+    resampler->SetDefaultPixelValue( 0 );
+    resampler->Update();
+    return resampler->GetOutput();
+    }
+
+  void MapPoints( const std::vector<double> points[Dimension], std::vector<double> mapped[Dimension] ) const
+    {
+    std::vector<TReal> coordinates[Dimension];
+    TReal *coordinatePointers[Dimension];
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      coordinates[d].assign( points[d].begin(), points[d].end() );
+      coordinatePointers[d] = &coordinates[d][0];
+      }
+
+    typename PointMapperType::Pointer mapper = PointMapperType::New();
+    mapper->SetTransform( this->m_Composite );
+    mapper->MapPoints( coordinatePointers, points[0].size() );
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      mapped[d].assign( coordinates[d].begin(), coordinates[d].end() );
+      }
+    }
+
+private:
+  typename ImageType::Pointer              m_Input;
+  typename ImageType::Pointer              m_Reference;
+  typename CompositeTransformType::Pointer m_Composite;
+};
+
+/** Returns the number of errors of the conversion of a TDoubleTransform to
+ * float, which must yield a TFloatTransform. */
+template<class TDoubleTransform, class TFloatTransform>
+unsigned int CheckConversion( const char *name )
+{
+  const unsigned int VDimension = TDoubleTransform::InputSpaceDimension;
+  typedef itk::Transform<float, VDimension, VDimension> FloatTransformType;
+
+  // Perturb the (identity) defaults such that every parameter matters.
+  typename TDoubleTransform::Pointer doubleTransform = TDoubleTransform::New();
+  typename TDoubleTransform::ParametersType fixedParameters = doubleTransform->GetFixedParameters();
+  for( unsigned int i = 0; i < fixedParameters.Size(); i++ )
+    {
+    fixedParameters[i] = 1.5 - 0.7 * i;
+    }
+  doubleTransform->SetFixedParameters( fixedParameters );
+  typename TDoubleTransform::ParametersType parameters = doubleTransform->GetParameters();
+  for( unsigned int i = 0; i < parameters.Size(); i++ )
+    {
+    parameters[i] += ( ( i & 1 ) ? -0.01 : 0.01 ) * ( i % 5 + 1 );
+    }
+  doubleTransform->SetParameters( parameters );
+
+  typename FloatTransformType::Pointer converted =
+    itk::ants::ConvertTransformPrecision<FloatTransformType>( doubleTransform.GetPointer() );
+  const TFloatTransform *floatTransform = dynamic_cast<const TFloatTransform *>( converted.GetPointer() );
+  if( !floatTransform ||
+    std::string( floatTransform->GetNameOfClass() ) != std::string( doubleTransform->GetNameOfClass() ) )
+    {
+    std::cerr << "  " << name << ":  not converted to float." << std::endl;
+    return 1;
+    }
+
+  double maximumPointError = 0.0;
+  for( unsigned int n = 0; n < 1000; n++ )
+    {
+    typename TDoubleTransform::InputPointType doublePoint;
+    typename TFloatTransform::InputPointType floatPoint;
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      floatPoint[d] = static_cast<float>( -40.0 + 80.0 * std::rand() / static_cast<double>( RAND_MAX ) );
+      doublePoint[d] = floatPoint[d];
+      }
+    const typename TDoubleTransform::OutputPointType doubleMapped = doubleTransform->TransformPoint( doublePoint );
+    const typename TFloatTransform::OutputPointType floatMapped = floatTransform->TransformPoint( floatPoint );
+    double distance = 0.0;
+    for( unsigned int d = 0; d < VDimension; d++ )
+      {
+      distance += vnl_math_sqr( doubleMapped[d] - static_cast<double>( floatMapped[d] ) );
+      }
+    maximumPointError = std::max( maximumPointError, std::sqrt( distance ) );
+    }
+
+  std::cout << "  " << name << ":  maximum point distance = " << maximumPointError << " mm" << std::endl;
+  return ( maximumPointError > PointTolerance ) ? 1 : 0;
+}
+
+/** Returns the number of transforms registered by TransformTypeRegistration
+ * which are not converted correctly. */
+unsigned int CheckTransformConversions()
+{
+  itk::ants::TransformTypeRegistration<float, 2>::RegisterTransforms();
+  itk::ants::TransformTypeRegistration<double, 2>::RegisterTransforms();
+  itk::ants::TransformTypeRegistration<float, 3>::RegisterTransforms();
+  itk::ants::TransformTypeRegistration<double, 3>::RegisterTransforms();
+
+  std::cout << "Conversion of transforms from double to float:" << std::endl;
+  unsigned int numberOfErrors = 0;
+
+  // Generic transforms, in 2-D and 3-D.
+  numberOfErrors += CheckConversion<itk::MatrixOffsetTransformBase<double, 2, 2>,
+    itk::MatrixOffsetTransformBase<float, 2, 2> >( "MatrixOffsetTransformBase 2-D" );
+  numberOfErrors += CheckConversion<itk::AffineTransform<double, 2>,
+    itk::AffineTransform<float, 2> >( "AffineTransform 2-D" );
+  numberOfErrors += CheckConversion<itk::CenteredAffineTransform<double, 2>,
+    itk::CenteredAffineTransform<float, 2> >( "CenteredAffineTransform 2-D" );
+  numberOfErrors += CheckConversion<itk::IdentityTransform<double, 2>,
+    itk::IdentityTransform<float, 2> >( "IdentityTransform 2-D" );
+  numberOfErrors += CheckConversion<itk::ScaleTransform<double, 2>,
+    itk::ScaleTransform<float, 2> >( "ScaleTransform 2-D" );
+  numberOfErrors += CheckConversion<itk::TranslationTransform<double, 2>,
+    itk::TranslationTransform<float, 2> >( "TranslationTransform 2-D" );
+  numberOfErrors += CheckConversion<itk::MatrixOffsetTransformBase<double, 3, 3>,
+    itk::MatrixOffsetTransformBase<float, 3, 3> >( "MatrixOffsetTransformBase 3-D" );
+  numberOfErrors += CheckConversion<itk::AffineTransform<double, 3>,
+    itk::AffineTransform<float, 3> >( "AffineTransform 3-D" );
+  numberOfErrors += CheckConversion<itk::CenteredAffineTransform<double, 3>,
+    itk::CenteredAffineTransform<float, 3> >( "CenteredAffineTransform 3-D" );
+  numberOfErrors += CheckConversion<itk::IdentityTransform<double, 3>,
+    itk::IdentityTransform<float, 3> >( "IdentityTransform 3-D" );
+  numberOfErrors += CheckConversion<itk::ScaleTransform<double, 3>,
+    itk::ScaleTransform<float, 3> >( "ScaleTransform 3-D" );
+  numberOfErrors += CheckConversion<itk::TranslationTransform<double, 3>,
+    itk::TranslationTransform<float, 3> >( "TranslationTransform 3-D" );
+
+  // 2-D transforms.
+  numberOfErrors += CheckConversion<itk::Euler2DTransform<double>,
+    itk::Euler2DTransform<float> >( "Euler2DTransform" );
+  numberOfErrors += CheckConversion<itk::Rigid2DTransform<double>,
+    itk::Rigid2DTransform<float> >( "Rigid2DTransform" );
+  numberOfErrors += CheckConversion<itk::CenteredRigid2DTransform<double>,
+    itk::CenteredRigid2DTransform<float> >( "CenteredRigid2DTransform" );
+  numberOfErrors += CheckConversion<itk::Similarity2DTransform<double>,
+    itk::Similarity2DTransform<float> >( "Similarity2DTransform" );
+  numberOfErrors += CheckConversion<itk::CenteredSimilarity2DTransform<double>,
+    itk::CenteredSimilarity2DTransform<float> >( "CenteredSimilarity2DTransform" );
+
+  // 3-D transforms.
+  numberOfErrors += CheckConversion<itk::Euler3DTransform<double>,
+    itk::Euler3DTransform<float> >( "Euler3DTransform" );
+  numberOfErrors += CheckConversion<itk::CenteredEuler3DTransform<double>,
+    itk::CenteredEuler3DTransform<float> >( "CenteredEuler3DTransform" );
+  numberOfErrors += CheckConversion<itk::QuaternionRigidTransform<double>,
+    itk::QuaternionRigidTransform<float> >( "QuaternionRigidTransform" );
+  numberOfErrors += CheckConversion<itk::VersorTransform<double>,
+    itk::VersorTransform<float> >( "VersorTransform" );
+  numberOfErrors += CheckConversion<itk::VersorRigid3DTransform<double>,
+    itk::VersorRigid3DTransform<float> >( "VersorRigid3DTransform" );
+  numberOfErrors += CheckConversion<itk::Similarity3DTransform<double>,
+    itk::Similarity3DTransform<float> >( "Similarity3DTransform" );
+  numberOfErrors += CheckConversion<itk::ScaleVersor3DTransform<double>,
+    itk::ScaleVersor3DTransform<float> >( "ScaleVersor3DTransform" );
+  numberOfErrors += CheckConversion<itk::ScaleSkewVersor3DTransform<double>,
+    itk::ScaleSkewVersor3DTransform<float> >( "ScaleSkewVersor3DTransform" );
+
+  return numberOfErrors;
+}
+
+} // end namespace
+
+int main( int, char * [] )
+{
+  WarpPipeline<double> doublePipeline;
+  WarpPipeline<float> floatPipeline;
+
+  typedef WarpPipeline<double>::ImageType DoubleImageType;
+  typedef WarpPipeline<float>::ImageType  FloatImageType;
+
+  DoubleImageType::Pointer doubleWarp = doublePipeline.Warp();
+  FloatImageType::Pointer floatWarp = floatPipeline.Warp();
+
+  double maximumIntensityError = 0.0;
+  itk::ImageRegionConstIterator<DoubleImageType> doubleIt( doubleWarp,
+    doubleWarp->GetLargestPossibleRegion() );
+  itk::ImageRegionConstIterator<FloatImageType> floatIt( floatWarp,
+    floatWarp->GetLargestPossibleRegion() );
+  for( ; !doubleIt.IsAtEnd(); ++doubleIt, ++floatIt )
+    {
+    maximumIntensityError = std::max( maximumIntensityError,
+      std::fabs( doubleIt.Get() - static_cast<double>( floatIt.Get() ) ) );
+    }
+
+  // Points covering the field, including some outside of it.
+  std::vector<double> points[Dimension];
+  std::srand( 1 );
+  for( unsigned int n = 0; n < 10000; n++ )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      points[d].push_back( -40.0 + 80.0 * std::rand() / static_cast<double>( RAND_MAX ) );
+      }
+    }
+  std::vector<double> doubleMapped[Dimension];
+  std::vector<double> floatMapped[Dimension];
+  doublePipeline.MapPoints( points, doubleMapped );
+  floatPipeline.MapPoints( points, floatMapped );
+
+  double maximumPointError = 0.0;
+  for( unsigned int n = 0; n < points[0].size(); n++ )
+    {
+    double distance = 0.0;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      distance += vnl_math_sqr( doubleMapped[d][n] - floatMapped[d][n] );
+      }
+    maximumPointError = std::max( maximumPointError, std::sqrt( distance ) );
+    }
+
+  std::cout << "Float vs. double:  maximum intensity difference = " << maximumIntensityError
+    << " (tolerance " << IntensityTolerance << "), maximum point distance = "
+    << maximumPointError << " mm (tolerance " << PointTolerance << " mm)" << std::endl;
+
+  int status = EXIT_SUCCESS;
+  if( maximumIntensityError > IntensityTolerance || maximumPointError > PointTolerance )
+    {
+    std::cerr << "Error:  The single precision warp deviates from the double precision warp."
+      << std::endl;
+    status = EXIT_FAILURE;
+    }
+
+  const unsigned int numberOfConversionErrors = CheckTransformConversions();
+  if( numberOfConversionErrors > 0 )
+    {
+    std::cerr << "Error:  " << numberOfConversionErrors << " transforms are not converted to float"
+      << " or deviate by more than " << PointTolerance << " mm." << std::endl;
+    status = EXIT_FAILURE;
+    }
+  return status;
+}
@@ -0,0 +1,296 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsMemoryMappedFile.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsMemoryMappedFile.h"
+
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+#if defined( _WIN32 )
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+namespace ants
+{
+
+MemoryMappedFile
+::MemoryMappedFile() : m_FileName( "" ),
+                       m_Buffer( NULL ),
+                       m_Size( 0 ),
+                       m_FileDescriptor( -1 ),
+                       m_IsWritable( false )
+{
+}
+
+MemoryMappedFile
+::~MemoryMappedFile()
+{
+  this->Close();
+}
+
+bool
+MemoryMappedFile
+::OpenForReading( const std::string & filename )
+{
+  this->Close();
+
+#if defined( _WIN32 )
+  return false;
+#else
+  int fd = open( filename.c_str(), O_RDONLY );
+  if( fd < 0 )
+    {
+    return false;
+    }
+  struct stat info;
+  if( fstat( fd, &info ) != 0 || info.st_size <= 0 )
+    {
+    close( fd );
+    return false;
+    }
+
+  // Private mapping:  pages are shared with the page cache until written.
+  void *buffer = mmap( NULL, static_cast<std::size_t>( info.st_size ),
+    PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+  if( buffer == MAP_FAILED )
+    {
+    close( fd );
+    return false;
+    }
+
+  this->m_FileName = filename;
+  this->m_Buffer = static_cast<char *>( buffer );
+  this->m_Size = static_cast<std::size_t>( info.st_size );
+  this->m_FileDescriptor = fd;
+  this->m_IsWritable = false;
+
+  return true;
+#endif
+}
+
+bool
+MemoryMappedFile
+::CreateForWriting( const std::string & filename, std::size_t size )
+{
+  this->Close();
+
+#if defined( _WIN32 )
+  return false;
+#else
+  if( size == 0 )
+    {
+    return false;
+    }
+  int fd = open( filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+  if( fd < 0 )
+    {
+    return false;
+    }
+  if( ftruncate( fd, static_cast<off_t>( size ) ) != 0 )
+    {
+    close( fd );
+    return false;
+    }
+
+  void *buffer = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  if( buffer == MAP_FAILED )
+    {
+    close( fd );
+    return false;
+    }
+
+  this->m_FileName = filename;
+  this->m_Buffer = static_cast<char *>( buffer );
+  this->m_Size = size;
+  this->m_FileDescriptor = fd;
+  this->m_IsWritable = true;
+
+  return true;
+#endif
+}
+
+void
+MemoryMappedFile
+::Flush()
+{
+#if !defined( _WIN32 )
+  if( this->m_Buffer && this->m_IsWritable )
+    {
+    msync( this->m_Buffer, this->m_Size, MS_SYNC );
+    }
+#endif
+}
+
+void
+MemoryMappedFile
+::Close()
+{
+#if !defined( _WIN32 )
+  if( this->m_Buffer )
+    {
+    if( this->m_IsWritable )
+      {
+      msync( this->m_Buffer, this->m_Size, MS_SYNC );
+      }
+    munmap( this->m_Buffer, this->m_Size );
+    }
+  if( this->m_FileDescriptor >= 0 )
+    {
+    close( this->m_FileDescriptor );
+    }
+#endif
+  this->m_Buffer = NULL;
+  this->m_Size = 0;
+  this->m_FileDescriptor = -1;
+  this->m_IsWritable = false;
+}
+
+std::string
+MemoryMappedFile
+::ComputeContentHash( const char *buffer, std::size_t size )
+{
+  // 64-bit FNV-1a.  We process the bytes in two interleaved streams to
+  // break the dependency chain and concatenate the two hashes.
+  const unsigned long long prime = 1099511628211ULL;
+  unsigned long long hash0 = 14695981039346656037ULL;
+  unsigned long long hash1 = hash0 ^ static_cast<unsigned long long>( size );
+
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>( buffer );
+  std::size_t n = 0;
+  for( ; n + 1 < size; n += 2 )
+    {
+    hash0 = ( hash0 ^ bytes[n] ) * prime;
+    hash1 = ( hash1 ^ bytes[n+1] ) * prime;
+    }
+  if( n < size )
+    {
+    hash0 = ( hash0 ^ bytes[n] ) * prime;
+    }
+
+  std::ostringstream oss;
+  oss << std::hex << std::setfill( '0' ) << std::setw( 16 ) << hash0
+    << std::setw( 16 ) << hash1;
+  return oss.str();
+}
+
+bool
+MemoryMappedFile
+::FileExists( const std::string & filename )
+{
+#if defined( _WIN32 )
+  FILE *fp = fopen( filename.c_str(), "rb" );
+  if( fp )
+    {
+    fclose( fp );
+    return true;
+    }
+  return false;
+#else
+  struct stat info;
+  return ( stat( filename.c_str(), &info ) == 0 );
+#endif
+}
+
+std::size_t
+MemoryMappedFile
+::GetFileSize( const std::string & filename )
+{
+#if defined( _WIN32 )
+  FILE *fp = fopen( filename.c_str(), "rb" );
+  if( !fp )
+    {
+    return 0;
+    }
+  fseek( fp, 0, SEEK_END );
+  long size = ftell( fp );
+  fclose( fp );
+  return ( size > 0 ) ? static_cast<std::size_t>( size ) : 0;
+#else
+  struct stat info;
+  if( stat( filename.c_str(), &info ) != 0 )
+    {
+    return 0;
+    }
+  return static_cast<std::size_t>( info.st_size );
+#endif
+}
+
+bool
+MemoryMappedFile
+::RenameFile( const std::string & from, const std::string & to )
+{
+  return ( std::rename( from.c_str(), to.c_str() ) == 0 );
+}
+
+std::string
+MemoryMappedFile
+::CreateTemporaryFile( const std::string & prefix, const std::string & suffix )
+{
+#if defined( _WIN32 )
+  for( unsigned int n = 0; n < 1000; n++ )
+    {
+    std::ostringstream oss;
+    oss << prefix << _getpid() << "_" << n << suffix;
+    const int fd = _open( oss.str().c_str(), _O_CREAT | _O_EXCL | _O_WRONLY, _S_IREAD | _S_IWRITE );
+    if( fd >= 0 )
+      {
+      _close( fd );
+      return oss.str();
+      }
+    }
+  return std::string( "" );
+#else
+  const std::string pattern = prefix + std::string( "XXXXXX" ) + suffix;
+  std::vector<char> filename( pattern.begin(), pattern.end() );
+  filename.push_back( '\0' );
+  const int fd = mkstemps( &filename[0], static_cast<int>( suffix.length() ) );
+  if( fd < 0 )
+    {
+    return std::string( "" );
+    }
+  close( fd );
+  return std::string( &filename[0] );
+#endif
+}
+
+bool
+MemoryMappedFile
+::HasExtension( const std::string & filename, const std::string & extension )
+{
+  if( filename.length() < extension.length() )
+    {
+    return false;
+    }
+  return ( filename.compare( filename.length() - extension.length(),
+    extension.length(), extension ) == 0 );
+}
+
+} // end namespace ants
+} // end namespace itk
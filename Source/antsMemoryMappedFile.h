@@ -0,0 +1,124 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsMemoryMappedFile.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsMemoryMappedFile_h
+#define __antsMemoryMappedFile_h
+
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkMacro.h"
+
+#include <string>
+
+namespace itk
+{
+namespace ants
+{
+/** \class MemoryMappedFile
+    \brief Thin wrapper around a memory mapping of a whole file.
+    \par
+    Files opened for reading are mapped privately (copy-on-write) so that
+    a buffer wrapped as an image can be modified without touching the file.
+    Files created for writing are mapped shared such that anything written
+    to the buffer ends up in the file.  The mapping is released when the
+    object is destroyed, so the owner of the buffer (e.g. an image pixel
+    container) should hold a smart pointer to this object.
+    \par
+    Also contains a couple of file system helpers used for the
+    content-addressed cache of decompressed inputs.
+*/
+
+class ITK_EXPORT MemoryMappedFile
+: public LightObject
+{
+public:
+  /** Standard class typedefs. */
+  typedef MemoryMappedFile                           Self;
+  typedef LightObject                                Superclass;
+  typedef SmartPointer<Self>                         Pointer;
+  typedef SmartPointer<const Self>                   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( MemoryMappedFile, LightObject );
+
+  /** Map an existing file.  Returns false if the file cannot be mapped. */
+  bool OpenForReading( const std::string & );
+
+  /** Create (or truncate) a file of the given size and map it. */
+  bool CreateForWriting( const std::string &, std::size_t );
+
+  /** Write modifications of a shared mapping back to the file. */
+  void Flush();
+
+  /** Flush any modifications and release the mapping. */
+  void Close();
+
+  char * GetBuffer()
+    {
+    return this->m_Buffer;
+    }
+  std::size_t GetSize() const
+    {
+    return this->m_Size;
+    }
+  const std::string & GetFileName() const
+    {
+    return this->m_FileName;
+    }
+
+  /** 64-bit FNV-1a hash of a buffer returned as a hex string. */
+  static std::string ComputeContentHash( const char *, std::size_t );
+
+  /** File system helpers. */
+  static bool FileExists( const std::string & );
+
+  /** Size of the file in bytes (0 if it does not exist). */
+  static std::size_t GetFileSize( const std::string & );
+
+  /** Atomically move a file into place (used when filling the cache). */
+  static bool RenameFile( const std::string &, const std::string & );
+
+  /** Create a new, empty file named prefix + a unique string + suffix and
+   * return its name (empty on failure).  Existing files are never
+   * reused. */
+  static std::string CreateTemporaryFile( const std::string &, const std::string & );
+
+  /** Returns true if the file name ends with the given extension. */
+  static bool HasExtension( const std::string &, const std::string & );
+
+protected:
+  MemoryMappedFile();
+  virtual ~MemoryMappedFile();
+
+private:
+  MemoryMappedFile( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::string                                        m_FileName;
+  char                                              *m_Buffer;
+  std::size_t                                        m_Size;
+  int                                                m_FileDescriptor;
+  bool                                               m_IsWritable;
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
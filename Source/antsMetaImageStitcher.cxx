@@ -0,0 +1,371 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsMetaImageStitcher.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsMetaImageStitcher.h"
+#include "antsMemoryMappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+namespace itk
+{
+namespace ants
+{
+
+namespace
+{
+typedef std::vector<std::pair<std::string, std::string> > HeaderType;
+
+struct ShardType
+  {
+  std::string                 m_FileName;
+  MemoryMappedFile::Pointer   m_File;
+  HeaderType                  m_Header;
+  std::size_t                 m_DataOffset;
+  std::vector<unsigned long>  m_Size;
+  std::vector<double>         m_Origin;
+  double                      m_Position;
+  };
+
+std::string Trim( const std::string & str )
+{
+  const std::string::size_type first = str.find_first_not_of( " \t\r" );
+  if( first == std::string::npos )
+    {
+    return std::string( "" );
+    }
+  const std::string::size_type last = str.find_last_not_of( " \t\r" );
+  return str.substr( first, last - first + 1 );
+}
+
+/** Parse the "Key = Value" lines up to and including ElementDataFile. */
+bool ReadHeader( const char *buffer, std::size_t size, HeaderType & header, std::size_t & dataOffset )
+{
+  header.clear();
+  std::size_t position = 0;
+  while( position < size )
+    {
+    const char *end = static_cast<const char *>( std::memchr( buffer + position, '\n', size - position ) );
+    if( !end )
+      {
+      return false;
+      }
+    const std::string line( buffer + position, end );
+    position = static_cast<std::size_t>( end - buffer ) + 1;
+
+    const std::string::size_type equal = line.find( '=' );
+    if( equal == std::string::npos )
+      {
+      return false;
+      }
+    const std::string key = Trim( line.substr( 0, equal ) );
+    const std::string value = Trim( line.substr( equal + 1 ) );
+    header.push_back( std::make_pair( key, value ) );
+    if( key == "ElementDataFile" )
+      {
+      dataOffset = position;
+      return true;
+      }
+    }
+  return false;
+}
+
+/** Value of the first of the given (synonymous) keys. */
+std::string GetValue( const HeaderType & header, const char *key, const char *synonym1 = NULL,
+  const char *synonym2 = NULL )
+{
+  for( HeaderType::const_iterator it = header.begin(); it != header.end(); ++it )
+    {
+    if( it->first == key || ( synonym1 && it->first == synonym1 ) ||
+      ( synonym2 && it->first == synonym2 ) )
+      {
+      return it->second;
+      }
+    }
+  return std::string( "" );
+}
+
+template <class T>
+std::vector<T> ParseVector( const std::string & str )
+{
+  std::vector<T> values;
+  std::istringstream iss( str );
+  T value;
+  while( iss >> value )
+    {
+    values.push_back( value );
+    }
+  return values;
+}
+
+std::size_t GetElementSize( const std::string & elementType )
+{
+  if( elementType == "MET_CHAR" || elementType == "MET_UCHAR" )
+    {
+    return 1;
+    }
+  if( elementType == "MET_SHORT" || elementType == "MET_USHORT" )
+    {
+    return 2;
+    }
+  if( elementType == "MET_INT" || elementType == "MET_UINT" || elementType == "MET_FLOAT" )
+    {
+    return 4;
+    }
+  if( elementType == "MET_DOUBLE" || elementType == "MET_LONG_LONG" ||
+    elementType == "MET_ULONG_LONG" )
+    {
+    return 8;
+    }
+  return 0;
+}
+
+bool CompareShardPositions( const ShardType & a, const ShardType & b )
+{
+  return a.m_Position < b.m_Position;
+}
+}
+
+bool
+MetaImageStitcher
+::GetShardRange( unsigned long size, unsigned long k, unsigned long N,
+  unsigned long & start, unsigned long & shardSize )
+{
+  if( N == 0 || k >= N )
+    {
+    return false;
+    }
+  // The end of slab k is computed as the start of slab k + 1, so the
+  // slabs tile the axis.
+  start = static_cast<unsigned long>( static_cast<double>( size ) * k / N );
+  const unsigned long end = static_cast<unsigned long>( static_cast<double>( size ) * ( k + 1 ) / N );
+  shardSize = end - start;
+  return shardSize > 0;
+}
+
+bool
+MetaImageStitcher
+::Stitch( const std::string & outputFileName, const std::vector<std::string> & shardFileNames,
+  std::string & errorMessage )
+{
+  if( shardFileNames.empty() )
+    {
+    errorMessage = "No shards were given.";
+    return false;
+    }
+  if( !MemoryMappedFile::HasExtension( outputFileName, ".mha" ) )
+    {
+    errorMessage = "The stitched image has to be a MetaImage (.mha) file.";
+    return false;
+    }
+
+  if( std::find( shardFileNames.begin(), shardFileNames.end(), outputFileName ) != shardFileNames.end() )
+    {
+    errorMessage = "The stitched image can't replace one of the shards.";
+    return false;
+    }
+
+  std::vector<ShardType> shards( shardFileNames.size() );
+  std::string elementType;
+  std::size_t elementSize = 0;
+  unsigned int numberOfDimensions = 0;
+  std::vector<double> spacing;
+  std::vector<double> direction;
+  for( std::size_t n = 0; n < shards.size(); n++ )
+    {
+    ShardType & shard = shards[n];
+    shard.m_FileName = shardFileNames[n];
+    shard.m_File = MemoryMappedFile::New();
+    if( !shard.m_File->OpenForReading( shard.m_FileName ) ||
+      !ReadHeader( shard.m_File->GetBuffer(), shard.m_File->GetSize(), shard.m_Header, shard.m_DataOffset ) )
+      {
+      errorMessage = shard.m_FileName + " is not a MetaImage file.";
+      return false;
+      }
+    const HeaderType & header = shard.m_Header;
+    if( GetValue( header, "ElementDataFile" ) != "LOCAL" ||
+      GetValue( header, "CompressedData" ) == "True" )
+      {
+      errorMessage = shard.m_FileName + " is not an uncompressed MetaImage (.mha) file.";
+      return false;
+      }
+
+    shard.m_Size = ParseVector<unsigned long>( GetValue( header, "DimSize" ) );
+    shard.m_Origin = ParseVector<double>( GetValue( header, "Offset", "Origin", "Position" ) );
+    const std::vector<double> shardSpacing = ParseVector<double>( GetValue( header, "ElementSpacing" ) );
+    const std::vector<double> shardDirection =
+      ParseVector<double>( GetValue( header, "TransformMatrix", "Rotation", "Orientation" ) );
+    const std::string shardElementType = GetValue( header, "ElementType" );
+    const unsigned int dimension = static_cast<unsigned int>( shard.m_Size.size() );
+    if( dimension == 0 || shard.m_Origin.size() != dimension || shardSpacing.size() != dimension ||
+      shardDirection.size() != dimension * dimension )
+      {
+      errorMessage = "The geometry of " + shard.m_FileName + " is incomplete.";
+      return false;
+      }
+
+    if( n == 0 )
+      {
+      numberOfDimensions = dimension;
+      spacing = shardSpacing;
+      direction = shardDirection;
+      elementType = shardElementType;
+      elementSize = GetElementSize( elementType );
+      if( elementSize == 0 )
+        {
+        errorMessage = "The element type " + elementType + " is not supported.";
+        return false;
+        }
+      const std::string channels = GetValue( header, "ElementNumberOfChannels" );
+      if( !channels.empty() )
+        {
+        elementSize *= static_cast<std::size_t>( std::atoi( channels.c_str() ) );
+        }
+      }
+    else
+      {
+      bool isCompatible = ( dimension == numberOfDimensions && shardElementType == elementType &&
+        GetValue( header, "ElementNumberOfChannels" ) ==
+        GetValue( shards[0].m_Header, "ElementNumberOfChannels" ) &&
+        GetValue( header, "BinaryDataByteOrderMSB" ) ==
+        GetValue( shards[0].m_Header, "BinaryDataByteOrderMSB" ) );
+      for( unsigned int d = 0; isCompatible && d < dimension; d++ )
+        {
+        isCompatible = ( std::fabs( shardSpacing[d] - spacing[d] ) <= 1e-6 * std::fabs( spacing[d] ) &&
+          ( d + 1 == dimension || shard.m_Size[d] == shards[0].m_Size[d] ) );
+        }
+      for( unsigned int i = 0; isCompatible && i < dimension * dimension; i++ )
+        {
+        isCompatible = ( std::fabs( shardDirection[i] - direction[i] ) <= 1e-6 );
+        }
+      if( !isCompatible )
+        {
+        errorMessage = shard.m_FileName + " does not match the grid of " + shards[0].m_FileName + ".";
+        return false;
+        }
+      }
+
+    std::size_t numberOfBytes = elementSize;
+    for( unsigned int d = 0; d < dimension; d++ )
+      {
+      numberOfBytes *= shard.m_Size[d];
+      }
+    if( shard.m_File->GetSize() < shard.m_DataOffset + numberOfBytes )
+      {
+      errorMessage = shard.m_FileName + " is truncated.";
+      return false;
+      }
+    }
+
+  // Position of each shard along the last axis in voxels relative to the
+  // first shard.  The last column of the (column-major) TransformMatrix is
+  // the direction of the last axis.
+  const unsigned int last = numberOfDimensions - 1;
+  for( std::size_t n = 0; n < shards.size(); n++ )
+    {
+    double position = 0.0;
+    for( unsigned int d = 0; d < numberOfDimensions; d++ )
+      {
+      position += ( shards[n].m_Origin[d] - shards[0].m_Origin[d] ) * direction[last * numberOfDimensions + d];
+      }
+    shards[n].m_Position = position / spacing[last];
+    }
+  std::stable_sort( shards.begin(), shards.end(), CompareShardPositions );
+
+  // The shards have to follow each other without gaps or overlaps and
+  // share the position along the other axes.
+  unsigned long lastSize = 0;
+  for( std::size_t n = 0; n < shards.size(); n++ )
+    {
+    const double expected = shards[0].m_Position + static_cast<double>( lastSize );
+    double offAxis = 0.0;
+    for( unsigned int d = 0; d < numberOfDimensions; d++ )
+      {
+      const double difference = shards[n].m_Origin[d] - shards[0].m_Origin[d] -
+        ( shards[n].m_Position - shards[0].m_Position ) * spacing[last] *
+        direction[last * numberOfDimensions + d];
+      offAxis = std::max( offAxis, std::fabs( difference ) );
+      }
+    if( std::fabs( shards[n].m_Position - expected ) > 1e-3 || offAxis > 1e-3 * spacing[last] )
+      {
+      errorMessage = shards[n].m_FileName + " does not continue the preceding shards along the last axis.";
+      return false;
+      }
+    lastSize += shards[n].m_Size[last];
+    }
+
+  // The header of the first shard with the total size along the last axis.
+  std::ostringstream oss;
+  for( HeaderType::const_iterator it = shards[0].m_Header.begin(); it != shards[0].m_Header.end(); ++it )
+    {
+    if( it->first == "DimSize" )
+      {
+      oss << "DimSize =";
+      for( unsigned int d = 0; d < numberOfDimensions; d++ )
+        {
+        oss << " " << ( d == last ? lastSize : shards[0].m_Size[d] );
+        }
+      oss << std::endl;
+      }
+    else if( it->first != "Comment" )
+      {
+      oss << it->first << " = " << it->second << std::endl;
+      }
+    }
+  const std::string header = oss.str();
+
+  std::size_t numberOfBytes = 0;
+  for( std::size_t n = 0; n < shards.size(); n++ )
+    {
+    std::size_t shardBytes = elementSize;
+    for( unsigned int d = 0; d < numberOfDimensions; d++ )
+      {
+      shardBytes *= shards[n].m_Size[d];
+      }
+    numberOfBytes += shardBytes;
+    }
+
+  MemoryMappedFile::Pointer output = MemoryMappedFile::New();
+  if( !output->CreateForWriting( outputFileName, header.length() + numberOfBytes ) )
+    {
+    errorMessage = "Unable to create " + outputFileName + ".";
+    return false;
+    }
+  char *buffer = output->GetBuffer();
+  std::memcpy( buffer, header.c_str(), header.length() );
+  buffer += header.length();
+  for( std::size_t n = 0; n < shards.size(); n++ )
+    {
+    std::size_t shardBytes = elementSize;
+    for( unsigned int d = 0; d < numberOfDimensions; d++ )
+      {
+      shardBytes *= shards[n].m_Size[d];
+      }
+    std::memcpy( buffer, shards[n].m_File->GetBuffer() + shards[n].m_DataOffset, shardBytes );
+    buffer += shardBytes;
+    shards[n].m_File->Close();
+    }
+  output->Close();
+  return true;
+}
+
+} // end namespace ants
+} // end namespace itk
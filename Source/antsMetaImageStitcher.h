@@ -0,0 +1,65 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsMetaImageStitcher.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsMetaImageStitcher_h
+#define __antsMetaImageStitcher_h
+
+#include "itkMacro.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+namespace ants
+{
+/** \class MetaImageStitcher
+    \brief Assemble slabs of an image stored as uncompressed MetaImage
+    files into one file.
+    \par
+    The slabs (e.g. the shards written by antsApplyTransforms --shard) have
+    to share the element type, spacing, direction and the size along all
+    but the last axis, and have to tile a contiguous range along the last
+    axis in any order.  Since the voxels of a slab are contiguous in the
+    stitched image, the voxel data of each slab is copied as a single block
+    of bytes after the header of the stitched image; nothing is decoded.
+    The stitched image has the origin of the first slab along the last
+    axis.
+*/
+
+class ITK_EXPORT MetaImageStitcher
+{
+public:
+  /** Stitch the shards into the output file.  Returns false and sets the
+   * error message if the shards can't be read or don't fit together. */
+  static bool Stitch( const std::string & outputFileName,
+    const std::vector<std::string> & shardFileNames, std::string & errorMessage );
+
+  /** Start and size of the k-th of N slabs of an axis of the given size:
+   * the slabs differ in size by at most one voxel.  Returns false if k is
+   * not below N or the slab would be empty. */
+  static bool GetShardRange( unsigned long size, unsigned long k, unsigned long N,
+    unsigned long & start, unsigned long & shardSize );
+
+private:
+  MetaImageStitcher(); //purposely not implemented
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
@@ -0,0 +1,244 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsParallelGzipCompressor.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsParallelGzipCompressor.h"
+
+#include "itk_zlib.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+
+namespace itk
+{
+namespace ants
+{
+
+namespace
+{
+// Size of the deflate window, i.e. the maximum useful dictionary size.
+const std::size_t DeflateWindowSize = 32768;
+
+// Number of blocks per thread compressed before the results are written.
+const std::size_t BlocksPerThreadAndRound = 4;
+
+void WriteLittleEndian32( std::ofstream & os, unsigned long value )
+{
+  unsigned char bytes[4];
+  for( unsigned int i = 0; i < 4; i++ )
+    {
+    bytes[i] = static_cast<unsigned char>( ( value >> ( 8 * i ) ) & 0xff );
+    }
+  os.write( reinterpret_cast<const char *>( bytes ), 4 );
+}
+} // end anonymous namespace
+
+ParallelGzipCompressor
+::ParallelGzipCompressor() : m_CompressionLevel( 6 ),
+                             m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+                             m_BlockSize( 1 << 20 ),
+                             m_Input( NULL ),
+                             m_InputSize( 0 ),
+                             m_NumberOfBlocks( 0 ),
+                             m_FirstBlock( 0 ),
+                             m_BlocksInRound( 0 )
+{
+}
+
+bool
+ParallelGzipCompressor
+::WriteFile( const char *buffer, std::size_t size, const std::string & filename )
+{
+  std::ofstream os( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+  if( !os )
+    {
+    return false;
+    }
+
+  // gzip member header:  magic, deflate, no flags, no time stamp, extra
+  // flags indicating the compression level and unix as operating system.
+  unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+  if( this->m_CompressionLevel >= 9 )
+    {
+    header[8] = 2;
+    }
+  else if( this->m_CompressionLevel <= 1 )
+    {
+    header[8] = 4;
+    }
+  os.write( reinterpret_cast<const char *>( header ), 10 );
+
+  this->m_Input = buffer;
+  this->m_InputSize = size;
+  this->m_NumberOfBlocks = std::max<std::size_t>( 1,
+    ( size + this->m_BlockSize - 1 ) / this->m_BlockSize );
+
+  const std::size_t blocksPerRound = std::max<std::size_t>( 1,
+    this->m_NumberOfThreads * BlocksPerThreadAndRound );
+  this->m_CompressedBlocks.resize( blocksPerRound );
+  this->m_BlockCRCs.resize( blocksPerRound );
+  this->m_BlockSucceeded.resize( blocksPerRound );
+
+  MultiThreader::Pointer threader = MultiThreader::New();
+
+  unsigned long crc = crc32( 0L, Z_NULL, 0 );
+  bool succeeded = true;
+
+  for( this->m_FirstBlock = 0; succeeded && this->m_FirstBlock < this->m_NumberOfBlocks;
+    this->m_FirstBlock += blocksPerRound )
+    {
+    this->m_BlocksInRound = std::min( blocksPerRound,
+      this->m_NumberOfBlocks - this->m_FirstBlock );
+
+    threader->SetNumberOfThreads( static_cast<int>( std::min<std::size_t>(
+      this->m_NumberOfThreads, this->m_BlocksInRound ) ) );
+    threader->SetSingleMethod( Self::CompressBlocksThreaderCallback, this );
+    threader->SingleMethodExecute();
+
+    for( std::size_t n = 0; n < this->m_BlocksInRound; n++ )
+      {
+      if( !this->m_BlockSucceeded[n] )
+        {
+        succeeded = false;
+        break;
+        }
+      const std::size_t start = ( this->m_FirstBlock + n ) * this->m_BlockSize;
+      const std::size_t length = std::min( this->m_BlockSize, size - std::min( size, start ) );
+      crc = crc32_combine( crc, this->m_BlockCRCs[n], static_cast<z_off_t>( length ) );
+
+      os.write( reinterpret_cast<const char *>( &this->m_CompressedBlocks[n][0] ),
+        this->m_CompressedBlocks[n].size() );
+      std::vector<unsigned char>().swap( this->m_CompressedBlocks[n] );
+      }
+    }
+
+  // gzip member trailer:  CRC-32 and size modulo 2^32.
+  WriteLittleEndian32( os, crc );
+  WriteLittleEndian32( os, static_cast<unsigned long>( size & 0xffffffffUL ) );
+
+  this->m_Input = NULL;
+  this->m_InputSize = 0;
+  this->m_CompressedBlocks.clear();
+
+  return ( succeeded && os.good() );
+}
+
+ITK_THREAD_RETURN_TYPE
+ParallelGzipCompressor
+::CompressBlocksThreaderCallback( void *arg )
+{
+  MultiThreader::ThreadInfoStruct *info =
+    static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+  Self *self = static_cast<Self *>( info->UserData );
+
+  const std::size_t threadId = static_cast<std::size_t>( info->ThreadID );
+  const std::size_t numberOfThreads = static_cast<std::size_t>( info->NumberOfThreads );
+
+  for( std::size_t n = threadId; n < self->m_BlocksInRound; n += numberOfThreads )
+    {
+    self->m_BlockSucceeded[n] = self->CompressBlock( n );
+    }
+
+  return ITK_THREAD_RETURN_VALUE;
+}
+
+bool
+ParallelGzipCompressor
+::CompressBlock( std::size_t n )
+{
+  const std::size_t block = this->m_FirstBlock + n;
+  const std::size_t start = std::min( this->m_InputSize, block * this->m_BlockSize );
+  const std::size_t length = std::min( this->m_BlockSize, this->m_InputSize - start );
+  const bool isLastBlock = ( block + 1 == this->m_NumberOfBlocks );
+
+  Bytef *input = reinterpret_cast<Bytef *>( const_cast<char *>( this->m_Input + start ) );
+
+  this->m_BlockCRCs[n] = crc32( crc32( 0L, Z_NULL, 0 ), input, static_cast<uInt>( length ) );
+
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+
+  // Raw deflate (negative window bits):  the gzip framing is written by
+  // WriteFile().
+  if( deflateInit2( &stream, this->m_CompressionLevel, Z_DEFLATED, -15, 8,
+      Z_DEFAULT_STRATEGY ) != Z_OK )
+    {
+    return false;
+    }
+
+  if( start > 0 )
+    {
+    const std::size_t dictionaryLength = std::min( start, DeflateWindowSize );
+    if( deflateSetDictionary( &stream, input - dictionaryLength,
+        static_cast<uInt>( dictionaryLength ) ) != Z_OK )
+      {
+      deflateEnd( &stream );
+      return false;
+      }
+    }
+
+  // Leave room for the sync flush marker in addition to the worst case
+  // expansion of the data.
+  std::vector<unsigned char> & output = this->m_CompressedBlocks[n];
+  output.resize( deflateBound( &stream, static_cast<uLong>( length ) ) + 16 );
+
+  stream.next_in = input;
+  stream.avail_in = static_cast<uInt>( length );
+  stream.next_out = reinterpret_cast<Bytef *>( &output[0] );
+  stream.avail_out = static_cast<uInt>( output.size() );
+
+  const int status = deflate( &stream, isLastBlock ? Z_FINISH : Z_SYNC_FLUSH );
+  const bool succeeded = ( isLastBlock ? ( status == Z_STREAM_END ) : ( status == Z_OK ) ) &&
+    ( stream.avail_in == 0 );
+
+  output.resize( output.size() - stream.avail_out );
+  deflateEnd( &stream );
+
+  return succeeded;
+}
+
+int
+ParallelGzipCompressor
+::ParseCompressionLevel( const std::string & value )
+{
+  std::string level( value );
+  std::transform( level.begin(), level.end(), level.begin(), tolower );
+
+  if( level == "fast" || level == "fastest" )
+    {
+    return 1;
+    }
+  else if( level == "best" )
+    {
+    return 9;
+    }
+  else if( level == "default" )
+    {
+    return 6;
+    }
+  else if( level.length() == 1 && level[0] >= '0' && level[0] <= '9' )
+    {
+    return level[0] - '0';
+    }
+  return -1;
+}
+
+} // end namespace ants
+} // end namespace itk
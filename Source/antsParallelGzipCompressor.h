@@ -0,0 +1,136 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsParallelGzipCompressor.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsParallelGzipCompressor_h
+#define __antsParallelGzipCompressor_h
+
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkMacro.h"
+#include "itkMultiThreader.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+namespace ants
+{
+/** \class ParallelGzipCompressor
+    \brief Compress a buffer into a standard single-member gzip file using
+    all available threads.
+    \par
+    The input is split into blocks which are deflated independently.  Each
+    block is primed with the 32 kB of input preceding it (as a preset
+    dictionary) so the compression ratio is close to that of a serial
+    deflate.  All but the last block are terminated with a sync flush such
+    that the raw deflate streams can simply be concatenated.  The CRC of the
+    whole buffer is assembled from the per-block CRCs.  The result can be
+    read by any gzip/zlib based reader (e.g. the NIfTI reader).
+    \par
+    Blocks are compressed in rounds of a few blocks per thread so that the
+    memory needed for the compressed data is bounded.
+*/
+
+class ITK_EXPORT ParallelGzipCompressor
+: public LightObject
+{
+public:
+  /** Standard class typedefs. */
+  typedef ParallelGzipCompressor                     Self;
+  typedef LightObject                                Superclass;
+  typedef SmartPointer<Self>                         Pointer;
+  typedef SmartPointer<const Self>                   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ParallelGzipCompressor, LightObject );
+
+  /** zlib compression level: 0 (store) ... 9 (best).  Default is 6, the
+   * level used by gzip and by the NIfTI writer. */
+  void SetCompressionLevel( int level )
+    {
+    this->m_CompressionLevel = ( level < 0 ) ? 0 : ( ( level > 9 ) ? 9 : level );
+    }
+  int GetCompressionLevel() const
+    {
+    return this->m_CompressionLevel;
+    }
+
+  /** Number of threads (defaults to the global default of the threader). */
+  void SetNumberOfThreads( unsigned int n )
+    {
+    this->m_NumberOfThreads = ( n > 0 ) ? n : 1;
+    }
+  unsigned int GetNumberOfThreads() const
+    {
+    return this->m_NumberOfThreads;
+    }
+
+  /** Size of the independently compressed blocks in bytes. */
+  void SetBlockSize( std::size_t size )
+    {
+    this->m_BlockSize = ( size > 0 ) ? size : 1;
+    }
+  std::size_t GetBlockSize() const
+    {
+    return this->m_BlockSize;
+    }
+
+  /** Compress the buffer and write the gzip stream to the file.  Returns
+   * false if the file cannot be written or zlib reports an error. */
+  bool WriteFile( const char *, std::size_t, const std::string & );
+
+  /** Parse a compression level option value ("fast", "best", "default" or
+   * a number).  Returns -1 for values that cannot be parsed. */
+  static int ParseCompressionLevel( const std::string & );
+
+protected:
+  ParallelGzipCompressor();
+  virtual ~ParallelGzipCompressor() {}
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE CompressBlocksThreaderCallback( void * );
+
+  /** Compress a single block of the current round. */
+  bool CompressBlock( std::size_t );
+
+private:
+  ParallelGzipCompressor( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  int                                                m_CompressionLevel;
+  unsigned int                                       m_NumberOfThreads;
+  std::size_t                                        m_BlockSize;
+
+  // State of the round being compressed.
+  const char                                        *m_Input;
+  std::size_t                                        m_InputSize;
+  std::size_t                                        m_NumberOfBlocks;
+  std::size_t                                        m_FirstBlock;
+  std::size_t                                        m_BlocksInRound;
+  std::vector<std::vector<unsigned char> >           m_CompressedBlocks;
+  std::vector<unsigned long>                         m_BlockCRCs;
+  std::vector<char>                                  m_BlockSucceeded;
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
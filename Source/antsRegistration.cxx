@@ -17,6 +17,7 @@
 *=========================================================================*/
 
 #include "antsCommandLineParser.h"
+#include "antsThreadAffinity.h"
 
 #include "itkImageRegistrationMethodv4.h"
 #include "itkTimeVaryingVelocityFieldImageRegistrationMethodv4.h"
@@ -52,10 +53,13 @@
 
 #include "itkGradientDescentOptimizerv4.h"
 
+#include "itkCastImageFilter.h"
 #include "itkHistogramMatchingImageFilter.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 #include "itkMacro.h"
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkParallelGzipImageFileWriter.h"
 #include "itkRegistrationParameterScalesFromShift.h"
 #include "itkResampleImageFilter.h"
 #include "itkShrinkImageFilter.h"
@@ -64,6 +68,7 @@
 #include "itkTransformFileWriter.h"
 #include "itkVector.h"
 
+#include <algorithm>
 #include <sstream>
 
 template<class TFilter>
@@ -167,6 +172,45 @@ public:
    typedef itk::Similarity3DTransform<double>  TransformType;
 };
 
+/**
+ * The registration methods and metrics operate on double precision
+ * transforms.  The resulting displacement fields can optionally be stored
+ * in single precision (--float) which halves the size of the warp files and
+ * the bandwidth needed to read them back in antsApplyTransforms.  The
+ * .nii.gz fields are compressed on all threads with the given level.
+ */
+template<class TDisplacementField>
+void WriteDisplacementField( const TDisplacementField *field,
+  const std::string & filename, bool useFloatPrecision, int compressionLevel )
+{
+  if( useFloatPrecision )
+    {
+    typedef itk::Vector<float, TDisplacementField::ImageDimension> FloatVectorType;
+    typedef itk::Image<FloatVectorType, TDisplacementField::ImageDimension> FloatDisplacementFieldType;
+
+    typedef itk::CastImageFilter<TDisplacementField, FloatDisplacementFieldType> CasterType;
+    typename CasterType::Pointer caster = CasterType::New();
+    caster->SetInput( field );
+    caster->Update();
+
+    typedef itk::ParallelGzipImageFileWriter<FloatDisplacementFieldType> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( caster->GetOutput() );
+    writer->SetFileName( filename );
+    writer->SetCompressionLevel( compressionLevel );
+    writer->Update();
+    }
+  else
+    {
+    typedef itk::ParallelGzipImageFileWriter<TDisplacementField> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( field );
+    writer->SetFileName( filename );
+    writer->SetCompressionLevel( compressionLevel );
+    writer->Update();
+    }
+}
+
 void ConvertToLowerCase( std::string& str )
 {
   std::transform( str.begin(), str.end(), str.begin(), tolower );
@@ -242,6 +286,48 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
     outputPrefix = outputOption->GetParameter( 0, 0 );
     }
 
+  bool useFloatPrecision = false;
+  typename OptionType::Pointer floatOption = parser->GetOption( "float" );
+  if( floatOption && floatOption->GetNumberOfValues() > 0 )
+    {
+    useFloatPrecision = parser->Convert<bool>( floatOption->GetValue() );
+    }
+  if( useFloatPrecision )
+    {
+    std::cout << "Displacement fields are written in single precision." << std::endl;
+    }
+
+  int compressionLevel = 6;
+  typename OptionType::Pointer compressionOption = parser->GetOption( "compressionLevel" );
+  if( compressionOption && compressionOption->GetNumberOfValues() > 0 )
+    {
+    compressionLevel = itk::ants::ParallelGzipCompressor::ParseCompressionLevel(
+      compressionOption->GetValue() );
+    if( compressionLevel < 0 )
+      {
+      std::cerr << "Unrecognized compression level: " << compressionOption->GetValue() << std::endl;
+      return EXIT_FAILURE;
+      }
+    }
+
+  // The fixed and moving images are read anew for every stage.  Memory
+  // mapping (and the cache of decompressed inputs) avoids decoding the same
+  // files over and over.
+
+  bool useMemoryMapping = false;
+  typename OptionType::Pointer memoryMapOption = parser->GetOption( "useMemoryMapping" );
+  if( memoryMapOption && memoryMapOption->GetNumberOfValues() > 0 )
+    {
+    useMemoryMapping = parser->Convert<bool>( memoryMapOption->GetValue() );
+    }
+  std::string cacheDirectory( "" );
+  typename OptionType::Pointer cacheOption = parser->GetOption( "cacheDirectory" );
+  if( cacheOption && cacheOption->GetNumberOfValues() > 0 )
+    {
+    cacheDirectory = cacheOption->GetValue();
+    useMemoryMapping = true;
+    }
+
   typedef float                                 PixelType;
   typedef double                                RealType;
   typedef itk::Image<PixelType, ImageDimension> FixedImageType;
@@ -291,10 +377,12 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
         typedef typename DisplacementFieldTransformType::DisplacementFieldType
           DisplacementFieldType;
 
-        typedef itk::ImageFileReader<DisplacementFieldType> DisplacementFieldReaderType;
+        typedef itk::MemoryMappedImageFileReader<DisplacementFieldType> DisplacementFieldReaderType;
         typename DisplacementFieldReaderType::Pointer fieldReader =
           DisplacementFieldReaderType::New();
-        fieldReader->SetFileName( initialTransformName.c_str() );
+        fieldReader->SetFileName( initialTransformName );
+        fieldReader->SetUseMemoryMapping( useMemoryMapping );
+        fieldReader->SetCacheDirectory( cacheDirectory );
         fieldReader->Update();
 
         typename DisplacementFieldTransformType::Pointer displacementFieldTransform =
@@ -401,20 +489,20 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
     std::cout << "  fixed image: " << fixedImageFileName << std::endl;
     std::cout << "  moving image: " << movingImageFileName << std::endl;
 
-    typedef itk::ImageFileReader<FixedImageType> ImageReaderType;
+    typedef itk::MemoryMappedImageFileReader<FixedImageType> ImageReaderType;
     typename ImageReaderType::Pointer fixedImageReader = ImageReaderType::New();
-    fixedImageReader->SetFileName( fixedImageFileName.c_str() );
+    fixedImageReader->SetFileName( fixedImageFileName );
+    fixedImageReader->SetUseMemoryMapping( useMemoryMapping );
+    fixedImageReader->SetCacheDirectory( cacheDirectory );
     fixedImageReader->Update();
     typename FixedImageType::Pointer fixedImage = fixedImageReader->GetOutput();
-    fixedImage->Update();
-    fixedImage->DisconnectPipeline();
 
     typename ImageReaderType::Pointer movingImageReader = ImageReaderType::New();
-    movingImageReader->SetFileName( movingImageFileName.c_str() );
+    movingImageReader->SetFileName( movingImageFileName );
+    movingImageReader->SetUseMemoryMapping( useMemoryMapping );
+    movingImageReader->SetCacheDirectory( cacheDirectory );
     movingImageReader->Update();
     typename MovingImageType::Pointer movingImage = movingImageReader->GetOutput();
-    movingImage->Update();
-    movingImage->DisconnectPipeline();
 
     // Histogram match images if requested by the user
 
@@ -834,11 +922,8 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
 
       std::string filename = outputPrefix + currentStageString.str() + std::string( "Warp.nii.gz" );
 
-      typedef itk::ImageFileWriter<DisplacementFieldType> WriterType;
-      typename WriterType::Pointer writer = WriterType::New();
-      writer->SetInput( const_cast<typename DisplacementFieldRegistrationType::TransformType *>( displacementFieldRegistration->GetOutput()->Get() )->GetDisplacementField() );
-      writer->SetFileName( filename.c_str() );
-      writer->Update();
+      WriteDisplacementField<DisplacementFieldType>( const_cast<typename DisplacementFieldRegistrationType::TransformType *>(
+        displacementFieldRegistration->GetOutput()->Get() )->GetDisplacementField(), filename, useFloatPrecision, compressionLevel );
       }
     else if( std::strcmp( whichTransform.c_str(), "bsplinedisplacementfield" ) == 0 || std::strcmp( whichTransform.c_str(), "dmffd" ) == 0 )
       {
@@ -962,11 +1047,8 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
 
       std::string filename = outputPrefix + currentStageString.str() + std::string( "Warp.nii.gz" );
 
-      typedef itk::ImageFileWriter<DisplacementFieldType> WriterType;
-      typename WriterType::Pointer writer = WriterType::New();
-      writer->SetInput( const_cast<typename DisplacementFieldRegistrationType::TransformType *>( displacementFieldRegistration->GetOutput()->Get() )->GetDisplacementField() );
-      writer->SetFileName( filename.c_str() );
-      writer->Update();
+      WriteDisplacementField<DisplacementFieldType>( const_cast<typename DisplacementFieldRegistrationType::TransformType *>(
+        displacementFieldRegistration->GetOutput()->Get() )->GetDisplacementField(), filename, useFloatPrecision, compressionLevel );
       }
     else if( std::strcmp( whichTransform.c_str(), "bspline" ) == 0 || std::strcmp( whichTransform.c_str(), "ffd" ) == 0 )
       {
@@ -1221,19 +1303,13 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
 
       typedef typename VelocityFieldRegistrationType::TransformType::DisplacementFieldType DisplacementFieldType;
 
-      typedef itk::ImageFileWriter<DisplacementFieldType> WriterType;
-      typename WriterType::Pointer writer = WriterType::New();
-      writer->SetInput( const_cast<typename VelocityFieldRegistrationType::TransformType *>( velocityFieldRegistration->GetOutput()->Get() )->GetDisplacementField() );
-      writer->SetFileName( filename.c_str() );
-      writer->Update();
+      WriteDisplacementField<DisplacementFieldType>( const_cast<typename VelocityFieldRegistrationType::TransformType *>(
+        velocityFieldRegistration->GetOutput()->Get() )->GetDisplacementField(), filename, useFloatPrecision, compressionLevel );
 
       std::string inverseFilename = outputPrefix + currentStageString.str() + std::string( "InverseWarp.nii.gz" );
 
-      typedef itk::ImageFileWriter<DisplacementFieldType> InverseWriterType;
-      typename InverseWriterType::Pointer inverseWriter = InverseWriterType::New();
-      inverseWriter->SetInput( const_cast<typename VelocityFieldRegistrationType::TransformType *>( velocityFieldRegistration->GetOutput()->Get() )->GetInverseDisplacementField() );
-      inverseWriter->SetFileName( inverseFilename.c_str() );
-      inverseWriter->Update();
+      WriteDisplacementField<DisplacementFieldType>( const_cast<typename VelocityFieldRegistrationType::TransformType *>(
+        velocityFieldRegistration->GetOutput()->Get() )->GetInverseDisplacementField(), inverseFilename, useFloatPrecision, compressionLevel );
       }
     else if( std::strcmp( whichTransform.c_str(), "timevaryingbsplinevelocityfield" ) == 0 || std::strcmp( whichTransform.c_str(), "tvdmffd" ) == 0 )
       {
@@ -1407,19 +1483,13 @@ int antsRegistration( itk::ants::CommandLineParser *parser )
 
       typedef typename VelocityFieldRegistrationType::TransformType::DisplacementFieldType DisplacementFieldType;
 
-      typedef itk::ImageFileWriter<DisplacementFieldType> WriterType;
-      typename WriterType::Pointer writer = WriterType::New();
-      writer->SetInput( const_cast<typename VelocityFieldRegistrationType::TransformType *>( velocityFieldRegistration->GetOutput()->Get() )->GetDisplacementField() );
-      writer->SetFileName( filename.c_str() );
-      writer->Update();
+      WriteDisplacementField<DisplacementFieldType>( const_cast<typename VelocityFieldRegistrationType::TransformType *>(
+        velocityFieldRegistration->GetOutput()->Get() )->GetDisplacementField(), filename, useFloatPrecision, compressionLevel );
 
       std::string inverseFilename = outputPrefix + currentStageString.str() + std::string( "InverseWarp.nii.gz" );
 
-      typedef itk::ImageFileWriter<DisplacementFieldType> InverseWriterType;
-      typename InverseWriterType::Pointer inverseWriter = InverseWriterType::New();
-      inverseWriter->SetInput( const_cast<typename VelocityFieldRegistrationType::TransformType *>( velocityFieldRegistration->GetOutput()->Get() )->GetInverseDisplacementField() );
-      inverseWriter->SetFileName( inverseFilename.c_str() );
-      inverseWriter->Update();
+      WriteDisplacementField<DisplacementFieldType>( const_cast<typename VelocityFieldRegistrationType::TransformType *>(
+        velocityFieldRegistration->GetOutput()->Get() )->GetInverseDisplacementField(), inverseFilename, useFloatPrecision, compressionLevel );
       }
     else
       {
@@ -1634,6 +1704,76 @@ void InitializeCommandLineOptions( itk::ants::CommandLineParser *parser )
   parser->AddOption( option );
   }
 
+  {
+  std::string description = std::string( "Memory map the fixed and moving images and the initial displacement " ) +
+    std::string( "fields if they are stored as uncompressed NIfTI (.nii) or MetaImage (.mha/.mhd) files " ) +
+    std::string( "with the pixel type used for the registration." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "useMemoryMapping" );
+  option->SetUsageOption( 0, "0/(1)" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description = std::string( "Directory used to cache decompressed copies of gzipped (.nii.gz) " ) +
+    std::string( "inputs.  The cached copies are named after a hash of the compressed file and are memory " ) +
+    std::string( "mapped for the subsequent stages and runs.  Implies --useMemoryMapping." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "cacheDirectory" );
+  option->SetUsageOption( 0, "directory" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description = std::string( "Write the displacement fields (Warp.nii.gz and InverseWarp.nii.gz) " ) +
+    std::string( "in single precision.  The fields are read back in single precision with " ) +
+    std::string( "antsApplyTransforms --float." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "float" );
+  option->SetUsageOption( 0, "0/(1)" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description = std::string( "Compression level (0-9) of the gzipped displacement fields.  " ) +
+    std::string( "'fast' (= 1) is recommended for scratch outputs, 'best' (= 9) for archival.  The fields " ) +
+    std::string( "are compressed on all threads.  Default = 6." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "compressionLevel" );
+  option->SetUsageOption( 0, "0-9/fast/best/(default)" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description = std::string( "Number of threads.  Default is the number of CPUs (of the NUMA node " ) +
+    std::string( "given by --numaNode), or ITK_GLOBAL_DEFAULT_NUMBER_OF_THREADS." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "threads" );
+  option->SetUsageOption( 0, "numberOfThreads" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
+  {
+  std::string description = std::string( "Run all threads on the CPUs of the given NUMA node, such that the " ) +
+    std::string( "images are allocated in its memory.  Useful to run one registration per socket." );
+
+  OptionType::Pointer option = OptionType::New();
+  option->SetLongName( "numaNode" );
+  option->SetUsageOption( 0, "node" );
+  option->SetDescription( description );
+  parser->AddOption( option );
+  }
+
   {
   std::string description = std::string( "Print the help menu (short version)." );
 
@@ -1681,6 +1821,26 @@ int main( int argc, char *argv[] )
     exit( EXIT_FAILURE );
     }
 
+  // Threads and their placement
+  int numaNode = -1;
+  itk::ants::CommandLineParser::OptionType::Pointer numaOption = parser->GetOption( "numaNode" );
+  if( numaOption && numaOption->GetNumberOfValues() > 0 )
+    {
+    numaNode = parser->Convert<int>( numaOption->GetValue() );
+    }
+  int numberOfThreads = 0;
+  itk::ants::CommandLineParser::OptionType::Pointer threadsOption = parser->GetOption( "threads" );
+  if( threadsOption && threadsOption->GetNumberOfValues() > 0 )
+    {
+    numberOfThreads = parser->Convert<int>( threadsOption->GetValue() );
+    }
+  if( !itk::ants::ThreadAffinity::InitializeThreads( numaNode, numberOfThreads ) )
+    {
+    std::cerr << "Unable to run on NUMA node " << numaNode << " (the machine has "
+      << itk::ants::ThreadAffinity::GetNumberOfNodes() << " nodes)." << std::endl;
+    exit( EXIT_FAILURE );
+    }
+
   // Get dimensionality
   unsigned int dimension = 3;
 
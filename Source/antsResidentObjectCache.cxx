@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsResidentObjectCache.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsResidentObjectCache.h"
+
+#include <climits>
+#include <cstdlib>
+#include <sstream>
+
+#if !defined( _WIN32 )
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace itk
+{
+namespace ants
+{
+
+namespace
+{
+ResidentObjectCache::Pointer s_GlobalCache;
+}
+
+ResidentObjectCache
+::ResidentObjectCache() : m_MaximumSize( 4096.0 * 1048576.0 ),
+                          m_Size( 0.0 ),
+                          m_NumberOfHits( 0 ),
+                          m_NumberOfMisses( 0 )
+{
+}
+
+void
+ResidentObjectCache
+::SetMaximumSize( double size )
+{
+  this->m_MaximumSize = size;
+  this->Shrink();
+}
+
+LightObject *
+ResidentObjectCache
+::Find( const std::string & key )
+{
+  EntryMapType::iterator it = this->m_EntryMap.find( key );
+  if( it == this->m_EntryMap.end() )
+    {
+    this->m_NumberOfMisses++;
+    return NULL;
+    }
+  this->m_NumberOfHits++;
+
+  // Move to the front of the list (most recently used).
+  this->m_Entries.splice( this->m_Entries.begin(), this->m_Entries, it->second );
+  return it->second->m_Object.GetPointer();
+}
+
+void
+ResidentObjectCache
+::Insert( const std::string & key, LightObject *object, double size )
+{
+  EntryMapType::iterator it = this->m_EntryMap.find( key );
+  if( it != this->m_EntryMap.end() )
+    {
+    this->m_Size -= it->second->m_Size;
+    this->m_Entries.erase( it->second );
+    this->m_EntryMap.erase( it );
+    }
+  if( !object || size > this->m_MaximumSize )
+    {
+    return;
+    }
+
+  EntryType entry;
+  entry.m_Key = key;
+  entry.m_Object = object;
+  entry.m_Size = size;
+  this->m_Entries.push_front( entry );
+  this->m_EntryMap[key] = this->m_Entries.begin();
+  this->m_Size += size;
+
+  this->Shrink();
+}
+
+void
+ResidentObjectCache
+::Clear()
+{
+  this->m_Entries.clear();
+  this->m_EntryMap.clear();
+  this->m_Size = 0.0;
+}
+
+void
+ResidentObjectCache
+::Shrink()
+{
+  while( this->m_Size > this->m_MaximumSize && !this->m_Entries.empty() )
+    {
+    const EntryType & entry = this->m_Entries.back();
+    this->m_Size -= entry.m_Size;
+    this->m_EntryMap.erase( entry.m_Key );
+    this->m_Entries.pop_back();
+    }
+}
+
+std::string
+ResidentObjectCache
+::GetFileKey( const std::string & filename, const std::string & type )
+{
+#if defined( _WIN32 )
+  return std::string( "" );
+#else
+  struct stat info;
+  if( stat( filename.c_str(), &info ) != 0 )
+    {
+    return std::string( "" );
+    }
+
+  // The path is made absolute since relative names depend on the working
+  // directory of the request.
+  char path[PATH_MAX];
+  if( !realpath( filename.c_str(), path ) )
+    {
+    return std::string( "" );
+    }
+
+  std::ostringstream oss;
+  oss << type << ":" << path << ":" << static_cast<long long>( info.st_size )
+    << ":" << static_cast<long long>( info.st_mtime );
+#if defined( __linux__ )
+  oss << "." << static_cast<long>( info.st_mtim.tv_nsec );
+#endif
+  return oss.str();
+#endif
+}
+
+void
+ResidentObjectCache
+::SetGlobalCache( Self *cache )
+{
+  s_GlobalCache = cache;
+}
+
+ResidentObjectCache *
+ResidentObjectCache
+::GetGlobalCache()
+{
+  return s_GlobalCache.GetPointer();
+}
+
+} // end namespace ants
+} // end namespace itk
@@ -0,0 +1,161 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsResidentObjectCache.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsResidentObjectCache_h
+#define __antsResidentObjectCache_h
+
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkMacro.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace itk
+{
+namespace ants
+{
+/** \class ResidentObjectCache
+    \brief Least recently used cache of decoded objects of a long running
+    process.
+    \par
+    Objects (images, transforms, coordinate maps) are stored under a string
+    key together with their approximate size in bytes.  When the total size
+    exceeds the maximum, the least recently used objects are dropped.  An
+    object larger than the maximum is not cached at all.
+    \par
+    Keys of objects read from files are built with GetFileKey() which
+    includes the absolute path, size and modification time of the file, so
+    a modified file is read again.  The global cache is only set by
+    processes serving many requests (see antsApplyTransforms --daemon);
+    otherwise GetGlobalCache() returns NULL and nothing is cached.
+*/
+
+class ITK_EXPORT ResidentObjectCache
+: public LightObject
+{
+public:
+  /** Standard class typedefs. */
+  typedef ResidentObjectCache                        Self;
+  typedef LightObject                                Superclass;
+  typedef SmartPointer<Self>                         Pointer;
+  typedef SmartPointer<const Self>                   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( ResidentObjectCache, LightObject );
+
+  /** Maximum total size in bytes.  Default is 4 GiB. */
+  void SetMaximumSize( double );
+  double GetMaximumSize() const
+    {
+    return this->m_MaximumSize;
+    }
+
+  /** Total size of the cached objects in bytes. */
+  double GetSize() const
+    {
+    return this->m_Size;
+    }
+  std::size_t GetNumberOfObjects() const
+    {
+    return this->m_Entries.size();
+    }
+  unsigned long GetNumberOfHits() const
+    {
+    return this->m_NumberOfHits;
+    }
+  unsigned long GetNumberOfMisses() const
+    {
+    return this->m_NumberOfMisses;
+    }
+
+  /** The object stored under the key (NULL if there is none).  The object
+   * becomes the most recently used one. */
+  LightObject * Find( const std::string & );
+
+  /** Store an object, replacing any object stored under the same key. */
+  void Insert( const std::string &, LightObject *, double size );
+
+  void Clear();
+
+  /** Key of the contents of a file:  absolute path, size and modification
+   * time prefixed by the given type name.  Empty if the file does not
+   * exist. */
+  static std::string GetFileKey( const std::string & filename, const std::string & type );
+
+  /** Cache used by the programs (NULL unless set). */
+  static void SetGlobalCache( Self * );
+  static Self * GetGlobalCache();
+
+  /** Look up an object of the given type in the global cache. */
+  template <class TObject>
+  static typename TObject::Pointer FindGlobal( const std::string & key )
+    {
+    Self *cache = GetGlobalCache();
+    if( !cache || key.empty() )
+      {
+      return NULL;
+      }
+    return dynamic_cast<TObject *>( cache->Find( key ) );
+    }
+
+  /** Store an object in the global cache (if any). */
+  static void InsertGlobal( const std::string & key, LightObject *object, double size )
+    {
+    Self *cache = GetGlobalCache();
+    if( cache && !key.empty() )
+      {
+      cache->Insert( key, object, size );
+      }
+    }
+
+protected:
+  ResidentObjectCache();
+  virtual ~ResidentObjectCache() {}
+
+  struct EntryType
+    {
+    std::string          m_Key;
+    LightObject::Pointer m_Object;
+    double               m_Size;
+    };
+  typedef std::list<EntryType>                              EntryListType;
+  typedef std::map<std::string, EntryListType::iterator>    EntryMapType;
+
+  /** Drop least recently used objects until the size fits. */
+  void Shrink();
+
+private:
+  ResidentObjectCache( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  EntryListType                                      m_Entries;
+  EntryMapType                                       m_EntryMap;
+  double                                             m_MaximumSize;
+  double                                             m_Size;
+  unsigned long                                      m_NumberOfHits;
+  unsigned long                                      m_NumberOfMisses;
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
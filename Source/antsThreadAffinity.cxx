@@ -0,0 +1,242 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsThreadAffinity.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsThreadAffinity.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined( __linux__ )
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+namespace ants
+{
+
+namespace
+{
+std::vector<int> s_CPUs;
+bool             s_BindThreads = false;
+
+/** Parse a list such as "0-15,32-47". */
+std::vector<int> ParseCPUList( const std::string & list )
+{
+  std::vector<int> cpus;
+  std::istringstream iss( list );
+  std::string range;
+  while( std::getline( iss, range, ',' ) )
+    {
+    if( range.empty() )
+      {
+      continue;
+      }
+    std::string::size_type dash = range.find( '-' );
+    int first = std::atoi( range.substr( 0, dash ).c_str() );
+    int last = ( dash == std::string::npos ) ? first : std::atoi( range.substr( dash + 1 ).c_str() );
+    for( int cpu = first; cpu <= last; cpu++ )
+      {
+      cpus.push_back( cpu );
+      }
+    }
+  return cpus;
+}
+
+/** CPUs of a node, empty if the node does not exist. */
+std::vector<int> GetNodeCPUs( unsigned int node )
+{
+  std::ostringstream oss;
+  oss << "/sys/devices/system/node/node" << node << "/cpulist";
+  std::ifstream file( oss.str().c_str() );
+  std::string list;
+  if( !file || !std::getline( file, list ) )
+    {
+    return std::vector<int>();
+    }
+  return ParseCPUList( list );
+}
+
+#if defined( __linux__ )
+/** Drop the CPUs the process is not allowed to run on (cgroups, taskset). */
+std::vector<int> GetAllowedCPUs( const std::vector<int> & cpus )
+{
+  cpu_set_t mask;
+  CPU_ZERO( &mask );
+  if( sched_getaffinity( 0, sizeof( mask ), &mask ) != 0 )
+    {
+    return cpus;
+    }
+  std::vector<int> allowed;
+  for( std::size_t n = 0; n < cpus.size(); n++ )
+    {
+    if( cpus[n] >= 0 && cpus[n] < CPU_SETSIZE && CPU_ISSET( cpus[n], &mask ) )
+      {
+      allowed.push_back( cpus[n] );
+      }
+    }
+  return allowed;
+}
+#endif
+}
+
+bool
+ThreadAffinity
+::Initialize( int node )
+{
+  s_CPUs.clear();
+
+  const unsigned int numberOfNodes = GetNumberOfNodes();
+  if( node >= static_cast<int>( numberOfNodes ) )
+    {
+    return false;
+    }
+  for( unsigned int n = 0; n < numberOfNodes; n++ )
+    {
+    if( node < 0 || static_cast<int>( n ) == node )
+      {
+      std::vector<int> cpus = GetNodeCPUs( n );
+      s_CPUs.insert( s_CPUs.end(), cpus.begin(), cpus.end() );
+      }
+    }
+
+#if defined( __linux__ )
+  if( s_CPUs.empty() )
+    {
+    const long numberOfCPUs = sysconf( _SC_NPROCESSORS_CONF );
+    for( long cpu = 0; cpu < numberOfCPUs; cpu++ )
+      {
+      s_CPUs.push_back( static_cast<int>( cpu ) );
+      }
+    }
+  s_CPUs = GetAllowedCPUs( s_CPUs );
+
+  if( node >= 0 )
+    {
+    if( s_CPUs.empty() )
+      {
+      return false;
+      }
+    cpu_set_t mask;
+    CPU_ZERO( &mask );
+    for( std::size_t n = 0; n < s_CPUs.size(); n++ )
+      {
+      CPU_SET( s_CPUs[n], &mask );
+      }
+    return sched_setaffinity( 0, sizeof( mask ), &mask ) == 0;
+    }
+#endif
+  return true;
+}
+
+bool
+ThreadAffinity
+::InitializeThreads( int node, int numberOfThreads )
+{
+  if( !Initialize( node ) )
+    {
+    return false;
+    }
+  if( numberOfThreads <= 0 && node >= 0 )
+    {
+    numberOfThreads = static_cast<int>( GetNumberOfCPUs() );
+    }
+  if( numberOfThreads > 0 )
+    {
+    MultiThreader::SetGlobalMaximumNumberOfThreads(
+      std::max( numberOfThreads, MultiThreader::GetGlobalMaximumNumberOfThreads() ) );
+    MultiThreader::SetGlobalDefaultNumberOfThreads( numberOfThreads );
+    }
+  return true;
+}
+
+void
+ThreadAffinity
+::SetBindThreads( bool bind )
+{
+  s_BindThreads = bind;
+}
+
+bool
+ThreadAffinity
+::GetBindThreads()
+{
+  return s_BindThreads && !s_CPUs.empty();
+}
+
+unsigned int
+ThreadAffinity
+::GetNumberOfNodes()
+{
+  unsigned int numberOfNodes = 0;
+  while( !GetNodeCPUs( numberOfNodes ).empty() )
+    {
+    numberOfNodes++;
+    }
+  return ( numberOfNodes > 0 ) ? numberOfNodes : 1;
+}
+
+unsigned int
+ThreadAffinity
+::GetNumberOfCPUs()
+{
+  return static_cast<unsigned int>( s_CPUs.size() );
+}
+
+bool
+ThreadAffinity
+::BindCurrentThread( unsigned int threadId )
+{
+  if( !GetBindThreads() )
+    {
+    return false;
+    }
+#if defined( __linux__ )
+  cpu_set_t mask;
+  CPU_ZERO( &mask );
+  CPU_SET( s_CPUs[threadId % s_CPUs.size()], &mask );
+  return sched_setaffinity( 0, sizeof( mask ), &mask ) == 0;
+#else
+  return false;
+#endif
+}
+
+void
+ThreadAffinity
+::UnbindCurrentThread()
+{
+  if( !GetBindThreads() )
+    {
+    return;
+    }
+#if defined( __linux__ )
+  cpu_set_t mask;
+  CPU_ZERO( &mask );
+  for( std::size_t n = 0; n < s_CPUs.size(); n++ )
+    {
+    CPU_SET( s_CPUs[n], &mask );
+    }
+  sched_setaffinity( 0, sizeof( mask ), &mask );
+#endif
+}
+
+} // end namespace ants
+} // end namespace itk
@@ -0,0 +1,148 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsThreadAffinity.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsThreadAffinity_h
+#define __antsThreadAffinity_h
+
+#include "itkMacro.h"
+#include "itkMultiThreader.h"
+
+#include <cstring>
+#include <vector>
+
+namespace itk
+{
+namespace ants
+{
+/** \class ThreadAffinity
+    \brief Placement of the worker threads on NUMA nodes.
+    \par
+    The CPUs the process may run on are ordered by NUMA node (as listed
+    in /sys/devices/system/node).  With thread binding on, work unit i of
+    a multithreaded filter that calls BindCurrentThread() runs on the
+    i-th CPU of that list.  Since ITK splits the output region of a filter
+    into slabs in thread order, consecutive slabs are processed, and
+    first-touched, on the same node and each node works on the slabs it
+    owns.
+    \par
+    Restricting the process to a single node binds all threads created
+    afterwards, including those of filters which do not bind themselves.
+    Thread binding is only available on Linux; elsewhere the functions
+    are no-ops.
+*/
+
+class ITK_EXPORT ThreadAffinity
+{
+public:
+  /** Collect the CPUs of all nodes (node < 0) or of the given node and,
+   * for a single node, restrict the process to them.  Returns false if
+   * the node does not exist. */
+  static bool Initialize( int node );
+
+  /** Initialize( node ) and set the global default number of threads of
+   * the MultiThreader to numberOfThreads or, if it is not positive and a
+   * node is given, to the number of CPUs of the node.  The global maximum
+   * is raised if needed.  Returns false if the node does not exist. */
+  static bool InitializeThreads( int node, int numberOfThreads );
+
+  /** Bind the threads of BindCurrentThread() to CPUs.  Default is off. */
+  static void SetBindThreads( bool );
+  static bool GetBindThreads();
+
+  /** Number of NUMA nodes of the machine (1 if unknown). */
+  static unsigned int GetNumberOfNodes();
+
+  /** Number of CPUs selected by Initialize(). */
+  static unsigned int GetNumberOfCPUs();
+
+  /** Bind the calling thread to CPU threadId (modulo the number of CPUs)
+   * of the ordered list if thread binding is on. */
+  static bool BindCurrentThread( unsigned int threadId );
+
+  /** Allow the calling thread to run on all selected CPUs again.  Since
+   * the MultiThreader runs thread 0 on the calling thread, this has to be
+   * called after a bound threaded section, otherwise the main thread (and
+   * every thread it creates) stays on the CPU of thread 0. */
+  static void UnbindCurrentThread();
+
+  /** Copy the buffer of an image into a new image whose pages are first
+   * touched, slab by slab, by bound threads in thread order, i.e. on the
+   * node of the threads that process the corresponding output slabs.
+   * Returns the input if thread binding is off. */
+  template <class TImage>
+  static typename TImage::Pointer FirstTouchCopy( TImage *image,
+    unsigned int numberOfThreads )
+    {
+    if( !GetBindThreads() || numberOfThreads < 2 )
+      {
+      return image;
+      }
+
+    typename TImage::Pointer copy = TImage::New();
+    copy->CopyInformation( image );
+    copy->SetRegions( image->GetBufferedRegion() );
+    copy->Allocate();
+
+    CopyStruct<typename TImage::PixelType> str;
+    str.m_Source = image->GetBufferPointer();
+    str.m_Destination = copy->GetBufferPointer();
+    str.m_NumberOfPixels = image->GetBufferedRegion().GetNumberOfPixels();
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads( static_cast<int>( numberOfThreads ) );
+    threader->SetSingleMethod( CopyThreaderCallback<typename TImage::PixelType>, &str );
+    threader->SingleMethodExecute();
+
+    return copy;
+    }
+
+private:
+  ThreadAffinity(); //purposely not implemented
+
+  template <class TPixel>
+  struct CopyStruct
+    {
+    const TPixel *m_Source;
+    TPixel       *m_Destination;
+    std::size_t   m_NumberOfPixels;
+    };
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  template <class TPixel>
+  static ITK_THREAD_RETURN_TYPE CopyThreaderCallback( void *arg )
+    {
+    MultiThreader::ThreadInfoStruct *info =
+      static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+    const CopyStruct<TPixel> *str = static_cast<const CopyStruct<TPixel> *>( info->UserData );
+
+    const std::size_t threadId = static_cast<std::size_t>( info->ThreadID );
+    const std::size_t numberOfThreads = static_cast<std::size_t>( info->NumberOfThreads );
+    BindCurrentThread( info->ThreadID );
+
+    const std::size_t first = str->m_NumberOfPixels * threadId / numberOfThreads;
+    const std::size_t last = str->m_NumberOfPixels * ( threadId + 1 ) / numberOfThreads;
+    std::memcpy( str->m_Destination + first, str->m_Source + first, ( last - first ) * sizeof( TPixel ) );
+
+    UnbindCurrentThread();
+    return ITK_THREAD_RETURN_VALUE;
+    }
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
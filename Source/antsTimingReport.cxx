@@ -0,0 +1,237 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsTimingReport.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsTimingReport.h"
+#include "antsMemoryMappedFile.h"
+
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace itk
+{
+namespace ants
+{
+
+namespace
+{
+std::string EscapeJSON( const std::string & str )
+{
+  std::ostringstream oss;
+  for( std::string::size_type n = 0; n < str.length(); n++ )
+    {
+    const char c = str[n];
+    if( c == '"' || c == '\\' )
+      {
+      oss << '\\' << c;
+      }
+    else if( static_cast<unsigned char>( c ) < 0x20 )
+      {
+      oss << "\\u" << std::hex << std::setw( 4 ) << std::setfill( '0' )
+        << static_cast<int>( c ) << std::dec;
+      }
+    else
+      {
+      oss << c;
+      }
+    }
+  return oss.str();
+}
+}
+
+TimingReport
+::TimingReport() : m_Command( "" ),
+                   m_CurrentPhase( "" ),
+                   m_BytesRead( 0.0 ),
+                   m_BytesWritten( 0.0 ),
+                   m_NumberOfVoxels( 0.0 ),
+                   m_ThroughputPhase( "" )
+{
+  this->m_TotalProbe.Start();
+}
+
+void
+TimingReport
+::StartPhase( const std::string & name )
+{
+  this->StopPhase();
+  this->m_CurrentPhase = name;
+  this->m_PhaseProbe.Start();
+}
+
+void
+TimingReport
+::StopPhase()
+{
+  if( this->m_CurrentPhase.empty() )
+    {
+    return;
+    }
+  // The probe accumulates, so the phase time is the increase of the total.
+  const double previousTotal = this->m_PhaseProbe.GetTotal();
+  this->m_PhaseProbe.Stop();
+  this->AddPhaseTime( this->m_CurrentPhase, this->m_PhaseProbe.GetTotal() - previousTotal );
+  this->m_CurrentPhase = std::string( "" );
+}
+
+void
+TimingReport
+::AddPhaseTime( const std::string & name, double time, bool isThreadTime )
+{
+  for( std::size_t n = 0; n < this->m_Phases.size(); n++ )
+    {
+    if( this->m_Phases[n].m_Name == name )
+      {
+      this->m_Phases[n].m_Time += time;
+      return;
+      }
+    }
+  PhaseType phase;
+  phase.m_Name = name;
+  phase.m_Time = time;
+  phase.m_IsThreadTime = isThreadTime;
+  this->m_Phases.push_back( phase );
+}
+
+void
+TimingReport
+::AddFileRead( const std::string & filename )
+{
+  this->m_BytesRead += static_cast<double>( MemoryMappedFile::GetFileSize( filename ) );
+}
+
+void
+TimingReport
+::AddFileWritten( const std::string & filename )
+{
+  this->m_BytesWritten += static_cast<double>( MemoryMappedFile::GetFileSize( filename ) );
+}
+
+double
+TimingReport
+::GetTotalTime()
+{
+  // The probe accumulates, so stopping and restarting it keeps the total.
+  this->m_TotalProbe.Stop();
+  const double total = this->m_TotalProbe.GetTotal();
+  this->m_TotalProbe.Start();
+  return total;
+}
+
+double
+TimingReport
+::GetPhaseTime( const std::string & name ) const
+{
+  for( std::size_t n = 0; n < this->m_Phases.size(); n++ )
+    {
+    if( this->m_Phases[n].m_Name == name )
+      {
+      return this->m_Phases[n].m_Time;
+      }
+    }
+  return 0.0;
+}
+
+void
+TimingReport
+::Print( std::ostream & os )
+{
+  this->StopPhase();
+  const double total = this->GetTotalTime();
+
+  os << std::endl << "Timing report" << std::endl;
+  os << std::fixed << std::setprecision( 3 );
+  for( std::size_t n = 0; n < this->m_Phases.size(); n++ )
+    {
+    os << "  " << std::left << std::setw( 28 ) << this->m_Phases[n].m_Name << std::right
+      << std::setw( 10 ) << this->m_Phases[n].m_Time << " s"
+      << ( this->m_Phases[n].m_IsThreadTime ? "  (summed over threads)" : "" ) << std::endl;
+    }
+  os << "  " << std::left << std::setw( 28 ) << "total" << std::right
+    << std::setw( 10 ) << total << " s" << std::endl;
+
+  os << std::setprecision( 1 );
+  os << "  bytes read:     " << this->m_BytesRead / 1048576.0 << " MiB" << std::endl;
+  os << "  bytes written:  " << this->m_BytesWritten / 1048576.0 << " MiB" << std::endl;
+
+  const double throughputTime = this->GetPhaseTime( this->m_ThroughputPhase );
+  if( this->m_NumberOfVoxels > 0.0 && throughputTime > 0.0 )
+    {
+    os << "  throughput:     " << this->m_NumberOfVoxels / throughputTime / 1e6
+      << " Mvoxels/s (" << this->m_ThroughputPhase << ")" << std::endl;
+    }
+  os.unsetf( std::ios::floatfield );
+  os << std::setprecision( 6 );
+}
+
+bool
+TimingReport
+::AppendJSONRecord( const std::string & filename )
+{
+  this->StopPhase();
+  const double total = this->GetTotalTime();
+
+  std::ostringstream oss;
+  oss << std::setprecision( 9 );
+  oss << "{\"command\": \"" << EscapeJSON( this->m_Command ) << "\"";
+  oss << ", \"timestamp\": " << static_cast<long>( std::time( NULL ) );
+  oss << ", \"phases\": {";
+  bool first = true;
+  for( std::size_t n = 0; n < this->m_Phases.size(); n++ )
+    {
+    if( this->m_Phases[n].m_IsThreadTime )
+      {
+      continue;
+      }
+    oss << ( first ? "" : ", " ) << "\"" << EscapeJSON( this->m_Phases[n].m_Name ) << "\": "
+      << this->m_Phases[n].m_Time;
+    first = false;
+    }
+  oss << "}, \"thread_times\": {";
+  first = true;
+  for( std::size_t n = 0; n < this->m_Phases.size(); n++ )
+    {
+    if( !this->m_Phases[n].m_IsThreadTime )
+      {
+      continue;
+      }
+    oss << ( first ? "" : ", " ) << "\"" << EscapeJSON( this->m_Phases[n].m_Name ) << "\": "
+      << this->m_Phases[n].m_Time;
+    first = false;
+    }
+  oss << "}, \"total_seconds\": " << total;
+  oss << ", \"bytes_read\": " << this->m_BytesRead;
+  oss << ", \"bytes_written\": " << this->m_BytesWritten;
+  oss << ", \"voxels\": " << this->m_NumberOfVoxels;
+
+  const double throughputTime = this->GetPhaseTime( this->m_ThroughputPhase );
+  oss << ", \"voxels_per_second\": "
+    << ( ( throughputTime > 0.0 ) ? this->m_NumberOfVoxels / throughputTime : 0.0 );
+  oss << "}";
+
+  std::ofstream file( filename.c_str(), std::ios::out | std::ios::app );
+  if( !file )
+    {
+    return false;
+    }
+  file << oss.str() << std::endl;
+  return file.good();
+}
+
+} // end namespace ants
+} // end namespace itk
@@ -0,0 +1,138 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsTimingReport.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsTimingReport_h
+#define __antsTimingReport_h
+
+#include "itkLightObject.h"
+#include "itkObjectFactory.h"
+#include "itkMacro.h"
+#include "itkTimeProbe.h"
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace itk
+{
+namespace ants
+{
+/** \class TimingReport
+    \brief Wall time per phase and I/O volume of a program run.
+    \par
+    Phases are timed with an itk::TimeProbe between StartPhase() and
+    StopPhase() (or the next StartPhase()).  Times measured elsewhere, e.g.
+    the summed thread times of the coordinate mapping and interpolation in
+    the resampler, can be added with AddPhaseTime().  Phases of the same
+    name are accumulated.
+    \par
+    The report is printed as a table and can be appended to a file as a
+    single line JSON record, such that the records of many runs can be
+    collected from one file.
+*/
+
+class ITK_EXPORT TimingReport
+: public LightObject
+{
+public:
+  /** Standard class typedefs. */
+  typedef TimingReport                               Self;
+  typedef LightObject                                Superclass;
+  typedef SmartPointer<Self>                         Pointer;
+  typedef SmartPointer<const Self>                   ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro( Self );
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro( TimingReport, LightObject );
+
+  void SetCommand( const std::string & command )
+    {
+    this->m_Command = command;
+    }
+
+  /** Stop the current phase (if any) and start timing the given one. */
+  void StartPhase( const std::string & );
+  void StopPhase();
+
+  /** Add a time (in seconds) measured elsewhere.  Thread times are
+   * flagged such that they are not added to the total. */
+  void AddPhaseTime( const std::string &, double, bool isThreadTime = false );
+
+  /** Add the size of a file to the bytes read or written. */
+  void AddFileRead( const std::string & );
+  void AddFileWritten( const std::string & );
+
+  void AddBytesRead( double bytes )
+    {
+    this->m_BytesRead += bytes;
+    }
+  void AddBytesWritten( double bytes )
+    {
+    this->m_BytesWritten += bytes;
+    }
+
+  /** Number of output voxels (or points) and the phase whose time the
+   * throughput is computed from. */
+  void SetThroughput( double numberOfVoxels, const std::string & phase )
+    {
+    this->m_NumberOfVoxels = numberOfVoxels;
+    this->m_ThroughputPhase = phase;
+    }
+
+  /** Time since the construction of the report. */
+  double GetTotalTime();
+
+  void Print( std::ostream & );
+
+  /** Append the report as a single line JSON record. */
+  bool AppendJSONRecord( const std::string & );
+
+protected:
+  TimingReport();
+  virtual ~TimingReport() {}
+
+  struct PhaseType
+    {
+    std::string m_Name;
+    double      m_Time;
+    bool        m_IsThreadTime;
+    };
+
+  double GetPhaseTime( const std::string & ) const;
+
+private:
+  TimingReport( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::string                                        m_Command;
+  std::vector<PhaseType>                             m_Phases;
+  TimeProbe                                          m_TotalProbe;
+  TimeProbe                                          m_PhaseProbe;
+  std::string                                        m_CurrentPhase;
+  double                                             m_BytesRead;
+  double                                             m_BytesWritten;
+  double                                             m_NumberOfVoxels;
+  std::string                                        m_ThroughputPhase;
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
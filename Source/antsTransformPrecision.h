@@ -0,0 +1,176 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsTransformPrecision.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsTransformPrecision_h
+#define __antsTransformPrecision_h
+
+#include "itkAffineTransform.h"
+#include "itkCenteredAffineTransform.h"
+#include "itkCenteredEuler3DTransform.h"
+#include "itkCenteredRigid2DTransform.h"
+#include "itkCenteredSimilarity2DTransform.h"
+#include "itkEuler2DTransform.h"
+#include "itkEuler3DTransform.h"
+#include "itkIdentityTransform.h"
+#include "itkMatrixOffsetTransformBase.h"
+#include "itkObjectFactoryBase.h"
+#include "itkQuaternionRigidTransform.h"
+#include "itkRigid2DTransform.h"
+#include "itkScaleSkewVersor3DTransform.h"
+#include "itkScaleTransform.h"
+#include "itkScaleVersor3DTransform.h"
+#include "itkSimilarity2DTransform.h"
+#include "itkSimilarity3DTransform.h"
+#include "itkTransformFactory.h"
+#include "itkTranslationTransform.h"
+#include "itkVersorRigid3DTransform.h"
+#include "itkVersorTransform.h"
+
+#include <string>
+#include <typeinfo>
+
+namespace itk
+{
+namespace ants
+{
+
+/**
+ * Register the linear transforms accepted from transform files with the
+ * transform factory in the given precision.  The default registrations of
+ * the factory are double only, so the float variants are needed for the
+ * conversion with --float (see ConvertTransformPrecision()).
+ */
+template<class TScalar, unsigned int Dimension>
+void RegisterGenericTransforms()
+{
+  TransformFactory<MatrixOffsetTransformBase<TScalar, Dimension, Dimension> >::RegisterTransform();
+  TransformFactory<AffineTransform<TScalar, Dimension> >::RegisterTransform();
+  TransformFactory<CenteredAffineTransform<TScalar, Dimension> >::RegisterTransform();
+  TransformFactory<IdentityTransform<TScalar, Dimension> >::RegisterTransform();
+  TransformFactory<ScaleTransform<TScalar, Dimension> >::RegisterTransform();
+  TransformFactory<TranslationTransform<TScalar, Dimension> >::RegisterTransform();
+}
+
+template<class TScalar, unsigned int Dimension>
+struct TransformTypeRegistration
+{
+  static void RegisterTransforms()
+    {
+    RegisterGenericTransforms<TScalar, Dimension>();
+    }
+};
+
+template<class TScalar>
+struct TransformTypeRegistration<TScalar, 2>
+{
+  static void RegisterTransforms()
+    {
+    RegisterGenericTransforms<TScalar, 2>();
+
+    TransformFactory<Euler2DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<Rigid2DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<CenteredRigid2DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<Similarity2DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<CenteredSimilarity2DTransform<TScalar> >::RegisterTransform();
+    }
+};
+
+template<class TScalar>
+struct TransformTypeRegistration<TScalar, 3>
+{
+  static void RegisterTransforms()
+    {
+    RegisterGenericTransforms<TScalar, 3>();
+
+    TransformFactory<Euler3DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<CenteredEuler3DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<QuaternionRigidTransform<TScalar> >::RegisterTransform();
+    TransformFactory<VersorTransform<TScalar> >::RegisterTransform();
+    TransformFactory<VersorRigid3DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<Similarity3DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<ScaleVersor3DTransform<TScalar> >::RegisterTransform();
+    TransformFactory<ScaleSkewVersor3DTransform<TScalar> >::RegisterTransform();
+    }
+};
+
+/**
+ * The transform file reader instantiates transforms according to the
+ * precision stored in the file (typically double).  When running in single
+ * precision, we recreate the same transform class with the requested scalar
+ * type through the object factory and copy the parameters over.  Returns a
+ * null pointer if the class is not registered in that precision (see
+ * TransformTypeRegistration).
+ */
+template<class TOutputTransform>
+typename TOutputTransform::Pointer
+ConvertTransformPrecision( TransformBase *inputTransform )
+{
+  typename TOutputTransform::Pointer outputTransform =
+    dynamic_cast<TOutputTransform *>( inputTransform );
+  if( outputTransform || !inputTransform )
+    {
+    return outputTransform;
+    }
+
+  typedef typename TOutputTransform::ScalarType ScalarType;
+  std::string outputPrecision( "double" );
+  std::string inputPrecision( "float" );
+  if( typeid( ScalarType ) == typeid( float ) )
+    {
+    outputPrecision = std::string( "float" );
+    inputPrecision = std::string( "double" );
+    }
+
+  std::string transformTypeName = inputTransform->GetTransformTypeAsString();
+  std::string::size_type pos = transformTypeName.find( inputPrecision );
+  if( pos == std::string::npos )
+    {
+    return outputTransform;
+    }
+  transformTypeName.replace( pos, inputPrecision.length(), outputPrecision );
+
+  LightObject::Pointer object =
+    ObjectFactoryBase::CreateInstance( transformTypeName.c_str() );
+  outputTransform = dynamic_cast<TOutputTransform *>( object.GetPointer() );
+  if( !outputTransform )
+    {
+    return outputTransform;
+    }
+
+  typename TOutputTransform::ParametersType fixedParameters;
+  fixedParameters.SetSize( inputTransform->GetFixedParameters().Size() );
+  for( unsigned int i = 0; i < fixedParameters.Size(); i++ )
+    {
+    fixedParameters[i] = inputTransform->GetFixedParameters()[i];
+    }
+  outputTransform->SetFixedParameters( fixedParameters );
+
+  typename TOutputTransform::ParametersType parameters;
+  parameters.SetSize( inputTransform->GetParameters().Size() );
+  for( unsigned int i = 0; i < parameters.Size(); i++ )
+    {
+    parameters[i] = inputTransform->GetParameters()[i];
+    }
+  outputTransform->SetParametersByValue( parameters );
+
+  return outputTransform;
+}
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
@@ -0,0 +1,301 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsWarpService.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#include "antsWarpService.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#if !defined( _WIN32 )
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace itk
+{
+namespace ants
+{
+
+namespace
+{
+volatile std::sig_atomic_t s_StopRequested = 0;
+
+#if !defined( _WIN32 )
+void StopHandler( int )
+{
+  s_StopRequested = 1;
+}
+
+// Requests are command lines; anything larger is not a request.
+const unsigned int MaximumStringLength = 64u << 20;
+const unsigned int MaximumNumberOfStrings = 1u << 16;
+
+bool SetAddress( const std::string & socketFileName, struct sockaddr_un & address )
+{
+  std::memset( &address, 0, sizeof( address ) );
+  address.sun_family = AF_UNIX;
+  if( socketFileName.empty() || socketFileName.length() >= sizeof( address.sun_path ) )
+    {
+    return false;
+    }
+  std::strncpy( address.sun_path, socketFileName.c_str(), sizeof( address.sun_path ) - 1 );
+  return true;
+}
+
+bool WriteAll( int socket, const char *buffer, std::size_t size )
+{
+  while( size > 0 )
+    {
+    const ssize_t written = write( socket, buffer, size );
+    if( written < 0 && errno == EINTR )
+      {
+      continue;
+      }
+    if( written <= 0 )
+      {
+      return false;
+      }
+    buffer += written;
+    size -= static_cast<std::size_t>( written );
+    }
+  return true;
+}
+
+bool ReadAll( int socket, char *buffer, std::size_t size )
+{
+  while( size > 0 )
+    {
+    const ssize_t bytesRead = read( socket, buffer, size );
+    if( bytesRead < 0 && errno == EINTR )
+      {
+      continue;
+      }
+    if( bytesRead <= 0 )
+      {
+      return false;
+      }
+    buffer += bytesRead;
+    size -= static_cast<std::size_t>( bytesRead );
+    }
+  return true;
+}
+
+bool WriteLength( int socket, unsigned int length )
+{
+  return WriteAll( socket, reinterpret_cast<const char *>( &length ), sizeof( length ) );
+}
+
+bool ReadLength( int socket, unsigned int & length )
+{
+  return ReadAll( socket, reinterpret_cast<char *>( &length ), sizeof( length ) );
+}
+#endif
+}
+
+int
+WarpService
+::Listen( const std::string & socketFileName )
+{
+#if defined( _WIN32 )
+  return -1;
+#else
+  struct sockaddr_un address;
+  if( !SetAddress( socketFileName, address ) )
+    {
+    return -1;
+    }
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( fd < 0 )
+    {
+    return -1;
+    }
+
+  // A socket file left behind by a service which did not shut down is
+  // removed, unless a service is still listening on it.
+  struct stat info;
+  if( stat( socketFileName.c_str(), &info ) == 0 && S_ISSOCK( info.st_mode ) )
+    {
+    int probe = Connect( socketFileName );
+    if( probe >= 0 )
+      {
+      Close( probe );
+      close( fd );
+      return -1;
+      }
+    unlink( socketFileName.c_str() );
+    }
+
+  // Requests name arbitrary files of the user running the service, so the
+  // socket is created accessible to the user only (and not chmod'ed after
+  // bind(), which would leave it open to others in between).
+  const mode_t previousMask = umask( S_IRWXG | S_IRWXO );
+  const bool isBound =
+    ( bind( fd, reinterpret_cast<struct sockaddr *>( &address ), sizeof( address ) ) == 0 );
+  umask( previousMask );
+  if( !isBound || listen( fd, 64 ) != 0 )
+    {
+    close( fd );
+    return -1;
+    }
+  chmod( socketFileName.c_str(), S_IRUSR | S_IWUSR );
+  return fd;
+#endif
+}
+
+int
+WarpService
+::Accept( int socket )
+{
+#if defined( _WIN32 )
+  return -1;
+#else
+  return accept( socket, NULL, NULL );
+#endif
+}
+
+int
+WarpService
+::Connect( const std::string & socketFileName )
+{
+#if defined( _WIN32 )
+  return -1;
+#else
+  struct sockaddr_un address;
+  if( !SetAddress( socketFileName, address ) )
+    {
+    return -1;
+    }
+  int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( fd < 0 )
+    {
+    return -1;
+    }
+  if( connect( fd, reinterpret_cast<struct sockaddr *>( &address ), sizeof( address ) ) != 0 )
+    {
+    close( fd );
+    return -1;
+    }
+  return fd;
+#endif
+}
+
+bool
+WarpService
+::SendStrings( int socket, const std::vector<std::string> & strings )
+{
+#if defined( _WIN32 )
+  return false;
+#else
+  if( !WriteLength( socket, static_cast<unsigned int>( strings.size() ) ) )
+    {
+    return false;
+    }
+  for( std::size_t n = 0; n < strings.size(); n++ )
+    {
+    if( !WriteLength( socket, static_cast<unsigned int>( strings[n].length() ) ) ||
+      !WriteAll( socket, strings[n].data(), strings[n].length() ) )
+      {
+      return false;
+      }
+    }
+  return true;
+#endif
+}
+
+bool
+WarpService
+::ReceiveStrings( int socket, std::vector<std::string> & strings )
+{
+  strings.clear();
+#if defined( _WIN32 )
+  return false;
+#else
+  unsigned int numberOfStrings = 0;
+  if( !ReadLength( socket, numberOfStrings ) || numberOfStrings > MaximumNumberOfStrings )
+    {
+    return false;
+    }
+  strings.resize( numberOfStrings );
+  for( unsigned int n = 0; n < numberOfStrings; n++ )
+    {
+    unsigned int length = 0;
+    if( !ReadLength( socket, length ) || length > MaximumStringLength )
+      {
+      return false;
+      }
+    strings[n].resize( length );
+    if( length > 0 && !ReadAll( socket, &strings[n][0], length ) )
+      {
+      return false;
+      }
+    }
+  return true;
+#endif
+}
+
+void
+WarpService
+::Close( int socket )
+{
+#if !defined( _WIN32 )
+  if( socket >= 0 )
+    {
+    close( socket );
+    }
+#endif
+}
+
+void
+WarpService
+::RemoveSocketFile( const std::string & socketFileName )
+{
+#if !defined( _WIN32 )
+  unlink( socketFileName.c_str() );
+#endif
+}
+
+void
+WarpService
+::InstallStopHandler()
+{
+#if !defined( _WIN32 )
+  // Without SA_RESTART, so that a pending accept() returns.
+  struct sigaction action;
+  std::memset( &action, 0, sizeof( action ) );
+  action.sa_handler = StopHandler;
+  sigemptyset( &action.sa_mask );
+  sigaction( SIGINT, &action, NULL );
+  sigaction( SIGTERM, &action, NULL );
+
+  action.sa_handler = SIG_IGN;
+  sigaction( SIGPIPE, &action, NULL );
+#endif
+}
+
+bool
+WarpService
+::IsStopRequested()
+{
+  return s_StopRequested != 0;
+}
+
+} // end namespace ants
+} // end namespace itk
@@ -0,0 +1,79 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: antsWarpService.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __antsWarpService_h
+#define __antsWarpService_h
+
+#include "itkMacro.h"
+
+#include <string>
+#include <vector>
+
+namespace itk
+{
+namespace ants
+{
+/** \class WarpService
+    \brief Local socket protocol of the resident antsApplyTransforms.
+    \par
+    A request is a list of strings:  the working directory of the client
+    followed by the command line (program name and arguments) in the
+    syntax of the CommandLineParser.  The reply is a list of two strings:
+    the exit status and the output of the request.  Lists are sent as the
+    number of strings followed by the length and the characters of each
+    string, all lengths as 32-bit unsigned integers in host byte order
+    (both ends run on the same machine).
+    \par
+    Connections are handled one at a time; each carries one request.
+    Only available on Unix systems; elsewhere the functions fail.
+*/
+
+class ITK_EXPORT WarpService
+{
+public:
+  /** Create a socket bound to the given file and listen on it.  A stale
+   * socket file is removed first.  Returns -1 on failure. */
+  static int Listen( const std::string & socketFileName );
+
+  /** Wait for the next connection.  Returns -1 on failure or if the wait
+   * was interrupted by a signal. */
+  static int Accept( int socket );
+
+  /** Connect to a listening service.  Returns -1 on failure. */
+  static int Connect( const std::string & socketFileName );
+
+  static bool SendStrings( int socket, const std::vector<std::string> & );
+  static bool ReceiveStrings( int socket, std::vector<std::string> & );
+
+  static void Close( int socket );
+
+  /** Remove the socket file of a service. */
+  static void RemoveSocketFile( const std::string & socketFileName );
+
+  /** Catch SIGINT and SIGTERM such that a service can remove its socket
+   * file before it exits, and ignore SIGPIPE (clients which go away). */
+  static void InstallStopHandler();
+  static bool IsStopRequested();
+
+private:
+  WarpService(); //purposely not implemented
+};
+
+} // end namespace ants
+} // end namespace itk
+
+#endif
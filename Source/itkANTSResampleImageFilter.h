@@ -0,0 +1,2474 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkANTSResampleImageFilter.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkANTSResampleImageFilter_h
+#define __itkANTSResampleImageFilter_h
+
+#include "antsThreadAffinity.h"
+#include "itkResampleImageFilter.h"
+#include "itkAntiAliasedImagePyramid.h"
+#include "itkBatchLinearInterpolator.h"
+#include "itkCompositeTransformPointMapper.h"
+#include "itkContinuousIndex.h"
+#include "itkImageLinearIteratorWithIndex.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkMutexLock.h"
+#include "itkSeparableKernelInterpolator.h"
+#include "itkTimeProbe.h"
+#include "itkVector.h"
+
+#include "vnl/algo/vnl_determinant.h"
+#include "vnl/algo/vnl_matrix_inverse.h"
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ANTSResampleImageFilter
+ * \brief Resample an image via a coordinate transform.
+ *
+ * Extends itk::ResampleImageFilter with the functionality needed by
+ * antsApplyTransforms:
+ *
+ * - The output can be written into a preallocated pixel container, e.g. a
+ *   memory mapped output file, instead of a freshly allocated buffer.
+ *
+ * - The output is generated row by row.  The physical points of a row are
+ *   mapped together through the transform (by a CompositeTransformPointMapper
+ *   if the transform is a composite) and then interpolated.
+ *
+ * - The Jacobian determinant of the transform (or its logarithm) can be
+ *   computed in the same traversal.  It is estimated from backward
+ *   differences of the mapped voxel positions, i.e. from points that have
+ *   been mapped for the resampling anyway.  The mapped rows of the current
+ *   slice (or volume) are kept so that each point is mapped only once;
+ *   only the rows preceding a thread's region are mapped additionally.
+ *   With ResampleInput off, only the Jacobian determinant is computed and
+ *   the output image is not allocated.
+ *
+ * - With thread binding on (see ants::ThreadAffinity), each thread is
+ *   bound to a CPU in thread order, so that the output slabs of a NUMA
+ *   node are first-touched and processed by the threads of that node.
+ *
+ * - Output voxels can be restricted to a mask.  Voxels outside the mask
+ *   are neither mapped nor interpolated.
+ *
+ * - Output voxels which cannot be mapped into the input buffer are set to
+ *   the default value without mapping them.  They are found from a
+ *   conservative bound of the output region that can map inside the input
+ *   (see CompositeTransformPointMapper::ComputePreimageBoundingBox()),
+ *   which pays off when a small input covers part of a large output, e.g.
+ *   a 2D section warped into a 3D reference.
+ *
+ * - The time spent mapping points and interpolating can be measured per
+ *   thread (see SetMeasurePhaseTimes()).
+ *
+ * - The output reduced along axis 0 (the first pass of the 2x reduction of
+ *   AntiAliasedImagePyramid) can be computed from each row while it is
+ *   still in cache, such that an output pyramid does not need to read the
+ *   full resolution output again.
+ *
+ * - The mapped points of the output grid can be recorded as a coordinate
+ *   map and given to a later resampling through the same transform onto
+ *   the same grid, which then skips the mapping.
+ *
+ * - If the transform reduces to a single affine map (a composite of
+ *   matrix/offset and translation transforms), the continuous input index
+ *   changes by a constant vector per output voxel along a row.  The index
+ *   of the first voxel of a row is computed once and then advanced by that
+ *   vector, re-anchored every AffineAnchorInterval voxels to bound the
+ *   rounding drift, and the interpolator is evaluated at the continuous
+ *   index directly.  No point is mapped through the transform or converted
+ *   back to an input index.
+ *
+ * - Smooth transforms can be approximated (see
+ *   SetCoordinateLatticeSpacing()):  the transform is evaluated exactly on
+ *   a lattice of every L-th output voxel along each axis and the mapped
+ *   points in between are interpolated multilinearly from the lattice
+ *   nodes.  Each lattice cell is checked at its centre, where the
+ *   interpolation error of a smooth map is largest; cells whose error
+ *   exceeds the tolerance (in physical units) are mapped exactly voxel by
+ *   voxel.
+ *
+ * - Downsampling can be anti-aliased (see SetUseAntiAliasing()):  an
+ *   AntiAliasedImagePyramid of the input is built once and each output
+ *   voxel is interpolated linearly at the level matching the local
+ *   spacing ratio, i.e. the length in input voxels of the steps between
+ *   mapped neighbors, estimated on a coarse grid from the Jacobian of the
+ *   transform.  Voxels at level 0 are interpolated as usual.
+ *
+ * - If the affine map moves along the axes of the input (scaling and
+ *   translation only, e.g. an integer zoom onto an aligned grid) and the
+ *   interpolator is linear or a SeparableKernelInterpolator (windowed
+ *   sinc, Gaussian, B-spline), the 1-D kernels of each output index along
+ *   each axis are tabulated once (see SetUsePolyphaseZoom()).  An integer
+ *   zoom by k only has k distinct phases per axis, but tabulating every
+ *   index also covers the boundary handling of the kernels.  Each output
+ *   row is filtered separably:  the input rows of its neighbors along
+ *   axes 1, ..., D-1 are summed into one line, which is then filtered
+ *   along axis 0.
+ *
+ * - With a LinearInterpolateImageFunction, the mapped points of a row are
+ *   converted to continuous input indices and interpolated together by a
+ *   BatchLinearInterpolator (vectorized with AVX2 if enabled at compile
+ *   time) instead of one virtual Evaluate() call per voxel.
+ *
+ * - The output can be traversed in tiles and the input of the batch
+ *   interpolator stored in bricks (see SetOutputTileSize() and
+ *   SetUseBrickedInput()), such that the neighborhoods interpolated for a
+ *   tile stay in cache when the rows of the output run obliquely through
+ *   the input.
+ *
+ * - The threads can also take their output in small work units from
+ *   per-thread queues and steal from each other (see
+ *   SetUseWorkStealing()), such that the wall time follows the total work
+ *   when the cost per voxel varies across the output.
+ *
+ * Only scalar output pixel types are supported.
+ *
+ * \ingroup GeometricTransforms
+ */
+template <class TInputImage, class TOutputImage,
+  class TInterpolatorPrecisionType = double>
+class ITK_EXPORT ANTSResampleImageFilter :
+  public ResampleImageFilter<TInputImage, TOutputImage, TInterpolatorPrecisionType>
+{
+public:
+  /** Standard class typedefs. */
+  typedef ANTSResampleImageFilter Self;
+  typedef ResampleImageFilter<TInputImage, TOutputImage,
+    TInterpolatorPrecisionType> Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ANTSResampleImageFilter, ResampleImageFilter);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TOutputImage::ImageDimension);
+
+  typedef TInputImage                                 InputImageType;
+  typedef TOutputImage                                OutputImageType;
+  typedef typename OutputImageType::PixelType         PixelType;
+  typedef typename OutputImageType::RegionType        OutputImageRegionType;
+  typedef typename OutputImageType::IndexType         IndexType;
+  typedef typename OutputImageType::SizeType          SizeType;
+  typedef typename OutputImageType::PixelContainer    OutputPixelContainerType;
+  typedef typename OutputPixelContainerType::Pointer  OutputPixelContainerPointer;
+
+  typedef TInterpolatorPrecisionType                  RealType;
+  typedef typename Superclass::TransformType          TransformType;
+  typedef typename Superclass::InterpolatorType       InterpolatorType;
+  typedef typename Superclass::PointType              PointType;
+
+  typedef LinearInterpolateImageFunction<InputImageType, RealType> LinearInterpolatorType;
+  typedef BatchLinearInterpolator<InputImageType, RealType>       BatchInterpolatorType;
+
+  typedef SeparableKernelInterpolator<InputImageType>              InputKernelInterpolatorType;
+  typedef Image<float, ImageDimension>                            CoefficientImageType;
+  typedef SeparableKernelInterpolator<CoefficientImageType>        CoefficientKernelInterpolatorType;
+
+  typedef CompositeTransformPointMapper<RealType, ImageDimension> PointMapperType;
+  typedef typename PointMapperType::CompositeTransformType        CompositeTransformType;
+
+  typedef Image<RealType, ImageDimension>             JacobianDeterminantImageType;
+
+  typedef AntiAliasedImagePyramid<OutputImageType>   PyramidType;
+  typedef AntiAliasedImagePyramid<InputImageType>    InputPyramidType;
+
+  typedef unsigned char                               MaskPixelType;
+  typedef Image<MaskPixelType, ImageDimension>        MaskImageType;
+
+  typedef Vector<RealType, ImageDimension>            CoordinateMapPixelType;
+  typedef Image<CoordinateMapPixelType, ImageDimension> CoordinateMapType;
+
+  /** Buffer to be used for the output instead of allocating a new one.
+   * The container has to hold at least as many pixels as the largest
+   * possible output region since the output is generated as a whole. */
+  itkSetObjectMacro(OutputPixelContainer, OutputPixelContainerType);
+  itkGetObjectMacro(OutputPixelContainer, OutputPixelContainerType);
+
+  /** Only output voxels inside the (non-zero part of the) mask are mapped
+   * and interpolated; the others are set to the default pixel value.  The
+   * mask does not have to share the output grid.  The Jacobian
+   * determinant, if requested, is still computed everywhere. */
+  itkSetConstObjectMacro(OutputMask, MaskImageType);
+  itkGetConstObjectMacro(OutputMask, MaskImageType);
+
+  /** Compute the Jacobian determinant of the transform at each output
+   * voxel.  Default is off. */
+  itkSetMacro(ComputeJacobianDeterminant, bool);
+  itkGetConstMacro(ComputeJacobianDeterminant, bool);
+  itkBooleanMacro(ComputeJacobianDeterminant);
+
+  /** Store the logarithm of the Jacobian determinant.  Determinants below
+   * machine epsilon (folding) are clamped before taking the logarithm. */
+  itkSetMacro(UseLogJacobianDeterminant, bool);
+  itkGetConstMacro(UseLogJacobianDeterminant, bool);
+  itkBooleanMacro(UseLogJacobianDeterminant);
+
+  /** Resample the input.  If off, only the Jacobian determinant is
+   * computed.  Default is on. */
+  itkSetMacro(ResampleInput, bool);
+  itkGetConstMacro(ResampleInput, bool);
+  itkBooleanMacro(ResampleInput);
+
+  /** Also compute the output reduced along axis 0.  Default is off. */
+  itkSetMacro(ComputeRowReducedOutput, bool);
+  itkGetConstMacro(ComputeRowReducedOutput, bool);
+  itkBooleanMacro(ComputeRowReducedOutput);
+
+  /** The output reduced along axis 0 (see AntiAliasedImagePyramid), or NULL
+   * if it could not be computed because the output region was split
+   * along axis 0. */
+  OutputImageType * GetRowReducedOutput()
+    {
+    return this->m_RowReducedOutput.GetPointer();
+    }
+
+  /** Time the mapping and the interpolation of each row.  Default is
+   * off. */
+  itkSetMacro(MeasurePhaseTimes, bool);
+  itkGetConstMacro(MeasurePhaseTimes, bool);
+  itkBooleanMacro(MeasurePhaseTimes);
+
+  /** Seconds spent mapping points during the last update, summed over
+   * the threads. */
+  double GetMappingTime() const
+    {
+    return this->SumProbes( this->m_MappingProbes );
+    }
+
+  /** Seconds spent interpolating during the last update, summed over the
+   * threads. */
+  double GetInterpolationTime() const
+    {
+    return this->SumProbes( this->m_InterpolationProbes );
+    }
+
+  /** Mapped physical points of the output voxels.  If set and its
+   * buffered region is the output region, the points are taken from the
+   * map instead of being mapped.  The map is not checked against the
+   * transform and the output grid:  it is up to the caller to give a map
+   * recorded with the same ones. */
+  void SetCoordinateMap( CoordinateMapType *map )
+    {
+    if( this->m_CoordinateMap != map )
+      {
+      this->m_CoordinateMap = map;
+      this->Modified();
+      }
+    }
+  CoordinateMapType * GetCoordinateMap()
+    {
+    return this->m_CoordinateMap.GetPointer();
+    }
+
+  /** Record the mapped points in a new coordinate map (see
+   * GetCoordinateMap()) unless a valid map is set.  The map is only
+   * recorded if all output voxels are mapped, i.e. without output mask and
+   * Jacobian determinant.  Default is off. */
+  itkSetMacro(RecordCoordinateMap, bool);
+  itkGetConstMacro(RecordCoordinateMap, bool);
+  itkBooleanMacro(RecordCoordinateMap);
+
+  /** Step the input index along the rows if the transform is affine (see
+   * above).  Not used together with the Jacobian determinant or while a
+   * coordinate map is recorded.  Default is on. */
+  itkSetMacro(UseIncrementalAffineMapping, bool);
+  itkGetConstMacro(UseIncrementalAffineMapping, bool);
+  itkBooleanMacro(UseIncrementalAffineMapping);
+
+  /** True if the rows of the last update were mapped incrementally. */
+  itkGetConstMacro(IsMappingIncrementally, bool);
+
+  /** Interpolate whole rows with a BatchLinearInterpolator if the
+   * interpolator is a LinearInterpolateImageFunction.  Default is on. */
+  itkSetMacro(UseBatchLinearInterpolation, bool);
+  itkGetConstMacro(UseBatchLinearInterpolation, bool);
+  itkBooleanMacro(UseBatchLinearInterpolation);
+
+  /** Spacing L (in output voxels) of the lattice on which the transform
+   * is evaluated exactly (see above).  Default is 1, i.e. every voxel is
+   * mapped exactly. */
+  itkSetClampMacro(CoordinateLatticeSpacing, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(CoordinateLatticeSpacing, unsigned int);
+
+  /** Largest accepted distance (in physical units of the input) between
+   * the interpolated and the exactly mapped centre of a lattice cell.
+   * Default is 0.05. */
+  itkSetMacro(CoordinateTolerance, double);
+  itkGetConstMacro(CoordinateTolerance, double);
+
+  /** Number of lattice cells and of those mapped exactly during the last
+   * update (both 0 if no lattice was used). */
+  SizeValueType GetNumberOfLatticeCells() const
+    {
+    return this->m_IsLatticeCellExact.size();
+    }
+  itkGetConstMacro(NumberOfExactLatticeCells, SizeValueType);
+
+  /** Interpolate each output voxel in a smoothed and decimated copy of
+   * the input (see above) whose level matches the local output to input
+   * spacing ratio.  Default is off. */
+  itkSetMacro(UseAntiAliasing, bool);
+  itkGetConstMacro(UseAntiAliasing, bool);
+  itkBooleanMacro(UseAntiAliasing);
+
+  /** Generate the output in tiles of OutputTileSize^D voxels, row by row
+   * within each tile, instead of whole rows of the thread's region.  Under
+   * rotations and warps the points of a tile map to a compact part of the
+   * input that stays in cache.  Not used with the Jacobian determinant or
+   * the row reduced output.  Default is 1 (whole rows). */
+  itkSetClampMacro(OutputTileSize, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(OutputTileSize, unsigned int);
+
+  /** Schedule the output dynamically:  the region of each thread is cut
+   * into work units of whole rows, 8 voxels (or the output tile size, if
+   * larger) along the other axes, which the thread generates in order.
+   * A thread that runs out of work units steals them from the end of
+   * another thread's queue, such that threads whose regions are cheap
+   * (e.g. outside the input or the mask) help with the expensive ones
+   * (e.g. multi-label or Gaussian interpolation at boundaries).  Not used
+   * with the Jacobian determinant.  Default is off. */
+  itkSetMacro(UseWorkStealing, bool);
+  itkGetConstMacro(UseWorkStealing, bool);
+  itkBooleanMacro(UseWorkStealing);
+
+  /** Let the BatchLinearInterpolator store the input in bricks (see
+   * BatchLinearInterpolator::SetUseBricks()).  Default is off. */
+  itkSetMacro(UseBrickedInput, bool);
+  itkGetConstMacro(UseBrickedInput, bool);
+  itkBooleanMacro(UseBrickedInput);
+
+  /** Filter separably with tabulated 1-D kernels if the transform is an
+   * axis aligned affine map (see above).  The result equals the one of the
+   * interpolator up to rounding (see itkANTSResampleImageFilterZoomTest).
+   * Default is on. */
+  itkSetMacro(UsePolyphaseZoom, bool);
+  itkGetConstMacro(UsePolyphaseZoom, bool);
+  itkBooleanMacro(UsePolyphaseZoom);
+
+  /** True if the last update filtered separably. */
+  itkGetConstMacro(IsZooming, bool);
+
+  /** Number of input pyramid levels (including the input) used during the
+   * last update, 0 if no voxel needed a reduced level. */
+  itkGetConstMacro(NumberOfAntiAliasingLevels, unsigned int);
+
+  /** Output region which can be mapped inside the input during the last
+   * update (the output region if no bound was computed). */
+  const OutputImageRegionType & GetMappableRegion() const
+    {
+    return this->m_MappableRegion;
+    }
+
+  /** Jacobian determinant (or its logarithm) on the output grid. */
+  JacobianDeterminantImageType * GetJacobianDeterminantImage()
+    {
+    return this->m_JacobianDeterminantImage.GetPointer();
+    }
+
+protected:
+  ANTSResampleImageFilter() : m_ComputeJacobianDeterminant( false ),
+    m_UseLogJacobianDeterminant( false ),
+    m_ResampleInput( true ),
+    m_ComputeRowReducedOutput( false ),
+    m_MeasurePhaseTimes( false ),
+    m_MaskIsAligned( false ),
+    m_RecordCoordinateMap( false ),
+    m_IsRecordingCoordinateMap( false ),
+    m_UseIncrementalAffineMapping( true ),
+    m_IsMappingIncrementally( false ),
+    m_UseBatchLinearInterpolation( true ),
+    m_CoordinateLatticeSpacing( 1 ),
+    m_CoordinateTolerance( 0.05 ),
+    m_NumberOfExactLatticeCells( 0 ),
+    m_UseAntiAliasing( false ),
+    m_NumberOfAntiAliasingLevels( 0 ),
+    m_UsePolyphaseZoom( true ),
+    m_IsZooming( false ),
+    m_ZoomLineLength( 0 ),
+    m_OutputTileSize( 1 ),
+    m_UseBrickedInput( false ),
+    m_UseWorkStealing( false )
+    {
+    this->m_PointMapper = PointMapperType::New();
+    }
+  ~ANTSResampleImageFilter() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "OutputPixelContainer: " << this->m_OutputPixelContainer.GetPointer() << std::endl;
+    os << indent << "ComputeJacobianDeterminant: " << this->m_ComputeJacobianDeterminant << std::endl;
+    os << indent << "UseLogJacobianDeterminant: " << this->m_UseLogJacobianDeterminant << std::endl;
+    os << indent << "ResampleInput: " << this->m_ResampleInput << std::endl;
+    os << indent << "OutputMask: " << this->m_OutputMask.GetPointer() << std::endl;
+    os << indent << "ComputeRowReducedOutput: " << this->m_ComputeRowReducedOutput << std::endl;
+    os << indent << "MeasurePhaseTimes: " << this->m_MeasurePhaseTimes << std::endl;
+    os << indent << "CoordinateMap: " << this->m_CoordinateMap.GetPointer() << std::endl;
+    os << indent << "RecordCoordinateMap: " << this->m_RecordCoordinateMap << std::endl;
+    os << indent << "UseIncrementalAffineMapping: " << this->m_UseIncrementalAffineMapping << std::endl;
+    os << indent << "UseBatchLinearInterpolation: " << this->m_UseBatchLinearInterpolation << std::endl;
+    os << indent << "CoordinateLatticeSpacing: " << this->m_CoordinateLatticeSpacing << std::endl;
+    os << indent << "CoordinateTolerance: " << this->m_CoordinateTolerance << std::endl;
+    os << indent << "UseAntiAliasing: " << this->m_UseAntiAliasing << std::endl;
+    os << indent << "UsePolyphaseZoom: " << this->m_UsePolyphaseZoom << std::endl;
+    os << indent << "OutputTileSize: " << this->m_OutputTileSize << std::endl;
+    os << indent << "UseBrickedInput: " << this->m_UseBrickedInput << std::endl;
+    os << indent << "UseWorkStealing: " << this->m_UseWorkStealing << std::endl;
+    }
+
+  virtual void AllocateOutputs()
+    {
+    OutputImageType *outputPtr = this->GetOutput();
+
+    if( !this->m_ResampleInput )
+      {
+      outputPtr->SetBufferedRegion( OutputImageRegionType() );
+      return;
+      }
+    if( this->m_OutputPixelContainer.IsNull() )
+      {
+      this->Superclass::AllocateOutputs();
+      return;
+      }
+
+    if( outputPtr->GetRequestedRegion() != outputPtr->GetLargestPossibleRegion() ||
+      this->m_OutputPixelContainer->Size() <
+      outputPtr->GetLargestPossibleRegion().GetNumberOfPixels() )
+      {
+      itkExceptionMacro( "The output pixel container does not cover the output region." );
+      }
+    outputPtr->SetBufferedRegion( outputPtr->GetRequestedRegion() );
+    outputPtr->SetPixelContainer( this->m_OutputPixelContainer );
+    }
+
+  virtual void BeforeThreadedGenerateData()
+    {
+    this->Superclass::BeforeThreadedGenerateData();
+
+    this->m_PointMapper->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->m_PointMapper->SetTransform(
+      dynamic_cast<const CompositeTransformType *>( this->GetTransform() ) );
+
+    this->m_JacobianDeterminantImage = NULL;
+    if( this->m_ComputeJacobianDeterminant )
+      {
+      const OutputImageType *outputPtr = this->GetOutput();
+      this->m_JacobianDeterminantImage = JacobianDeterminantImageType::New();
+      this->m_JacobianDeterminantImage->CopyInformation( outputPtr );
+      this->m_JacobianDeterminantImage->SetRegions( outputPtr->GetRequestedRegion() );
+      this->m_JacobianDeterminantImage->Allocate();
+      }
+
+    // Physical point = origin + ( D * S ) index.  The Jacobian of the index
+    // to physical mapping of the output grid is divided out of the
+    // determinant of the finite differences.
+    vnl_matrix<double> indexToPhysical( ImageDimension, ImageDimension );
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        indexToPhysical( i, j ) = this->GetOutput()->GetDirection()[i][j] *
+          this->GetOutput()->GetSpacing()[j];
+        }
+      }
+    this->m_GridJacobianDeterminant = vnl_determinant( indexToPhysical );
+
+    this->m_MappingProbes.clear();
+    this->m_InterpolationProbes.clear();
+    if( this->m_MeasurePhaseTimes )
+      {
+      this->m_MappingProbes.resize( this->GetNumberOfThreads() );
+      this->m_InterpolationProbes.resize( this->GetNumberOfThreads() );
+      }
+
+    const OutputImageRegionType & outputRegion = this->GetOutput()->GetRequestedRegion();
+    this->m_IsRecordingCoordinateMap = false;
+    if( this->m_CoordinateMap.IsNotNull() &&
+      this->m_CoordinateMap->GetBufferedRegion() != outputRegion )
+      {
+      this->m_CoordinateMap = NULL;
+      }
+    if( this->m_CoordinateMap.IsNull() && this->m_RecordCoordinateMap &&
+      this->m_OutputMask.IsNull() && !this->m_ComputeJacobianDeterminant )
+      {
+      this->m_CoordinateMap = CoordinateMapType::New();
+      this->m_CoordinateMap->CopyInformation( this->GetOutput() );
+      this->m_CoordinateMap->SetRegions( outputRegion );
+      this->m_CoordinateMap->Allocate();
+      this->m_IsRecordingCoordinateMap = true;
+      }
+
+    // The Jacobian determinant and a recorded coordinate map need every
+    // output voxel to be mapped.
+    this->m_MappableRegion = outputRegion;
+    if( this->m_ResampleInput && !this->m_ComputeJacobianDeterminant &&
+      !this->m_IsRecordingCoordinateMap )
+      {
+      this->ComputeMappableRegion();
+      }
+
+    this->m_IsMappingIncrementally = false;
+    this->m_BatchInterpolator = NULL;
+    this->m_AntiAliasingLevelMap.clear();
+    this->m_InputPyramid = NULL;
+    this->m_LevelInterpolators.clear();
+    this->m_NumberOfAntiAliasingLevels = 0;
+    this->m_IsZooming = false;
+    this->m_ZoomInput = NULL;
+    this->m_ZoomCoefficients = NULL;
+    if( this->m_ResampleInput && this->ComputeInputIndexMapping() )
+      {
+      if( this->m_UseIncrementalAffineMapping && !this->m_ComputeJacobianDeterminant &&
+        !this->m_IsRecordingCoordinateMap )
+        {
+        this->ComputeAffineIndexMapping();
+        }
+      if( this->m_UseBatchLinearInterpolation &&
+        dynamic_cast<const LinearInterpolatorType *>( this->GetInterpolator() ) )
+        {
+        this->m_BatchInterpolator = BatchInterpolatorType::New();
+        this->m_BatchInterpolator->SetUseBricks( this->m_UseBrickedInput );
+        this->m_BatchInterpolator->SetInputImage( this->GetInput() );
+        }
+      if( this->m_UseAntiAliasing )
+        {
+        this->ComputeAntiAliasingLevels();
+        }
+      if( this->m_UsePolyphaseZoom && this->m_IsMappingIncrementally &&
+        this->m_AntiAliasingLevelMap.empty() )
+        {
+        this->ComputeZoomKernels();
+        }
+      }
+
+    // A stored coordinate map or the affine stepping make the lattice
+    // pointless.
+    this->m_LatticePoints.clear();
+    this->m_IsLatticeCellExact.clear();
+    this->m_NumberOfExactLatticeCells = 0;
+    if( this->m_CoordinateLatticeSpacing > 1 && !this->m_IsMappingIncrementally &&
+      ( this->m_CoordinateMap.IsNull() || this->m_IsRecordingCoordinateMap ) )
+      {
+      this->ComputeCoordinateLattice();
+      }
+
+    this->m_RowReducedOutput = NULL;
+    if( this->m_ComputeRowReducedOutput && this->m_ResampleInput )
+      {
+      this->m_RowReducedOutput = OutputImageType::New();
+      PyramidType::ReduceInformation( this->GetOutput(), 0, this->m_RowReducedOutput );
+      this->m_RowReducedOutput->Allocate();
+      this->m_IsRowSplit.assign( this->GetNumberOfThreads(), 0 );
+      }
+
+    // If the mask shares the output grid up to an index offset, the mask
+    // values are looked up by index instead of by physical point.
+    this->m_MaskIsAligned = false;
+    if( this->m_OutputMask.IsNotNull() )
+      {
+      const OutputImageType *outputPtr = this->GetOutput();
+      const MaskImageType *mask = this->m_OutputMask.GetPointer();
+
+      bool isAligned = true;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        if( vnl_math_abs( mask->GetSpacing()[i] - outputPtr->GetSpacing()[i] ) >
+          1e-6 * outputPtr->GetSpacing()[i] )
+          {
+          isAligned = false;
+          }
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          if( vnl_math_abs( mask->GetDirection()[i][j] - outputPtr->GetDirection()[i][j] ) > 1e-6 )
+            {
+            isAligned = false;
+            }
+          }
+        }
+      if( isAligned )
+        {
+        typename MaskImageType::PointType outputOrigin;
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          outputOrigin[i] = outputPtr->GetOrigin()[i];
+          }
+        ContinuousIndex<double, ImageDimension> originIndex;
+        mask->TransformPhysicalPointToContinuousIndex( outputOrigin, originIndex );
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          const double offset = vnl_math_rnd( originIndex[i] );
+          if( vnl_math_abs( originIndex[i] - offset ) > 1e-3 )
+            {
+            isAligned = false;
+            }
+          this->m_MaskIndexOffset[i] = static_cast<typename MaskImageType::OffsetValueType>( offset );
+          }
+        }
+      this->m_MaskIsAligned = isAligned;
+      }
+
+    this->FillWorkQueues();
+    }
+
+  virtual void AfterThreadedGenerateData()
+    {
+    this->Superclass::AfterThreadedGenerateData();
+    ants::ThreadAffinity::UnbindCurrentThread();
+
+    this->m_InputPyramid = NULL;
+    this->m_LevelInterpolators.clear();
+    this->m_ZoomInput = NULL;
+    this->m_ZoomCoefficients = NULL;
+    this->m_WorkQueues.clear();
+    this->m_WorkQueueLocks.clear();
+
+    if( this->m_RowReducedOutput.IsNotNull() &&
+      std::find( this->m_IsRowSplit.begin(), this->m_IsRowSplit.end(), 1 ) != this->m_IsRowSplit.end() )
+      {
+      this->m_RowReducedOutput = NULL;
+      }
+    }
+
+  virtual void ThreadedGenerateData( const OutputImageRegionType & region,
+    ThreadIdType threadId )
+    {
+    if( !this->m_WorkQueues.empty() )
+      {
+      ants::ThreadAffinity::BindCurrentThread( threadId );
+      OutputImageRegionType workUnit;
+      while( this->PopWorkUnit( threadId, workUnit ) )
+        {
+        this->GenerateRegion( workUnit, threadId );
+        }
+      return;
+      }
+
+    if( region.GetNumberOfPixels() == 0 )
+      {
+      return;
+      }
+    ants::ThreadAffinity::BindCurrentThread( threadId );
+    this->GenerateRegion( region, threadId );
+    }
+
+  /** Generate a region in tiles (see SetOutputTileSize()) or rows. */
+  void GenerateRegion( const OutputImageRegionType & region, ThreadIdType threadId )
+    {
+    // The Jacobian determinant reuses the mapped rows preceding each row
+    // and the row reduced output needs whole rows.
+    const long tileSize = static_cast<long>( this->m_OutputTileSize );
+    if( tileSize <= 1 || this->m_ComputeJacobianDeterminant || this->m_RowReducedOutput.IsNotNull() )
+      {
+      this->GenerateRows( region, threadId );
+      return;
+      }
+
+    // Tiles in row-major order, each generated row by row.
+    long numberOfTiles[ImageDimension];
+    long tile[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      numberOfTiles[d] = ( static_cast<long>( region.GetSize()[d] ) + tileSize - 1 ) / tileSize;
+      tile[d] = 0;
+      }
+    for( ;; )
+      {
+      OutputImageRegionType tileRegion;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        const long begin = tile[d] * tileSize;
+        tileRegion.SetIndex( d, region.GetIndex()[d] + begin );
+        tileRegion.SetSize( d, static_cast<SizeValueType>(
+          std::min( tileSize, static_cast<long>( region.GetSize()[d] ) - begin ) ) );
+        }
+      this->GenerateRows( tileRegion, threadId );
+
+      unsigned int d = 0;
+      for( ; d < ImageDimension; d++ )
+        {
+        if( ++tile[d] < numberOfTiles[d] )
+          {
+          break;
+          }
+        tile[d] = 0;
+        }
+      if( d >= ImageDimension )
+        {
+        break;
+        }
+      }
+    }
+
+  /** Generate the rows of a region in order, axis 1 fastest. */
+  void GenerateRows( const OutputImageRegionType & region, ThreadIdType threadId )
+    {
+    OutputImageType *outputPtr = this->GetOutput();
+    const InterpolatorType *interpolator = this->GetInterpolator();
+
+    const long rowLength = static_cast<long>( region.GetSize()[0] );
+
+    // Rows are processed in order, axis 1 fastest.  The row preceding the
+    // current one along axis k lies rowDistance[k] rows back.
+    long rowDistance[ImageDimension];
+    long numberOfRows = 1;
+    for( unsigned int k = 1; k < ImageDimension; k++ )
+      {
+      rowDistance[k] = numberOfRows;
+      numberOfRows *= static_cast<long>( region.GetSize()[k] );
+      }
+
+    // Mapped rows are kept in a ring buffer covering the largest row
+    // distance that fits into the cache budget.  Each row holds the point
+    // preceding the row along axis 0 followed by the row itself.
+    const long pointsPerRow = rowLength + 1;
+    long numberOfCachedRows = 1;
+    if( this->m_ComputeJacobianDeterminant )
+      {
+      const long maximumCachedPoints = 8L << 20;
+      for( unsigned int k = 1; k < ImageDimension; k++ )
+        {
+        if( ( rowDistance[k] + 1 ) * pointsPerRow <= maximumCachedPoints )
+          {
+          numberOfCachedRows = rowDistance[k] + 1;
+          }
+        }
+      }
+    std::vector<RealType> cache[ImageDimension];
+    std::vector<RealType> neighborRow[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      cache[d].resize( numberOfCachedRows * pointsPerRow );
+      neighborRow[d].resize( pointsPerRow );
+      }
+
+    std::vector<PixelType> outputRow( rowLength );
+    std::vector<unsigned char> maskRow( rowLength );
+    std::vector<RealType> jacobianRow( rowLength );
+
+    // Continuous input indices, values and inside flags of a row
+    // interpolated by index (see InterpolateIndexRow()).
+    std::vector<RealType> indexRow[ImageDimension];
+    RealType *cindex[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      indexRow[d].resize( rowLength );
+      cindex[d] = &indexRow[d][0];
+      }
+    std::vector<double> valueRow( rowLength );
+    std::vector<unsigned char> insideRow( rowLength );
+
+    // Line of summed input rows (see ZoomRow()).
+    std::vector<double> zoomLine;
+    if( this->m_IsZooming )
+      {
+      zoomLine.resize( this->m_ZoomLineLength );
+      }
+
+    // Pyramid levels and reduced input indices of a row (see
+    // InterpolateAntiAliasedRow()).
+    const bool useAntiAliasing = !this->m_AntiAliasingLevelMap.empty();
+    std::vector<unsigned char> levelRow;
+    std::vector<RealType> levelIndexRow[ImageDimension];
+    RealType *levelIndex[ImageDimension];
+    if( useAntiAliasing )
+      {
+      levelRow.resize( rowLength );
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        levelIndexRow[d].resize( rowLength );
+        levelIndex[d] = &levelIndexRow[d][0];
+        }
+      }
+
+    ImageLinearIteratorWithIndex<OutputImageType> outIt;
+    if( this->m_ResampleInput )
+      {
+      outIt = ImageLinearIteratorWithIndex<OutputImageType>( outputPtr, region );
+      outIt.SetDirection( 0 );
+      outIt.GoToBegin();
+      }
+    ImageLinearIteratorWithIndex<JacobianDeterminantImageType> jacobianIt;
+    if( this->m_ComputeJacobianDeterminant )
+      {
+      jacobianIt = ImageLinearIteratorWithIndex<JacobianDeterminantImageType>(
+        this->m_JacobianDeterminantImage, region );
+      jacobianIt.SetDirection( 0 );
+      jacobianIt.GoToBegin();
+      }
+
+    // The reduced rows need whole output rows.
+    PixelType *reducedBuffer = NULL;
+    if( this->m_RowReducedOutput.IsNotNull() )
+      {
+      if( region.GetSize()[0] == outputPtr->GetBufferedRegion().GetSize()[0] )
+        {
+        reducedBuffer = this->m_RowReducedOutput->GetBufferPointer();
+        }
+      else
+        {
+        this->m_IsRowSplit[threadId] = 1;
+        }
+      }
+
+    TimeProbe *mappingProbe = NULL;
+    TimeProbe *interpolationProbe = NULL;
+    if( this->m_MeasurePhaseTimes )
+      {
+      mappingProbe = &this->m_MappingProbes[threadId];
+      interpolationProbe = &this->m_InterpolationProbes[threadId];
+      }
+
+    const double minimumValue = static_cast<double>( NumericTraits<PixelType>::NonpositiveMin() );
+    const double maximumValue = static_cast<double>( NumericTraits<PixelType>::max() );
+    const PixelType defaultValue = this->GetDefaultPixelValue();
+
+    IndexType rowIndex = region.GetIndex();
+    for( long row = 0; row < numberOfRows; row++ )
+      {
+      // Map the current row (including the preceding point along axis 0).
+      RealType *mapped[ImageDimension];
+      const long slot = row % numberOfCachedRows;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        mapped[d] = &cache[d][slot * pointsPerRow];
+        }
+      const bool useMask = this->m_OutputMask.IsNotNull() && this->m_ResampleInput;
+      if( useMask )
+        {
+        this->GetMaskRow( rowIndex, rowLength, maskRow );
+        }
+
+      // Voxels outside [runBegin, runEnd) cannot be mapped into the input.
+      long runBegin = 0;
+      long runEnd = rowLength;
+      this->GetMappableRun( rowIndex, rowLength, runBegin, runEnd );
+
+      if( mappingProbe )
+        {
+        mappingProbe->Start();
+        }
+      if( this->m_ComputeJacobianDeterminant )
+        {
+        IndexType firstIndex = rowIndex;
+        firstIndex[0]--;
+        this->MapRow( firstIndex, rowLength + 1, mapped, 0 );
+        }
+      else if( this->m_IsMappingIncrementally )
+        {
+        // The input indices are stepped while interpolating.
+        }
+      else if( !useMask )
+        {
+        if( runEnd > runBegin )
+          {
+          IndexType runIndex = rowIndex;
+          runIndex[0] += runBegin;
+          this->MapRow( runIndex, runEnd - runBegin, mapped, runBegin + 1 );
+          }
+        }
+      else
+        {
+        // Only the runs of voxels inside the mask are mapped.
+        for( long n = runBegin; n < runEnd; )
+          {
+          if( !maskRow[n] )
+            {
+            n++;
+            continue;
+            }
+          long end = n + 1;
+          while( end < runEnd && maskRow[end] )
+            {
+            end++;
+            }
+          IndexType runIndex = rowIndex;
+          runIndex[0] += n;
+          this->MapRow( runIndex, end - n, mapped, n + 1 );
+          n = end;
+          }
+        }
+
+      if( mappingProbe )
+        {
+        mappingProbe->Stop();
+        }
+
+      if( this->m_ResampleInput )
+        {
+        if( interpolationProbe )
+          {
+          interpolationProbe->Start();
+          }
+        PointType point;
+        std::fill( outputRow.begin(), outputRow.begin() + runBegin, defaultValue );
+        std::fill( outputRow.begin() + runEnd, outputRow.end(), defaultValue );
+        if( this->m_IsZooming )
+          {
+          if( this->m_ZoomCoefficients.IsNotNull() )
+            {
+            this->ZoomRow( this->m_ZoomCoefficients.GetPointer(), rowIndex, runBegin, runEnd,
+              &zoomLine[0], &valueRow[0], &insideRow[0] );
+            }
+          else
+            {
+            this->ZoomRow( this->m_ZoomInput.GetPointer(), rowIndex, runBegin, runEnd,
+              &zoomLine[0], &valueRow[0], &insideRow[0] );
+            }
+          this->StoreInterpolatedRow( runBegin, runEnd, useMask ? &maskRow[0] : NULL,
+            &valueRow[0], &insideRow[0], &outputRow[0] );
+          }
+        else if( this->m_IsMappingIncrementally || this->m_BatchInterpolator.IsNotNull() || useAntiAliasing )
+          {
+          if( this->m_IsMappingIncrementally )
+            {
+            this->ComputeAffineIndexRow( rowIndex, runBegin, runEnd, cindex );
+            }
+          else
+            {
+            this->ComputeIndexRow( mapped, runBegin, runEnd, cindex );
+            }
+          if( useAntiAliasing )
+            {
+            this->GetAntiAliasingLevelRow( rowIndex, runBegin, runEnd, &levelRow[0] );
+            this->InterpolateAntiAliasedRow( cindex, runBegin, runEnd, &levelRow[0],
+              useMask ? &maskRow[0] : NULL, levelIndex, &valueRow[0], &insideRow[0], &outputRow[0] );
+            }
+          else
+            {
+            this->InterpolateIndexRow( cindex, runBegin, runEnd, useMask ? &maskRow[0] : NULL,
+              &valueRow[0], &insideRow[0], &outputRow[0] );
+            }
+          }
+        else
+          {
+          for( long n = runBegin; n < runEnd; n++ )
+            {
+            if( useMask && !maskRow[n] )
+              {
+              outputRow[n] = defaultValue;
+              continue;
+              }
+            for( unsigned int d = 0; d < ImageDimension; d++ )
+              {
+              point[d] = mapped[d][n + 1];
+              }
+            if( interpolator->IsInsideBuffer( point ) )
+              {
+              double value = static_cast<double>( interpolator->Evaluate( point ) );
+              value = ( value < minimumValue ) ? minimumValue : ( ( value > maximumValue ) ? maximumValue : value );
+              outputRow[n] = static_cast<PixelType>( value );
+              }
+            else
+              {
+              outputRow[n] = defaultValue;
+              }
+            }
+          }
+        if( interpolationProbe )
+          {
+          interpolationProbe->Stop();
+          }
+        for( long n = 0; n < rowLength; n++, ++outIt )
+          {
+          outIt.Set( outputRow[n] );
+          }
+        outIt.NextLine();
+
+        if( reducedBuffer )
+          {
+          const IndexType & bufferIndex = outputPtr->GetBufferedRegion().GetIndex();
+          long reducedOffset = 0;
+          for( unsigned int k = ImageDimension - 1; k > 0; k-- )
+            {
+            reducedOffset = reducedOffset * static_cast<long>( outputPtr->GetBufferedRegion().GetSize()[k] ) +
+              ( rowIndex[k] - bufferIndex[k] );
+            }
+          PyramidType::ReduceRow( &outputRow[0], rowLength,
+            reducedBuffer + reducedOffset * ( ( rowLength + 1 ) / 2 ) );
+          }
+        }
+
+      if( this->m_ComputeJacobianDeterminant )
+        {
+        // Preceding rows along axes 1, ..., D-1:  taken from the cache if
+        // they belong to this thread's region and are still cached, mapped
+        // otherwise.
+        const RealType *neighbors[ImageDimension][ImageDimension];
+        std::vector<RealType> extraRows[ImageDimension][ImageDimension];
+        for( unsigned int k = 1; k < ImageDimension; k++ )
+          {
+          if( rowIndex[k] > region.GetIndex()[k] && rowDistance[k] < numberOfCachedRows )
+            {
+            const long neighborSlot = ( row - rowDistance[k] ) % numberOfCachedRows;
+            for( unsigned int d = 0; d < ImageDimension; d++ )
+              {
+              neighbors[k][d] = &cache[d][neighborSlot * pointsPerRow];
+              }
+            }
+          else
+            {
+            IndexType neighborIndex = rowIndex;
+            neighborIndex[k]--;
+            RealType *extra[ImageDimension];
+            for( unsigned int d = 0; d < ImageDimension; d++ )
+              {
+              extraRows[k][d].resize( pointsPerRow );
+              extra[d] = &extraRows[k][d][0];
+              neighbors[k][d] = extra[d];
+              }
+            this->MapRow( neighborIndex, rowLength, extra, 1 );
+            }
+          }
+
+        vnl_matrix<double> differences( ImageDimension, ImageDimension );
+        for( long n = 0; n < rowLength; n++ )
+          {
+          for( unsigned int d = 0; d < ImageDimension; d++ )
+            {
+            differences( d, 0 ) = mapped[d][n + 1] - mapped[d][n];
+            for( unsigned int k = 1; k < ImageDimension; k++ )
+              {
+              differences( d, k ) = mapped[d][n + 1] - neighbors[k][d][n + 1];
+              }
+            }
+          double determinant = vnl_determinant( differences ) / this->m_GridJacobianDeterminant;
+          if( this->m_UseLogJacobianDeterminant )
+            {
+            determinant = vcl_log( vnl_math_max( determinant,
+              static_cast<double>( NumericTraits<RealType>::epsilon() ) ) );
+            }
+          jacobianRow[n] = static_cast<RealType>( determinant );
+          }
+        for( long n = 0; n < rowLength; n++, ++jacobianIt )
+          {
+          jacobianIt.Set( jacobianRow[n] );
+          }
+        jacobianIt.NextLine();
+        }
+
+      // Next row
+      for( unsigned int k = 1; k < ImageDimension; k++ )
+        {
+        rowIndex[k]++;
+        if( rowIndex[k] < region.GetIndex()[k] + static_cast<long>( region.GetSize()[k] ) )
+          {
+          break;
+          }
+        rowIndex[k] = region.GetIndex()[k];
+        }
+      }
+    }
+
+  /** Physical point -> continuous input index:
+   * m_InputPhysicalToIndex ( point - m_InputOrigin ).  Returns false if
+   * there is no input or its grid is singular. */
+  bool ComputeInputIndexMapping()
+    {
+    const InputImageType *input = this->GetInput();
+    if( !input )
+      {
+      return false;
+      }
+    vnl_matrix<double> inputIndexToPhysical( ImageDimension, ImageDimension );
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        inputIndexToPhysical( i, j ) = input->GetDirection()[i][j] * input->GetSpacing()[j];
+        }
+      }
+    if( vnl_math_abs( vnl_determinant( inputIndexToPhysical ) ) < 1e-12 )
+      {
+      return false;
+      }
+    const vnl_matrix<double> physicalToInputIndex =
+      vnl_matrix_inverse<double>( inputIndexToPhysical ).inverse();
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        this->m_InputPhysicalToIndex[i][j] = physicalToInputIndex( i, j );
+        }
+      this->m_InputOrigin[i] = input->GetOrigin()[i];
+      }
+    return true;
+    }
+
+  /** Compose the output index -> physical point, the affine transform and
+   * the physical point -> input index mappings into
+   * input index = m_AffineIndexMatrix output index + m_AffineIndexOffset.
+   * Requires the input mapping (see ComputeInputIndexMapping()). */
+  void ComputeAffineIndexMapping()
+    {
+    const TransformType *transform = this->GetTransform();
+    if( !transform )
+      {
+      return;
+      }
+
+    double matrix[ImageDimension][ImageDimension];
+    double offset[ImageDimension];
+    if( this->m_PointMapper->GetTransform() )
+      {
+      if( !this->m_PointMapper->GetAffineTransform( matrix, offset ) )
+        {
+        return;
+        }
+      }
+    else if( const typename PointMapperType::MatrixOffsetTransformType *matrixTransform =
+      dynamic_cast<const typename PointMapperType::MatrixOffsetTransformType *>( transform ) )
+      {
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          matrix[i][j] = matrixTransform->GetMatrix()[i][j];
+          }
+        offset[i] = matrixTransform->GetOffset()[i];
+        }
+      }
+    else
+      {
+      return;
+      }
+
+    const OutputImageType *outputPtr = this->GetOutput();
+
+    // A ( D_out S_out ) and A origin_out + offset - origin_in
+    double outputToMapped[ImageDimension][ImageDimension];
+    double mappedOrigin[ImageDimension];
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      mappedOrigin[i] = offset[i] - this->m_InputOrigin[i];
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        outputToMapped[i][j] = 0.0;
+        for( unsigned int k = 0; k < ImageDimension; k++ )
+          {
+          outputToMapped[i][j] += matrix[i][k] * outputPtr->GetDirection()[k][j] *
+            outputPtr->GetSpacing()[j];
+          }
+        mappedOrigin[i] += matrix[i][j] * outputPtr->GetOrigin()[j];
+        }
+      }
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      this->m_AffineIndexOffset[i] = 0.0;
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        this->m_AffineIndexMatrix[i][j] = 0.0;
+        for( unsigned int k = 0; k < ImageDimension; k++ )
+          {
+          this->m_AffineIndexMatrix[i][j] += this->m_InputPhysicalToIndex[i][k] * outputToMapped[k][j];
+          }
+        this->m_AffineIndexOffset[i] += this->m_InputPhysicalToIndex[i][j] * mappedOrigin[j];
+        }
+      }
+    this->m_IsMappingIncrementally = true;
+    }
+
+  /** Continuous input indices of the voxels [runBegin, runEnd) of the
+   * row starting at rowIndex, stepped from the anchor of the row. */
+  void ComputeAffineIndexRow( const IndexType & rowIndex, long runBegin, long runEnd,
+    RealType * const cindex[ImageDimension] ) const
+    {
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      double anchor = this->m_AffineIndexOffset[i];
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        anchor += this->m_AffineIndexMatrix[i][j] * static_cast<double>( rowIndex[j] );
+        }
+      const double step = this->m_AffineIndexMatrix[i][0];
+
+      double index = 0.0;
+      for( long n = runBegin; n < runEnd; n++ )
+        {
+        if( ( n - runBegin ) % AffineAnchorInterval == 0 )
+          {
+          index = anchor + static_cast<double>( n ) * step;
+          }
+        else
+          {
+          index += step;
+          }
+        cindex[i][n] = static_cast<RealType>( index );
+        }
+      }
+    }
+
+  /** Tabulate the 1-D kernels of the output indices along each axis if the
+   * affine index mapping is axis aligned and the kernel of the
+   * interpolator is separable (see above).  Requires the affine index
+   * mapping (see ComputeAffineIndexMapping()). */
+  void ComputeZoomKernels()
+    {
+    const OutputImageRegionType & region = this->GetOutput()->GetRequestedRegion();
+
+    // The off-diagonal terms may move an index by at most 1e-6 voxels
+    // across the output region.
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        if( i != j && vnl_math_abs( this->m_AffineIndexMatrix[i][j] ) *
+          static_cast<double>( region.GetSize()[j] ) > 1e-6 )
+          {
+          return;
+          }
+        }
+      }
+
+    const InterpolatorType *interpolator = this->GetInterpolator();
+    const LinearInterpolatorType *linear =
+      dynamic_cast<const LinearInterpolatorType *>( interpolator );
+    const InputKernelInterpolatorType *inputKernel =
+      dynamic_cast<const InputKernelInterpolatorType *>( interpolator );
+    const CoefficientKernelInterpolatorType *coefficientKernel =
+      dynamic_cast<const CoefficientKernelInterpolatorType *>( interpolator );
+
+    const InputImageType *input = this->GetInput();
+    const typename InputImageType::RegionType & inputRegion = input->GetBufferedRegion();
+    if( linear )
+      {
+      this->m_ZoomInput = input;
+      this->m_ZoomLineLength = static_cast<long>( inputRegion.GetSize()[0] );
+      }
+    else if( inputKernel && inputKernel->GetSeparableKernelSamples() )
+      {
+      this->m_ZoomInput = inputKernel->GetSeparableKernelSamples();
+      this->m_ZoomLineLength = static_cast<long>( this->m_ZoomInput->GetBufferedRegion().GetSize()[0] );
+      }
+    else if( coefficientKernel && coefficientKernel->GetSeparableKernelSamples() )
+      {
+      this->m_ZoomCoefficients = coefficientKernel->GetSeparableKernelSamples();
+      this->m_ZoomLineLength = static_cast<long>( this->m_ZoomCoefficients->GetBufferedRegion().GetSize()[0] );
+      }
+    else
+      {
+      return;
+      }
+
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      unsigned int width = 2;
+      if( !linear )
+        {
+        width = this->m_ZoomInput.IsNotNull() ? inputKernel->GetSeparableKernelWidth( d ) :
+          coefficientKernel->GetSeparableKernelWidth( d );
+        }
+      const long size = static_cast<long>( region.GetSize()[d] );
+      this->m_ZoomKernelWidth[d] = width;
+      this->m_ZoomNeighbors[d].resize( size * width );
+      this->m_ZoomWeights[d].resize( size * width );
+      this->m_ZoomInside[d].resize( size );
+
+      const long start = inputRegion.GetIndex()[d];
+      const long inputSize = static_cast<long>( inputRegion.GetSize()[d] );
+      for( long n = 0; n < size; n++ )
+        {
+        const double c = this->m_AffineIndexMatrix[d][d] *
+          static_cast<double>( region.GetIndex()[d] + n ) + this->m_AffineIndexOffset[d];
+        this->m_ZoomInside[d][n] = ( c >= static_cast<double>( start ) - 0.5 &&
+          c < static_cast<double>( start + inputSize ) - 0.5 ) ? 1 : 0;
+
+        long *neighbors = &this->m_ZoomNeighbors[d][n * width];
+        double *weights = &this->m_ZoomWeights[d][n * width];
+        if( linear )
+          {
+          // Clamped neighbors as in LinearInterpolateImageFunction.
+          const double base = vcl_floor( c );
+          const long lower = static_cast<long>( base ) - start;
+          neighbors[0] = std::min( std::max( lower, 0L ), inputSize - 1 );
+          neighbors[1] = std::min( std::max( lower + 1, 0L ), inputSize - 1 );
+          weights[0] = 1.0 - ( c - base );
+          weights[1] = c - base;
+          }
+        else if( this->m_ZoomInput.IsNotNull() )
+          {
+          inputKernel->ComputeSeparableKernel( d, c, neighbors, weights );
+          }
+        else
+          {
+          coefficientKernel->ComputeSeparableKernel( d, c, neighbors, weights );
+          }
+        }
+      }
+    this->m_IsZooming = true;
+    }
+
+  /** Interpolate the voxels [runBegin, runEnd) of the row starting at
+   * rowIndex from the tabulated kernels (see ComputeZoomKernels()):  the
+   * rows of the samples at the neighbors along axes 1, ..., D-1 are summed
+   * into the line, weighted by the products of their weights, and the
+   * line is filtered along axis 0. */
+  template <class TSampleImage>
+  void ZoomRow( const TSampleImage *samples, const IndexType & rowIndex, long runBegin, long runEnd,
+    double *line, double *values, unsigned char *isInside ) const
+    {
+    if( runEnd <= runBegin )
+      {
+      return;
+      }
+    const OutputImageRegionType & region = this->GetOutput()->GetRequestedRegion();
+
+    const long *neighbors[ImageDimension];
+    const double *weights[ImageDimension];
+    bool isRowInside = true;
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      const long n = rowIndex[d] - region.GetIndex()[d];
+      neighbors[d] = &this->m_ZoomNeighbors[d][n * this->m_ZoomKernelWidth[d]];
+      weights[d] = &this->m_ZoomWeights[d][n * this->m_ZoomKernelWidth[d]];
+      isRowInside = isRowInside && this->m_ZoomInside[d][n];
+      }
+    if( !isRowInside )
+      {
+      std::fill( isInside + runBegin, isInside + runEnd, 0 );
+      return;
+      }
+
+    // Part of the line needed by the run.
+    const unsigned int width = this->m_ZoomKernelWidth[0];
+    const long rowOffset = rowIndex[0] - region.GetIndex()[0];
+    const long *lineNeighbors = &this->m_ZoomNeighbors[0][0];
+    const double *lineWeights = &this->m_ZoomWeights[0][0];
+    long first = this->m_ZoomLineLength;
+    long last = -1;
+    for( long k = ( rowOffset + runBegin ) * width; k < ( rowOffset + runEnd ) * width; k++ )
+      {
+      first = std::min( first, lineNeighbors[k] );
+      last = std::max( last, lineNeighbors[k] );
+      }
+    const long lineLength = last - first + 1;
+    std::fill( line, line + lineLength, 0.0 );
+
+    typedef typename TSampleImage::PixelType SamplePixelType;
+    const SamplePixelType *buffer = samples->GetBufferPointer() + first;
+    const typename TSampleImage::OffsetValueType *offsetTable = samples->GetOffsetTable();
+
+    // Odometer over the neighbors along axes 1, ..., D-1.  Neighbors with
+    // a zero weight (e.g. at the exact phases of a linear zoom) are
+    // skipped.
+    unsigned int counter[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      counter[d] = 0;
+      }
+    for( ;; )
+      {
+      double weight = 1.0;
+      long offset = 0;
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        weight *= weights[d][counter[d]];
+        offset += neighbors[d][counter[d]] * static_cast<long>( offsetTable[d] );
+        }
+      if( weight != 0.0 )
+        {
+        const SamplePixelType *row = buffer + offset;
+        for( long x = 0; x < lineLength; x++ )
+          {
+          line[x] += weight * static_cast<double>( row[x] );
+          }
+        }
+
+      unsigned int d = 1;
+      for( ; d < ImageDimension; d++ )
+        {
+        if( ++counter[d] < this->m_ZoomKernelWidth[d] )
+          {
+          break;
+          }
+        counter[d] = 0;
+        }
+      if( d >= ImageDimension )
+        {
+        break;
+        }
+      }
+
+    for( long n = runBegin; n < runEnd; n++ )
+      {
+      const long k = ( rowOffset + n ) * width;
+      double value = 0.0;
+      for( unsigned int t = 0; t < width; t++ )
+        {
+        value += lineWeights[k + t] * line[lineNeighbors[k + t] - first];
+        }
+      values[n] = value;
+      isInside[n] = this->m_ZoomInside[0][rowOffset + n];
+      }
+    }
+
+  /** Continuous input indices of the mapped points [runBegin, runEnd) of a
+   * row (stored from mapped[d][1]). */
+  void ComputeIndexRow( RealType * const mapped[ImageDimension], long runBegin, long runEnd,
+    RealType * const cindex[ImageDimension] ) const
+    {
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( long n = runBegin; n < runEnd; n++ )
+        {
+        double index = 0.0;
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          index += this->m_InputPhysicalToIndex[i][j] *
+            ( static_cast<double>( mapped[j][n + 1] ) - this->m_InputOrigin[j] );
+          }
+        cindex[i][n] = static_cast<RealType>( index );
+        }
+      }
+    }
+
+  /** Interpolate the voxels [runBegin, runEnd) of a row at the given
+   * continuous input indices, by the batch interpolator if there is one.
+   * Voxels outside the mask (if given) or the input buffer are set to the
+   * default value. */
+  void InterpolateIndexRow( RealType * const cindex[ImageDimension], long runBegin, long runEnd,
+    const unsigned char *maskRow, double *values, unsigned char *isInside, PixelType *outputRow ) const
+    {
+    if( runEnd <= runBegin )
+      {
+      return;
+      }
+
+    if( this->m_BatchInterpolator.IsNotNull() )
+      {
+      EvaluateMaskedRow( this->m_BatchInterpolator.GetPointer(), cindex, runBegin, runEnd,
+        maskRow, values, isInside );
+      }
+    else
+      {
+      typedef typename InterpolatorType::ContinuousIndexType ContinuousIndexType;
+
+      const InterpolatorType *interpolator = this->GetInterpolator();
+      ContinuousIndexType index;
+      for( long n = runBegin; n < runEnd; n++ )
+        {
+        isInside[n] = 0;
+        if( maskRow && !maskRow[n] )
+          {
+          continue;
+          }
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          index[d] = cindex[d][n];
+          }
+        if( interpolator->IsInsideBuffer( index ) )
+          {
+          values[n] = static_cast<double>( interpolator->EvaluateAtContinuousIndex( index ) );
+          isInside[n] = 1;
+          }
+        }
+      }
+    this->StoreInterpolatedRow( runBegin, runEnd, maskRow, values, isInside, outputRow );
+    }
+
+  /** Evaluate a batch interpolator at the voxels [runBegin, runEnd) of a
+   * row, one batch per run of voxels inside the mask (if given).  The
+   * voxels outside the mask, whose points are not mapped, are skipped. */
+  static void EvaluateMaskedRow( const BatchInterpolatorType *interpolator,
+    RealType * const cindex[ImageDimension], long runBegin, long runEnd,
+    const unsigned char *maskRow, double *values, unsigned char *isInside )
+    {
+    const RealType *runIndices[ImageDimension];
+    for( long n = runBegin; n < runEnd; )
+      {
+      if( maskRow && !maskRow[n] )
+        {
+        isInside[n++] = 0;
+        continue;
+        }
+      long end = n + 1;
+      while( end < runEnd && ( !maskRow || maskRow[end] ) )
+        {
+        end++;
+        }
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        runIndices[d] = cindex[d] + n;
+        }
+      interpolator->EvaluateRow( runIndices, end - n, values + n, isInside + n );
+      n = end;
+      }
+    }
+
+  /** Clamp the interpolated values of the voxels [runBegin, runEnd) to the
+   * output pixel range.  Voxels outside the mask (if given) or the input
+   * buffer are set to the default value. */
+  void StoreInterpolatedRow( long runBegin, long runEnd, const unsigned char *maskRow,
+    const double *values, const unsigned char *isInside, PixelType *outputRow ) const
+    {
+    const double minimumValue = static_cast<double>( NumericTraits<PixelType>::NonpositiveMin() );
+    const double maximumValue = static_cast<double>( NumericTraits<PixelType>::max() );
+    const PixelType defaultValue = this->GetDefaultPixelValue();
+    for( long n = runBegin; n < runEnd; n++ )
+      {
+      if( ( maskRow && !maskRow[n] ) || !isInside[n] )
+        {
+        outputRow[n] = defaultValue;
+        continue;
+        }
+      const double value = values[n];
+      outputRow[n] = static_cast<PixelType>(
+        ( value < minimumValue ) ? minimumValue : ( ( value > maximumValue ) ? maximumValue : value ) );
+      }
+    }
+
+  /** Cut the region of each thread into work units (see
+   * SetUseWorkStealing()).  Leaves the queues empty if work stealing is
+   * off or not applicable. */
+  void FillWorkQueues()
+    {
+    this->m_WorkQueues.clear();
+    this->m_WorkQueueLocks.clear();
+    if( !this->m_UseWorkStealing || this->m_ComputeJacobianDeterminant )
+      {
+      return;
+      }
+
+    const long unitSize = std::max<long>( WorkUnitSize, this->m_OutputTileSize );
+    const ThreadIdType numberOfThreads = this->GetNumberOfThreads();
+    this->m_WorkQueues.resize( numberOfThreads );
+    this->m_WorkQueueLocks.resize( numberOfThreads );
+
+    OutputImageRegionType threadRegion;
+    const ThreadIdType numberOfRegions = this->SplitRequestedRegion( 0, numberOfThreads, threadRegion );
+    for( ThreadIdType t = 0; t < numberOfThreads; t++ )
+      {
+      this->m_WorkQueueLocks[t] = MutexLock::New();
+      if( t >= numberOfRegions )
+        {
+        continue;
+        }
+      this->SplitRequestedRegion( t, numberOfThreads, threadRegion );
+      if( threadRegion.GetNumberOfPixels() == 0 )
+        {
+        continue;
+        }
+
+      // Odometer over the units along axes 1, ..., D-1 in row order.
+      long numberOfUnits[ImageDimension];
+      long unit[ImageDimension];
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        numberOfUnits[d] = ( static_cast<long>( threadRegion.GetSize()[d] ) + unitSize - 1 ) / unitSize;
+        unit[d] = 0;
+        }
+      for( ;; )
+        {
+        OutputImageRegionType workUnit = threadRegion;
+        for( unsigned int d = 1; d < ImageDimension; d++ )
+          {
+          const long begin = unit[d] * unitSize;
+          workUnit.SetIndex( d, threadRegion.GetIndex()[d] + begin );
+          workUnit.SetSize( d, static_cast<SizeValueType>(
+            std::min( unitSize, static_cast<long>( threadRegion.GetSize()[d] ) - begin ) ) );
+          }
+        this->m_WorkQueues[t].push_back( workUnit );
+
+        unsigned int d = 1;
+        for( ; d < ImageDimension; d++ )
+          {
+          if( ++unit[d] < numberOfUnits[d] )
+            {
+            break;
+            }
+          unit[d] = 0;
+          }
+        if( d >= ImageDimension )
+          {
+          break;
+          }
+        }
+      }
+    }
+
+  /** Take the next work unit of the thread, or steal the last one of
+   * another thread.  Returns false when all queues are empty. */
+  bool PopWorkUnit( ThreadIdType threadId, OutputImageRegionType & workUnit )
+    {
+    const ThreadIdType numberOfQueues = static_cast<ThreadIdType>( this->m_WorkQueues.size() );
+    for( ThreadIdType n = 0; n < numberOfQueues; n++ )
+      {
+      const ThreadIdType q = ( threadId + n ) % numberOfQueues;
+      std::deque<OutputImageRegionType> & queue = this->m_WorkQueues[q];
+
+      this->m_WorkQueueLocks[q]->Lock();
+      const bool found = !queue.empty();
+      if( found )
+        {
+        if( n == 0 )
+          {
+          workUnit = queue.front();
+          queue.pop_front();
+          }
+        else
+          {
+          workUnit = queue.back();
+          queue.pop_back();
+          }
+        }
+      this->m_WorkQueueLocks[q]->Unlock();
+      if( found )
+        {
+        return true;
+        }
+      }
+    return false;
+    }
+
+  /** Select the pyramid level of the output voxels on a grid of every
+   * AntiAliasingGridSpacing-th voxel:  each node and its successors along
+   * the output axes are mapped, and the longest step in input voxels
+   * (along the input axes that the pyramid reduces) gives level
+   * floor( log2( step ) ), i.e. the coarsest level whose voxels are not
+   * larger than the step.  If any node needs a level above 0, the input
+   * pyramid is built up to the highest such level.  Requires the input
+   * mapping (see ComputeInputIndexMapping()). */
+  void ComputeAntiAliasingLevels()
+    {
+    const OutputImageType *outputPtr = this->GetOutput();
+    const InputImageType *input = this->GetInput();
+    const OutputImageRegionType & region = outputPtr->GetRequestedRegion();
+    const typename InputImageType::RegionType & inputRegion = input->GetBufferedRegion();
+
+    SizeValueType numberOfNodes = 1;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const long size = static_cast<long>( region.GetSize()[d] );
+      if( size == 0 )
+        {
+        return;
+        }
+      this->m_LevelMapSize[d] = ( size - 1 + AntiAliasingGridSpacing - 1 ) / AntiAliasingGridSpacing + 1;
+      numberOfNodes *= this->m_LevelMapSize[d];
+      }
+
+    // The pyramid stops reducing once the largest input axis is a single
+    // voxel.
+    unsigned int maximumLevel = 0;
+    SizeValueType largestInputSize = 1;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      largestInputSize = std::max<SizeValueType>( largestInputSize, inputRegion.GetSize()[d] );
+      }
+    while( ( largestInputSize - 1 ) >> ( maximumLevel + 1 ) > 0 )
+      {
+      maximumLevel++;
+      }
+
+    const SizeValueType pointsPerNode = ImageDimension + 1;
+    std::vector<RealType> points[ImageDimension];
+    RealType *pointPointers[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      points[d].resize( numberOfNodes * pointsPerNode );
+      pointPointers[d] = &points[d][0];
+      }
+    IndexType index;
+    PointType point;
+    for( SizeValueType node = 0; node < numberOfNodes; node++ )
+      {
+      SizeValueType remainder = node;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        index[d] = region.GetIndex()[d] + std::min<long>(
+          static_cast<long>( remainder % this->m_LevelMapSize[d] ) * AntiAliasingGridSpacing,
+          static_cast<long>( region.GetSize()[d] ) - 1 );
+        remainder /= this->m_LevelMapSize[d];
+        }
+      for( unsigned int j = 0; j <= ImageDimension; j++ )
+        {
+        IndexType neighborIndex = index;
+        if( j > 0 )
+          {
+          neighborIndex[j - 1]++;
+          }
+        outputPtr->TransformIndexToPhysicalPoint( neighborIndex, point );
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          points[d][node * pointsPerNode + j] = static_cast<RealType>( point[d] );
+          }
+        }
+      }
+    this->MapLatticePoints( pointPointers, numberOfNodes * pointsPerNode );
+
+    this->m_AntiAliasingLevelMap.assign( numberOfNodes, 0 );
+    unsigned int highestLevel = 0;
+    for( SizeValueType node = 0; node < numberOfNodes; node++ )
+      {
+      const SizeValueType first = node * pointsPerNode;
+      double squaredStep = 0.0;
+      for( unsigned int j = 1; j <= ImageDimension; j++ )
+        {
+        if( region.GetSize()[j - 1] <= 1 )
+          {
+          continue;
+          }
+        double squaredNorm = 0.0;
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          if( inputRegion.GetSize()[i] <= 1 )
+            {
+            continue;
+            }
+          double difference = 0.0;
+          for( unsigned int k = 0; k < ImageDimension; k++ )
+            {
+            difference += this->m_InputPhysicalToIndex[i][k] *
+              ( static_cast<double>( points[k][first + j] ) - static_cast<double>( points[k][first] ) );
+            }
+          squaredNorm += difference * difference;
+          }
+        squaredStep = vnl_math_max( squaredStep, squaredNorm );
+        }
+
+      // NaN steps (unmappable points) stay at level 0.
+      unsigned int level = 0;
+      while( level < maximumLevel && squaredStep >= vnl_math_sqr( std::ldexp( 2.0, level ) ) )
+        {
+        level++;
+        }
+      this->m_AntiAliasingLevelMap[node] = static_cast<unsigned char>( level );
+      highestLevel = vnl_math_max( highestLevel, level );
+      }
+    if( highestLevel == 0 )
+      {
+      this->m_AntiAliasingLevelMap.clear();
+      return;
+      }
+
+    this->m_InputPyramid = InputPyramidType::New();
+    this->m_InputPyramid->SetInput( input );
+    this->m_InputPyramid->SetNumberOfLevels( highestLevel + 1 );
+    this->m_InputPyramid->SetNumberOfThreads( this->GetNumberOfThreads() );
+    this->m_InputPyramid->Update();
+
+    this->m_LevelInterpolators.assign( highestLevel + 1, typename BatchInterpolatorType::Pointer() );
+    for( unsigned int level = 1; level <= highestLevel; level++ )
+      {
+      this->m_LevelInterpolators[level] = BatchInterpolatorType::New();
+      this->m_LevelInterpolators[level]->SetInputImage( this->m_InputPyramid->GetOutput( level ) );
+      }
+    this->m_NumberOfAntiAliasingLevels = highestLevel + 1;
+    }
+
+  /** Pyramid levels of the voxels [runBegin, runEnd) of the row starting
+   * at rowIndex, taken from the nearest node of the level grid. */
+  void GetAntiAliasingLevelRow( const IndexType & rowIndex, long runBegin, long runEnd,
+    unsigned char *levelRow ) const
+    {
+    const OutputImageRegionType & region = this->GetOutput()->GetRequestedRegion();
+    long nodeOffset = 0;
+    long nodeStride = this->m_LevelMapSize[0];
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      const long node = std::min<long>( ( rowIndex[d] - region.GetIndex()[d] + AntiAliasingGridSpacing / 2 ) /
+        AntiAliasingGridSpacing, this->m_LevelMapSize[d] - 1 );
+      nodeOffset += node * nodeStride;
+      nodeStride *= this->m_LevelMapSize[d];
+      }
+    for( long n = runBegin; n < runEnd; n++ )
+      {
+      const long node = std::min<long>( ( rowIndex[0] + n - region.GetIndex()[0] + AntiAliasingGridSpacing / 2 ) /
+        AntiAliasingGridSpacing, this->m_LevelMapSize[0] - 1 );
+      levelRow[n] = this->m_AntiAliasingLevelMap[nodeOffset + node];
+      }
+    }
+
+  /** Interpolate the voxels [runBegin, runEnd) of a row at the given
+   * continuous input indices, each at its pyramid level:  level 0 by
+   * InterpolateIndexRow(), the others linearly in the reduced input.  The
+   * inside test is the one of the full resolution input, whose border
+   * voxels are clamped onto the reduced one. */
+  void InterpolateAntiAliasedRow( RealType * const cindex[ImageDimension], long runBegin, long runEnd,
+    const unsigned char *levelRow, const unsigned char *maskRow, RealType * const levelIndex[ImageDimension],
+    double *values, unsigned char *isInside, PixelType *outputRow ) const
+    {
+    const typename InputImageType::RegionType & inputRegion = this->GetInput()->GetBufferedRegion();
+    for( long n = runBegin; n < runEnd; )
+      {
+      const unsigned int level = levelRow[n];
+      long end = n + 1;
+      while( end < runEnd && levelRow[end] == level )
+        {
+        end++;
+        }
+      if( level == 0 )
+        {
+        this->InterpolateIndexRow( cindex, n, end, maskRow, values, isInside, outputRow );
+        n = end;
+        continue;
+        }
+
+      const BatchInterpolatorType *interpolator = this->m_LevelInterpolators[level];
+      const typename InputImageType::RegionType & levelRegion =
+        interpolator->GetInputImage()->GetBufferedRegion();
+      const double scale = std::ldexp( 1.0, -static_cast<int>( level ) );
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        const double start = static_cast<double>( inputRegion.GetIndex()[d] );
+        const double last = static_cast<double>( levelRegion.GetSize()[d] ) - 1.0;
+        for( long m = n; m < end; m++ )
+          {
+          const double c = ( static_cast<double>( cindex[d][m] ) - start ) * scale;
+          levelIndex[d][m] = static_cast<RealType>( ( c < 0.0 ) ? 0.0 : ( ( c > last ) ? last : c ) );
+          }
+        }
+      EvaluateMaskedRow( interpolator, levelIndex, n, end, maskRow, values, isInside );
+
+      for( long m = n; m < end; m++ )
+        {
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          const double c = static_cast<double>( cindex[d][m] );
+          const double start = static_cast<double>( inputRegion.GetIndex()[d] );
+          if( !( c >= start - 0.5 && c < start + static_cast<double>( inputRegion.GetSize()[d] ) - 0.5 ) )
+            {
+            isInside[m] = 0;
+            }
+          }
+        }
+      this->StoreInterpolatedRow( n, end, maskRow, values, isInside, outputRow );
+      n = end;
+      }
+    }
+
+  /** Map the physical points of count voxels starting at index along
+   * axis 0.  The coordinates are stored starting at offset. */
+  void MapRow( const IndexType & index, long count, RealType * const mapped[ImageDimension],
+    long offset ) const
+    {
+    CoordinateMapPixelType *storedPoints = this->GetCoordinateMapRow( index, count );
+    if( storedPoints && !this->m_IsRecordingCoordinateMap )
+      {
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        RealType *coordinates = mapped[d] + offset;
+        for( long n = 0; n < count; n++ )
+          {
+          coordinates[n] = storedPoints[n][d];
+          }
+        }
+      return;
+      }
+
+    const OutputImageType *outputPtr = this->GetOutput();
+
+    PointType point;
+    outputPtr->TransformIndexToPhysicalPoint( index, point );
+
+    RealType *coordinates[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const double step = outputPtr->GetDirection()[d][0] * outputPtr->GetSpacing()[0];
+      coordinates[d] = mapped[d] + offset;
+      for( long n = 0; n < count; n++ )
+        {
+        coordinates[d][n] = static_cast<RealType>( point[d] + n * step );
+        }
+      }
+
+    if( this->m_LatticePoints.empty() || !this->ApproximateRow( index, count, coordinates ) )
+      {
+      this->MapPhysicalPoints( coordinates, count );
+      }
+
+    if( storedPoints )
+      {
+      for( long n = 0; n < count; n++ )
+        {
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          storedPoints[n][d] = coordinates[d][n];
+          }
+        }
+      }
+    }
+
+  /** Map count physical points in place through the transform. */
+  void MapPhysicalPoints( RealType * const coordinates[ImageDimension], long count ) const
+    {
+    if( this->m_PointMapper->GetTransform() )
+      {
+      this->m_PointMapper->MapChunk( coordinates, count );
+      return;
+      }
+    const TransformType *transform = this->GetTransform();
+    PointType point;
+    for( long n = 0; n < count; n++ )
+      {
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        point[d] = coordinates[d][n];
+        }
+      point = transform->TransformPoint( point );
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        coordinates[d][n] = point[d];
+        }
+      }
+    }
+
+  /** Output index of a lattice node along an axis:  every L-th voxel of
+   * the output region and its last voxel. */
+  long GetLatticeNodeIndex( unsigned int d, long node ) const
+    {
+    return this->m_LatticeRegion.GetIndex()[d] + std::min<long>(
+      node * static_cast<long>( this->m_CoordinateLatticeSpacing ),
+      static_cast<long>( this->m_LatticeRegion.GetSize()[d] ) - 1 );
+    }
+
+  /** Lattice cell containing an output index along an axis, its nodes and
+   * the weight of the upper node. */
+  void GetLatticeCell( unsigned int d, long index, long & cell, long & lowerNode,
+    long & upperNode, double & weight ) const
+    {
+    cell = std::min<long>( ( index - this->m_LatticeRegion.GetIndex()[d] ) /
+      static_cast<long>( this->m_CoordinateLatticeSpacing ), this->m_LatticeNumberOfCells[d] - 1 );
+    lowerNode = cell;
+    upperNode = std::min<long>( cell + 1, this->m_LatticeSize[d] - 1 );
+    const long lowerIndex = this->GetLatticeNodeIndex( d, lowerNode );
+    const long upperIndex = this->GetLatticeNodeIndex( d, upperNode );
+    weight = ( upperIndex > lowerIndex ) ?
+      static_cast<double>( index - lowerIndex ) / static_cast<double>( upperIndex - lowerIndex ) : 0.0;
+    }
+
+  /** Multilinear interpolation of the mapped lattice nodes at an output
+   * index inside the lattice region. */
+  void InterpolateLattice( const IndexType & index, double point[ImageDimension] ) const
+    {
+    long lowerNode[ImageDimension];
+    long upperNode[ImageDimension];
+    double weight[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      long cell;
+      this->GetLatticeCell( d, index[d], cell, lowerNode[d], upperNode[d], weight[d] );
+      point[d] = 0.0;
+      }
+    for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+      {
+      double w = 1.0;
+      long node = 0;
+      long stride = 1;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        const bool isUpper = ( corner & ( 1u << d ) ) != 0;
+        w *= isUpper ? weight[d] : 1.0 - weight[d];
+        node += ( isUpper ? upperNode[d] : lowerNode[d] ) * stride;
+        stride *= this->m_LatticeSize[d];
+        }
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        point[d] += w * this->m_LatticePoints[node * ImageDimension + d];
+        }
+      }
+    }
+
+  /** Map the lattice nodes and the centres of the lattice cells exactly
+   * and flag the cells whose interpolated centre is off by more than the
+   * tolerance. */
+  void ComputeCoordinateLattice()
+    {
+    const OutputImageType *outputPtr = this->GetOutput();
+    this->m_LatticeRegion = outputPtr->GetRequestedRegion();
+
+    const long spacing = static_cast<long>( this->m_CoordinateLatticeSpacing );
+    SizeValueType numberOfNodes = 1;
+    SizeValueType numberOfCells = 1;
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const long size = static_cast<long>( this->m_LatticeRegion.GetSize()[d] );
+      this->m_LatticeSize[d] = ( size - 1 + spacing - 1 ) / spacing + 1;
+      this->m_LatticeNumberOfCells[d] = std::max<long>( 1, this->m_LatticeSize[d] - 1 );
+      numberOfNodes *= this->m_LatticeSize[d];
+      numberOfCells *= this->m_LatticeNumberOfCells[d];
+      }
+    if( numberOfNodes == 0 )
+      {
+      return;
+      }
+
+    // Nodes
+    std::vector<RealType> nodes[ImageDimension];
+    RealType *nodePointers[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      nodes[d].resize( numberOfNodes );
+      nodePointers[d] = &nodes[d][0];
+      }
+    IndexType index;
+    PointType point;
+    for( SizeValueType node = 0; node < numberOfNodes; node++ )
+      {
+      SizeValueType remainder = node;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        index[d] = this->GetLatticeNodeIndex( d, static_cast<long>( remainder % this->m_LatticeSize[d] ) );
+        remainder /= this->m_LatticeSize[d];
+        }
+      outputPtr->TransformIndexToPhysicalPoint( index, point );
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        nodes[d][node] = static_cast<RealType>( point[d] );
+        }
+      }
+    this->MapLatticePoints( nodePointers, numberOfNodes );
+    this->m_LatticePoints.resize( numberOfNodes * ImageDimension );
+    for( SizeValueType node = 0; node < numberOfNodes; node++ )
+      {
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        this->m_LatticePoints[node * ImageDimension + d] = nodes[d][node];
+        }
+      }
+
+    // Cell centres
+    std::vector<RealType> centres[ImageDimension];
+    RealType *centrePointers[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      centres[d].resize( numberOfCells );
+      centrePointers[d] = &centres[d][0];
+      }
+    std::vector<IndexType> centreIndices( numberOfCells );
+    for( SizeValueType cell = 0; cell < numberOfCells; cell++ )
+      {
+      SizeValueType remainder = cell;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        const long c = static_cast<long>( remainder % this->m_LatticeNumberOfCells[d] );
+        remainder /= this->m_LatticeNumberOfCells[d];
+        const long lowerIndex = this->GetLatticeNodeIndex( d, c );
+        const long upperIndex = this->GetLatticeNodeIndex( d, std::min<long>( c + 1, this->m_LatticeSize[d] - 1 ) );
+        index[d] = lowerIndex + ( upperIndex - lowerIndex ) / 2;
+        }
+      centreIndices[cell] = index;
+      outputPtr->TransformIndexToPhysicalPoint( index, point );
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        centres[d][cell] = static_cast<RealType>( point[d] );
+        }
+      }
+    this->MapLatticePoints( centrePointers, numberOfCells );
+
+    this->m_IsLatticeCellExact.assign( numberOfCells, 0 );
+    const double squaredTolerance = vnl_math_sqr( this->m_CoordinateTolerance );
+    double estimate[ImageDimension];
+    for( SizeValueType cell = 0; cell < numberOfCells; cell++ )
+      {
+      this->InterpolateLattice( centreIndices[cell], estimate );
+      double squaredError = 0.0;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        squaredError += vnl_math_sqr( estimate[d] - static_cast<double>( centres[d][cell] ) );
+        }
+      if( !( squaredError <= squaredTolerance ) )
+        {
+        this->m_IsLatticeCellExact[cell] = 1;
+        this->m_NumberOfExactLatticeCells++;
+        }
+      }
+    }
+
+  /** Map the lattice points, using the threads of the point mapper. */
+  void MapLatticePoints( RealType * const coordinates[ImageDimension], SizeValueType count )
+    {
+    if( this->m_PointMapper->GetTransform() )
+      {
+      this->m_PointMapper->SetNumberOfThreads( this->GetNumberOfThreads() );
+      this->m_PointMapper->MapPoints( coordinates, count );
+      }
+    else
+      {
+      this->MapPhysicalPoints( coordinates, static_cast<long>( count ) );
+      }
+    }
+
+  /** Approximate the mapped points of count voxels starting at index along
+   * axis 0 from the lattice.  The coordinates hold the physical points on
+   * entry (needed by cells which are mapped exactly).  Returns false if
+   * the voxels are not inside the lattice region. */
+  bool ApproximateRow( const IndexType & index, long count, RealType * const coordinates[ImageDimension] ) const
+    {
+    const IndexType & start = this->m_LatticeRegion.GetIndex();
+    const SizeType & size = this->m_LatticeRegion.GetSize();
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const long last = ( d == 0 ) ? index[d] + count : index[d] + 1;
+      if( index[d] < start[d] || last > start[d] + static_cast<long>( size[d] ) )
+        {
+        return false;
+        }
+      }
+
+    // Interpolate the lattice along axes 1, ..., D-1 at each node along
+    // axis 0, which leaves a linear interpolation along the row.
+    long cellOffset = 0;
+    long cellStride = this->m_LatticeNumberOfCells[0];
+    long lowerNode[ImageDimension];
+    long upperNode[ImageDimension];
+    double weight[ImageDimension];
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      long cell;
+      this->GetLatticeCell( d, index[d], cell, lowerNode[d], upperNode[d], weight[d] );
+      cellOffset += cell * cellStride;
+      cellStride *= this->m_LatticeNumberOfCells[d];
+      }
+    std::vector<double> rowNodes( this->m_LatticeSize[0] * ImageDimension, 0.0 );
+    for( unsigned int corner = 0; corner < ( 1u << ( ImageDimension - 1 ) ); corner++ )
+      {
+      double w = 1.0;
+      long node = 0;
+      long stride = this->m_LatticeSize[0];
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        const bool isUpper = ( corner & ( 1u << ( d - 1 ) ) ) != 0;
+        w *= isUpper ? weight[d] : 1.0 - weight[d];
+        node += ( isUpper ? upperNode[d] : lowerNode[d] ) * stride;
+        stride *= this->m_LatticeSize[d];
+        }
+      if( w == 0.0 )
+        {
+        continue;
+        }
+      for( long node0 = 0; node0 < this->m_LatticeSize[0]; node0++ )
+        {
+        const RealType *latticePoint = &this->m_LatticePoints[( node + node0 ) * ImageDimension];
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          rowNodes[node0 * ImageDimension + d] += w * latticePoint[d];
+          }
+        }
+      }
+
+    // Cell by cell along the row.
+    const long spacing = static_cast<long>( this->m_CoordinateLatticeSpacing );
+    for( long n = 0; n < count; )
+      {
+      long cell;
+      long lower;
+      long upper;
+      double w;
+      this->GetLatticeCell( 0, index[0] + n, cell, lower, upper, w );
+      const long end = ( cell == this->m_LatticeNumberOfCells[0] - 1 ) ? count :
+        std::min<long>( count, start[0] + ( cell + 1 ) * spacing - index[0] );
+
+      if( this->m_IsLatticeCellExact[cellOffset + cell] )
+        {
+        RealType *segment[ImageDimension];
+        for( unsigned int d = 0; d < ImageDimension; d++ )
+          {
+          segment[d] = coordinates[d] + n;
+          }
+        this->MapPhysicalPoints( segment, end - n );
+        }
+      else
+        {
+        const long lowerIndex = this->GetLatticeNodeIndex( 0, lower );
+        const long upperIndex = this->GetLatticeNodeIndex( 0, upper );
+        const double step = ( upperIndex > lowerIndex ) ? 1.0 / ( upperIndex - lowerIndex ) : 0.0;
+        for( long m = n; m < end; m++ )
+          {
+          const double t = ( index[0] + m - lowerIndex ) * step;
+          for( unsigned int d = 0; d < ImageDimension; d++ )
+            {
+            coordinates[d][m] = static_cast<RealType>( ( 1.0 - t ) * rowNodes[lower * ImageDimension + d] +
+              t * rowNodes[upper * ImageDimension + d] );
+            }
+          }
+        }
+      n = end;
+      }
+    return true;
+    }
+
+  /** Points of the coordinate map for count voxels starting at index along
+   * axis 0, or NULL if there is no map or it does not cover them. */
+  CoordinateMapPixelType * GetCoordinateMapRow( const IndexType & index, long count ) const
+    {
+    if( this->m_CoordinateMap.IsNull() )
+      {
+      return NULL;
+      }
+    const typename CoordinateMapType::RegionType & mapRegion =
+      this->m_CoordinateMap->GetBufferedRegion();
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const long last = ( d == 0 ) ? index[d] + count : index[d] + 1;
+      if( index[d] < mapRegion.GetIndex()[d] ||
+        last > mapRegion.GetIndex()[d] + static_cast<long>( mapRegion.GetSize()[d] ) )
+        {
+        return NULL;
+        }
+      }
+    return this->m_CoordinateMap->GetBufferPointer() +
+      this->m_CoordinateMap->ComputeOffset( index );
+    }
+
+  /** Bound the output voxels which can be mapped into the input buffer:
+   * the buffer (padded by half a voxel beyond the interpolator's bounds) is
+   * mapped back through the stages of the composite and the resulting box
+   * is padded by a voxel of the output grid.  Nothing is bounded if the
+   * transform is not a composite or has no bounded inverse. */
+  void ComputeMappableRegion()
+    {
+    const InputImageType *input = this->GetInput();
+    if( !this->m_PointMapper->GetTransform() || !input )
+      {
+      return;
+      }
+    const typename InputImageType::RegionType & inputRegion = input->GetBufferedRegion();
+
+    typedef typename PointMapperType::BoundingBoxType BoundingBoxType;
+    BoundingBoxType inputBox;
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      inputBox.m_Lower[i] = NumericTraits<double>::max();
+      inputBox.m_Upper[i] = NumericTraits<double>::NonpositiveMin();
+      }
+    for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+      {
+      ContinuousIndex<double, ImageDimension> cindex;
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        cindex[j] = ( corner & ( 1u << j ) ) ?
+          static_cast<double>( inputRegion.GetIndex()[j] + static_cast<long>( inputRegion.GetSize()[j] ) ) :
+          static_cast<double>( inputRegion.GetIndex()[j] - 1 );
+        }
+      typename InputImageType::PointType point;
+      input->TransformContinuousIndexToPhysicalPoint( cindex, point );
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        inputBox.m_Lower[i] = vnl_math_min( inputBox.m_Lower[i], static_cast<double>( point[i] ) );
+        inputBox.m_Upper[i] = vnl_math_max( inputBox.m_Upper[i], static_cast<double>( point[i] ) );
+        }
+      }
+
+    BoundingBoxType outputBox;
+    if( !this->m_PointMapper->ComputePreimageBoundingBox( inputBox, outputBox ) )
+      {
+      return;
+      }
+
+    const OutputImageType *outputPtr = this->GetOutput();
+    double lower[ImageDimension];
+    double upper[ImageDimension];
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      lower[i] = NumericTraits<double>::max();
+      upper[i] = NumericTraits<double>::NonpositiveMin();
+      }
+    for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+      {
+      PointType point;
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        point[j] = ( corner & ( 1u << j ) ) ? outputBox.m_Upper[j] : outputBox.m_Lower[j];
+        }
+      ContinuousIndex<double, ImageDimension> cindex;
+      outputPtr->TransformPhysicalPointToContinuousIndex( point, cindex );
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        lower[i] = vnl_math_min( lower[i], cindex[i] );
+        upper[i] = vnl_math_max( upper[i], cindex[i] );
+        }
+      }
+
+    OutputImageRegionType mappableRegion = this->m_MappableRegion;
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      const double regionBegin = static_cast<double>( mappableRegion.GetIndex()[i] );
+      const double regionEnd = regionBegin + static_cast<double>( mappableRegion.GetSize()[i] );
+      const double begin = vnl_math_max( regionBegin, vcl_floor( lower[i] ) - 1.0 );
+      const double end = vnl_math_min( regionEnd, vcl_ceil( upper[i] ) + 2.0 );
+      mappableRegion.SetIndex( i, static_cast<long>( begin ) );
+      mappableRegion.SetSize( i, ( end > begin ) ? static_cast<unsigned long>( end - begin ) : 0 );
+      }
+    this->m_MappableRegion = mappableRegion;
+    }
+
+  /** Restrict the voxels [runBegin, runEnd) of the row starting at index
+   * to the mappable region. */
+  void GetMappableRun( const IndexType & index, long rowLength, long & runBegin, long & runEnd ) const
+    {
+    const OutputImageRegionType & mappableRegion = this->m_MappableRegion;
+    for( unsigned int k = 1; k < ImageDimension; k++ )
+      {
+      if( index[k] < mappableRegion.GetIndex()[k] ||
+        index[k] >= mappableRegion.GetIndex()[k] + static_cast<long>( mappableRegion.GetSize()[k] ) )
+        {
+        runBegin = runEnd = 0;
+        return;
+        }
+      }
+    runBegin = std::max( 0L, mappableRegion.GetIndex()[0] - index[0] );
+    runEnd = std::min( rowLength, mappableRegion.GetIndex()[0] +
+      static_cast<long>( mappableRegion.GetSize()[0] ) - index[0] );
+    if( runEnd < runBegin )
+      {
+      runBegin = runEnd = 0;
+      }
+    }
+
+  static double SumProbes( const std::vector<TimeProbe> & probes )
+    {
+    double total = 0.0;
+    for( std::size_t n = 0; n < probes.size(); n++ )
+      {
+      total += probes[n].GetTotal();
+      }
+    return total;
+    }
+
+  /** Mask values (0/1) of count voxels starting at index along axis 0.
+   * Voxels outside the mask image are outside the mask. */
+  void GetMaskRow( const IndexType & index, long count, std::vector<unsigned char> & maskRow ) const
+    {
+    const MaskImageType *mask = this->m_OutputMask.GetPointer();
+    const typename MaskImageType::RegionType & maskRegion = mask->GetBufferedRegion();
+
+    typename MaskImageType::IndexType maskIndex;
+    if( this->m_MaskIsAligned )
+      {
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        maskIndex[d] = index[d] + this->m_MaskIndexOffset[d];
+        }
+      bool isInside = true;
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        if( maskIndex[d] < maskRegion.GetIndex()[d] ||
+          maskIndex[d] >= maskRegion.GetIndex()[d] + static_cast<long>( maskRegion.GetSize()[d] ) )
+          {
+          isInside = false;
+          }
+        }
+      const long maskBegin = maskRegion.GetIndex()[0];
+      const long maskEnd = maskBegin + static_cast<long>( maskRegion.GetSize()[0] );
+      for( long n = 0; n < count; n++, maskIndex[0]++ )
+        {
+        maskRow[n] = ( isInside && maskIndex[0] >= maskBegin && maskIndex[0] < maskEnd &&
+          mask->GetPixel( maskIndex ) != NumericTraits<MaskPixelType>::Zero ) ? 1 : 0;
+        }
+      }
+    else
+      {
+      const OutputImageType *outputPtr = this->GetOutput();
+      IndexType voxelIndex = index;
+      PointType point;
+      for( long n = 0; n < count; n++, voxelIndex[0]++ )
+        {
+        outputPtr->TransformIndexToPhysicalPoint( voxelIndex, point );
+        maskRow[n] = ( mask->TransformPhysicalPointToIndex( point, maskIndex ) &&
+          mask->GetPixel( maskIndex ) != NumericTraits<MaskPixelType>::Zero ) ? 1 : 0;
+        }
+      }
+    }
+
+private:
+  ANTSResampleImageFilter( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  OutputPixelContainerPointer                           m_OutputPixelContainer;
+  bool                                                  m_ComputeJacobianDeterminant;
+  bool                                                  m_UseLogJacobianDeterminant;
+  bool                                                  m_ResampleInput;
+  bool                                                  m_ComputeRowReducedOutput;
+  typename OutputImageType::Pointer                     m_RowReducedOutput;
+  std::vector<char>                                     m_IsRowSplit;
+  bool                                                  m_MeasurePhaseTimes;
+  std::vector<TimeProbe>                                m_MappingProbes;
+  std::vector<TimeProbe>                                m_InterpolationProbes;
+  typename JacobianDeterminantImageType::Pointer        m_JacobianDeterminantImage;
+  typename PointMapperType::Pointer                     m_PointMapper;
+  double                                                m_GridJacobianDeterminant;
+  typename MaskImageType::ConstPointer                  m_OutputMask;
+  bool                                                  m_MaskIsAligned;
+  typename MaskImageType::OffsetType                    m_MaskIndexOffset;
+  OutputImageRegionType                                 m_MappableRegion;
+  typename CoordinateMapType::Pointer                   m_CoordinateMap;
+  bool                                                  m_RecordCoordinateMap;
+  bool                                                  m_IsRecordingCoordinateMap;
+  bool                                                  m_UseIncrementalAffineMapping;
+  bool                                                  m_IsMappingIncrementally;
+  double                                                m_AffineIndexMatrix[ImageDimension][ImageDimension];
+  double                                                m_AffineIndexOffset[ImageDimension];
+  double                                                m_InputPhysicalToIndex[ImageDimension][ImageDimension];
+  double                                                m_InputOrigin[ImageDimension];
+  bool                                                  m_UseBatchLinearInterpolation;
+  typename BatchInterpolatorType::Pointer               m_BatchInterpolator;
+  unsigned int                                          m_CoordinateLatticeSpacing;
+  double                                                m_CoordinateTolerance;
+  SizeValueType                                         m_NumberOfExactLatticeCells;
+  OutputImageRegionType                                 m_LatticeRegion;
+  long                                                  m_LatticeSize[ImageDimension];
+  long                                                  m_LatticeNumberOfCells[ImageDimension];
+  std::vector<RealType>                                 m_LatticePoints;
+  std::vector<unsigned char>                            m_IsLatticeCellExact;
+  bool                                                  m_UseAntiAliasing;
+  unsigned int                                          m_NumberOfAntiAliasingLevels;
+  long                                                  m_LevelMapSize[ImageDimension];
+  std::vector<unsigned char>                            m_AntiAliasingLevelMap;
+  typename InputPyramidType::Pointer                    m_InputPyramid;
+  std::vector<typename BatchInterpolatorType::Pointer>  m_LevelInterpolators;
+  bool                                                  m_UsePolyphaseZoom;
+  bool                                                  m_IsZooming;
+  unsigned int                                          m_ZoomKernelWidth[ImageDimension];
+  std::vector<long>                                     m_ZoomNeighbors[ImageDimension];
+  std::vector<double>                                   m_ZoomWeights[ImageDimension];
+  std::vector<unsigned char>                            m_ZoomInside[ImageDimension];
+  long                                                  m_ZoomLineLength;
+  typename InputImageType::ConstPointer                 m_ZoomInput;
+  typename CoefficientImageType::ConstPointer           m_ZoomCoefficients;
+  unsigned int                                          m_OutputTileSize;
+  bool                                                  m_UseBrickedInput;
+  bool                                                  m_UseWorkStealing;
+
+  // Work units of each thread and their locks (see SetUseWorkStealing()).
+  std::vector<std::deque<OutputImageRegionType> >       m_WorkQueues;
+  std::vector<MutexLock::Pointer>                       m_WorkQueueLocks;
+
+  /** Number of voxels after which the stepped index is recomputed. */
+  static const long                                     AffineAnchorInterval = 64;
+
+  /** Spacing (in output voxels) of the grid on which the pyramid levels
+   * are selected. */
+  static const long                                     AntiAliasingGridSpacing = 8;
+
+  /** Smallest size (in output voxels) of the work units along the axes
+   * other than 0. */
+  static const long                                     WorkUnitSize = 8;
+};
+
+} // end namespace itk
+
+#endif
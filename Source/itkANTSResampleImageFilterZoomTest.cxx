@@ -0,0 +1,256 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkANTSResampleImageFilterZoomTest.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+/**
+ * Checks the polyphase zoom of ANTSResampleImageFilter (see
+ * SetUsePolyphaseZoom()) against the interpolator evaluated voxel by
+ * voxel for the linear, Gaussian, windowed sinc and B-spline kernels.
+ * The output grids extend beyond the input on every side, such that the
+ * kernels are clamped, truncated or mirrored at the borders of the input
+ * and part of the output is outside.  Two axis aligned maps are used:  a
+ * zoom by 2 whose output voxels fall between the input voxels, and
+ * different non-integer scalings and shifts along each axis.  Inside
+ * voxels must agree within ValueTolerance (the input ranges over about
+ * 200 units), outside voxels must have the default value.
+ */
+
+#include "itkANTSResampleImageFilter.h"
+#include "itkAffineTransform.h"
+#include "itkCachedBSplineInterpolateImageFunction.h"
+#include "itkGaussianInterpolateImageFunction.h"
+#include "itkImage.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkLinearInterpolateImageFunction.h"
+#include "itkSeparableWindowedSincInterpolateImageFunction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+const unsigned int Dimension = 3;
+const double ValueTolerance = 1e-6;
+const double DefaultValue = -1234.0;
+
+typedef itk::Image<double, Dimension>                                       ImageType;
+typedef itk::ANTSResampleImageFilter<ImageType, ImageType, double>          ResamplerType;
+typedef itk::InterpolateImageFunction<ImageType, double>                    InterpolatorType;
+typedef itk::AffineTransform<double, Dimension>                             AffineTransformType;
+typedef itk::LinearInterpolateImageFunction<ImageType, double>              LinearInterpolatorType;
+typedef itk::GaussianInterpolateImageFunction<ImageType, double>            GaussianInterpolatorType;
+typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+  itk::Function::LanczosWindowFunction<3>, double>                          LanczosInterpolatorType;
+typedef itk::SeparableWindowedSincInterpolateImageFunction<ImageType, 3,
+  itk::Function::HammingWindowFunction<3>, double>                          HammingInterpolatorType;
+typedef itk::CachedBSplineInterpolateImageFunction<ImageType, double>       BSplineInterpolatorType;
+
+ImageType::Pointer CreateInput()
+{
+  ImageType::RegionType region;
+  ImageType::SpacingType spacing;
+  ImageType::PointType origin;
+  const unsigned long size[Dimension] = { 19, 14, 11 };
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    region.SetIndex( d, 0 );
+    region.SetSize( d, size[d] );
+    spacing[d] = 1.0 + 0.5 * d;
+    origin[d] = -5.0 + d;
+    }
+  ImageType::Pointer input = ImageType::New();
+  input->SetRegions( region );
+  input->SetSpacing( spacing );
+  input->SetOrigin( origin );
+  input->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<ImageType> It( input, region );
+  for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+    {
+    const ImageType::IndexType & index = It.GetIndex();
+    It.Set( 50.0 * std::sin( 0.7 * index[0] ) + 30.0 * std::cos( 0.9 * index[1] ) +
+      20.0 * std::sin( 1.3 * index[2] + 0.4 * index[0] ) + 2.0 * index[2] );
+    }
+  return input;
+}
+
+/** Returns the number of output voxels that differ from the interpolator
+ * evaluated voxel by voxel. */
+unsigned int CompareWithInterpolator( const char *name, const ImageType *input,
+  InterpolatorType *interpolator, const AffineTransformType *transform,
+  const ImageType::SpacingType & outputSpacing, const ImageType::PointType & outputOrigin,
+  const ImageType::SizeType & outputSize )
+{
+  ResamplerType::Pointer resampler = ResamplerType::New();
+  resampler->SetInput( input );
+  resampler->SetTransform( transform );
+  resampler->SetInterpolator( interpolator );
+  resampler->SetOutputSpacing( outputSpacing );
+  resampler->SetOutputOrigin( outputOrigin );
+  resampler->SetSize( outputSize );
+  resampler->SetDefaultPixelValue( DefaultValue );
+  resampler->SetUsePolyphaseZoom( true );
+  resampler->Update();
+  if( !resampler->GetIsZooming() )
+    {
+    std::cerr << name << ":  the resampler did not zoom." << std::endl;
+    return 1;
+    }
+
+  interpolator->SetInputImage( input );
+  const ImageType *output = resampler->GetOutput();
+  unsigned int numberOfErrors = 0;
+  unsigned int numberOfInsideVoxels = 0;
+  double maximumDifference = 0.0;
+  itk::ImageRegionConstIteratorWithIndex<ImageType> It( output, output->GetLargestPossibleRegion() );
+  for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+    {
+    ImageType::PointType point;
+    output->TransformIndexToPhysicalPoint( It.GetIndex(), point );
+    const ImageType::PointType mapped = transform->TransformPoint( point );
+    itk::ContinuousIndex<double, Dimension> cindex;
+    input->TransformPhysicalPointToContinuousIndex( mapped, cindex );
+
+    double expected = DefaultValue;
+    if( interpolator->IsInsideBuffer( cindex ) )
+      {
+      expected = interpolator->EvaluateAtContinuousIndex( cindex );
+      numberOfInsideVoxels++;
+      }
+    const double difference = std::fabs( It.Get() - expected );
+    maximumDifference = std::max( maximumDifference, difference );
+    if( !( difference <= ValueTolerance ) )
+      {
+      if( numberOfErrors < 10 )
+        {
+        std::cerr << "  " << name << " at " << It.GetIndex() << " (input index " << cindex
+          << "):  expected " << expected << ", zoomed " << It.Get() << std::endl;
+        }
+      numberOfErrors++;
+      }
+    }
+  std::cout << name << ":  " << numberOfInsideVoxels << " of "
+    << output->GetLargestPossibleRegion().GetNumberOfPixels() << " voxels inside, maximum difference "
+    << maximumDifference << ", " << numberOfErrors << " errors" << std::endl;
+  return numberOfErrors;
+}
+
+unsigned int CompareKernels( const char *mapName, const ImageType *input,
+  const AffineTransformType *transform, const ImageType::SpacingType & outputSpacing,
+  const ImageType::PointType & outputOrigin, const ImageType::SizeType & outputSize )
+{
+  std::cout << mapName << ":" << std::endl;
+
+  GaussianInterpolatorType::Pointer gaussian = GaussianInterpolatorType::New();
+  double sigma[Dimension];
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    sigma[d] = input->GetSpacing()[d];
+    }
+  gaussian->SetParameters( sigma, 1.0 );
+
+  BSplineInterpolatorType::Pointer bSpline = BSplineInterpolatorType::New();
+  bSpline->SetSplineOrder( 3 );
+
+  BSplineInterpolatorType::Pointer quadraticBSpline = BSplineInterpolatorType::New();
+  quadraticBSpline->SetSplineOrder( 2 );
+
+  unsigned int numberOfErrors = 0;
+  numberOfErrors += CompareWithInterpolator( "  linear", input, LinearInterpolatorType::New(),
+    transform, outputSpacing, outputOrigin, outputSize );
+  numberOfErrors += CompareWithInterpolator( "  Gaussian", input, gaussian,
+    transform, outputSpacing, outputOrigin, outputSize );
+  numberOfErrors += CompareWithInterpolator( "  Lanczos windowed sinc", input, LanczosInterpolatorType::New(),
+    transform, outputSpacing, outputOrigin, outputSize );
+  numberOfErrors += CompareWithInterpolator( "  Hamming windowed sinc", input, HammingInterpolatorType::New(),
+    transform, outputSpacing, outputOrigin, outputSize );
+  numberOfErrors += CompareWithInterpolator( "  cubic B-spline", input, bSpline,
+    transform, outputSpacing, outputOrigin, outputSize );
+  numberOfErrors += CompareWithInterpolator( "  quadratic B-spline", input, quadraticBSpline,
+    transform, outputSpacing, outputOrigin, outputSize );
+  return numberOfErrors;
+}
+
+} // end namespace
+
+int main( int, char * [] )
+{
+  ImageType::Pointer input = CreateInput();
+  const ImageType::SpacingType & inputSpacing = input->GetSpacing();
+  const ImageType::PointType & inputOrigin = input->GetOrigin();
+  const ImageType::SizeType & inputSize = input->GetLargestPossibleRegion().GetSize();
+
+  unsigned int numberOfErrors = 0;
+
+  // Zoom by 2 with the identity:  the output indices map to input indices
+  // -3.25, -2.75, ..., i.e. beyond the input by 3 voxels on each side.
+  {
+  AffineTransformType::Pointer identity = AffineTransformType::New();
+  ImageType::SpacingType outputSpacing;
+  ImageType::PointType outputOrigin;
+  ImageType::SizeType outputSize;
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    outputSpacing[d] = 0.5 * inputSpacing[d];
+    outputOrigin[d] = inputOrigin[d] - 3.25 * inputSpacing[d];
+    outputSize[d] = 2 * inputSize[d] + 12;
+    }
+  numberOfErrors += CompareKernels( "Zoom by 2", input, identity,
+    outputSpacing, outputOrigin, outputSize );
+  }
+
+  // Different non-integer scalings and shifts along each axis.
+  {
+  AffineTransformType::Pointer scaling = AffineTransformType::New();
+  AffineTransformType::MatrixType matrix;
+  AffineTransformType::OutputVectorType offset;
+  matrix.SetIdentity();
+  matrix[0][0] = 1.1;
+  matrix[1][1] = 0.9;
+  matrix[2][2] = 1.05;
+  offset[0] = 0.31;
+  offset[1] = -0.23;
+  offset[2] = 0.17;
+  scaling->SetMatrix( matrix );
+  scaling->SetOffset( offset );
+
+  ImageType::SpacingType outputSpacing;
+  ImageType::PointType outputOrigin;
+  ImageType::SizeType outputSize;
+  const double scale[Dimension] = { 0.7, 1.3, 0.55 };
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    outputSpacing[d] = scale[d] * inputSpacing[d];
+    outputOrigin[d] = inputOrigin[d] - 3.1 * inputSpacing[d];
+    outputSize[d] = static_cast<unsigned long>( ( inputSize[d] + 6 ) / scale[d] );
+    }
+  numberOfErrors += CompareKernels( "Scaling and shift", input, scaling,
+    outputSpacing, outputOrigin, outputSize );
+  }
+
+  if( numberOfErrors > 0 )
+    {
+    std::cerr << "Error:  The polyphase zoom deviates from the interpolator by more than "
+      << ValueTolerance << "." << std::endl;
+    return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkAntiAliasedImagePyramid.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkAntiAliasedImagePyramid_h
+#define __itkAntiAliasedImagePyramid_h
+
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace itk
+{
+
+/** \class AntiAliasedImagePyramid
+ * \brief Successive 2x reductions of an image.
+ *
+ * Level k + 1 is computed from level k by smoothing with the binomial
+ * kernel [1 2 1] / 4 and keeping every second voxel, separably along each
+ * axis (axes of size 1 are left alone).  Voxel 0 keeps its physical
+ * position and the spacing doubles, i.e. voxel j of a level lies on voxel
+ * 2j of the previous one.  Each reduction along an axis reads its input
+ * once; since the sizes halve, the full resolution image is only read by
+ * the first pass, which can also be skipped if the input has already
+ * been reduced along axis 0 (see
+ * ANTSResampleImageFilter::SetComputeRowReducedOutput()).
+ *
+ * Only scalar pixel types are supported.  As for the memory mapped reader,
+ * this class is not a pipeline filter:  set the input and call Update().
+ *
+ * \ingroup MultiResolution
+ */
+template <class TImage>
+class ITK_EXPORT AntiAliasedImagePyramid : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef AntiAliasedImagePyramid Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(AntiAliasedImagePyramid, Object);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TImage::ImageDimension);
+
+  typedef TImage                                    ImageType;
+  typedef typename ImageType::PixelType             PixelType;
+  typedef typename NumericTraits<PixelType>::RealType RealType;
+  typedef typename ImageType::RegionType            RegionType;
+  typedef typename ImageType::SizeType              SizeType;
+
+  /** Number of levels including the input.  Default is 4 (full, 1/2, 1/4
+   * and 1/8 resolution). */
+  itkSetClampMacro(NumberOfLevels, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(NumberOfLevels, unsigned int);
+
+  /** Number of threads.  Default is the global default of the threader. */
+  itkSetClampMacro(NumberOfThreads, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
+  void SetInput( const ImageType *image )
+    {
+    this->m_Input = image;
+    }
+
+  /** The input reduced along axis 0 only (optional). */
+  void SetRowReducedInput( const ImageType *image )
+    {
+    this->m_RowReducedInput = image;
+    }
+
+  void Update()
+    {
+    if( this->m_Input.IsNull() )
+      {
+      itkExceptionMacro( "No input." );
+      }
+
+    this->m_Levels.clear();
+    this->m_Levels.push_back( this->m_Input );
+    for( unsigned int level = 1; level < this->m_NumberOfLevels; level++ )
+      {
+      typename ImageType::ConstPointer current = this->m_Levels.back();
+      for( unsigned int axis = 0; axis < ImageDimension; axis++ )
+        {
+        if( current->GetBufferedRegion().GetSize()[axis] <= 1 )
+          {
+          continue;
+          }
+        if( level == 1 && axis == 0 && this->m_RowReducedInput.IsNotNull() )
+          {
+          current = this->m_RowReducedInput;
+          }
+        else
+          {
+          current = this->ReduceAlongAxis( current, axis ).GetPointer();
+          }
+        }
+      this->m_Levels.push_back( current );
+      }
+    }
+
+  /** Level 0 is the input. */
+  const ImageType * GetOutput( unsigned int level ) const
+    {
+    if( level >= this->m_Levels.size() )
+      {
+      return NULL;
+      }
+    return this->m_Levels[level].GetPointer();
+    }
+
+  /** Smooth and subsample a row of length voxels into ( length + 1 ) / 2
+   * voxels.  The row is extended by replicating its end points. */
+  static void ReduceRow( const PixelType *row, long length, PixelType *reduced )
+    {
+    const long reducedLength = ( length + 1 ) / 2;
+    for( long j = 0; j < reducedLength; j++ )
+      {
+      const long center = 2 * j;
+      const long previous = ( center > 0 ) ? center - 1 : 0;
+      const long next = ( center + 1 < length ) ? center + 1 : length - 1;
+      reduced[j] = static_cast<PixelType>( 0.25 * ( static_cast<RealType>( row[previous] ) +
+        2.0 * static_cast<RealType>( row[center] ) + static_cast<RealType>( row[next] ) ) );
+      }
+    }
+
+  /** Geometry of the image reduced along the given axis. */
+  static void ReduceInformation( const ImageType *image, unsigned int axis, ImageType *reduced )
+    {
+    reduced->CopyInformation( image );
+
+    RegionType region = image->GetBufferedRegion();
+    typename ImageType::PointType origin;
+    image->TransformIndexToPhysicalPoint( region.GetIndex(), origin );
+
+    SizeType size = region.GetSize();
+    size[axis] = ( size[axis] + 1 ) / 2;
+    typename ImageType::SpacingType spacing = image->GetSpacing();
+    spacing[axis] *= 2.0;
+
+    typename ImageType::IndexType index;
+    index.Fill( 0 );
+    region.SetIndex( index );
+    region.SetSize( size );
+    reduced->SetOrigin( origin );
+    reduced->SetSpacing( spacing );
+    reduced->SetRegions( region );
+    }
+
+protected:
+  AntiAliasedImagePyramid() : m_NumberOfLevels( 4 ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    m_ReduceAxis( 0 ) {}
+  ~AntiAliasedImagePyramid() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "NumberOfLevels: " << this->m_NumberOfLevels << std::endl;
+    os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+    }
+
+  typename ImageType::Pointer ReduceAlongAxis( const ImageType *image, unsigned int axis )
+    {
+    typename ImageType::Pointer reduced = ImageType::New();
+    ReduceInformation( image, axis, reduced );
+    reduced->Allocate();
+
+    this->m_ReduceInput = image;
+    this->m_ReduceOutput = reduced;
+    this->m_ReduceAxis = axis;
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads( static_cast<int>( std::max<long>( 1, std::min<long>(
+      this->m_NumberOfThreads, this->GetNumberOfWorkUnits() ) ) ) );
+    threader->SetSingleMethod( Self::ReduceThreaderCallback, this );
+    threader->SingleMethodExecute();
+
+    this->m_ReduceInput = NULL;
+    this->m_ReduceOutput = NULL;
+    return reduced;
+    }
+
+  /** Rows along axis 0, or output lines of the (contiguous) lower axes. */
+  long GetNumberOfWorkUnits() const
+    {
+    const SizeType & size = this->m_ReduceInput->GetBufferedRegion().GetSize();
+    long units = 1;
+    for( unsigned int d = this->m_ReduceAxis + 1; d < ImageDimension; d++ )
+      {
+      units *= static_cast<long>( size[d] );
+      }
+    if( this->m_ReduceAxis > 0 )
+      {
+      units *= static_cast<long>( ( size[this->m_ReduceAxis] + 1 ) / 2 );
+      }
+    return units;
+    }
+
+  void ReduceWorkUnits( long first, long last ) const
+    {
+    const SizeType & size = this->m_ReduceInput->GetBufferedRegion().GetSize();
+    const PixelType *input = this->m_ReduceInput->GetBufferPointer();
+    PixelType *output = this->m_ReduceOutput->GetBufferPointer();
+    const unsigned int axis = this->m_ReduceAxis;
+
+    const long length = static_cast<long>( size[axis] );
+    const long reducedLength = ( length + 1 ) / 2;
+    long inner = 1;
+    for( unsigned int d = 0; d < axis; d++ )
+      {
+      inner *= static_cast<long>( size[d] );
+      }
+
+    if( axis == 0 )
+      {
+      for( long unit = first; unit < last; unit++ )
+        {
+        ReduceRow( input + unit * length, length, output + unit * reducedLength );
+        }
+      return;
+      }
+
+    for( long unit = first; unit < last; unit++ )
+      {
+      const long outer = unit / reducedLength;
+      const long center = 2 * ( unit % reducedLength );
+      const long previous = ( center > 0 ) ? center - 1 : 0;
+      const long next = ( center + 1 < length ) ? center + 1 : length - 1;
+
+      const PixelType *slice = input + outer * length * inner;
+      const PixelType *previousLine = slice + previous * inner;
+      const PixelType *centerLine = slice + center * inner;
+      const PixelType *nextLine = slice + next * inner;
+      PixelType *reducedLine = output + unit * inner;
+      for( long i = 0; i < inner; i++ )
+        {
+        reducedLine[i] = static_cast<PixelType>( 0.25 * ( static_cast<RealType>( previousLine[i] ) +
+          2.0 * static_cast<RealType>( centerLine[i] ) + static_cast<RealType>( nextLine[i] ) ) );
+        }
+      }
+    }
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE ReduceThreaderCallback( void *arg )
+    {
+    MultiThreader::ThreadInfoStruct *info =
+      static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+    const Self *self = static_cast<const Self *>( info->UserData );
+
+    const long units = self->GetNumberOfWorkUnits();
+    const long threads = static_cast<long>( info->NumberOfThreads );
+    const long thread = static_cast<long>( info->ThreadID );
+    self->ReduceWorkUnits( units * thread / threads, units * ( thread + 1 ) / threads );
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+private:
+  AntiAliasedImagePyramid( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  typename ImageType::ConstPointer                  m_Input;
+  typename ImageType::ConstPointer                  m_RowReducedInput;
+  std::vector<typename ImageType::ConstPointer>     m_Levels;
+  unsigned int                                      m_NumberOfLevels;
+  unsigned int                                      m_NumberOfThreads;
+
+  typename ImageType::ConstPointer                  m_ReduceInput;
+  typename ImageType::Pointer                       m_ReduceOutput;
+  unsigned int                                      m_ReduceAxis;
+};
+
+} // end namespace itk
+
+#endif
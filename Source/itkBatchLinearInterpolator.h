@@ -0,0 +1,407 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkBatchLinearInterpolator.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkBatchLinearInterpolator_h
+#define __itkBatchLinearInterpolator_h
+
+#include "itkImage.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+namespace itk
+{
+
+/** \class BatchLinearInterpolator
+ * \brief Linear interpolation of a scalar image at rows of continuous
+ * indices.
+ *
+ * The result is the one of LinearInterpolateImageFunction:  a point is
+ * inside if its continuous index lies in [start - 0.5, end + 0.5) along
+ * each axis and neighbors beyond the buffer are clamped to its border.
+ * Points with a non-finite (e.g. NaN) index are outside, for which
+ * LinearInterpolateImageFunction is undefined.
+ * Instead of one virtual call per point, the indices are given as arrays
+ * (one per axis) and evaluated in one loop without virtual dispatch.
+ *
+ * If compiled for AVX2 (see the USE_AVX2 CMake option), four points are
+ * evaluated at once in double lanes:  the corner voxels are fetched with
+ * gather instructions (float and double pixels) and blended with the
+ * products of the interpolation weights.  Buffers with more than 2^31
+ * voxels, which cannot be addressed with 32-bit gather offsets, and the
+ * remainder of a row are evaluated one point at a time.
+ *
+ * With UseBricks on, the input is copied into bricks of 8^D voxels (each
+ * stored contiguously, the bricks in row-major order) when it is set.
+ * The corners of a point then lie in one or a few bricks, i.e. a few
+ * cache lines and one page, whatever the direction in which the points
+ * move through the input, which keeps rotated and warped traversals in
+ * cache.  The copy costs one pass over the input and its memory.
+ *
+ * \ingroup ImageFunctions
+ */
+template <class TInputImage, class TCoordRep = double>
+class ITK_EXPORT BatchLinearInterpolator : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef BatchLinearInterpolator Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(BatchLinearInterpolator, Object);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TInputImage::ImageDimension);
+
+  typedef TInputImage                           InputImageType;
+  typedef typename InputImageType::PixelType    PixelType;
+  typedef TCoordRep                             CoordRepType;
+
+  /** Edge length of a brick is 2^BrickShift voxels. */
+  itkStaticConstMacro(BrickShift, unsigned int, 3);
+
+  /** Store the input in bricks (see above).  Has to be set before the
+   * input image.  Default is off. */
+  itkSetMacro(UseBricks, bool);
+  itkGetConstMacro(UseBricks, bool);
+  itkBooleanMacro(UseBricks);
+
+  void SetInputImage( const InputImageType *image )
+    {
+    this->m_Image = image;
+    this->m_Buffer = NULL;
+    this->m_Bricks.clear();
+    if( !image )
+      {
+      return;
+      }
+    const typename InputImageType::RegionType & region = image->GetBufferedRegion();
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->m_Start[d] = static_cast<double>( region.GetIndex()[d] );
+      this->m_End[d] = static_cast<double>( region.GetIndex()[d] +
+        static_cast<long>( region.GetSize()[d] ) - 1 );
+      this->m_Stride[d] = static_cast<long>( image->GetOffsetTable()[d] );
+      }
+    this->m_Buffer = image->GetBufferPointer();
+    SizeValueType numberOfStoredPixels = region.GetNumberOfPixels();
+    if( this->m_UseBricks && numberOfStoredPixels > 0 )
+      {
+      this->CopyIntoBricks();
+      numberOfStoredPixels = this->m_Bricks.size();
+      }
+    this->m_UseGather = ( numberOfStoredPixels <=
+      static_cast<SizeValueType>( NumericTraits<int>::max() ) );
+    }
+  const InputImageType * GetInputImage() const
+    {
+    return this->m_Image.GetPointer();
+    }
+
+  /** Interpolate at count points.  cindex[d][n] is the d-th continuous
+   * index of the n-th point.  isInside[n] is set to 0 for points outside
+   * the buffer, whose values are undefined. */
+  void EvaluateRow( const CoordRepType * const cindex[ImageDimension], long count,
+    double *values, unsigned char *isInside ) const
+    {
+    long n = 0;
+#if defined( __AVX2__ )
+    if( this->m_UseGather )
+      {
+      for( ; n + 4 <= count; n += 4 )
+        {
+        this->EvaluateFour( cindex, n, values + n, isInside + n );
+        }
+      }
+#endif
+    for( ; n < count; n++ )
+      {
+      isInside[n] = this->EvaluateOne( cindex, n, values[n] ) ? 1 : 0;
+      }
+    }
+
+protected:
+  BatchLinearInterpolator() : m_Buffer( NULL ),
+    m_UseGather( false ),
+    m_UseBricks( false )
+    {
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->m_Start[d] = 0.0;
+      this->m_End[d] = -1.0;
+      this->m_Stride[d] = 0;
+      this->m_BrickStride[d] = 0;
+      }
+    }
+  ~BatchLinearInterpolator() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "InputImage: " << this->m_Image.GetPointer() << std::endl;
+    os << indent << "UseGather: " << this->m_UseGather << std::endl;
+    os << indent << "UseBricks: " << this->m_UseBricks << std::endl;
+    }
+
+  /** Offset of buffer position x along dimension d in the stored layout
+   * (row-major or bricked). */
+  inline long GetAxisOffset( unsigned int d, long x ) const
+    {
+    if( this->m_UseBricks )
+      {
+      return ( x >> BrickShift ) * this->m_BrickStride[d] +
+        ( ( x & ( ( 1L << BrickShift ) - 1 ) ) << ( BrickShift * d ) );
+      }
+    return x * this->m_Stride[d];
+    }
+
+  /** Copy the input into bricks; rows along dimension 0 are distributed
+   * over the threads. */
+  void CopyIntoBricks()
+    {
+    const typename InputImageType::RegionType & region = this->m_Image->GetBufferedRegion();
+    this->m_BrickStride[0] = 1L << ( BrickShift * ImageDimension );
+    for( unsigned int d = 1; d < ImageDimension; d++ )
+      {
+      const long gridSize = ( static_cast<long>( region.GetSize()[d - 1] ) +
+        ( 1L << BrickShift ) - 1 ) >> BrickShift;
+      this->m_BrickStride[d] = this->m_BrickStride[d - 1] * gridSize;
+      }
+    const long lastGridSize = ( static_cast<long>( region.GetSize()[ImageDimension - 1] ) +
+      ( 1L << BrickShift ) - 1 ) >> BrickShift;
+    this->m_Bricks.assign( this->m_BrickStride[ImageDimension - 1] * lastGridSize,
+      NumericTraits<PixelType>::Zero );
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads( static_cast<int>( std::max<SizeValueType>( 1, std::min<SizeValueType>(
+      MultiThreader::GetGlobalDefaultNumberOfThreads(), region.GetNumberOfPixels() / region.GetSize()[0] ) ) ) );
+    threader->SetSingleMethod( Self::CopyThreaderCallback, this );
+    threader->SingleMethodExecute();
+    this->m_Buffer = &this->m_Bricks[0];
+    }
+
+  void CopyRows( SizeValueType first, SizeValueType last )
+    {
+    const typename InputImageType::RegionType & region = this->m_Image->GetBufferedRegion();
+    const PixelType *buffer = this->m_Image->GetBufferPointer();
+    const long rowLength = static_cast<long>( region.GetSize()[0] );
+    for( SizeValueType row = first; row < last; row++ )
+      {
+      long offset = 0;
+      SizeValueType remainder = row;
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        offset += this->GetAxisOffset( d, static_cast<long>( remainder % region.GetSize()[d] ) );
+        remainder /= region.GetSize()[d];
+        }
+      const PixelType *source = buffer + row * rowLength;
+      PixelType *bricks = &this->m_Bricks[offset];
+      for( long x = 0; x < rowLength; x++ )
+        {
+        bricks[this->GetAxisOffset( 0, x )] = source[x];
+        }
+      }
+    }
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE CopyThreaderCallback( void *arg )
+    {
+    MultiThreader::ThreadInfoStruct *info =
+      static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+    Self *self = static_cast<Self *>( info->UserData );
+
+    const typename InputImageType::RegionType & region = self->m_Image->GetBufferedRegion();
+    const SizeValueType rows = region.GetNumberOfPixels() / region.GetSize()[0];
+    const SizeValueType threads = static_cast<SizeValueType>( info->NumberOfThreads );
+    const SizeValueType thread = static_cast<SizeValueType>( info->ThreadID );
+    self->CopyRows( rows * thread / threads, rows * ( thread + 1 ) / threads );
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  bool EvaluateOne( const CoordRepType * const cindex[ImageDimension], long n, double & value ) const
+    {
+    long lower[ImageDimension];
+    long upper[ImageDimension];
+    double fraction[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const double c = static_cast<double>( cindex[d][n] );
+      if( !( c >= this->m_Start[d] - 0.5 && c < this->m_End[d] + 0.5 ) )
+        {
+        return false;
+        }
+      const double base = std::floor( c );
+      fraction[d] = c - base;
+      lower[d] = this->GetAxisOffset( d,
+        static_cast<long>( std::max( base, this->m_Start[d] ) - this->m_Start[d] ) );
+      upper[d] = this->GetAxisOffset( d,
+        static_cast<long>( std::min( base + 1.0, this->m_End[d] ) - this->m_Start[d] ) );
+      }
+
+    value = 0.0;
+    for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+      {
+      double weight = 1.0;
+      long offset = 0;
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        if( corner & ( 1u << d ) )
+          {
+          weight *= fraction[d];
+          offset += upper[d];
+          }
+        else
+          {
+          weight *= 1.0 - fraction[d];
+          offset += lower[d];
+          }
+        }
+      value += weight * static_cast<double>( this->m_Buffer[offset] );
+      }
+    return true;
+    }
+
+#if defined( __AVX2__ )
+  static __m256d LoadFour( const double *p )
+    {
+    return _mm256_loadu_pd( p );
+    }
+  static __m256d LoadFour( const float *p )
+    {
+    return _mm256_cvtps_pd( _mm_loadu_ps( p ) );
+    }
+
+  static __m256d GatherFour( const double *buffer, __m128i offsets )
+    {
+    return _mm256_i32gather_pd( buffer, offsets, 8 );
+    }
+  static __m256d GatherFour( const float *buffer, __m128i offsets )
+    {
+    return _mm256_cvtps_pd( _mm_i32gather_ps( buffer, offsets, 4 ) );
+    }
+  template <class TPixel>
+  static __m256d GatherFour( const TPixel *buffer, __m128i offsets )
+    {
+    int o[4];
+    _mm_storeu_si128( reinterpret_cast<__m128i *>( o ), offsets );
+    return _mm256_set_pd( static_cast<double>( buffer[o[3]] ), static_cast<double>( buffer[o[2]] ),
+      static_cast<double>( buffer[o[1]] ), static_cast<double>( buffer[o[0]] ) );
+    }
+
+  /** GetAxisOffset() of four buffer positions. */
+  inline __m128i GetAxisOffsetFour( unsigned int d, __m128i x ) const
+    {
+    if( this->m_UseBricks )
+      {
+      const __m128i brick = _mm_mullo_epi32( _mm_srli_epi32( x, BrickShift ),
+        _mm_set1_epi32( static_cast<int>( this->m_BrickStride[d] ) ) );
+      const __m128i within = _mm_sll_epi32( _mm_and_si128( x, _mm_set1_epi32( ( 1 << BrickShift ) - 1 ) ),
+        _mm_cvtsi32_si128( static_cast<int>( BrickShift * d ) ) );
+      return _mm_add_epi32( brick, within );
+      }
+    return _mm_mullo_epi32( x, _mm_set1_epi32( static_cast<int>( this->m_Stride[d] ) ) );
+    }
+
+  void EvaluateFour( const CoordRepType * const cindex[ImageDimension], long n,
+    double *values, unsigned char *isInside ) const
+    {
+    const __m256d one = _mm256_set1_pd( 1.0 );
+    const __m256d half = _mm256_set1_pd( 0.5 );
+
+    __m128i lower[ImageDimension];
+    __m128i upper[ImageDimension];
+    __m256d fraction[ImageDimension];
+    __m256d inside = _mm256_castsi256_pd( _mm256_set1_epi64x( -1 ) );
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      const __m256d start = _mm256_set1_pd( this->m_Start[d] );
+      const __m256d end = _mm256_set1_pd( this->m_End[d] );
+      const __m256d c = LoadFour( cindex[d] + n );
+      inside = _mm256_and_pd( inside, _mm256_cmp_pd( c, _mm256_sub_pd( start, half ), _CMP_GE_OQ ) );
+      inside = _mm256_and_pd( inside, _mm256_cmp_pd( c, _mm256_add_pd( end, half ), _CMP_LT_OQ ) );
+
+      // Clamping also keeps the offsets of outside (and NaN) points inside
+      // the buffer:  max/min return the second operand for NaN.
+      const __m256d base = _mm256_floor_pd( c );
+      fraction[d] = _mm256_sub_pd( c, base );
+      const __m256d lowerIndex = _mm256_min_pd( _mm256_max_pd( base, start ), end );
+      const __m256d upperIndex = _mm256_min_pd( _mm256_max_pd( _mm256_add_pd( base, one ), start ), end );
+      lower[d] = this->GetAxisOffsetFour( d, _mm256_cvtpd_epi32( _mm256_sub_pd( lowerIndex, start ) ) );
+      upper[d] = this->GetAxisOffsetFour( d, _mm256_cvtpd_epi32( _mm256_sub_pd( upperIndex, start ) ) );
+      }
+
+    __m256d value = _mm256_setzero_pd();
+    for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+      {
+      __m256d weight = one;
+      __m128i offset = _mm_setzero_si128();
+      for( unsigned int d = 0; d < ImageDimension; d++ )
+        {
+        if( corner & ( 1u << d ) )
+          {
+          weight = _mm256_mul_pd( weight, fraction[d] );
+          offset = _mm_add_epi32( offset, upper[d] );
+          }
+        else
+          {
+          weight = _mm256_mul_pd( weight, _mm256_sub_pd( one, fraction[d] ) );
+          offset = _mm_add_epi32( offset, lower[d] );
+          }
+        }
+      value = _mm256_add_pd( value, _mm256_mul_pd( weight, GatherFour( this->m_Buffer, offset ) ) );
+      }
+    _mm256_storeu_pd( values, value );
+
+    const int mask = _mm256_movemask_pd( inside );
+    for( unsigned int k = 0; k < 4; k++ )
+      {
+      isInside[k] = ( mask >> k ) & 1;
+      }
+    }
+#endif
+
+private:
+  BatchLinearInterpolator( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  typename InputImageType::ConstPointer             m_Image;
+  const PixelType                                   *m_Buffer;
+  double                                            m_Start[ImageDimension];
+  double                                            m_End[ImageDimension];
+  long                                              m_Stride[ImageDimension];
+  bool                                              m_UseGather;
+  bool                                              m_UseBricks;
+  std::vector<PixelType>                            m_Bricks;
+  long                                              m_BrickStride[ImageDimension];
+};
+
+} // end namespace itk
+
+#endif
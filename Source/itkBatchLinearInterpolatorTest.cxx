@@ -0,0 +1,228 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkBatchLinearInterpolatorTest.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+/**
+ * Checks itk::BatchLinearInterpolator against LinearInterpolateImageFunction
+ * for float, double and short images with and without bricks.  The points
+ * are random (in and around the buffer) plus the borders of the inside
+ * interval [start - 0.5, end + 0.5) and points just beyond them, integer
+ * indices, and non-finite indices (which are outside).  Each row is
+ * evaluated as a whole (four points at a time if compiled for AVX2) and
+ * point by point (the scalar path).
+ */
+
+#include "itkBatchLinearInterpolator.h"
+#include "itkImage.h"
+#include "itkImageRegionIterator.h"
+#include "itkLinearInterpolateImageFunction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+const unsigned int Dimension = 3;
+
+double RandomNumber( double lower, double upper )
+{
+  return lower + ( upper - lower ) * std::rand() / static_cast<double>( RAND_MAX );
+}
+
+template<class TPixel>
+int TestBatchLinearInterpolator( const char *pixelTypeName, bool useBricks )
+{
+  typedef itk::Image<TPixel, Dimension>                             ImageType;
+  typedef itk::BatchLinearInterpolator<ImageType, double>           BatchInterpolatorType;
+  typedef itk::LinearInterpolateImageFunction<ImageType, double>    InterpolatorType;
+  typedef typename InterpolatorType::ContinuousIndexType            ContinuousIndexType;
+
+  // Odd sizes, such that the bricks at the upper borders are partial.
+  typename ImageType::RegionType region;
+  const long start[Dimension] = { 2, -1, 0 };
+  const unsigned long size[Dimension] = { 17, 9, 12 };
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    region.SetIndex( d, start[d] );
+    region.SetSize( d, size[d] );
+    }
+  typename ImageType::Pointer image = ImageType::New();
+  image->SetRegions( region );
+  image->Allocate();
+  itk::ImageRegionIterator<ImageType> It( image, region );
+  for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+    {
+    It.Set( static_cast<TPixel>( RandomNumber( -1000.0, 1000.0 ) ) );
+    }
+
+  typename InterpolatorType::Pointer interpolator = InterpolatorType::New();
+  interpolator->SetInputImage( image );
+  typename BatchInterpolatorType::Pointer batchInterpolator = BatchInterpolatorType::New();
+  batchInterpolator->SetUseBricks( useBricks );
+  batchInterpolator->SetInputImage( image );
+
+  // Random points around the buffer.
+  std::vector<double> cindex[Dimension];
+  for( unsigned int n = 0; n < 2001; n++ )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      cindex[d].push_back( RandomNumber( start[d] - 2.0, start[d] + static_cast<double>( size[d] ) + 1.0 ) );
+      }
+    }
+
+  // Borders of the inside interval, just beyond them, and integer indices
+  // along each axis.
+  std::vector<double> axisValues[Dimension];
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    const double lower = start[d] - 0.5;
+    const double upper = start[d] + static_cast<double>( size[d] ) - 0.5;
+    axisValues[d].push_back( lower );
+    axisValues[d].push_back( lower - 1e-9 );
+    axisValues[d].push_back( lower + 1e-9 );
+    axisValues[d].push_back( upper );
+    axisValues[d].push_back( upper - 1e-9 );
+    axisValues[d].push_back( upper + 1e-9 );
+    axisValues[d].push_back( start[d] );
+    axisValues[d].push_back( start[d] + static_cast<double>( size[d] ) - 1.0 );
+    axisValues[d].push_back( 0.5 * ( lower + upper ) );
+    }
+  for( unsigned int i = 0; i < axisValues[0].size(); i++ )
+    {
+    for( unsigned int j = 0; j < axisValues[1].size(); j++ )
+      {
+      for( unsigned int k = 0; k < axisValues[2].size(); k++ )
+        {
+        cindex[0].push_back( axisValues[0][i] );
+        cindex[1].push_back( axisValues[1][j] );
+        cindex[2].push_back( axisValues[2][k] );
+        }
+      }
+    }
+
+  // Non-finite indices along each axis.
+  const double nonFinite[3] = { std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+  const unsigned int firstNonFinite = cindex[0].size();
+  for( unsigned int i = 0; i < 3; i++ )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      for( unsigned int e = 0; e < Dimension; e++ )
+        {
+        cindex[e].push_back( ( e == d ) ? nonFinite[i] : start[e] + 1.0 );
+        }
+      }
+    }
+
+  const long count = static_cast<long>( cindex[0].size() );
+  const double *indices[Dimension];
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    indices[d] = &cindex[d][0];
+    }
+  std::vector<double> rowValues( count );
+  std::vector<unsigned char> rowIsInside( count );
+  batchInterpolator->EvaluateRow( indices, count, &rowValues[0], &rowIsInside[0] );
+
+  unsigned int numberOfErrors = 0;
+  unsigned int numberOfInsidePoints = 0;
+  for( long n = 0; n < count; n++ )
+    {
+    // One point at a time.
+    const double *pointIndices[Dimension];
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      pointIndices[d] = indices[d] + n;
+      }
+    double pointValue = 0.0;
+    unsigned char pointIsInside = 0;
+    batchInterpolator->EvaluateRow( pointIndices, 1, &pointValue, &pointIsInside );
+
+    bool expectedIsInside = false;
+    double expectedValue = 0.0;
+    if( n < static_cast<long>( firstNonFinite ) )
+      {
+      ContinuousIndexType index;
+      for( unsigned int d = 0; d < Dimension; d++ )
+        {
+        index[d] = cindex[d][n];
+        }
+      expectedIsInside = interpolator->IsInsideBuffer( index );
+      if( expectedIsInside )
+        {
+        expectedValue = interpolator->EvaluateAtContinuousIndex( index );
+        }
+      }
+
+    const double tolerance = 1e-9 * std::max( 1.0, std::fabs( expectedValue ) );
+    bool isCorrect = ( static_cast<bool>( rowIsInside[n] ) == expectedIsInside &&
+      static_cast<bool>( pointIsInside ) == expectedIsInside );
+    if( isCorrect && expectedIsInside )
+      {
+      numberOfInsidePoints++;
+      isCorrect = ( std::fabs( rowValues[n] - expectedValue ) <= tolerance &&
+        std::fabs( pointValue - expectedValue ) <= tolerance );
+      }
+    if( !isCorrect )
+      {
+      if( numberOfErrors < 10 )
+        {
+        std::cerr << "  at [" << cindex[0][n] << ", " << cindex[1][n] << ", " << cindex[2][n]
+          << "]:  expected " << ( expectedIsInside ? "inside" : "outside" ) << " " << expectedValue
+          << ", row " << static_cast<int>( rowIsInside[n] ) << " " << rowValues[n]
+          << ", point " << static_cast<int>( pointIsInside ) << " " << pointValue << std::endl;
+        }
+      numberOfErrors++;
+      }
+    }
+
+  std::cout << pixelTypeName << ( useBricks ? ", bricks" : "" ) << ":  " << count
+    << " points, " << numberOfInsidePoints << " inside, " << numberOfErrors << " errors" << std::endl;
+  return ( numberOfErrors == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // end namespace
+
+int main( int, char * [] )
+{
+  std::srand( 1 );
+
+  int status = EXIT_SUCCESS;
+  for( unsigned int bricks = 0; bricks < 2; bricks++ )
+    {
+    if( TestBatchLinearInterpolator<float>( "float", bricks ) != EXIT_SUCCESS )
+      {
+      status = EXIT_FAILURE;
+      }
+    if( TestBatchLinearInterpolator<double>( "double", bricks ) != EXIT_SUCCESS )
+      {
+      status = EXIT_FAILURE;
+      }
+    if( TestBatchLinearInterpolator<short>( "short", bricks ) != EXIT_SUCCESS )
+      {
+      status = EXIT_FAILURE;
+      }
+    }
+  return status;
+}
@@ -0,0 +1,431 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkCachedBSplineInterpolateImageFunction.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkCachedBSplineInterpolateImageFunction_h
+#define __itkCachedBSplineInterpolateImageFunction_h
+
+#include "antsMemoryMappedFile.h"
+#include "itkMemoryMappedImageFileReader.h"
+
+#include "itkBSplineDecompositionImageFilter.h"
+#include "itkBSplineInterpolateImageFunction.h"
+#include "itkImageFileWriter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkSeparableKernelInterpolator.h"
+#include "itkSimpleFastMutexLock.h"
+#include "itksys/SystemTools.hxx"
+#include "vnl/vnl_math.h"
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace itk
+{
+
+/** \class CachedBSplineInterpolateImageFunction
+ * \brief B-spline interpolation with reusable coefficient images.
+ *
+ * The coefficients are computed by the recursive decomposition in double
+ * precision and stored as TCoefficientType (float by default).  They are
+ * looked up, in this order, in
+ *
+ * - a process wide registry keyed by a hash of the input voxels and
+ *   geometry and the spline order, such that interpolators of the same
+ *   image (e.g. one per input of a batch) share a single buffer.  Entries
+ *   which are only referenced by the registry are dropped on the next
+ *   lookup of another image,
+ *
+ * - the coefficient file given by SetCoefficientFileName(), e.g. stored
+ *   next to the input image.  The file is only used if its geometry
+ *   matches the input, otherwise it is recomputed and overwritten,
+ *
+ * - the cache directory given by SetCacheDirectory(), in which the
+ *   coefficients are stored as <hash>_bspline<order>.mha,
+ *
+ * and only computed if none of these exist.  Coefficient files are
+ * memory mapped when read.  The spline order has to be set before the
+ * input image.
+ *
+ * The B-spline weights and mirrored neighbors along each dimension are
+ * available through the SeparableKernelInterpolator interface, whose
+ * samples are the coefficients.
+ *
+ * \ingroup ImageFunctions ImageInterpolators
+ */
+template <class TImageType, class TCoordRep = double, class TCoefficientType = float>
+class ITK_EXPORT CachedBSplineInterpolateImageFunction :
+  public BSplineInterpolateImageFunction<TImageType, TCoordRep, TCoefficientType>,
+  public SeparableKernelInterpolator<typename BSplineInterpolateImageFunction<
+    TImageType, TCoordRep, TCoefficientType>::CoefficientImageType>
+{
+public:
+  /** Standard class typedefs. */
+  typedef CachedBSplineInterpolateImageFunction Self;
+  typedef BSplineInterpolateImageFunction<TImageType, TCoordRep, TCoefficientType> Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(CachedBSplineInterpolateImageFunction, BSplineInterpolateImageFunction);
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Dimension underlying input image. */
+  itkStaticConstMacro(ImageDimension, unsigned int, Superclass::ImageDimension);
+
+  typedef TImageType                                      InputImageType;
+  typedef typename Superclass::CoefficientImageType       CoefficientImageType;
+  typedef Image<double, itkGetStaticConstMacro(ImageDimension)> DecompositionImageType;
+  typedef BSplineDecompositionImageFilter<TImageType, DecompositionImageType>
+                                                          DecompositionFilterType;
+
+  typedef std::map<std::string, typename CoefficientImageType::ConstPointer>
+                                                          RegistryType;
+
+  /** File in which the coefficients are stored.  Empty by default. */
+  itkSetStringMacro(CoefficientFileName);
+  itkGetStringMacro(CoefficientFileName);
+
+  /** Directory in which coefficients are stored by content hash.  Empty by
+   * default. */
+  itkSetStringMacro(CacheDirectory);
+  itkGetStringMacro(CacheDirectory);
+
+  /** Share the coefficients through the process wide registry.  Default
+   * is on. */
+  itkSetMacro(ShareCoefficients, bool);
+  itkGetConstMacro(ShareCoefficients, bool);
+  itkBooleanMacro(ShareCoefficients);
+
+  /** True if the coefficients of the last input were not computed. */
+  itkGetConstMacro(IsCached, bool);
+
+  virtual void SetInputImage( const TImageType *inputData )
+    {
+    this->m_IsCached = false;
+    if( !inputData )
+      {
+      this->Superclass::SetInputImage( inputData );
+      return;
+      }
+
+    const std::string key = this->ComputeKey( inputData );
+
+    typename CoefficientImageType::ConstPointer coefficients;
+    if( this->m_ShareCoefficients )
+      {
+      GetRegistryLock().Lock();
+
+      // Coefficients of other images which are only referenced by the
+      // registry are no longer shared.
+      RegistryType & registry = GetRegistry();
+      for( typename RegistryType::iterator it = registry.begin(); it != registry.end(); )
+        {
+        if( it->first != key && it->second->GetReferenceCount() <= 1 )
+          {
+          registry.erase( it++ );
+          }
+        else
+          {
+          ++it;
+          }
+        }
+
+      typename RegistryType::const_iterator it = registry.find( key );
+      if( it != registry.end() )
+        {
+        coefficients = it->second;
+        }
+      GetRegistryLock().Unlock();
+      }
+
+    std::string cachedFileName( "" );
+    if( !this->m_CacheDirectory.empty() )
+      {
+      cachedFileName = this->m_CacheDirectory + std::string( "/" ) + key + std::string( ".mha" );
+      }
+
+    if( coefficients.IsNull() )
+      {
+      coefficients = this->ReadCoefficients( this->m_CoefficientFileName, inputData );
+      }
+    if( coefficients.IsNull() )
+      {
+      coefficients = this->ReadCoefficients( cachedFileName, inputData );
+      if( coefficients.IsNotNull() && !this->m_CoefficientFileName.empty() )
+        {
+        this->WriteCoefficients( coefficients, this->m_CoefficientFileName );
+        }
+      }
+
+    if( coefficients.IsNull() )
+      {
+      coefficients = this->ComputeCoefficients( inputData );
+      this->WriteCoefficients( coefficients, this->m_CoefficientFileName );
+      this->WriteCoefficients( coefficients, cachedFileName );
+      }
+    else
+      {
+      this->m_IsCached = true;
+      }
+
+    if( this->m_ShareCoefficients )
+      {
+      GetRegistryLock().Lock();
+      GetRegistry()[key] = coefficients;
+      GetRegistryLock().Unlock();
+      }
+
+    // Bypass the decomposition of the superclass.
+    this->m_Coefficients = coefficients;
+    this->InterpolateImageFunction<TImageType, TCoordRep>::SetInputImage( inputData );
+    this->m_DataLength = inputData->GetBufferedRegion().GetSize();
+    }
+
+  /** SeparableKernelInterpolator interface:  the samples are the
+   * coefficients. */
+  virtual const CoefficientImageType * GetSeparableKernelSamples() const
+    {
+    return this->m_Coefficients.GetPointer();
+    }
+
+  virtual unsigned int GetSeparableKernelWidth( unsigned int ) const
+    {
+    return this->GetSplineOrder() + 1;
+    }
+
+  /** Same support and mirror boundary conditions as the superclass; the
+   * weights are the centred B-spline of the spline order. */
+  virtual void ComputeSeparableKernel( unsigned int d, double cindex,
+    long *neighbors, double *weights ) const
+    {
+    const unsigned int splineOrder = this->GetSplineOrder();
+    const double halfOffset = ( splineOrder & 1 ) ? 0.0 : 0.5;
+    const long first = static_cast<long>( vcl_floor( cindex + halfOffset ) ) -
+      static_cast<long>( splineOrder / 2 );
+    const long dataLength = static_cast<long>( this->m_DataLength[d] );
+    const long dataLength2 = 2 * dataLength - 2;
+    for( unsigned int k = 0; k <= splineOrder; k++ )
+      {
+      const long index = first + static_cast<long>( k );
+      weights[k] = EvaluateBSpline( splineOrder, cindex - static_cast<double>( index ) );
+
+      long neighbor = 0;
+      if( dataLength > 1 )
+        {
+        neighbor = ( index < 0 ) ? -index - dataLength2 * ( ( -index ) / dataLength2 ) :
+          index - dataLength2 * ( index / dataLength2 );
+        if( neighbor >= dataLength )
+          {
+          neighbor = dataLength2 - neighbor;
+          }
+        }
+      neighbors[k] = neighbor;
+      }
+    }
+
+  /** Centred B-spline of the given order:  1 / n! sum_j ( -1 )^j
+   * ( n + 1 choose j ) ( x + ( n + 1 ) / 2 - j )_+^n. */
+  static double EvaluateBSpline( unsigned int order, double x )
+    {
+    double sum = 0.0;
+    double binomial = 1.0;
+    double factorial = 1.0;
+    for( unsigned int j = 0; j <= order + 1; j++ )
+      {
+      const double t = x + 0.5 * static_cast<double>( order + 1 ) - static_cast<double>( j );
+      if( t >= 0.0 )
+        {
+        sum += ( ( j & 1 ) ? -binomial : binomial ) * vcl_pow( t, static_cast<double>( order ) );
+        }
+      binomial *= static_cast<double>( order + 1 - j ) / static_cast<double>( j + 1 );
+      }
+    for( unsigned int n = 2; n <= order; n++ )
+      {
+      factorial *= static_cast<double>( n );
+      }
+    return sum / factorial;
+    }
+
+  /** Release all coefficient images held by the registry. */
+  static void ReleaseSharedCoefficients()
+    {
+    GetRegistryLock().Lock();
+    GetRegistry().clear();
+    GetRegistryLock().Unlock();
+    }
+
+protected:
+  CachedBSplineInterpolateImageFunction() : m_ShareCoefficients( true ),
+    m_IsCached( false ) {}
+  ~CachedBSplineInterpolateImageFunction() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "CoefficientFileName: " << this->m_CoefficientFileName << std::endl;
+    os << indent << "CacheDirectory: " << this->m_CacheDirectory << std::endl;
+    os << indent << "ShareCoefficients: " << this->m_ShareCoefficients << std::endl;
+    }
+
+  static RegistryType & GetRegistry()
+    {
+    static RegistryType registry;
+    return registry;
+    }
+  static SimpleFastMutexLock & GetRegistryLock()
+    {
+    static SimpleFastMutexLock lock;
+    return lock;
+    }
+
+  /** Hash of the voxels and geometry of the image followed by the spline
+   * order and the coefficient type. */
+  std::string ComputeKey( const TImageType *image ) const
+    {
+    const std::size_t numberOfBytes = image->GetPixelContainer()->Size() *
+      sizeof( typename TImageType::PixelType );
+
+    std::ostringstream oss;
+    oss << ants::MemoryMappedFile::ComputeContentHash(
+      reinterpret_cast<const char *>( image->GetBufferPointer() ), numberOfBytes );
+    oss.precision( 17 );
+    oss << image->GetBufferedRegion() << image->GetSpacing() << image->GetOrigin()
+        << image->GetDirection();
+    const std::string description = oss.str();
+
+    std::ostringstream key;
+    key << ants::MemoryMappedFile::ComputeContentHash( description.c_str(), description.length() )
+        << "_bspline" << this->GetSplineOrder() << "_" << sizeof( TCoefficientType );
+    return key.str();
+    }
+
+  typename CoefficientImageType::ConstPointer ComputeCoefficients( const TImageType *inputData ) const
+    {
+    typename DecompositionFilterType::Pointer decomposition = DecompositionFilterType::New();
+    decomposition->SetSplineOrder( this->GetSplineOrder() );
+    decomposition->SetInput( inputData );
+    decomposition->Update();
+
+    typename CoefficientImageType::Pointer coefficients = CoefficientImageType::New();
+    coefficients->CopyInformation( decomposition->GetOutput() );
+    coefficients->SetRegions( decomposition->GetOutput()->GetBufferedRegion() );
+    coefficients->Allocate();
+
+    ImageRegionConstIterator<DecompositionImageType> It( decomposition->GetOutput(),
+      decomposition->GetOutput()->GetBufferedRegion() );
+    ImageRegionIterator<CoefficientImageType> ItC( coefficients,
+      coefficients->GetBufferedRegion() );
+    for( It.GoToBegin(), ItC.GoToBegin(); !It.IsAtEnd(); ++It, ++ItC )
+      {
+      ItC.Set( static_cast<TCoefficientType>( It.Get() ) );
+      }
+    return coefficients.GetPointer();
+    }
+
+  /** Returns NULL if the file does not exist or does not match the input. */
+  typename CoefficientImageType::ConstPointer ReadCoefficients( const std::string & filename,
+    const TImageType *inputData ) const
+    {
+    if( filename.empty() || !ants::MemoryMappedFile::FileExists( filename ) )
+      {
+      return NULL;
+      }
+
+    typedef MemoryMappedImageFileReader<CoefficientImageType> ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( filename );
+    try
+      {
+      reader->Update();
+      }
+    catch( ExceptionObject & )
+      {
+      return NULL;
+      }
+
+    const CoefficientImageType *coefficients = reader->GetOutput();
+    const double tolerance = 1e-6;
+    if( coefficients->GetBufferedRegion().GetSize() != inputData->GetBufferedRegion().GetSize() )
+      {
+      return NULL;
+      }
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      if( vnl_math_abs( coefficients->GetSpacing()[d] - inputData->GetSpacing()[d] ) > tolerance ||
+        vnl_math_abs( coefficients->GetOrigin()[d] - inputData->GetOrigin()[d] ) > tolerance )
+        {
+        return NULL;
+        }
+      }
+    return coefficients;
+    }
+
+  /** Write through a temporary file such that concurrent readers never see
+   * a partial file.  Failures are not fatal. */
+  void WriteCoefficients( const CoefficientImageType *coefficients, const std::string & filename ) const
+    {
+    if( filename.empty() )
+      {
+      return;
+      }
+
+    std::ostringstream tmp;
+    std::string path = itksys::SystemTools::GetFilenamePath( filename );
+    if( !path.empty() )
+      {
+      tmp << path << "/";
+      }
+    tmp << ".tmp_" << this << "_" << itksys::SystemTools::GetFilenameName( filename );
+    const std::string temporaryFileName = tmp.str();
+
+    typedef ImageFileWriter<CoefficientImageType> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( coefficients );
+    writer->SetFileName( temporaryFileName.c_str() );
+    writer->UseCompressionOff();
+    try
+      {
+      writer->Update();
+      }
+    catch( ExceptionObject & )
+      {
+      std::remove( temporaryFileName.c_str() );
+      return;
+      }
+    if( !ants::MemoryMappedFile::RenameFile( temporaryFileName, filename ) )
+      {
+      std::remove( temporaryFileName.c_str() );
+      }
+    }
+
+private:
+  CachedBSplineInterpolateImageFunction( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::string                                       m_CoefficientFileName;
+  std::string                                       m_CacheDirectory;
+  bool                                              m_ShareCoefficients;
+  bool                                              m_IsCached;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,774 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkCompositeTransformPointMapper.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkCompositeTransformPointMapper_h
+#define __itkCompositeTransformPointMapper_h
+
+#include "itkCompositeTransform.h"
+#include "itkDisplacementFieldPlanes.h"
+#include "itkDisplacementFieldTransform.h"
+#include "itkIdentityTransform.h"
+#include "itkMatrixOffsetTransformBase.h"
+#include "itkMultiThreader.h"
+#include "itkTranslationTransform.h"
+
+#include "vnl/algo/vnl_determinant.h"
+#include "vnl/algo/vnl_matrix_inverse.h"
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class CompositeTransformPointMapper
+ * \brief Map large numbers of points through a composite transform.
+ *
+ * The composite is decomposed once into a list of stages which are then
+ * applied chunk by chunk to points stored as separate coordinate arrays
+ * (structure of arrays).  Identity transforms are dropped, matrix/offset
+ * and translation transforms are applied as a plain matrix product over
+ * the chunk, and displacement fields are interpolated linearly with loops
+ * over the compile-time dimension.  Other transforms fall back to
+ * TransformPoint().
+ *
+ * The components of each displacement field are read from one plane per
+ * component in the value type of the field (see DisplacementFieldPlanes),
+ * which is built once per field and shared by all mappers the field is
+ * set on.  A corner of the interpolation is then the same offset in each
+ * plane, and the components are accumulated in lanes sharing the weight.
+ * The chunks are distributed over the threads of an itk::MultiThreader.
+ *
+ * Consecutive matrix stages are composed into one.  The common chain
+ * shapes of a single displacement field, optionally preceded and/or
+ * followed by an affine map (e.g. [affine, field, affine] as written by
+ * antsRegistration), are recognized and mapped by a loop instantiated for
+ * the shape, which applies all stages to a point before moving to the
+ * next one.  Other chains are mapped stage by stage over the chunk.
+ *
+ * The result is identical to CompositeTransform::TransformPoint(), i.e.
+ * the transform added last is applied first and points outside a
+ * displacement field are not displaced by it.
+ *
+ * The stages also give a bound of the points which can be mapped into a
+ * box (see ComputePreimageBoundingBox()).
+ *
+ * \ingroup Transforms
+ */
+template <class TScalarType, unsigned int NDimensions>
+class ITK_EXPORT CompositeTransformPointMapper : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef CompositeTransformPointMapper Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(CompositeTransformPointMapper, Object);
+
+  itkStaticConstMacro(Dimension, unsigned int, NDimensions);
+
+  typedef TScalarType                                        ScalarType;
+  typedef CompositeTransform<ScalarType, NDimensions>        CompositeTransformType;
+  typedef Transform<ScalarType, NDimensions, NDimensions>    TransformType;
+  typedef typename TransformType::InputPointType             PointType;
+  typedef MatrixOffsetTransformBase<ScalarType, NDimensions, NDimensions>
+                                                             MatrixOffsetTransformType;
+  typedef TranslationTransform<ScalarType, NDimensions>      TranslationTransformType;
+  typedef IdentityTransform<ScalarType, NDimensions>         IdentityTransformType;
+  typedef DisplacementFieldTransform<ScalarType, NDimensions>
+                                                             DisplacementFieldTransformType;
+  typedef typename DisplacementFieldTransformType::DisplacementFieldType
+                                                             DisplacementFieldType;
+  typedef typename DisplacementFieldType::PixelType          DisplacementVectorType;
+  typedef DisplacementFieldPlanes<DisplacementFieldType>     FieldPlanesType;
+  typedef typename FieldPlanesType::ValueType                FieldValueType;
+
+  /** Axis aligned box of physical points. */
+  struct BoundingBoxType
+    {
+    double m_Lower[NDimensions];
+    double m_Upper[NDimensions];
+    };
+
+  /** Set the composite and decompose it into stages.  The planes of the
+   * displacement fields which are not shared yet are built with
+   * NumberOfThreads threads. */
+  void SetTransform( const CompositeTransformType *transform )
+    {
+    this->m_Transform = transform;
+    this->m_Stages.clear();
+    this->m_ChainShape = GenericChain;
+    if( !transform )
+      {
+      return;
+      }
+
+    // The last transform added to the composite is applied first.
+    for( long n = static_cast<long>( transform->GetNumberOfTransforms() ) - 1; n >= 0; n-- )
+      {
+      const TransformType *nthTransform = transform->GetNthTransform( n ).GetPointer();
+
+      StageType stage;
+      stage.m_Transform = nthTransform;
+
+      if( dynamic_cast<const IdentityTransformType *>( nthTransform ) )
+        {
+        continue;
+        }
+      else if( const MatrixOffsetTransformType *matrixTransform =
+        dynamic_cast<const MatrixOffsetTransformType *>( nthTransform ) )
+        {
+        stage.m_Type = MatrixStage;
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          for( unsigned int j = 0; j < NDimensions; j++ )
+            {
+            stage.m_Matrix[i][j] = matrixTransform->GetMatrix()[i][j];
+            }
+          stage.m_Offset[i] = matrixTransform->GetOffset()[i];
+          }
+        }
+      else if( const TranslationTransformType *translationTransform =
+        dynamic_cast<const TranslationTransformType *>( nthTransform ) )
+        {
+        stage.m_Type = MatrixStage;
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          for( unsigned int j = 0; j < NDimensions; j++ )
+            {
+            stage.m_Matrix[i][j] = ( i == j ) ? 1.0 : 0.0;
+            }
+          stage.m_Offset[i] = translationTransform->GetOffset()[i];
+          }
+        }
+      else if( const DisplacementFieldTransformType *fieldTransform =
+        dynamic_cast<const DisplacementFieldTransformType *>( nthTransform ) )
+        {
+        const DisplacementFieldType *field = fieldTransform->GetDisplacementField();
+        if( !field || field->GetBufferedRegion() != field->GetLargestPossibleRegion() )
+          {
+          stage.m_Type = GenericStage;
+          }
+        else
+          {
+          stage.m_Type = DisplacementFieldStage;
+          stage.m_Field = field;
+
+          // Physical point -> continuous index:  ( D * S )^-1 ( x - origin )
+          typename DisplacementFieldType::DirectionType indexToPhysical;
+          for( unsigned int i = 0; i < NDimensions; i++ )
+            {
+            for( unsigned int j = 0; j < NDimensions; j++ )
+              {
+              indexToPhysical[i][j] = field->GetDirection()[i][j] * field->GetSpacing()[j];
+              }
+            }
+          const typename DisplacementFieldType::DirectionType physicalToIndex =
+            indexToPhysical.GetInverse();
+          for( unsigned int i = 0; i < NDimensions; i++ )
+            {
+            for( unsigned int j = 0; j < NDimensions; j++ )
+              {
+              stage.m_Matrix[i][j] = physicalToIndex[i][j];
+              }
+            stage.m_Offset[i] = field->GetOrigin()[i];
+            stage.m_Size[i] = static_cast<long>( field->GetLargestPossibleRegion().GetSize()[i] );
+            stage.m_Start[i] = field->GetLargestPossibleRegion().GetIndex()[i];
+            stage.m_Stride[i] = static_cast<long>( field->GetOffsetTable()[i] );
+            }
+          }
+        }
+      else
+        {
+        stage.m_Type = GenericStage;
+        }
+      // The composition of consecutive matrix stages is a matrix stage.
+      if( stage.m_Type == MatrixStage && !this->m_Stages.empty() &&
+        this->m_Stages.back().m_Type == MatrixStage )
+        {
+        ComposeMatrixStages( this->m_Stages.back(), stage );
+        continue;
+        }
+      this->m_Stages.push_back( stage );
+      }
+    for( typename StageContainerType::iterator it = this->m_Stages.begin();
+      it != this->m_Stages.end(); ++it )
+      {
+      if( it->m_Type == DisplacementFieldStage )
+        {
+        it->m_FieldPlanes = FieldPlanesType::GetPlanes( it->m_Field, this->m_NumberOfThreads );
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          it->m_Planes[i] = it->m_FieldPlanes->GetPlane( i );
+          }
+        }
+      }
+    this->m_ChainShape = this->ClassifyChain();
+    this->Modified();
+    }
+  const CompositeTransformType * GetTransform() const
+    {
+    return this->m_Transform.GetPointer();
+    }
+
+  /** Number of points mapped as one unit of work.  Default is 4096. */
+  itkSetClampMacro(ChunkSize, SizeValueType, 1, NumericTraits<SizeValueType>::max());
+  itkGetConstMacro(ChunkSize, SizeValueType);
+
+  /** Number of threads.  Default is the global default of the threader. */
+  itkSetClampMacro(NumberOfThreads, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
+  /** Map the points in place.  coordinates[d][n] holds the d-th coordinate
+   * of the n-th point. */
+  void MapPoints( ScalarType * const coordinates[NDimensions], SizeValueType numberOfPoints )
+    {
+    for( unsigned int d = 0; d < NDimensions; d++ )
+      {
+      this->m_Coordinates[d] = coordinates[d];
+      }
+    this->m_NumberOfPoints = numberOfPoints;
+
+    const SizeValueType numberOfChunks =
+      ( numberOfPoints + this->m_ChunkSize - 1 ) / this->m_ChunkSize;
+    if( numberOfChunks == 0 || this->m_Stages.empty() )
+      {
+      return;
+      }
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads( static_cast<int>( std::min<SizeValueType>(
+      this->m_NumberOfThreads, numberOfChunks ) ) );
+    threader->SetSingleMethod( Self::MapPointsThreaderCallback, this );
+    threader->SingleMethodExecute();
+    }
+
+  /** If all stages are matrix stages (or there are none), compose them
+   * into the single affine map y = matrix x + offset and return true. */
+  bool GetAffineTransform( double matrix[NDimensions][NDimensions], double offset[NDimensions] ) const
+    {
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      for( unsigned int j = 0; j < NDimensions; j++ )
+        {
+        matrix[i][j] = ( i == j ) ? 1.0 : 0.0;
+        }
+      offset[i] = 0.0;
+      }
+    for( typename StageContainerType::const_iterator it = this->m_Stages.begin();
+      it != this->m_Stages.end(); ++it )
+      {
+      if( it->m_Type != MatrixStage )
+        {
+        return false;
+        }
+      double product[NDimensions][NDimensions];
+      double productOffset[NDimensions];
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        productOffset[i] = it->m_Offset[i];
+        for( unsigned int j = 0; j < NDimensions; j++ )
+          {
+          product[i][j] = 0.0;
+          for( unsigned int k = 0; k < NDimensions; k++ )
+            {
+            product[i][j] += it->m_Matrix[i][k] * matrix[k][j];
+            }
+          productOffset[i] += it->m_Matrix[i][j] * offset[j];
+          }
+        }
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        for( unsigned int j = 0; j < NDimensions; j++ )
+          {
+          matrix[i][j] = product[i][j];
+          }
+        offset[i] = productOffset[i];
+        }
+      }
+    return true;
+    }
+
+  /** Compute a box containing all points which are mapped into the given
+   * box.  Matrix stages are inverted (the preimage of a box is bounded by
+   * the box of its mapped corners); displacement field stages can move a
+   * point by at most their largest displacement, so the box is dilated by
+   * it.  Returns false if there is no bound, i.e. for singular matrices
+   * and transforms other than the ones handled by the stages. */
+  bool ComputePreimageBoundingBox( const BoundingBoxType & box, BoundingBoxType & preimage ) const
+    {
+    preimage = box;
+    for( typename StageContainerType::const_reverse_iterator it = this->m_Stages.rbegin();
+      it != this->m_Stages.rend(); ++it )
+      {
+      if( it->m_Type == MatrixStage )
+        {
+        vnl_matrix<double> matrix( NDimensions, NDimensions );
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          for( unsigned int j = 0; j < NDimensions; j++ )
+            {
+            matrix( i, j ) = it->m_Matrix[i][j];
+            }
+          }
+        if( vnl_math_abs( vnl_determinant( matrix ) ) < 1e-12 )
+          {
+          return false;
+          }
+        const vnl_matrix<double> inverse = vnl_matrix_inverse<double>( matrix );
+
+        BoundingBoxType corners;
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          corners.m_Lower[i] = NumericTraits<double>::max();
+          corners.m_Upper[i] = NumericTraits<double>::NonpositiveMin();
+          }
+        for( unsigned int corner = 0; corner < ( 1u << NDimensions ); corner++ )
+          {
+          double y[NDimensions];
+          for( unsigned int j = 0; j < NDimensions; j++ )
+            {
+            y[j] = ( ( corner & ( 1u << j ) ) ? preimage.m_Upper[j] : preimage.m_Lower[j] ) -
+              it->m_Offset[j];
+            }
+          for( unsigned int i = 0; i < NDimensions; i++ )
+            {
+            double x = 0.0;
+            for( unsigned int j = 0; j < NDimensions; j++ )
+              {
+              x += inverse( i, j ) * y[j];
+              }
+            corners.m_Lower[i] = vnl_math_min( corners.m_Lower[i], x );
+            corners.m_Upper[i] = vnl_math_max( corners.m_Upper[i], x );
+            }
+          }
+        preimage = corners;
+        }
+      else if( it->m_Type == DisplacementFieldStage )
+        {
+        const DisplacementVectorType *buffer = it->m_Field->GetBufferPointer();
+        const SizeValueType numberOfVectors =
+          it->m_Field->GetBufferedRegion().GetNumberOfPixels();
+        double maximumDisplacement[NDimensions];
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          maximumDisplacement[i] = 0.0;
+          }
+        for( SizeValueType n = 0; n < numberOfVectors; n++ )
+          {
+          for( unsigned int i = 0; i < NDimensions; i++ )
+            {
+            maximumDisplacement[i] = vnl_math_max( maximumDisplacement[i],
+              static_cast<double>( vnl_math_abs( buffer[n][i] ) ) );
+            }
+          }
+        for( unsigned int i = 0; i < NDimensions; i++ )
+          {
+          preimage.m_Lower[i] -= maximumDisplacement[i];
+          preimage.m_Upper[i] += maximumDisplacement[i];
+          }
+        }
+      else
+        {
+        return false;
+        }
+      }
+    return true;
+    }
+
+  /** Map the points of a single chunk in place (used by MapPoints()). */
+  void MapChunk( ScalarType * const coordinates[NDimensions], SizeValueType numberOfPoints ) const
+    {
+    const StageType *stages = this->m_Stages.empty() ? NULL : &this->m_Stages[0];
+    switch( this->m_ChainShape )
+      {
+      case FieldChain:
+        this->template MapChunkThroughFieldChain<false, false>( NULL, stages[0], NULL,
+          coordinates, numberOfPoints );
+        return;
+      case MatrixFieldChain:
+        this->template MapChunkThroughFieldChain<true, false>( &stages[0], stages[1], NULL,
+          coordinates, numberOfPoints );
+        return;
+      case FieldMatrixChain:
+        this->template MapChunkThroughFieldChain<false, true>( NULL, stages[0], &stages[1],
+          coordinates, numberOfPoints );
+        return;
+      case MatrixFieldMatrixChain:
+        this->template MapChunkThroughFieldChain<true, true>( &stages[0], stages[1], &stages[2],
+          coordinates, numberOfPoints );
+        return;
+      default:
+        break;
+      }
+
+    for( typename StageContainerType::const_iterator it = this->m_Stages.begin();
+      it != this->m_Stages.end(); ++it )
+      {
+      switch( it->m_Type )
+        {
+        case MatrixStage:
+          this->MapChunkThroughMatrix( *it, coordinates, numberOfPoints );
+          break;
+        case DisplacementFieldStage:
+          this->MapChunkThroughDisplacementField( *it, coordinates, numberOfPoints );
+          break;
+        default:
+          this->MapChunkThroughTransform( *it, coordinates, numberOfPoints );
+          break;
+        }
+      }
+    }
+
+protected:
+  CompositeTransformPointMapper() : m_ChainShape( GenericChain ),
+    m_ChunkSize( 4096 ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    m_NumberOfPoints( 0 )
+    {
+    for( unsigned int d = 0; d < NDimensions; d++ )
+      {
+      this->m_Coordinates[d] = NULL;
+      }
+    }
+  ~CompositeTransformPointMapper() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "Number of stages: " << this->m_Stages.size() << std::endl;
+    os << indent << "Chain shape: " << this->m_ChainShape << std::endl;
+    os << indent << "ChunkSize: " << this->m_ChunkSize << std::endl;
+    os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+    }
+
+  enum StageTypeEnum { MatrixStage, DisplacementFieldStage, GenericStage };
+
+  struct StageType
+    {
+    StageTypeEnum                                 m_Type;
+    typename TransformType::ConstPointer          m_Transform;
+    typename DisplacementFieldType::ConstPointer  m_Field;
+
+    // Matrix stages:  y = M x + offset.  Displacement field stages:
+    // continuous index = M ( x - origin ) - start.
+    double                                        m_Matrix[NDimensions][NDimensions];
+    double                                        m_Offset[NDimensions];
+    long                                          m_Start[NDimensions];
+    long                                          m_Size[NDimensions];
+    long                                          m_Stride[NDimensions];
+
+    // Displacement field stages:  the planes of the field components.
+    typename FieldPlanesType::ConstPointer        m_FieldPlanes;
+    const FieldValueType                         *m_Planes[NDimensions];
+    };
+  typedef std::vector<StageType> StageContainerType;
+
+  /** Chains mapped by a loop instantiated for their shape (M: matrix
+   * stage, F: displacement field stage, in the order of application). */
+  enum ChainShapeEnum { GenericChain, FieldChain, MatrixFieldChain, FieldMatrixChain,
+    MatrixFieldMatrixChain };
+
+  ChainShapeEnum ClassifyChain() const
+    {
+    std::string shape;
+    for( typename StageContainerType::const_iterator it = this->m_Stages.begin();
+      it != this->m_Stages.end(); ++it )
+      {
+      switch( it->m_Type )
+        {
+        case MatrixStage:
+          shape += "M";
+          break;
+        case DisplacementFieldStage:
+          shape += "F";
+          break;
+        default:
+          return GenericChain;
+        }
+      }
+    if( shape == "F" )
+      {
+      return FieldChain;
+      }
+    if( shape == "MF" )
+      {
+      return MatrixFieldChain;
+      }
+    if( shape == "FM" )
+      {
+      return FieldMatrixChain;
+      }
+    if( shape == "MFM" )
+      {
+      return MatrixFieldMatrixChain;
+      }
+    return GenericChain;
+    }
+
+  /** first <- second o first, i.e. first is applied before second. */
+  static void ComposeMatrixStages( StageType & first, const StageType & second )
+    {
+    double matrix[NDimensions][NDimensions];
+    double offset[NDimensions];
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      offset[i] = second.m_Offset[i];
+      for( unsigned int j = 0; j < NDimensions; j++ )
+        {
+        matrix[i][j] = 0.0;
+        for( unsigned int k = 0; k < NDimensions; k++ )
+          {
+          matrix[i][j] += second.m_Matrix[i][k] * first.m_Matrix[k][j];
+          }
+        offset[i] += second.m_Matrix[i][j] * first.m_Offset[j];
+        }
+      }
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      for( unsigned int j = 0; j < NDimensions; j++ )
+        {
+        first.m_Matrix[i][j] = matrix[i][j];
+        }
+      first.m_Offset[i] = offset[i];
+      }
+    first.m_Transform = NULL;
+    }
+
+  /** x <- M x + offset */
+  static inline void TransformPointByMatrix( const StageType & stage, double x[NDimensions] )
+    {
+    double y[NDimensions];
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      y[i] = stage.m_Offset[i];
+      for( unsigned int j = 0; j < NDimensions; j++ )
+        {
+        y[i] += stage.m_Matrix[i][j] * x[j];
+        }
+      }
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      x[i] = y[i];
+      }
+    }
+
+  /** x <- x + u( x ), where u is interpolated linearly from the planes
+   * of the field.  As for the transform's interpolator, points within half
+   * a voxel of the buffer are inside (and interpolated with clamped
+   * neighbors); points outside are not displaced. */
+  static inline void DisplacePoint( const StageType & stage, double x[NDimensions] )
+    {
+    // Offsets of the lower and upper neighbors along each dimension, in
+    // elements of the planes.
+    long lower[NDimensions];
+    long upper[NDimensions];
+    double fraction[NDimensions];
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      // Continuous index relative to the start of the buffer.
+      double cindex = -static_cast<double>( stage.m_Start[i] );
+      for( unsigned int j = 0; j < NDimensions; j++ )
+        {
+        cindex += stage.m_Matrix[i][j] * ( x[j] - stage.m_Offset[j] );
+        }
+      if( !( cindex >= -0.5 && cindex < stage.m_Size[i] - 0.5 ) )
+        {
+        return;
+        }
+      const double floorIndex = vcl_floor( cindex );
+      const long base = static_cast<long>( floorIndex );
+      fraction[i] = cindex - floorIndex;
+
+      lower[i] = std::max( 0L, base ) * stage.m_Stride[i];
+      upper[i] = std::min( base + 1, stage.m_Size[i] - 1 ) * stage.m_Stride[i];
+      }
+
+    double displacement[NDimensions];
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      displacement[i] = 0.0;
+      }
+    for( unsigned int corner = 0; corner < ( 1u << NDimensions ); corner++ )
+      {
+      double weight = 1.0;
+      long offset = 0;
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        if( corner & ( 1u << i ) )
+          {
+          weight *= fraction[i];
+          offset += upper[i];
+          }
+        else
+          {
+          weight *= 1.0 - fraction[i];
+          offset += lower[i];
+          }
+        }
+      if( weight == 0.0 )
+        {
+        continue;
+        }
+      // All components share the weight.
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        displacement[i] += weight * static_cast<double>( stage.m_Planes[i][offset] );
+        }
+      }
+    for( unsigned int i = 0; i < NDimensions; i++ )
+      {
+      x[i] += displacement[i];
+      }
+    }
+
+  /** Map each point through an optional matrix stage, the field stage and
+   * an optional matrix stage.  The absent stages are compiled out. */
+  template <bool THasPreMatrix, bool THasPostMatrix>
+  void MapChunkThroughFieldChain( const StageType *preMatrix, const StageType & field,
+    const StageType *postMatrix, ScalarType * const coordinates[NDimensions],
+    SizeValueType numberOfPoints ) const
+    {
+    double x[NDimensions];
+    for( SizeValueType n = 0; n < numberOfPoints; n++ )
+      {
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        x[i] = coordinates[i][n];
+        }
+      if( THasPreMatrix )
+        {
+        TransformPointByMatrix( *preMatrix, x );
+        }
+      DisplacePoint( field, x );
+      if( THasPostMatrix )
+        {
+        TransformPointByMatrix( *postMatrix, x );
+        }
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        coordinates[i][n] = static_cast<ScalarType>( x[i] );
+        }
+      }
+    }
+
+  void MapChunkThroughMatrix( const StageType & stage,
+    ScalarType * const coordinates[NDimensions], SizeValueType numberOfPoints ) const
+    {
+    ScalarType x[NDimensions];
+    for( SizeValueType n = 0; n < numberOfPoints; n++ )
+      {
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        x[i] = coordinates[i][n];
+        }
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        double y = stage.m_Offset[i];
+        for( unsigned int j = 0; j < NDimensions; j++ )
+          {
+          y += stage.m_Matrix[i][j] * x[j];
+          }
+        coordinates[i][n] = static_cast<ScalarType>( y );
+        }
+      }
+    }
+
+  void MapChunkThroughDisplacementField( const StageType & stage,
+    ScalarType * const coordinates[NDimensions], SizeValueType numberOfPoints ) const
+    {
+    double x[NDimensions];
+    for( SizeValueType n = 0; n < numberOfPoints; n++ )
+      {
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        x[i] = coordinates[i][n];
+        }
+      DisplacePoint( stage, x );
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        coordinates[i][n] = static_cast<ScalarType>( x[i] );
+        }
+      }
+    }
+
+  void MapChunkThroughTransform( const StageType & stage,
+    ScalarType * const coordinates[NDimensions], SizeValueType numberOfPoints ) const
+    {
+    PointType point;
+    for( SizeValueType n = 0; n < numberOfPoints; n++ )
+      {
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        point[i] = coordinates[i][n];
+        }
+      point = stage.m_Transform->TransformPoint( point );
+      for( unsigned int i = 0; i < NDimensions; i++ )
+        {
+        coordinates[i][n] = point[i];
+        }
+      }
+    }
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE MapPointsThreaderCallback( void *arg )
+    {
+    MultiThreader::ThreadInfoStruct *info =
+      static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+    Self *self = static_cast<Self *>( info->UserData );
+
+    const SizeValueType chunkSize = self->m_ChunkSize;
+    const SizeValueType numberOfChunks =
+      ( self->m_NumberOfPoints + chunkSize - 1 ) / chunkSize;
+
+    ScalarType *chunk[NDimensions];
+    for( SizeValueType c = info->ThreadID; c < numberOfChunks; c += info->NumberOfThreads )
+      {
+      const SizeValueType first = c * chunkSize;
+      for( unsigned int d = 0; d < NDimensions; d++ )
+        {
+        chunk[d] = self->m_Coordinates[d] + first;
+        }
+      self->MapChunk( chunk, std::min( chunkSize, self->m_NumberOfPoints - first ) );
+      }
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+private:
+  CompositeTransformPointMapper( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  typename CompositeTransformType::ConstPointer     m_Transform;
+  StageContainerType                                m_Stages;
+  ChainShapeEnum                                    m_ChainShape;
+  SizeValueType                                     m_ChunkSize;
+  unsigned int                                      m_NumberOfThreads;
+
+  ScalarType                                       *m_Coordinates[NDimensions];
+  SizeValueType                                     m_NumberOfPoints;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,281 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkCompositeTransformPointMapperTest.cxx,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+/**
+ * Checks itk::CompositeTransformPointMapper against
+ * CompositeTransform::TransformPoint() for random points, about a third of
+ * which lie outside the displacement fields, through the chain shapes the
+ * mapper distinguishes:  [affine, field, affine] and its parts, chains
+ * with identity, translation and inverted affine stages that are dropped
+ * or composed, and a chain of two fields that is mapped stage by stage.
+ * The fields have a rotated direction and a non-zero start index.  Also
+ * checks that the planes of a field are shared until it is modified.
+ */
+
+#include "itkAffineTransform.h"
+#include "itkCompositeTransform.h"
+#include "itkCompositeTransformPointMapper.h"
+#include "itkDisplacementFieldTransform.h"
+#include "itkIdentityTransform.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkTranslationTransform.h"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const unsigned int Dimension = 3;
+const double PointTolerance = 1e-9;
+
+typedef itk::CompositeTransformPointMapper<double, Dimension> PointMapperType;
+typedef PointMapperType::CompositeTransformType               CompositeTransformType;
+typedef PointMapperType::TransformType                        TransformType;
+typedef PointMapperType::DisplacementFieldTransformType       FieldTransformType;
+typedef PointMapperType::DisplacementFieldType                FieldType;
+typedef itk::AffineTransform<double, Dimension>               AffineTransformType;
+typedef itk::TranslationTransform<double, Dimension>          TranslationTransformType;
+typedef itk::IdentityTransform<double, Dimension>             IdentityTransformType;
+
+double RandomNumber( double lower, double upper )
+{
+  return lower + ( upper - lower ) * std::rand() / static_cast<double>( RAND_MAX );
+}
+
+FieldTransformType::Pointer CreateFieldTransform( double amplitude, double frequency )
+{
+  FieldType::RegionType region;
+  FieldType::SpacingType spacing;
+  FieldType::PointType origin;
+  const long start[Dimension] = { 3, -2, 5 };
+  const unsigned long size[Dimension] = { 24, 20, 16 };
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    region.SetIndex( d, start[d] );
+    region.SetSize( d, size[d] );
+    spacing[d] = 1.5 + 0.25 * d;
+    origin[d] = -20.0 + 3.0 * d;
+    }
+
+  // Rotation by 0.3 rad about z.
+  FieldType::DirectionType direction;
+  direction.SetIdentity();
+  direction[0][0] = std::cos( 0.3 );
+  direction[0][1] = -std::sin( 0.3 );
+  direction[1][0] = std::sin( 0.3 );
+  direction[1][1] = std::cos( 0.3 );
+
+  FieldType::Pointer field = FieldType::New();
+  field->SetRegions( region );
+  field->SetSpacing( spacing );
+  field->SetOrigin( origin );
+  field->SetDirection( direction );
+  field->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<FieldType> It( field, region );
+  for( It.GoToBegin(); !It.IsAtEnd(); ++It )
+    {
+    FieldType::PointType point;
+    field->TransformIndexToPhysicalPoint( It.GetIndex(), point );
+    FieldType::PixelType displacement;
+    displacement[0] = amplitude * std::sin( frequency * point[1] );
+    displacement[1] = amplitude * std::cos( frequency * point[2] );
+    displacement[2] = amplitude * std::sin( frequency * ( point[0] + point[1] ) );
+    It.Set( displacement );
+    }
+
+  FieldTransformType::Pointer transform = FieldTransformType::New();
+  transform->SetDisplacementField( field );
+  return transform;
+}
+
+AffineTransformType::Pointer CreateAffineTransform()
+{
+  AffineTransformType::Pointer transform = AffineTransformType::New();
+  AffineTransformType::MatrixType matrix;
+  AffineTransformType::OutputVectorType offset;
+  for( unsigned int i = 0; i < Dimension; i++ )
+    {
+    for( unsigned int j = 0; j < Dimension; j++ )
+      {
+      matrix[i][j] = ( i == j ? 1.0 : 0.0 ) + RandomNumber( -0.1, 0.1 );
+      }
+    offset[i] = RandomNumber( -3.0, 3.0 );
+    }
+  transform->SetMatrix( matrix );
+  transform->SetOffset( offset );
+  return transform;
+}
+
+/** Returns the largest distance between the mapper and TransformPoint(). */
+double CompareWithTransformPoint( const CompositeTransformType *composite )
+{
+  const unsigned int numberOfPoints = 20000;
+  std::vector<double> coordinates[Dimension];
+  std::vector<CompositeTransformType::InputPointType> points( numberOfPoints );
+  for( unsigned int n = 0; n < numberOfPoints; n++ )
+    {
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      points[n][d] = RandomNumber( -40.0, 50.0 );
+      coordinates[d].push_back( points[n][d] );
+      }
+    }
+
+  // Small chunks over several threads.
+  PointMapperType::Pointer mapper = PointMapperType::New();
+  mapper->SetTransform( composite );
+  mapper->SetChunkSize( 37 );
+  mapper->SetNumberOfThreads( 4 );
+  double *coordinatePointers[Dimension];
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    coordinatePointers[d] = &coordinates[d][0];
+    }
+  mapper->MapPoints( coordinatePointers, numberOfPoints );
+
+  double maximumDistance = 0.0;
+  for( unsigned int n = 0; n < numberOfPoints; n++ )
+    {
+    const CompositeTransformType::OutputPointType expected = composite->TransformPoint( points[n] );
+    double distance = 0.0;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      distance += vnl_math_sqr( expected[d] - coordinates[d][n] );
+      }
+    maximumDistance = std::max( maximumDistance, std::sqrt( distance ) );
+    }
+  return maximumDistance;
+}
+
+} // end namespace
+
+int main( int, char * [] )
+{
+  std::srand( 1 );
+
+  FieldTransformType::Pointer field = CreateFieldTransform( 2.0, 0.15 );
+  FieldTransformType::Pointer secondField = CreateFieldTransform( 1.0, 0.3 );
+  AffineTransformType::Pointer preAffine = CreateAffineTransform();
+  AffineTransformType::Pointer postAffine = CreateAffineTransform();
+
+  TransformType::Pointer inverseAffine = postAffine->GetInverseTransform();
+  if( !inverseAffine )
+    {
+    std::cerr << "Error:  The affine transform is not invertible." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  TranslationTransformType::Pointer translation = TranslationTransformType::New();
+  TranslationTransformType::OutputVectorType translationOffset;
+  for( unsigned int d = 0; d < Dimension; d++ )
+    {
+    translationOffset[d] = 1.5 - d;
+    }
+  translation->SetOffset( translationOffset );
+
+  IdentityTransformType::Pointer identity = IdentityTransformType::New();
+
+  // Transforms in the order added, i.e. the last one is applied first.
+  std::vector<std::string> names;
+  std::vector<std::vector<TransformType::Pointer> > chains;
+
+  names.push_back( "field" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( field.GetPointer() );
+
+  names.push_back( "affine, field" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( postAffine.GetPointer() );
+  chains.back().push_back( field.GetPointer() );
+
+  names.push_back( "field, affine" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( field.GetPointer() );
+  chains.back().push_back( preAffine.GetPointer() );
+
+  names.push_back( "affine, field, affine" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( postAffine.GetPointer() );
+  chains.back().push_back( field.GetPointer() );
+  chains.back().push_back( preAffine.GetPointer() );
+
+  names.push_back( "identity, inverse affine, translation, field, identity, affine, affine" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( identity.GetPointer() );
+  chains.back().push_back( inverseAffine.GetPointer() );
+  chains.back().push_back( translation.GetPointer() );
+  chains.back().push_back( field.GetPointer() );
+  chains.back().push_back( identity.GetPointer() );
+  chains.back().push_back( postAffine.GetPointer() );
+  chains.back().push_back( preAffine.GetPointer() );
+
+  names.push_back( "affine, field, inverse affine, field" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( postAffine.GetPointer() );
+  chains.back().push_back( field.GetPointer() );
+  chains.back().push_back( inverseAffine.GetPointer() );
+  chains.back().push_back( secondField.GetPointer() );
+
+  names.push_back( "identity" );
+  chains.push_back( std::vector<TransformType::Pointer>() );
+  chains.back().push_back( identity.GetPointer() );
+
+  bool passed = true;
+  for( unsigned int c = 0; c < chains.size(); c++ )
+    {
+    CompositeTransformType::Pointer composite = CompositeTransformType::New();
+    for( unsigned int n = 0; n < chains[c].size(); n++ )
+      {
+      composite->AddTransform( chains[c][n] );
+      }
+    const double maximumDistance = CompareWithTransformPoint( composite );
+    std::cout << "[" << names[c] << "]:  maximum distance to TransformPoint() = "
+      << maximumDistance << " mm" << std::endl;
+    if( !( maximumDistance <= PointTolerance ) )
+      {
+      std::cerr << "Error:  The mapped points of [" << names[c] << "] deviate by more than "
+        << PointTolerance << " mm." << std::endl;
+      passed = false;
+      }
+    }
+
+  // The planes of a field are shared until it is modified.
+  typedef PointMapperType::FieldPlanesType FieldPlanesType;
+  FieldPlanesType::ConstPointer planes = FieldPlanesType::GetPlanes( field->GetDisplacementField(), 2 );
+  if( FieldPlanesType::GetPlanes( field->GetDisplacementField(), 2 ) != planes )
+    {
+    std::cerr << "Error:  The planes of the field are not shared." << std::endl;
+    passed = false;
+    }
+  field->GetDisplacementField()->Modified();
+  if( FieldPlanesType::GetPlanes( field->GetDisplacementField(), 2 ) == planes )
+    {
+    std::cerr << "Error:  The planes of the modified field were not rebuilt." << std::endl;
+    passed = false;
+    }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
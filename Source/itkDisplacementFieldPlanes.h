@@ -0,0 +1,224 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkDisplacementFieldPlanes.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkDisplacementFieldPlanes_h
+#define __itkDisplacementFieldPlanes_h
+
+#include "antsThreadAffinity.h"
+#include "itkMultiThreader.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkSimpleFastMutexLock.h"
+
+#include <algorithm>
+#include <map>
+
+namespace itk
+{
+
+/** \class DisplacementFieldPlanes
+ * \brief The components of a displacement field stored as one contiguous
+ * plane each.
+ *
+ * Plane d holds the d-th component of every vector of the buffer, in the
+ * order of the buffer and in the value type of the field (i.e. float for
+ * a single precision field), such that the planes take as much memory as
+ * the field itself.
+ *
+ * The planes are built by GetPlanes() on the first request for a field
+ * and shared by all later requests for it (e.g. by every point mapper the
+ * field transform is set on) until the MTime of the field changes or the
+ * field is released.  They are filled by the threads of an
+ * itk::MultiThreader, each of which binds itself with ants::ThreadAffinity
+ * and copies a slab of vectors in thread order, i.e. the pages are first
+ * touched as in ThreadAffinity::FirstTouchCopy().
+ *
+ * \ingroup Transforms
+ */
+template <class TDisplacementField>
+class ITK_EXPORT DisplacementFieldPlanes : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef DisplacementFieldPlanes Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(DisplacementFieldPlanes, Object);
+
+  itkStaticConstMacro(Dimension, unsigned int, TDisplacementField::PixelType::Dimension);
+
+  typedef TDisplacementField                               DisplacementFieldType;
+  typedef typename DisplacementFieldType::PixelType        DisplacementVectorType;
+  typedef typename DisplacementVectorType::ValueType       ValueType;
+
+  /** Planes of the buffer of field, built with numberOfThreads threads if
+   * they are not shared yet or the field was modified since. */
+  static ConstPointer GetPlanes( const DisplacementFieldType *field, unsigned int numberOfThreads )
+    {
+    GetRegistryLock().Lock();
+
+    // Planes of fields which are only referenced by the registry are no
+    // longer shared.
+    RegistryType & registry = GetRegistry();
+    for( typename RegistryType::iterator it = registry.begin(); it != registry.end(); )
+      {
+      if( it->first != field && it->second.m_Field->GetReferenceCount() <= 1 )
+        {
+        registry.erase( it++ );
+        }
+      else
+        {
+        ++it;
+        }
+      }
+
+    RegistryEntryType & entry = registry[field];
+    if( entry.m_Planes.IsNull() || entry.m_MTime != field->GetMTime() )
+      {
+      Pointer planes = new Self;
+      planes->UnRegister();
+      planes->Build( field, numberOfThreads );
+      entry.m_Field = field;
+      entry.m_MTime = field->GetMTime();
+      entry.m_Planes = planes.GetPointer();
+      }
+    ConstPointer planes = entry.m_Planes;
+
+    GetRegistryLock().Unlock();
+    return planes;
+    }
+
+  /** Drop the planes of all fields. */
+  static void ReleasePlanes()
+    {
+    GetRegistryLock().Lock();
+    GetRegistry().clear();
+    GetRegistryLock().Unlock();
+    }
+
+  /** The d-th component of all vectors. */
+  const ValueType * GetPlane( unsigned int d ) const
+    {
+    return this->m_Values + d * this->m_NumberOfVectors;
+    }
+
+  SizeValueType GetNumberOfVectors() const
+    {
+    return this->m_NumberOfVectors;
+    }
+
+protected:
+  DisplacementFieldPlanes() : m_Values( NULL ),
+    m_NumberOfVectors( 0 ) {}
+  ~DisplacementFieldPlanes()
+    {
+    delete [] this->m_Values;
+    }
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "NumberOfVectors: " << this->m_NumberOfVectors << std::endl;
+    }
+
+private:
+  DisplacementFieldPlanes( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  struct RegistryEntryType
+    {
+    RegistryEntryType() : m_MTime( 0 ) {}
+
+    typename DisplacementFieldType::ConstPointer m_Field;
+    unsigned long                                m_MTime;
+    ConstPointer                                 m_Planes;
+    };
+  typedef std::map<const DisplacementFieldType *, RegistryEntryType> RegistryType;
+
+  static RegistryType & GetRegistry()
+    {
+    static RegistryType registry;
+    return registry;
+    }
+  static SimpleFastMutexLock & GetRegistryLock()
+    {
+    static SimpleFastMutexLock lock;
+    return lock;
+    }
+
+  struct BuildStruct
+    {
+    const DisplacementVectorType *m_Source;
+    Self                         *m_Planes;
+    };
+
+  void Build( const DisplacementFieldType *field, unsigned int numberOfThreads )
+    {
+    this->m_NumberOfVectors = field->GetBufferedRegion().GetNumberOfPixels();
+    if( this->m_NumberOfVectors == 0 )
+      {
+      return;
+      }
+    // Not initialized, such that the copying threads touch the pages first.
+    this->m_Values = new ValueType[Dimension * this->m_NumberOfVectors];
+
+    BuildStruct str;
+    str.m_Source = field->GetBufferPointer();
+    str.m_Planes = this;
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads( static_cast<int>( std::max( 1u, numberOfThreads ) ) );
+    threader->SetSingleMethod( Self::BuildThreaderCallback, &str );
+    threader->SingleMethodExecute();
+    }
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE BuildThreaderCallback( void *arg )
+    {
+    MultiThreader::ThreadInfoStruct *info =
+      static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+    const BuildStruct *str = static_cast<const BuildStruct *>( info->UserData );
+
+    const SizeValueType numberOfVectors = str->m_Planes->m_NumberOfVectors;
+    const SizeValueType threadId = static_cast<SizeValueType>( info->ThreadID );
+    const SizeValueType numberOfThreads = static_cast<SizeValueType>( info->NumberOfThreads );
+    ants::ThreadAffinity::BindCurrentThread( info->ThreadID );
+
+    const SizeValueType first = numberOfVectors * threadId / numberOfThreads;
+    const SizeValueType last = numberOfVectors * ( threadId + 1 ) / numberOfThreads;
+    for( unsigned int d = 0; d < Dimension; d++ )
+      {
+      ValueType *plane = str->m_Planes->m_Values + d * numberOfVectors;
+      for( SizeValueType n = first; n < last; n++ )
+        {
+        plane[n] = str->m_Source[n][d];
+        }
+      }
+
+    ants::ThreadAffinity::UnbindCurrentThread();
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  ValueType     *m_Values;
+  SizeValueType  m_NumberOfVectors;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,685 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkFixedPointDisplacementFieldInverter.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkFixedPointDisplacementFieldInverter_h
+#define __itkFixedPointDisplacementFieldInverter_h
+
+#include "antsMemoryMappedFile.h"
+#include "itkImage.h"
+#include "itkImageFileWriter.h"
+#include "itkMemoryMappedImageFileReader.h"
+#include "itkMultiThreader.h"
+#include "itkNumericTraits.h"
+#include "itksys/SystemTools.hxx"
+
+#include "vnl/vnl_math.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace itk
+{
+
+/** \class FixedPointDisplacementFieldInverter
+ * \brief Invert a displacement field by fixed point iteration.
+ *
+ * The inverse v of a displacement field u (on the grid of u) satisfies
+ * v(x) = -u( x + v(x) ), which is solved at each voxel by iterating
+ * v <- -u( x + v ) until the residual | v(x) + u( x + v(x) ) | is below the
+ * tolerance or the maximum number of iterations is reached.  Since each
+ * voxel only depends on its own iterate, the voxels are distributed over
+ * the threads without synchronization.  The iteration converges where u
+ * is a contraction, i.e. where the warp does not fold.
+ *
+ * The iteration is started coarse to fine:  the inverse is first computed
+ * on a grid coarsened by 2^(NumberOfLevels-1) (sampling the full resolution
+ * u) and each level is started from the inverse of the previous one, such
+ * that the full resolution level only needs a few iterations.
+ *
+ * As for DisplacementFieldTransform, u is interpolated linearly and points
+ * outside the field are not displaced.
+ *
+ * With a cache directory, the inverse is stored as
+ * <hash>_inverse<sizeof>.mha, where the hash covers the voxels and the
+ * geometry of u and the iteration parameters, and read back instead of
+ * being computed again.  The residual statistics are stored next to it in
+ * <hash>_inverse<sizeof>.residuals and restored with the inverse; an
+ * inverse without them is computed again.
+ *
+ * As for the memory mapped reader, this class is not a pipeline filter:
+ * set the input and call Update().
+ *
+ * \ingroup Transforms
+ */
+template <class TDisplacementField>
+class ITK_EXPORT FixedPointDisplacementFieldInverter : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef FixedPointDisplacementFieldInverter Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(FixedPointDisplacementFieldInverter, Object);
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TDisplacementField::ImageDimension);
+
+  typedef TDisplacementField                          DisplacementFieldType;
+  typedef typename DisplacementFieldType::PixelType   VectorType;
+  typedef typename VectorType::ValueType              ValueType;
+  typedef typename DisplacementFieldType::RegionType  RegionType;
+  typedef typename DisplacementFieldType::SizeType    SizeType;
+
+  /** Largest residual accepted at a voxel, in units of the smallest
+   * spacing of the field.  Default is 0.01. */
+  itkSetMacro(Tolerance, double);
+  itkGetConstMacro(Tolerance, double);
+
+  /** Maximum number of iterations per voxel and level.  Default is 20. */
+  itkSetMacro(MaximumNumberOfIterations, unsigned int);
+  itkGetConstMacro(MaximumNumberOfIterations, unsigned int);
+
+  /** Number of levels including the full resolution.  Default is 3. */
+  itkSetClampMacro(NumberOfLevels, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(NumberOfLevels, unsigned int);
+
+  /** Number of threads.  Default is the global default of the threader. */
+  itkSetClampMacro(NumberOfThreads, unsigned int, 1, NumericTraits<unsigned int>::max());
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
+  /** Directory in which inverses are stored by content hash.  Empty by
+   * default. */
+  itkSetStringMacro(CacheDirectory);
+  itkGetStringMacro(CacheDirectory);
+
+  /** True if the inverse (and its residual statistics) was read from the
+   * cache directory. */
+  itkGetConstMacro(IsCached, bool);
+
+  /** Largest and mean residual (in physical units) of the full resolution
+   * level, and the number of its voxels above the tolerance.  Restored
+   * with a cached inverse. */
+  itkGetConstMacro(MaximumResidual, double);
+  itkGetConstMacro(MeanResidual, double);
+  itkGetConstMacro(NumberOfUnconvergedVoxels, SizeValueType);
+
+  void SetInput( const DisplacementFieldType *field )
+    {
+    this->m_Input = field;
+    }
+
+  void Update()
+    {
+    if( this->m_Input.IsNull() )
+      {
+      itkExceptionMacro( "No input." );
+      }
+
+    this->m_IsCached = false;
+    this->m_MaximumResidual = 0.0;
+    this->m_MeanResidual = 0.0;
+    this->m_NumberOfUnconvergedVoxels = 0;
+
+    std::string cachedFileName( "" );
+    std::string residualsFileName( "" );
+    if( !this->m_CacheDirectory.empty() )
+      {
+      const std::string cachedName = this->m_CacheDirectory + std::string( "/" ) + this->ComputeKey();
+      cachedFileName = cachedName + std::string( ".mha" );
+      residualsFileName = cachedName + std::string( ".residuals" );
+      if( this->ReadResiduals( residualsFileName ) )
+        {
+        this->m_Output = this->ReadInverse( cachedFileName );
+        if( this->m_Output.IsNotNull() )
+          {
+          this->m_IsCached = true;
+          return;
+          }
+        this->m_MaximumResidual = 0.0;
+        this->m_MeanResidual = 0.0;
+        this->m_NumberOfUnconvergedVoxels = 0;
+        }
+      }
+
+    typename DisplacementFieldType::Pointer previous;
+    for( int level = static_cast<int>( this->m_NumberOfLevels ) - 1; level >= 0; level-- )
+      {
+      typename DisplacementFieldType::Pointer inverse = this->CreateLevelGrid( 1L << level );
+      this->InvertLevel( inverse, previous );
+      previous = inverse;
+      }
+    this->m_Output = previous;
+
+    // The statistics first, such that a cached inverse always has them.
+    if( this->WriteResiduals( residualsFileName ) )
+      {
+      this->WriteInverse( cachedFileName );
+      }
+    }
+
+  DisplacementFieldType * GetOutput()
+    {
+    return this->m_Output.GetPointer();
+    }
+
+protected:
+  FixedPointDisplacementFieldInverter() : m_Tolerance( 0.01 ),
+    m_MaximumNumberOfIterations( 20 ),
+    m_NumberOfLevels( 3 ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() ),
+    m_IsCached( false ),
+    m_MaximumResidual( 0.0 ),
+    m_MeanResidual( 0.0 ),
+    m_NumberOfUnconvergedVoxels( 0 ) {}
+  ~FixedPointDisplacementFieldInverter() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "Tolerance: " << this->m_Tolerance << std::endl;
+    os << indent << "MaximumNumberOfIterations: " << this->m_MaximumNumberOfIterations << std::endl;
+    os << indent << "NumberOfLevels: " << this->m_NumberOfLevels << std::endl;
+    os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+    os << indent << "CacheDirectory: " << this->m_CacheDirectory << std::endl;
+    }
+
+  /** Linear interpolation of a field at a physical point.  Outside the
+   * field, the value is zero or, if clamped, the value at the nearest
+   * voxel. */
+  struct FieldSamplerType
+    {
+    const VectorType *m_Buffer;
+    double            m_Origin[ImageDimension];
+    double            m_PhysicalToIndex[ImageDimension][ImageDimension];
+    long              m_Size[ImageDimension];
+    long              m_Stride[ImageDimension];
+
+    void Initialize( const DisplacementFieldType *field )
+      {
+      typename DisplacementFieldType::DirectionType indexToPhysical;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          indexToPhysical[i][j] = field->GetDirection()[i][j] * field->GetSpacing()[j];
+          }
+        }
+      const typename DisplacementFieldType::DirectionType physicalToIndex =
+        indexToPhysical.GetInverse();
+
+      // Physical point of the first voxel of the buffer.
+      typename DisplacementFieldType::PointType origin;
+      field->TransformIndexToPhysicalPoint( field->GetBufferedRegion().GetIndex(), origin );
+
+      this->m_Buffer = field->GetBufferPointer();
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        this->m_Origin[i] = origin[i];
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          this->m_PhysicalToIndex[i][j] = physicalToIndex[i][j];
+          }
+        this->m_Size[i] = static_cast<long>( field->GetBufferedRegion().GetSize()[i] );
+        this->m_Stride[i] = static_cast<long>( field->GetOffsetTable()[i] );
+        }
+      }
+
+    void Evaluate( const double point[ImageDimension], double value[ImageDimension],
+      bool clamp ) const
+      {
+      long base[ImageDimension];
+      double fraction[ImageDimension];
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        value[i] = 0.0;
+        }
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        double cindex = 0.0;
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          cindex += this->m_PhysicalToIndex[i][j] * ( point[j] - this->m_Origin[j] );
+          }
+        if( !( cindex >= -0.5 && cindex < this->m_Size[i] - 0.5 ) )
+          {
+          if( !clamp )
+            {
+            return;
+            }
+          cindex = std::max( 0.0, std::min( cindex, static_cast<double>( this->m_Size[i] - 1 ) ) );
+          }
+        const double floorIndex = vcl_floor( cindex );
+        base[i] = static_cast<long>( floorIndex );
+        fraction[i] = cindex - floorIndex;
+        }
+
+      for( unsigned int corner = 0; corner < ( 1u << ImageDimension ); corner++ )
+        {
+        double weight = 1.0;
+        long offset = 0;
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          long index = base[i];
+          if( corner & ( 1u << i ) )
+            {
+            weight *= fraction[i];
+            index++;
+            }
+          else
+            {
+            weight *= 1.0 - fraction[i];
+            }
+          index = std::max( 0L, std::min( index, this->m_Size[i] - 1 ) );
+          offset += index * this->m_Stride[i];
+          }
+        if( weight == 0.0 )
+          {
+          continue;
+          }
+        const VectorType & vector = this->m_Buffer[offset];
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          value[i] += weight * static_cast<double>( vector[i] );
+          }
+        }
+      }
+    };
+
+  /** Grid of the input coarsened by the given factor.  Voxel 0 keeps its
+   * physical position and the grid covers at least the input. */
+  typename DisplacementFieldType::Pointer CreateLevelGrid( long factor ) const
+    {
+    const DisplacementFieldType *input = this->m_Input.GetPointer();
+
+    typename DisplacementFieldType::PointType origin;
+    input->TransformIndexToPhysicalPoint( input->GetBufferedRegion().GetIndex(), origin );
+
+    SizeType size;
+    typename DisplacementFieldType::SpacingType spacing = input->GetSpacing();
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      size[i] = ( input->GetBufferedRegion().GetSize()[i] + factor - 1 ) / factor;
+      spacing[i] *= static_cast<double>( factor );
+      }
+    typename DisplacementFieldType::IndexType index;
+    index.Fill( 0 );
+    RegionType region;
+    region.SetIndex( index );
+    region.SetSize( size );
+
+    typename DisplacementFieldType::Pointer grid = DisplacementFieldType::New();
+    grid->CopyInformation( input );
+    grid->SetOrigin( origin );
+    grid->SetSpacing( spacing );
+    grid->SetRegions( region );
+    grid->Allocate();
+    return grid;
+    }
+
+  struct LevelStruct
+    {
+    const Self                   *m_Inverter;
+    DisplacementFieldType        *m_Inverse;
+    FieldSamplerType              m_Field;
+    FieldSamplerType              m_Previous;
+    bool                          m_HasPrevious;
+    double                        m_Tolerance;
+    std::vector<double>           m_MaximumResidual;
+    std::vector<double>           m_SumOfResiduals;
+    std::vector<SizeValueType>    m_NumberOfUnconvergedVoxels;
+    };
+
+  void InvertLevel( DisplacementFieldType *inverse, const DisplacementFieldType *previous )
+    {
+    double minimumSpacing = NumericTraits<double>::max();
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      minimumSpacing = vnl_math_min( minimumSpacing,
+        static_cast<double>( this->m_Input->GetSpacing()[i] ) );
+      }
+
+    const SizeValueType numberOfVoxels = inverse->GetBufferedRegion().GetNumberOfPixels();
+    const unsigned int numberOfThreads = static_cast<unsigned int>( std::max<SizeValueType>( 1,
+      std::min<SizeValueType>( this->m_NumberOfThreads, numberOfVoxels ) ) );
+
+    LevelStruct str;
+    str.m_Inverter = this;
+    str.m_Inverse = inverse;
+    str.m_Field.Initialize( this->m_Input );
+    str.m_HasPrevious = ( previous != NULL );
+    if( previous )
+      {
+      str.m_Previous.Initialize( previous );
+      }
+    str.m_Tolerance = this->m_Tolerance * minimumSpacing;
+    str.m_MaximumResidual.assign( numberOfThreads, 0.0 );
+    str.m_SumOfResiduals.assign( numberOfThreads, 0.0 );
+    str.m_NumberOfUnconvergedVoxels.assign( numberOfThreads, 0 );
+
+    MultiThreader::Pointer threader = MultiThreader::New();
+    threader->SetNumberOfThreads( static_cast<int>( numberOfThreads ) );
+    threader->SetSingleMethod( Self::InvertThreaderCallback, &str );
+    threader->SingleMethodExecute();
+
+    this->m_MaximumResidual = 0.0;
+    this->m_MeanResidual = 0.0;
+    this->m_NumberOfUnconvergedVoxels = 0;
+    for( unsigned int n = 0; n < numberOfThreads; n++ )
+      {
+      this->m_MaximumResidual = vnl_math_max( this->m_MaximumResidual, str.m_MaximumResidual[n] );
+      this->m_MeanResidual += str.m_SumOfResiduals[n];
+      this->m_NumberOfUnconvergedVoxels += str.m_NumberOfUnconvergedVoxels[n];
+      }
+    this->m_MeanResidual /= static_cast<double>( std::max<SizeValueType>( 1, numberOfVoxels ) );
+    }
+
+  /** Iterate the voxels [first, last) of the level grid. */
+  void InvertVoxels( LevelStruct & str, SizeValueType first, SizeValueType last,
+    unsigned int threadId ) const
+    {
+    DisplacementFieldType *inverse = str.m_Inverse;
+    const RegionType & region = inverse->GetBufferedRegion();
+    VectorType *buffer = inverse->GetBufferPointer();
+
+    double indexToPhysical[ImageDimension][ImageDimension];
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        indexToPhysical[i][j] = inverse->GetDirection()[i][j] * inverse->GetSpacing()[j];
+        }
+      }
+
+    double maximumResidual = 0.0;
+    double sumOfResiduals = 0.0;
+    SizeValueType numberOfUnconvergedVoxels = 0;
+    for( SizeValueType voxel = first; voxel < last; voxel++ )
+      {
+      // Index of the voxel (axis 0 fastest) and its physical point.
+      long index[ImageDimension];
+      SizeValueType remainder = voxel;
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        index[i] = static_cast<long>( remainder % region.GetSize()[i] );
+        remainder /= region.GetSize()[i];
+        }
+      double x[ImageDimension];
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        x[i] = inverse->GetOrigin()[i];
+        for( unsigned int j = 0; j < ImageDimension; j++ )
+          {
+          x[i] += indexToPhysical[i][j] * static_cast<double>( index[j] );
+          }
+        }
+
+      // Start from the previous level or from -u( x ).
+      double v[ImageDimension];
+      double u[ImageDimension];
+      if( str.m_HasPrevious )
+        {
+        str.m_Previous.Evaluate( x, v, true );
+        }
+      else
+        {
+        str.m_Field.Evaluate( x, u, false );
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          v[i] = -u[i];
+          }
+        }
+
+      double residual = 0.0;
+      for( unsigned int iteration = 0; ; iteration++ )
+        {
+        double y[ImageDimension];
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          y[i] = x[i] + v[i];
+          }
+        str.m_Field.Evaluate( y, u, false );
+
+        residual = 0.0;
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          residual += vnl_math_sqr( v[i] + u[i] );
+          }
+        residual = vcl_sqrt( residual );
+        if( residual <= str.m_Tolerance || iteration >= this->m_MaximumNumberOfIterations )
+          {
+          break;
+          }
+        for( unsigned int i = 0; i < ImageDimension; i++ )
+          {
+          v[i] = -u[i];
+          }
+        }
+
+      VectorType & vector = buffer[voxel];
+      for( unsigned int i = 0; i < ImageDimension; i++ )
+        {
+        vector[i] = static_cast<ValueType>( v[i] );
+        }
+      maximumResidual = vnl_math_max( maximumResidual, residual );
+      sumOfResiduals += residual;
+      if( residual > str.m_Tolerance )
+        {
+        numberOfUnconvergedVoxels++;
+        }
+      }
+    str.m_MaximumResidual[threadId] = maximumResidual;
+    str.m_SumOfResiduals[threadId] = sumOfResiduals;
+    str.m_NumberOfUnconvergedVoxels[threadId] = numberOfUnconvergedVoxels;
+    }
+
+  /** Static function used as a "callback" by the MultiThreader. */
+  static ITK_THREAD_RETURN_TYPE InvertThreaderCallback( void *arg )
+    {
+    MultiThreader::ThreadInfoStruct *info =
+      static_cast<MultiThreader::ThreadInfoStruct *>( arg );
+    LevelStruct *str = static_cast<LevelStruct *>( info->UserData );
+
+    const SizeValueType voxels = str->m_Inverse->GetBufferedRegion().GetNumberOfPixels();
+    const SizeValueType threads = static_cast<SizeValueType>( info->NumberOfThreads );
+    const SizeValueType thread = static_cast<SizeValueType>( info->ThreadID );
+    str->m_Inverter->InvertVoxels( *str, voxels * thread / threads,
+      voxels * ( thread + 1 ) / threads, info->ThreadID );
+    return ITK_THREAD_RETURN_VALUE;
+    }
+
+  /** Hash of the voxels and geometry of the input and the iteration
+   * parameters. */
+  std::string ComputeKey() const
+    {
+    const DisplacementFieldType *input = this->m_Input.GetPointer();
+    const std::size_t numberOfBytes = input->GetPixelContainer()->Size() * sizeof( VectorType );
+
+    std::ostringstream oss;
+    oss << ants::MemoryMappedFile::ComputeContentHash(
+      reinterpret_cast<const char *>( input->GetBufferPointer() ), numberOfBytes );
+    oss.precision( 17 );
+    oss << input->GetBufferedRegion() << input->GetSpacing() << input->GetOrigin()
+        << input->GetDirection() << this->m_Tolerance << " " << this->m_MaximumNumberOfIterations
+        << " " << this->m_NumberOfLevels;
+    const std::string description = oss.str();
+
+    std::ostringstream key;
+    key << ants::MemoryMappedFile::ComputeContentHash( description.c_str(), description.length() )
+        << "_inverse" << sizeof( ValueType );
+    return key.str();
+    }
+
+  /** Returns NULL if the file does not exist or does not match the input. */
+  typename DisplacementFieldType::Pointer ReadInverse( const std::string & filename ) const
+    {
+    if( filename.empty() || !ants::MemoryMappedFile::FileExists( filename ) )
+      {
+      return NULL;
+      }
+
+    typedef MemoryMappedImageFileReader<DisplacementFieldType> ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( filename );
+    try
+      {
+      reader->Update();
+      }
+    catch( ExceptionObject & )
+      {
+      return NULL;
+      }
+
+    typename DisplacementFieldType::Pointer inverse = reader->GetOutput();
+    const DisplacementFieldType *input = this->m_Input.GetPointer();
+    const double tolerance = 1e-6;
+    if( inverse->GetBufferedRegion().GetSize() != input->GetBufferedRegion().GetSize() )
+      {
+      return NULL;
+      }
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      if( vnl_math_abs( inverse->GetSpacing()[d] - input->GetSpacing()[d] ) > tolerance )
+        {
+        return NULL;
+        }
+      }
+    inverse->DisconnectPipeline();
+    return inverse;
+    }
+
+  /** Read the residual statistics stored with a cached inverse.  Returns
+   * false if the file does not exist or cannot be parsed. */
+  bool ReadResiduals( const std::string & filename )
+    {
+    if( filename.empty() || !ants::MemoryMappedFile::FileExists( filename ) )
+      {
+      return false;
+      }
+    std::ifstream stream( filename.c_str() );
+    double maximumResidual = 0.0;
+    double meanResidual = 0.0;
+    SizeValueType numberOfUnconvergedVoxels = 0;
+    if( !( stream >> maximumResidual >> meanResidual >> numberOfUnconvergedVoxels ) )
+      {
+      return false;
+      }
+    this->m_MaximumResidual = maximumResidual;
+    this->m_MeanResidual = meanResidual;
+    this->m_NumberOfUnconvergedVoxels = numberOfUnconvergedVoxels;
+    return true;
+    }
+
+  /** Temporary file next to filename, unique to this inverter. */
+  std::string GetTemporaryFileName( const std::string & filename ) const
+    {
+    std::ostringstream tmp;
+    std::string path = itksys::SystemTools::GetFilenamePath( filename );
+    if( !path.empty() )
+      {
+      tmp << path << "/";
+      }
+    tmp << ".tmp_" << this << "_" << itksys::SystemTools::GetFilenameName( filename );
+    return tmp.str();
+    }
+
+  /** Write the residual statistics through a temporary file.  Returns
+   * false on failure. */
+  bool WriteResiduals( const std::string & filename ) const
+    {
+    if( filename.empty() )
+      {
+      return false;
+      }
+    const std::string temporaryFileName = this->GetTemporaryFileName( filename );
+    {
+    std::ofstream stream( temporaryFileName.c_str() );
+    stream.precision( 17 );
+    stream << this->m_MaximumResidual << " " << this->m_MeanResidual << " "
+      << this->m_NumberOfUnconvergedVoxels << std::endl;
+    if( !stream )
+      {
+      stream.close();
+      std::remove( temporaryFileName.c_str() );
+      return false;
+      }
+    }
+    if( !ants::MemoryMappedFile::RenameFile( temporaryFileName, filename ) )
+      {
+      std::remove( temporaryFileName.c_str() );
+      return false;
+      }
+    return true;
+    }
+
+  /** Write through a temporary file such that concurrent readers never see
+   * a partial file.  Failures are not fatal. */
+  void WriteInverse( const std::string & filename ) const
+    {
+    if( filename.empty() )
+      {
+      return;
+      }
+
+    const std::string temporaryFileName = this->GetTemporaryFileName( filename );
+
+    typedef ImageFileWriter<DisplacementFieldType> WriterType;
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( this->m_Output );
+    writer->SetFileName( temporaryFileName.c_str() );
+    writer->UseCompressionOff();
+    try
+      {
+      writer->Update();
+      }
+    catch( ExceptionObject & )
+      {
+      std::remove( temporaryFileName.c_str() );
+      return;
+      }
+    if( !ants::MemoryMappedFile::RenameFile( temporaryFileName, filename ) )
+      {
+      std::remove( temporaryFileName.c_str() );
+      }
+    }
+
+private:
+  FixedPointDisplacementFieldInverter( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  typename DisplacementFieldType::ConstPointer      m_Input;
+  typename DisplacementFieldType::Pointer           m_Output;
+  double                                            m_Tolerance;
+  unsigned int                                      m_MaximumNumberOfIterations;
+  unsigned int                                      m_NumberOfLevels;
+  unsigned int                                      m_NumberOfThreads;
+  std::string                                       m_CacheDirectory;
+  bool                                              m_IsCached;
+  double                                            m_MaximumResidual;
+  double                                            m_MeanResidual;
+  SizeValueType                                     m_NumberOfUnconvergedVoxels;
+};
+
+} // end namespace itk
+
+#endif
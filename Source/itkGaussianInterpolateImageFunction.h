@@ -19,6 +19,7 @@
 #define __itkGaussianInterpolateImageFunction_h
 
 #include "itkInterpolateImageFunction.h"
+#include "itkSeparableKernelInterpolator.h"
 #include "vnl/vnl_erf.h"
 
 namespace itk
@@ -68,13 +69,16 @@ void compute_erf_array (
  * over the input image type and the coordinate representation type 
  * (e.g. float or double).
  *
- * This function works for N-dimensional images.
+ * This function works for N-dimensional images.  The kernel is separable
+ * (the product of the normalized 1-D erf differences), see
+ * SeparableKernelInterpolator.
  *
  * \ingroup ImageFunctions ImageInterpolators 
  */
 template <class TInputImage, class TCoordRep = double>
 class ITK_EXPORT GaussianInterpolateImageFunction : 
-  public InterpolateImageFunction<TInputImage,TCoordRep> 
+  public InterpolateImageFunction<TInputImage,TCoordRep>,
+  public SeparableKernelInterpolator<TInputImage>
 {
 public:
   /** Standard class typedefs. */
@@ -236,6 +240,56 @@ public:
 
     }
 
+  /** SeparableKernelInterpolator interface:  the samples are the input
+   * voxels and the 1-D weights are normalized, which gives the same
+   * value as the normalization by the sum of the N-D weights. */
+  virtual const TInputImage * GetSeparableKernelSamples() const
+    {
+    return this->GetInputImage();
+    }
+
+  virtual unsigned int GetSeparableKernelWidth( unsigned int d ) const
+    {
+    return static_cast<unsigned int>( ceil( 2.0 * cut[d] ) ) + 2;
+    }
+
+  virtual void ComputeSeparableKernel( unsigned int d, double cindex,
+    long *neighbors, double *weights ) const
+    {
+    const unsigned int width = this->GetSeparableKernelWidth( d );
+
+    // Same range and erf differences as compute_erf_array().
+    int k0 = (int) floor(cindex - bb_start[d] - cut[d]);
+    int k1 = (int) ceil(cindex - bb_start[d] + cut[d]);
+    if(k0 < 0) k0 = 0;
+    if(k1 > nt[d]) k1 = nt[d];
+
+    double t = (bb_start[d] - cindex + k0) * sf[d];
+    double e_last = vnl_erf(t);
+    double sum = 0.0;
+    for(unsigned int i = 0; i < width; i++)
+      {
+      neighbors[i] = 0;
+      weights[i] = 0.0;
+      if(k0 + (int) i < k1)
+        {
+        t += sf[d];
+        double e_now = vnl_erf(t);
+        neighbors[i] = k0 + i;
+        weights[i] = e_now - e_last;
+        sum += weights[i];
+        e_last = e_now;
+        }
+      }
+    if(sum > 0.0)
+      {
+      for(unsigned int i = 0; i < width; i++)
+        {
+        weights[i] /= sum;
+        }
+      }
+    }
+
 protected:
   GaussianInterpolateImageFunction() {}
   ~GaussianInterpolateImageFunction(){};
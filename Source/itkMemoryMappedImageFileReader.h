@@ -0,0 +1,481 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkMemoryMappedImageFileReader.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMemoryMappedImageFileReader_h
+#define __itkMemoryMappedImageFileReader_h
+
+#include "antsMemoryMappedFile.h"
+#include "itkMemoryMappedImportImageContainer.h"
+
+#include "itkByteSwapper.h"
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "itkImageIOBase.h"
+#include "itkImageIOFactory.h"
+#include "itkPixelTraits.h"
+#include "itksys/SystemTools.hxx"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace itk
+{
+
+/** \class MemoryMappedImageFileReader
+ * \brief Read an image by mapping the file and wrapping the mapped voxel
+ * data as the image buffer.
+ *
+ * Uncompressed single-file NIfTI (.nii) images with scalar voxels and
+ * MetaImage (.mha/.mhd) images are mapped directly when the stored
+ * component type, number of components and byte order match the requested
+ * pixel type, i.e. no copy of the voxel data is made.  Vector NIfTI images
+ * are stored component by component and can not be wrapped as an
+ * itk::Image of vectors.
+ *
+ * If a cache directory is given, gzip compressed inputs are decompressed
+ * once and stored in the cache as MetaImage header/raw pairs with the
+ * requested pixel type.  The cached files are named after a hash of the
+ * compressed file contents so that repeated reads of the same template or
+ * warp are served from the (mapped) cache.
+ *
+ * Anything else falls back to the regular itk::ImageFileReader, so this
+ * class can be used as a drop-in replacement.  Unlike the regular reader,
+ * this class is not a pipeline filter:  call Update() and take the output.
+ *
+ * \ingroup IOFilters
+ */
+template <class TOutputImage>
+class ITK_EXPORT MemoryMappedImageFileReader : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef MemoryMappedImageFileReader Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MemoryMappedImageFileReader, Object);
+
+  typedef TOutputImage                              OutputImageType;
+  typedef typename OutputImageType::Pointer         OutputImagePointer;
+  typedef typename OutputImageType::PixelType       PixelType;
+  typedef typename PixelTraits<PixelType>::ValueType ComponentType;
+  typedef typename OutputImageType::RegionType      RegionType;
+  typedef typename OutputImageType::SizeType        SizeType;
+  typedef typename OutputImageType::IndexType       IndexType;
+  typedef typename OutputImageType::SpacingType     SpacingType;
+  typedef typename OutputImageType::PointType       PointType;
+  typedef typename OutputImageType::DirectionType   DirectionType;
+
+  typedef MemoryMappedImportImageContainer<
+    typename OutputImageType::PixelContainer::ElementIdentifier, PixelType>
+                                                    MappedPixelContainerType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TOutputImage::ImageDimension);
+
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  /** Directory holding decompressed copies of gzipped inputs.  If empty,
+   * no cache is used. */
+  itkSetStringMacro(CacheDirectory);
+  itkGetStringMacro(CacheDirectory);
+
+  /** Turn mapping (and the cache) on or off. Default is on. */
+  itkSetMacro(UseMemoryMapping, bool);
+  itkGetConstMacro(UseMemoryMapping, bool);
+  itkBooleanMacro(UseMemoryMapping);
+
+  /** True if the last Update() wrapped the mapped file. */
+  itkGetConstMacro(IsMemoryMapped, bool);
+
+  /** True if the last Update() was served from the cache. */
+  itkGetConstMacro(IsCached, bool);
+
+  OutputImageType * GetOutput()
+    {
+    return this->m_Output.GetPointer();
+    }
+
+  void Update()
+    {
+    this->m_Output = NULL;
+    this->m_IsMemoryMapped = false;
+    this->m_IsCached = false;
+
+    std::string filename = this->m_FileName;
+
+    if( this->m_UseMemoryMapping && !this->m_CacheDirectory.empty() &&
+      ants::MemoryMappedFile::HasExtension( filename, ".gz" ) )
+      {
+      std::string cachedFileName = this->GetCachedFileName( filename );
+      if( !cachedFileName.empty() )
+        {
+        filename = cachedFileName;
+        this->m_IsCached = true;
+        }
+      }
+
+    if( this->m_UseMemoryMapping && this->MapImage( filename ) )
+      {
+      this->m_IsMemoryMapped = true;
+      return;
+      }
+
+    typedef ImageFileReader<OutputImageType> ReaderType;
+    typename ReaderType::Pointer reader = ReaderType::New();
+    reader->SetFileName( filename.c_str() );
+    reader->Update();
+
+    this->m_Output = reader->GetOutput();
+    this->m_Output->DisconnectPipeline();
+    }
+
+protected:
+  MemoryMappedImageFileReader() : m_UseMemoryMapping( true ),
+                                  m_IsMemoryMapped( false ),
+                                  m_IsCached( false ) {}
+  ~MemoryMappedImageFileReader() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "FileName: " << this->m_FileName << std::endl;
+    os << indent << "CacheDirectory: " << this->m_CacheDirectory << std::endl;
+    os << indent << "UseMemoryMapping: " << this->m_UseMemoryMapping << std::endl;
+    }
+
+  /** Name used for the pixel type in the cache file names. */
+  std::string GetPixelTypeTag() const
+    {
+    std::ostringstream oss;
+    oss << ImageIOBase::GetComponentTypeAsString(
+      ImageIOBase::MapPixelType<ComponentType>::CType )
+      << PixelTraits<PixelType>::Dimension << "_" << ImageDimension << "D";
+    return oss.str();
+    }
+
+  /** Returns the name of the decompressed copy in the cache, creating it
+   * if it doesn't exist yet.  An empty string is returned on failure. */
+  std::string GetCachedFileName( const std::string & filename )
+    {
+    ants::MemoryMappedFile::Pointer compressedFile = ants::MemoryMappedFile::New();
+    if( !compressedFile->OpenForReading( filename ) )
+      {
+      return std::string( "" );
+      }
+    std::string hash = ants::MemoryMappedFile::ComputeContentHash(
+      compressedFile->GetBuffer(), compressedFile->GetSize() );
+    compressedFile->Close();
+
+    std::string baseName = hash + std::string( "_" ) + this->GetPixelTypeTag();
+    std::string cachedFileName = this->m_CacheDirectory + "/" + baseName + ".mhd";
+
+    if( ants::MemoryMappedFile::FileExists( cachedFileName ) )
+      {
+      return cachedFileName;
+      }
+
+    // The header refers to the raw file by its relative name so we write
+    // both files to a private subdirectory and move them into place
+    // afterwards (raw file first) such that concurrent readers never see a
+    // partial entry.
+    std::ostringstream tmp;
+    tmp << this->m_CacheDirectory << "/.tmp_" << baseName << "_" << this;
+    std::string temporaryDirectory = tmp.str();
+    if( !itksys::SystemTools::MakeDirectory( temporaryDirectory.c_str() ) )
+      {
+      return std::string( "" );
+      }
+
+    std::string temporaryHeader = temporaryDirectory + "/" + baseName + ".mhd";
+    std::string temporaryRaw = temporaryDirectory + "/" + baseName + ".raw";
+    bool success = true;
+    try
+      {
+      typedef ImageFileReader<OutputImageType> ReaderType;
+      typename ReaderType::Pointer reader = ReaderType::New();
+      reader->SetFileName( filename.c_str() );
+
+      typedef ImageFileWriter<OutputImageType> WriterType;
+      typename WriterType::Pointer writer = WriterType::New();
+      writer->SetInput( reader->GetOutput() );
+      writer->SetFileName( temporaryHeader.c_str() );
+      writer->UseCompressionOff();
+      writer->Update();
+      }
+    catch( ExceptionObject & )
+      {
+      success = false;
+      }
+
+    if( success )
+      {
+      success = ants::MemoryMappedFile::RenameFile( temporaryRaw,
+        this->m_CacheDirectory + "/" + baseName + ".raw" ) &&
+        ants::MemoryMappedFile::RenameFile( temporaryHeader, cachedFileName );
+      }
+    std::remove( temporaryRaw.c_str() );
+    std::remove( temporaryHeader.c_str() );
+    itksys::SystemTools::RemoveADirectory( temporaryDirectory.c_str() );
+
+    return success ? cachedFileName : std::string( "" );
+    }
+
+  /** Locate the voxel data of a NIfTI file.  Returns false if the voxels
+   * can't be used as is (scaled intensities, foreign byte order, ...). */
+  bool GetNiftiDataOffset( ants::MemoryMappedFile *file, std::size_t & offset )
+    {
+    if( file->GetSize() < 352 )
+      {
+      return false;
+      }
+    const char *header = file->GetBuffer();
+
+    int sizeOfHeader;
+    std::memcpy( &sizeOfHeader, header, sizeof( int ) );
+    if( sizeOfHeader != 348 || std::strncmp( header + 344, "n+1", 3 ) != 0 )
+      {
+      return false;
+      }
+
+    float voxelOffset;
+    float sclSlope;
+    float sclIntercept;
+    std::memcpy( &voxelOffset, header + 108, sizeof( float ) );
+    std::memcpy( &sclSlope, header + 112, sizeof( float ) );
+    std::memcpy( &sclIntercept, header + 116, sizeof( float ) );
+    if( sclSlope != 0.0 && ( sclSlope != 1.0 || sclIntercept != 0.0 ) )
+      {
+      return false;
+      }
+
+    offset = static_cast<std::size_t>( voxelOffset );
+    return true;
+    }
+
+  /** Locate the voxel data of a MetaImage file. */
+  bool GetMetaImageDataLocation( ants::MemoryMappedFile *headerFile,
+    std::size_t numberOfBytes, std::string & dataFileName, std::size_t & offset )
+    {
+    const char *buffer = headerFile->GetBuffer();
+    const std::size_t size = headerFile->GetSize();
+
+    long headerSize = 0;
+    std::size_t position = 0;
+    while( position < size )
+      {
+      std::size_t end = position;
+      while( end < size && buffer[end] != '\n' )
+        {
+        end++;
+        }
+      std::string line( buffer + position, end - position );
+      position = end + 1;
+
+      std::string::size_type equal = line.find( '=' );
+      if( equal == std::string::npos )
+        {
+        continue;
+        }
+      std::string key = line.substr( 0, equal );
+      std::string value = line.substr( equal + 1 );
+      key.erase( key.find_last_not_of( " \t\r" ) + 1 );
+      value.erase( 0, value.find_first_not_of( " \t" ) );
+      value.erase( value.find_last_not_of( " \t\r" ) + 1 );
+
+      if( key == "CompressedData" && ( value == "True" || value == "true" ) )
+        {
+        return false;
+        }
+      else if( key == "HeaderSize" )
+        {
+        headerSize = atol( value.c_str() );
+        }
+      else if( key == "ElementDataFile" )
+        {
+        if( value == "LOCAL" || value == "Local" || value == "local" )
+          {
+          dataFileName = headerFile->GetFileName();
+          offset = position;
+          return ( headerSize == 0 );
+          }
+        if( value.find( ' ' ) != std::string::npos || value == "LIST" )
+          {
+          return false;
+          }
+        std::string path = itksys::SystemTools::GetFilenamePath( headerFile->GetFileName() );
+        dataFileName = path.empty() ? value : path + "/" + value;
+        if( headerSize >= 0 )
+          {
+          offset = static_cast<std::size_t>( headerSize );
+          }
+        else
+          {
+          std::size_t dataFileSize = ants::MemoryMappedFile::GetFileSize( dataFileName );
+          if( dataFileSize < numberOfBytes )
+            {
+            return false;
+            }
+          offset = dataFileSize - numberOfBytes;
+          }
+        return true;
+        }
+      }
+    return false;
+    }
+
+  bool MapImage( const std::string & filename )
+    {
+    ImageIOBase::Pointer imageIO = ImageIOFactory::CreateImageIO(
+      filename.c_str(), ImageIOFactory::ReadMode );
+    if( imageIO.IsNull() )
+      {
+      return false;
+      }
+    try
+      {
+      imageIO->SetFileName( filename.c_str() );
+      imageIO->ReadImageInformation();
+      }
+    catch( ExceptionObject & )
+      {
+      return false;
+      }
+
+    if( imageIO->GetNumberOfDimensions() != ImageDimension ||
+      imageIO->GetComponentType() != ImageIOBase::MapPixelType<ComponentType>::CType ||
+      imageIO->GetNumberOfComponents() != PixelTraits<PixelType>::Dimension )
+      {
+      return false;
+      }
+    const bool isBigEndian = ByteSwapper<int>::SystemIsBigEndian();
+    if( ( imageIO->GetByteOrder() == ImageIOBase::BigEndian && !isBigEndian ) ||
+      ( imageIO->GetByteOrder() == ImageIOBase::LittleEndian && isBigEndian ) )
+      {
+      return false;
+      }
+
+    SizeType size;
+    SpacingType spacing;
+    PointType origin;
+    DirectionType direction;
+    std::size_t numberOfPixels = 1;
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      size[i] = imageIO->GetDimensions( i );
+      spacing[i] = imageIO->GetSpacing( i );
+      origin[i] = imageIO->GetOrigin( i );
+      std::vector<double> axis = imageIO->GetDirection( i );
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        direction[j][i] = axis[j];
+        }
+      numberOfPixels *= size[i];
+      }
+    const std::size_t numberOfBytes = numberOfPixels * sizeof( PixelType );
+
+    ants::MemoryMappedFile::Pointer mappedFile = ants::MemoryMappedFile::New();
+    std::size_t offset = 0;
+
+    if( ants::MemoryMappedFile::HasExtension( filename, ".nii" ) )
+      {
+      if( imageIO->GetNumberOfComponents() > 1 )
+        {
+        return false;
+        }
+      if( !mappedFile->OpenForReading( filename ) ||
+        !this->GetNiftiDataOffset( mappedFile, offset ) )
+        {
+        return false;
+        }
+      }
+    else if( ants::MemoryMappedFile::HasExtension( filename, ".mha" ) ||
+      ants::MemoryMappedFile::HasExtension( filename, ".mhd" ) )
+      {
+      ants::MemoryMappedFile::Pointer headerFile = ants::MemoryMappedFile::New();
+      std::string dataFileName;
+      if( !headerFile->OpenForReading( filename ) ||
+        !this->GetMetaImageDataLocation( headerFile, numberOfBytes, dataFileName, offset ) )
+        {
+        return false;
+        }
+      if( dataFileName == filename )
+        {
+        mappedFile = headerFile;
+        }
+      else if( !mappedFile->OpenForReading( dataFileName ) )
+        {
+        return false;
+        }
+      }
+    else
+      {
+      return false;
+      }
+
+    // The wrapped buffer has to be large enough and suitably aligned for
+    // the component type.
+    if( mappedFile->GetSize() < offset + numberOfBytes ||
+      ( reinterpret_cast<std::size_t>( mappedFile->GetBuffer() + offset ) %
+      sizeof( ComponentType ) ) != 0 )
+      {
+      return false;
+      }
+
+    typename MappedPixelContainerType::Pointer container = MappedPixelContainerType::New();
+    container->SetMappedFile( mappedFile, offset, numberOfPixels );
+
+    IndexType index;
+    index.Fill( 0 );
+    RegionType region;
+    region.SetSize( size );
+    region.SetIndex( index );
+
+    OutputImagePointer image = OutputImageType::New();
+    image->SetRegions( region );
+    image->SetSpacing( spacing );
+    image->SetOrigin( origin );
+    image->SetDirection( direction );
+    image->SetPixelContainer( container );
+
+    this->m_Output = image;
+    return true;
+    }
+
+private:
+  MemoryMappedImageFileReader( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::string           m_FileName;
+  std::string           m_CacheDirectory;
+  bool                  m_UseMemoryMapping;
+  bool                  m_IsMemoryMapped;
+  bool                  m_IsCached;
+  OutputImagePointer    m_Output;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,244 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkMemoryMappedImageFileWriter.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMemoryMappedImageFileWriter_h
+#define __itkMemoryMappedImageFileWriter_h
+
+#include "antsMemoryMappedFile.h"
+#include "itkMemoryMappedImportImageContainer.h"
+
+#include "itkByteSwapper.h"
+#include "itkPixelTraits.h"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+
+namespace itk
+{
+
+/** \class MemoryMappedImageFileWriter
+ * \brief Create an uncompressed MetaImage (.mha) file and expose its voxel
+ * data as a pixel container.
+ *
+ * The header is written up front (padded such that the voxel data is
+ * aligned) and the file is mapped shared.  Setting the returned container
+ * as the buffer of an image, e.g. as the output buffer of a filter, writes
+ * the voxels directly into the file without an intermediate copy.  Call
+ * Flush() once the buffer has been filled.
+ *
+ * \ingroup IOFilters
+ */
+template <class TInputImage>
+class ITK_EXPORT MemoryMappedImageFileWriter : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef MemoryMappedImageFileWriter Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MemoryMappedImageFileWriter, Object);
+
+  typedef TInputImage                               InputImageType;
+  typedef typename InputImageType::PixelType        PixelType;
+  typedef typename PixelTraits<PixelType>::ValueType ComponentType;
+
+  typedef MemoryMappedImportImageContainer<
+    typename InputImageType::PixelContainer::ElementIdentifier, PixelType>
+                                                    MappedPixelContainerType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, TInputImage::ImageDimension);
+
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  /** Only uncompressed MetaImage files can be written in place. */
+  static bool CanWriteFile( const std::string & filename )
+    {
+    return ( ants::MemoryMappedFile::HasExtension( filename, ".mha" ) &&
+      !GetMetaElementType().empty() );
+    }
+
+  /** Create the file for an image with the geometry (largest possible
+   * region, spacing, origin and direction) of the given image.  Returns
+   * NULL if the file can't be created. */
+  MappedPixelContainerType * CreatePixelContainer( const InputImageType *image )
+    {
+    this->m_PixelContainer = NULL;
+
+    // MetaImage has no notion of a start index.
+    const std::string elementType = GetMetaElementType();
+    if( elementType.empty() )
+      {
+      return NULL;
+      }
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      if( image->GetLargestPossibleRegion().GetIndex()[i] != 0 )
+        {
+        return NULL;
+        }
+      }
+
+    const typename InputImageType::SizeType size =
+      image->GetLargestPossibleRegion().GetSize();
+    const unsigned int numberOfComponents = PixelTraits<PixelType>::Dimension;
+
+    std::ostringstream oss;
+    oss << std::setprecision( 17 );
+    oss << "ObjectType = Image" << std::endl;
+    oss << "NDims = " << ImageDimension << std::endl;
+    oss << "BinaryData = True" << std::endl;
+    oss << "BinaryDataByteOrderMSB = "
+      << ( ByteSwapper<int>::SystemIsBigEndian() ? "True" : "False" ) << std::endl;
+    oss << "CompressedData = False" << std::endl;
+    oss << "TransformMatrix =";
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      for( unsigned int j = 0; j < ImageDimension; j++ )
+        {
+        oss << " " << image->GetDirection()[j][i];
+        }
+      }
+    oss << std::endl;
+    oss << "Offset =";
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      oss << " " << image->GetOrigin()[i];
+      }
+    oss << std::endl;
+    oss << "CenterOfRotation =";
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      oss << " 0";
+      }
+    oss << std::endl;
+    oss << "ElementSpacing =";
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      oss << " " << image->GetSpacing()[i];
+      }
+    oss << std::endl;
+    oss << "DimSize =";
+    for( unsigned int i = 0; i < ImageDimension; i++ )
+      {
+      oss << " " << size[i];
+      }
+    oss << std::endl;
+    if( numberOfComponents > 1 )
+      {
+      oss << "ElementNumberOfChannels = " << numberOfComponents << std::endl;
+      }
+    oss << "ElementType = " << elementType << std::endl;
+
+    // Pad the header with a comment such that the voxel data starts at a
+    // multiple of 64 bytes.
+    const std::string lastLine( "ElementDataFile = LOCAL\n" );
+    std::string header = oss.str() + std::string( "Comment = " );
+    std::size_t length = header.length() + 1 + lastLine.length();
+    header += std::string( ( 64 - length % 64 ) % 64, ' ' ) + std::string( "\n" ) + lastLine;
+
+    const std::size_t numberOfPixels = image->GetLargestPossibleRegion().GetNumberOfPixels();
+    const std::size_t numberOfBytes = numberOfPixels * sizeof( PixelType );
+
+    ants::MemoryMappedFile::Pointer mappedFile = ants::MemoryMappedFile::New();
+    if( !mappedFile->CreateForWriting( this->m_FileName, header.length() + numberOfBytes ) )
+      {
+      return NULL;
+      }
+    std::memcpy( mappedFile->GetBuffer(), header.c_str(), header.length() );
+
+    this->m_PixelContainer = MappedPixelContainerType::New();
+    this->m_PixelContainer->SetMappedFile( mappedFile, header.length(), numberOfPixels );
+
+    return this->m_PixelContainer.GetPointer();
+    }
+
+  /** Write the voxel data to disk. */
+  void Flush()
+    {
+    if( this->m_PixelContainer )
+      {
+      this->m_PixelContainer->GetMappedFile()->Flush();
+      }
+    }
+
+protected:
+  MemoryMappedImageFileWriter() {}
+  ~MemoryMappedImageFileWriter() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "FileName: " << this->m_FileName << std::endl;
+    }
+
+  static std::string GetMetaElementType()
+    {
+    if( typeid( ComponentType ) == typeid( float ) )
+      {
+      return std::string( "MET_FLOAT" );
+      }
+    else if( typeid( ComponentType ) == typeid( double ) )
+      {
+      return std::string( "MET_DOUBLE" );
+      }
+    else if( typeid( ComponentType ) == typeid( char ) )
+      {
+      return std::string( "MET_CHAR" );
+      }
+    else if( typeid( ComponentType ) == typeid( unsigned char ) )
+      {
+      return std::string( "MET_UCHAR" );
+      }
+    else if( typeid( ComponentType ) == typeid( short ) )
+      {
+      return std::string( "MET_SHORT" );
+      }
+    else if( typeid( ComponentType ) == typeid( unsigned short ) )
+      {
+      return std::string( "MET_USHORT" );
+      }
+    else if( typeid( ComponentType ) == typeid( int ) )
+      {
+      return std::string( "MET_INT" );
+      }
+    else if( typeid( ComponentType ) == typeid( unsigned int ) )
+      {
+      return std::string( "MET_UINT" );
+      }
+    return std::string( "" );
+    }
+
+private:
+  MemoryMappedImageFileWriter( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::string                                       m_FileName;
+  typename MappedPixelContainerType::Pointer        m_PixelContainer;
+};
+
+} // end namespace itk
+
+#endif
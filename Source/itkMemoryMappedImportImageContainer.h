@@ -0,0 +1,84 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkMemoryMappedImportImageContainer.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkMemoryMappedImportImageContainer_h
+#define __itkMemoryMappedImportImageContainer_h
+
+#include "itkImportImageContainer.h"
+#include "antsMemoryMappedFile.h"
+
+namespace itk
+{
+
+/** \class MemoryMappedImportImageContainer
+ * \brief Pixel container wrapping (part of) a memory mapped file.
+ *
+ * The container does not manage the memory itself.  Instead it keeps a
+ * reference to the mapping such that the file stays mapped for as long as
+ * an image refers to the buffer.  It can be set directly as the pixel
+ * container of an itk::Image since it derives from the default container.
+ *
+ * \ingroup ImageObjects
+ */
+template <typename TElementIdentifier, typename TElement>
+class ITK_EXPORT MemoryMappedImportImageContainer :
+  public ImportImageContainer<TElementIdentifier, TElement>
+{
+public:
+  /** Standard class typedefs. */
+  typedef MemoryMappedImportImageContainer Self;
+  typedef ImportImageContainer<TElementIdentifier, TElement> Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(MemoryMappedImportImageContainer, ImportImageContainer);
+
+  typedef ants::MemoryMappedFile MemoryMappedFileType;
+
+  /** Wrap the buffer starting at the given byte offset of the mapping. */
+  void SetMappedFile(MemoryMappedFileType *file, std::size_t offset,
+    TElementIdentifier numberOfElements)
+    {
+    this->m_MappedFile = file;
+    this->SetImportPointer(
+      reinterpret_cast<TElement *>(file->GetBuffer() + offset),
+      numberOfElements, false);
+    }
+
+  MemoryMappedFileType * GetMappedFile()
+    {
+    return this->m_MappedFile.GetPointer();
+    }
+
+protected:
+  MemoryMappedImportImageContainer() {}
+  ~MemoryMappedImportImageContainer() {}
+
+private:
+  MemoryMappedImportImageContainer( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  typename MemoryMappedFileType::Pointer m_MappedFile;
+};
+
+} // end namespace itk
+
+#endif
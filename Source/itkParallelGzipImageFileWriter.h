@@ -0,0 +1,201 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkParallelGzipImageFileWriter.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkParallelGzipImageFileWriter_h
+#define __itkParallelGzipImageFileWriter_h
+
+#include "antsMemoryMappedFile.h"
+#include "antsParallelGzipCompressor.h"
+
+#include "itkImageFileWriter.h"
+
+#include "itksys/SystemTools.hxx"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class ParallelGzipImageFileWriter
+ * \brief Write an image, compressing gzipped NIfTI (.nii.gz) files on all
+ * threads.
+ *
+ * The image is first written as an uncompressed NIfTI file next to the
+ * output, which is then compressed block-wise in parallel (see
+ * ants::ParallelGzipCompressor) into a standard gzip stream.  The
+ * uncompressed file gets a new, unique name (such that no existing file
+ * is overwritten) and is removed on every path, including exceptions of
+ * the NIfTI writer.  The compression level can be chosen, including 0
+ * (stored) and 1 (fast) for scratch outputs, and is always honoured:  if
+ * the gzip stream cannot be written, an exception is thrown rather than
+ * falling back to the serial compression of the NIfTI writer.
+ *
+ * Other file types are written with the regular itk::ImageFileWriter.  As
+ * for the memory mapped reader, this class is not a pipeline filter:  set
+ * the input and call Update().
+ *
+ * \ingroup IOFilters
+ */
+template <class TInputImage>
+class ITK_EXPORT ParallelGzipImageFileWriter : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef ParallelGzipImageFileWriter Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(ParallelGzipImageFileWriter, Object);
+
+  typedef TInputImage                               InputImageType;
+  typedef ImageFileWriter<InputImageType>           WriterType;
+
+  itkSetStringMacro(FileName);
+  itkGetStringMacro(FileName);
+
+  /** zlib compression level (0-9).  Default is 6. */
+  itkSetClampMacro(CompressionLevel, int, 0, 9);
+  itkGetConstMacro(CompressionLevel, int);
+
+  /** Number of compression threads.  Default is the global default. */
+  itkSetMacro(NumberOfThreads, unsigned int);
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
+  void SetInput( const InputImageType *image )
+    {
+    this->m_Input = image;
+    }
+  const InputImageType * GetInput() const
+    {
+    return this->m_Input.GetPointer();
+    }
+
+  void Update()
+    {
+    if( this->m_Input.IsNull() )
+      {
+      itkExceptionMacro( "No input to write." );
+      }
+
+    typename WriterType::Pointer writer = WriterType::New();
+    writer->SetInput( this->m_Input );
+
+    if( !ants::MemoryMappedFile::HasExtension( this->m_FileName, ".nii.gz" ) )
+      {
+      writer->SetFileName( this->m_FileName.c_str() );
+      writer->Update();
+      return;
+      }
+
+    std::string prefix = itksys::SystemTools::GetFilenamePath( this->m_FileName );
+    if( !prefix.empty() )
+      {
+      prefix += std::string( "/" );
+      }
+    const std::string name = itksys::SystemTools::GetFilenameName( this->m_FileName );
+    prefix += std::string( "." ) + name.substr( 0, name.length() - 7 ) + std::string( "." );
+
+    const TemporaryFile uncompressedFile(
+      ants::MemoryMappedFile::CreateTemporaryFile( prefix, std::string( ".nii" ) ) );
+    if( uncompressedFile.m_FileName.empty() )
+      {
+      itkExceptionMacro( "Could not create a temporary file next to " << this->m_FileName );
+      }
+
+    writer->SetFileName( uncompressedFile.m_FileName.c_str() );
+    writer->Update();
+
+    ants::ParallelGzipCompressor::Pointer compressor = ants::ParallelGzipCompressor::New();
+    compressor->SetCompressionLevel( this->m_CompressionLevel );
+    compressor->SetNumberOfThreads( this->m_NumberOfThreads );
+
+    bool succeeded = false;
+    ants::MemoryMappedFile::Pointer mappedFile = ants::MemoryMappedFile::New();
+    if( mappedFile->OpenForReading( uncompressedFile.m_FileName ) )
+      {
+      succeeded = compressor->WriteFile( mappedFile->GetBuffer(), mappedFile->GetSize(),
+        this->m_FileName );
+      mappedFile->Close();
+      }
+    else
+      {
+      // Read the file if it cannot be mapped (e.g. on Windows).
+      std::vector<char> buffer( ants::MemoryMappedFile::GetFileSize( uncompressedFile.m_FileName ) );
+      std::ifstream stream( uncompressedFile.m_FileName.c_str(), std::ios::in | std::ios::binary );
+      if( !buffer.empty() && stream.read( &buffer[0], buffer.size() ) )
+        {
+        succeeded = compressor->WriteFile( &buffer[0], buffer.size(), this->m_FileName );
+        }
+      }
+
+    if( !succeeded )
+      {
+      std::remove( this->m_FileName.c_str() );
+      itkExceptionMacro( "Could not write " << this->m_FileName );
+      }
+    }
+
+protected:
+  ParallelGzipImageFileWriter() : m_CompressionLevel( 6 ),
+    m_NumberOfThreads( MultiThreader::GetGlobalDefaultNumberOfThreads() )
+    {
+    }
+  ~ParallelGzipImageFileWriter() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "FileName: " << this->m_FileName << std::endl;
+    os << indent << "CompressionLevel: " << this->m_CompressionLevel << std::endl;
+    os << indent << "NumberOfThreads: " << this->m_NumberOfThreads << std::endl;
+    }
+
+private:
+  ParallelGzipImageFileWriter( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  /** Removes the file when it goes out of scope. */
+  struct TemporaryFile
+    {
+    TemporaryFile( const std::string & filename ) : m_FileName( filename ) {}
+    ~TemporaryFile()
+      {
+      if( !this->m_FileName.empty() )
+        {
+        std::remove( this->m_FileName.c_str() );
+        }
+      }
+
+    const std::string m_FileName;
+    };
+
+  typename InputImageType::ConstPointer             m_Input;
+  std::string                                       m_FileName;
+  int                                               m_CompressionLevel;
+  unsigned int                                      m_NumberOfThreads;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,68 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkSeparableKernelInterpolator.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSeparableKernelInterpolator_h
+#define __itkSeparableKernelInterpolator_h
+
+namespace itk
+{
+
+/** \class SeparableKernelInterpolator
+ * \brief Interface of interpolators whose kernel is a product of 1-D
+ * kernels.
+ *
+ * The interpolated value at a continuous index c is
+ *
+ *   sum over the neighbors n of  prod_d w_d( n_d ) sample( n ),
+ *
+ * where the neighbors n_d and weights w_d along dimension d only depend
+ * on c_d.  The samples are the voxels of GetSeparableKernelSamples(),
+ * e.g. the input image or its B-spline coefficients.  Boundary handling
+ * (clamping, mirroring, truncation) is part of the 1-D kernels.
+ *
+ * Lets a resampler that moves along the axes of the input (see
+ * ANTSResampleImageFilter) tabulate the 1-D kernels once per axis and
+ * filter the samples separably instead of evaluating the interpolator
+ * point by point.
+ *
+ * \ingroup ImageFunctions ImageInterpolators
+ */
+template <class TSampleImage>
+class SeparableKernelInterpolator
+{
+public:
+  typedef TSampleImage SampleImageType;
+
+  virtual ~SeparableKernelInterpolator() {}
+
+  /** Image whose voxels are weighted by the kernel. */
+  virtual const SampleImageType * GetSeparableKernelSamples() const = 0;
+
+  /** Largest number of neighbors along dimension d. */
+  virtual unsigned int GetSeparableKernelWidth( unsigned int d ) const = 0;
+
+  /** Neighbors and weights (GetSeparableKernelWidth( d ) of each) at the
+   * continuous index cindex along dimension d.  The neighbors are buffer
+   * positions along d, i.e. relative to the start of the buffered region
+   * of the samples, and lie inside it.  Unused entries have weight 0. */
+  virtual void ComputeSeparableKernel( unsigned int d, double cindex,
+    long *neighbors, double *weights ) const = 0;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,269 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkSeparableWindowedSincInterpolateImageFunction.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkSeparableWindowedSincInterpolateImageFunction_h
+#define __itkSeparableWindowedSincInterpolateImageFunction_h
+
+#include "itkInterpolateImageFunction.h"
+#include "itkSeparableKernelInterpolator.h"
+#include "itkWindowedSincInterpolateImageFunction.h"
+
+#include "vnl/vnl_math.h"
+
+#include <vector>
+
+namespace itk
+{
+
+/** \class SeparableWindowedSincInterpolateImageFunction
+ * \brief Windowed sinc interpolation with a tabulated, separable kernel.
+ *
+ * Computes the same interpolant as itk::WindowedSincInterpolateImageFunction
+ * with a zero flux Neumann boundary condition (i.e. the image is extended
+ * by replicating the border voxels), but
+ *
+ * - the 1-D kernel window( x ) * sinc( x ) is tabulated once on a fine grid
+ *   (SamplesPerUnit samples per voxel) and linearly interpolated from the
+ *   table instead of evaluating the window and sinc functions for every
+ *   neighbor and sample,
+ *
+ * - the 2 * VRadius weights and clamped neighbor offsets are computed per
+ *   dimension and the neighborhood is accumulated along the rows of the
+ *   image buffer with raw strides instead of an N-D neighborhood iterator.
+ *
+ * The inner loops have a compile time trip count of 2 * VRadius so the
+ * compiler can unroll and vectorize them.  The relative difference to the
+ * exact kernel is below 1e-6.  The 1-D kernels are also available through
+ * the SeparableKernelInterpolator interface.
+ *
+ * \ingroup ImageFunctions ImageInterpolators
+ */
+template <class TInputImage, unsigned int VRadius,
+  class TWindowFunction = Function::HammingWindowFunction<VRadius>,
+  class TCoordRep = double>
+class ITK_EXPORT SeparableWindowedSincInterpolateImageFunction :
+  public InterpolateImageFunction<TInputImage, TCoordRep>,
+  public SeparableKernelInterpolator<TInputImage>
+{
+public:
+  /** Standard class typedefs. */
+  typedef SeparableWindowedSincInterpolateImageFunction Self;
+  typedef InterpolateImageFunction<TInputImage, TCoordRep> Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(SeparableWindowedSincInterpolateImageFunction, InterpolateImageFunction);
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** OutputType typedef support. */
+  typedef typename Superclass::OutputType OutputType;
+
+  /** InputImageType typedef support. */
+  typedef typename Superclass::InputImageType InputImageType;
+  typedef typename InputImageType::PixelType  InputPixelType;
+
+  /** RealType typedef support. */
+  typedef typename Superclass::RealType RealType;
+
+  /** Dimension underlying input image. */
+  itkStaticConstMacro(ImageDimension, unsigned int, Superclass::ImageDimension);
+
+  /** Index typedef support. */
+  typedef typename Superclass::IndexType IndexType;
+
+  /** ContinuousIndex typedef support. */
+  typedef typename Superclass::ContinuousIndexType ContinuousIndexType;
+
+  /** Size of the kernel support along each dimension. */
+  itkStaticConstMacro(KernelWidth, unsigned int, 2 * VRadius);
+
+  /** Number of table entries per voxel. */
+  itkStaticConstMacro(SamplesPerUnit, unsigned int, 4096);
+
+  virtual void SetInputImage( const TInputImage *image )
+    {
+    this->Superclass::SetInputImage( image );
+    if( !image )
+      {
+      return;
+      }
+    const typename InputImageType::RegionType & region = image->GetBufferedRegion();
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->m_Start[d] = region.GetIndex()[d];
+      this->m_Size[d] = static_cast<long>( region.GetSize()[d] );
+      this->m_Stride[d] = static_cast<long>( image->GetOffsetTable()[d] );
+      }
+    }
+
+  /** Evaluate the function at a ContinuousIndex position.  No bounds
+   * checking is done, use IsInsideBuffer() first. */
+  virtual OutputType EvaluateAtContinuousIndex( const ContinuousIndexType & index ) const
+    {
+    double weights[ImageDimension][KernelWidth];
+    long offsets[ImageDimension][KernelWidth];
+
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->ComputeSeparableKernel( d, index[d], offsets[d], weights[d] );
+      for( unsigned int i = 0; i < KernelWidth; i++ )
+        {
+        offsets[d][i] *= this->m_Stride[d];
+        }
+      }
+
+    const InputPixelType *buffer = this->GetInputImage()->GetBufferPointer();
+
+    // Odometer over the neighbors along dimensions 1, ..., D-1; the sum
+    // along dimension 0 is the innermost loop.
+    unsigned int counter[ImageDimension];
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      counter[d] = 0;
+      }
+
+    double sum = 0.0;
+    for( ;; )
+      {
+      double weight = 1.0;
+      long offset = 0;
+      for( unsigned int d = 1; d < ImageDimension; d++ )
+        {
+        weight *= weights[d][counter[d]];
+        offset += offsets[d][counter[d]];
+        }
+
+      const InputPixelType *row = buffer + offset;
+      double rowSum = 0.0;
+      for( unsigned int i = 0; i < KernelWidth; i++ )
+        {
+        rowSum += weights[0][i] * static_cast<double>( row[offsets[0][i]] );
+        }
+      sum += weight * rowSum;
+
+      unsigned int d = 1;
+      for( ; d < ImageDimension; d++ )
+        {
+        if( ++counter[d] < KernelWidth )
+          {
+          break;
+          }
+        counter[d] = 0;
+        }
+      if( d >= ImageDimension )
+        {
+        break;
+        }
+      }
+
+    return static_cast<OutputType>( sum );
+    }
+
+  /** SeparableKernelInterpolator interface:  the samples are the input
+   * voxels. */
+  virtual const TInputImage * GetSeparableKernelSamples() const
+    {
+    return this->GetInputImage();
+    }
+
+  virtual unsigned int GetSeparableKernelWidth( unsigned int ) const
+    {
+    return KernelWidth;
+    }
+
+  virtual void ComputeSeparableKernel( unsigned int d, double cindex,
+    long *neighbors, double *weights ) const
+    {
+    const double baseIndex = vcl_floor( cindex );
+    const double distance = cindex - baseIndex;
+    const long first = static_cast<long>( baseIndex ) - static_cast<long>( VRadius ) + 1
+      - this->m_Start[d];
+    for( unsigned int i = 0; i < KernelWidth; i++ )
+      {
+      // Neighbor first + i lies at distance + VRadius - 1 - i.
+      weights[i] = this->EvaluateKernel( distance + VRadius - 1.0 - i );
+
+      const long neighbor = first + static_cast<long>( i );
+      neighbors[i] = ( neighbor < 0 ) ? 0 : ( ( neighbor >= this->m_Size[d] ) ? this->m_Size[d] - 1 : neighbor );
+      }
+    }
+
+protected:
+  SeparableWindowedSincInterpolateImageFunction()
+    {
+    // Tabulate window( x ) * sinc( x ) for x in [0, VRadius] with one
+    // extra entry for the interpolation at the end of the table.
+    TWindowFunction window;
+    const unsigned int tableSize = VRadius * SamplesPerUnit + 2;
+    this->m_KernelTable.resize( tableSize );
+    for( unsigned int n = 0; n < tableSize; n++ )
+      {
+      const double x = static_cast<double>( n ) / static_cast<double>( SamplesPerUnit );
+      if( x >= static_cast<double>( VRadius ) )
+        {
+        this->m_KernelTable[n] = 0.0;
+        continue;
+        }
+      const double px = vnl_math::pi * x;
+      const double sinc = ( x == 0.0 ) ? 1.0 : vcl_sin( px ) / px;
+      this->m_KernelTable[n] = window( x ) * sinc;
+      }
+
+    for( unsigned int d = 0; d < ImageDimension; d++ )
+      {
+      this->m_Start[d] = 0;
+      this->m_Size[d] = 0;
+      this->m_Stride[d] = 0;
+      }
+    }
+  ~SeparableWindowedSincInterpolateImageFunction() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "Radius: " << VRadius << std::endl;
+    os << indent << "Kernel table size: " << this->m_KernelTable.size() << std::endl;
+    }
+
+  /** Kernel value at (signed) distance x from the sample. */
+  inline double EvaluateKernel( double x ) const
+    {
+    const double t = vnl_math_abs( x ) * static_cast<double>( SamplesPerUnit );
+    const unsigned int n = static_cast<unsigned int>( t );
+    if( n + 1 >= this->m_KernelTable.size() )
+      {
+      return 0.0;
+      }
+    const double fraction = t - static_cast<double>( n );
+    return this->m_KernelTable[n] + fraction * ( this->m_KernelTable[n + 1] - this->m_KernelTable[n] );
+    }
+
+private:
+  SeparableWindowedSincInterpolateImageFunction( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::vector<double>                               m_KernelTable;
+  long                                              m_Start[ImageDimension];
+  long                                              m_Size[ImageDimension];
+  long                                              m_Stride[ImageDimension];
+};
+
+} // end namespace itk
+
+#endif
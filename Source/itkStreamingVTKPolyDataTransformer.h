@@ -0,0 +1,369 @@
+/*=========================================================================
+
+  Program:   Advanced Normalization Tools
+  Module:    $RCSfile: itkStreamingVTKPolyDataTransformer.h,v $
+  Language:  C++
+  Date:      $Date: $
+  Version:   $Revision: $
+
+  Copyright (c) ConsortiumOfANTS. All rights reserved.
+  See accompanying COPYING.txt or
+ http://sourceforge.net/projects/advants/files/ANTS/ANTSCopyright.txt for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+#ifndef __itkStreamingVTKPolyDataTransformer_h
+#define __itkStreamingVTKPolyDataTransformer_h
+
+#include "antsMemoryMappedFile.h"
+#include "itkCompositeTransformPointMapper.h"
+
+#include "itkByteSwapper.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace itk
+{
+
+/** \class StreamingVTKPolyDataTransformer
+ * \brief Warp the vertices of a legacy VTK PolyData file (.vtk) through a
+ * composite transform.
+ *
+ * The input file is mapped and only the POINTS section is decoded:  the
+ * vertices are converted chunk by chunk into coordinate arrays, mapped in
+ * parallel by a CompositeTransformPointMapper and encoded again in the
+ * format (ASCII or big endian BINARY, float or double) of the input.  The
+ * remainder of the file (polygons, strips, point and cell data, ...) is
+ * written straight from the mapping, i.e. the connectivity is neither
+ * parsed nor copied.
+ *
+ * VTK points always have three coordinates.  For 2-D transforms, only the
+ * first two coordinates are mapped.
+ *
+ * \ingroup IOFilters
+ */
+template <class TScalarType, unsigned int NDimensions>
+class ITK_EXPORT StreamingVTKPolyDataTransformer : public Object
+{
+public:
+  /** Standard class typedefs. */
+  typedef StreamingVTKPolyDataTransformer Self;
+  typedef Object Superclass;
+  typedef SmartPointer<Self> Pointer;
+  typedef SmartPointer<const Self>  ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). */
+  itkTypeMacro(StreamingVTKPolyDataTransformer, Object);
+
+  typedef TScalarType                                          ScalarType;
+  typedef CompositeTransformPointMapper<ScalarType, NDimensions> PointMapperType;
+  typedef typename PointMapperType::CompositeTransformType     CompositeTransformType;
+
+  itkSetStringMacro(InputFileName);
+  itkGetStringMacro(InputFileName);
+
+  itkSetStringMacro(OutputFileName);
+  itkGetStringMacro(OutputFileName);
+
+  /** Number of vertices decoded and mapped at a time.  Default is 2^20. */
+  itkSetClampMacro(ChunkSize, SizeValueType, 1, NumericTraits<SizeValueType>::max());
+  itkGetConstMacro(ChunkSize, SizeValueType);
+
+  void SetTransform( const CompositeTransformType *transform )
+    {
+    this->m_PointMapper->SetTransform( transform );
+    this->Modified();
+    }
+
+  itkGetConstMacro(NumberOfPoints, SizeValueType);
+
+  void Update()
+    {
+    if( NDimensions > 3 )
+      {
+      itkExceptionMacro( "VTK points have (at most) three coordinates." );
+      }
+
+    ants::MemoryMappedFile::Pointer input = ants::MemoryMappedFile::New();
+    if( !input->OpenForReading( this->m_InputFileName ) )
+      {
+      itkExceptionMacro( "Unable to map " << this->m_InputFileName );
+      }
+    this->m_Buffer = input->GetBuffer();
+    this->m_Size = input->GetSize();
+
+    // Header:  version, title, ASCII/BINARY, DATASET POLYDATA, POINTS n type.
+    std::size_t position = 0;
+    std::string line = this->ReadLine( position );
+    if( line.compare( 0, 5, "# vtk" ) != 0 )
+      {
+      itkExceptionMacro( << this->m_InputFileName << " is not a legacy VTK file." );
+      }
+    this->ReadLine( position );
+    const std::string format = ToUpperCase( this->ReadNonEmptyLine( position ) );
+    if( format != "ASCII" && format != "BINARY" )
+      {
+      itkExceptionMacro( "Unknown VTK file format " << format );
+      }
+    const bool isBinary = ( format == "BINARY" );
+
+    std::istringstream dataset( ToUpperCase( this->ReadNonEmptyLine( position ) ) );
+    std::string keyword;
+    std::string datasetType;
+    dataset >> keyword >> datasetType;
+    if( keyword != "DATASET" || datasetType != "POLYDATA" )
+      {
+      itkExceptionMacro( << this->m_InputFileName << " does not contain POLYDATA." );
+      }
+
+    std::istringstream pointsLine( this->ReadNonEmptyLine( position ) );
+    std::string pointsType;
+    this->m_NumberOfPoints = 0;
+    pointsLine >> keyword >> this->m_NumberOfPoints >> pointsType;
+    pointsType = ToUpperCase( pointsType );
+    if( ToUpperCase( keyword ) != "POINTS" || ( pointsType != "FLOAT" && pointsType != "DOUBLE" ) )
+      {
+      itkExceptionMacro( "Expected float or double POINTS in " << this->m_InputFileName );
+      }
+
+    std::ofstream os( this->m_OutputFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !os )
+      {
+      itkExceptionMacro( "Unable to write " << this->m_OutputFileName );
+      }
+
+    // Everything up to the point data is copied verbatim.
+    os.write( this->m_Buffer, position );
+
+    if( isBinary && pointsType == "FLOAT" )
+      {
+      position = this->TransformBinaryPoints<float>( position, os );
+      }
+    else if( isBinary )
+      {
+      position = this->TransformBinaryPoints<double>( position, os );
+      }
+    else
+      {
+      position = this->TransformASCIIPoints( position,
+        ( pointsType == "FLOAT" ) ? std::numeric_limits<float>::digits10 + 2 :
+        std::numeric_limits<double>::digits10 + 2, os );
+      }
+
+    // The connectivity and any attributes are copied verbatim.
+    os.write( this->m_Buffer + position, this->m_Size - position );
+    if( !os.good() )
+      {
+      itkExceptionMacro( "Error writing " << this->m_OutputFileName );
+      }
+
+    this->m_Buffer = NULL;
+    this->m_Size = 0;
+    }
+
+protected:
+  StreamingVTKPolyDataTransformer() : m_ChunkSize( 1 << 20 ),
+    m_NumberOfPoints( 0 ), m_Buffer( NULL ), m_Size( 0 )
+    {
+    this->m_PointMapper = PointMapperType::New();
+    }
+  ~StreamingVTKPolyDataTransformer() {}
+  void PrintSelf(std::ostream& os, Indent indent) const
+    {
+    this->Superclass::PrintSelf(os,indent);
+    os << indent << "InputFileName: " << this->m_InputFileName << std::endl;
+    os << indent << "OutputFileName: " << this->m_OutputFileName << std::endl;
+    os << indent << "ChunkSize: " << this->m_ChunkSize << std::endl;
+    }
+
+  static std::string ToUpperCase( std::string str )
+    {
+    std::transform( str.begin(), str.end(), str.begin(), toupper );
+    return str;
+    }
+
+  /** Returns the line starting at position (without the line break) and
+   * moves position to the start of the next line. */
+  std::string ReadLine( std::size_t & position ) const
+    {
+    const std::size_t begin = position;
+    while( position < this->m_Size && this->m_Buffer[position] != '\n' )
+      {
+      position++;
+      }
+    std::size_t end = position;
+    if( position < this->m_Size )
+      {
+      position++;
+      }
+    if( end > begin && this->m_Buffer[end-1] == '\r' )
+      {
+      end--;
+      }
+    return std::string( this->m_Buffer + begin, end - begin );
+    }
+
+  std::string ReadNonEmptyLine( std::size_t & position ) const
+    {
+    std::string line;
+    while( position < this->m_Size && line.find_first_not_of( " \t" ) == std::string::npos )
+      {
+      line = this->ReadLine( position );
+      }
+    return line;
+    }
+
+  template <class TFileScalar>
+  std::size_t TransformBinaryPoints( std::size_t position, std::ofstream & os )
+    {
+    const std::size_t numberOfBytes = this->m_NumberOfPoints * 3 * sizeof( TFileScalar );
+    if( position + numberOfBytes > this->m_Size )
+      {
+      itkExceptionMacro( "Unexpected end of the point data in " << this->m_InputFileName );
+      }
+
+    std::vector<TFileScalar> block;
+    std::vector<ScalarType> coordinates[NDimensions];
+    ScalarType *coordinatePointers[NDimensions];
+
+    for( SizeValueType first = 0; first < this->m_NumberOfPoints; first += this->m_ChunkSize )
+      {
+      const SizeValueType count = std::min( this->m_ChunkSize, this->m_NumberOfPoints - first );
+
+      block.resize( count * 3 );
+      std::memcpy( &block[0], this->m_Buffer + position + first * 3 * sizeof( TFileScalar ),
+        count * 3 * sizeof( TFileScalar ) );
+      ByteSwapper<TFileScalar>::SwapRangeFromSystemToBigEndian( &block[0], count * 3 );
+
+      for( unsigned int d = 0; d < NDimensions; d++ )
+        {
+        coordinates[d].resize( count );
+        coordinatePointers[d] = &coordinates[d][0];
+        for( SizeValueType n = 0; n < count; n++ )
+          {
+          coordinates[d][n] = static_cast<ScalarType>( block[n * 3 + d] );
+          }
+        }
+
+      this->m_PointMapper->MapPoints( coordinatePointers, count );
+
+      for( unsigned int d = 0; d < NDimensions; d++ )
+        {
+        for( SizeValueType n = 0; n < count; n++ )
+          {
+          block[n * 3 + d] = static_cast<TFileScalar>( coordinates[d][n] );
+          }
+        }
+      ByteSwapper<TFileScalar>::SwapRangeFromSystemToBigEndian( &block[0], count * 3 );
+      os.write( reinterpret_cast<const char *>( &block[0] ), count * 3 * sizeof( TFileScalar ) );
+      }
+
+    return position + numberOfBytes;
+    }
+
+  /** Parses the next number.  Returns false at the end of the file. */
+  bool ReadASCIIValue( std::size_t & position, double & value ) const
+    {
+    while( position < this->m_Size && isspace( this->m_Buffer[position] ) )
+      {
+      position++;
+      }
+    char token[64];
+    std::size_t length = 0;
+    while( position < this->m_Size && !isspace( this->m_Buffer[position] ) && length < 63 )
+      {
+      token[length++] = this->m_Buffer[position++];
+      }
+    token[length] = '\0';
+    char *end;
+    value = std::strtod( token, &end );
+    return ( length > 0 && *end == '\0' );
+    }
+
+  std::size_t TransformASCIIPoints( std::size_t position, int precision, std::ofstream & os )
+    {
+    std::vector<double> block;
+    std::vector<ScalarType> coordinates[NDimensions];
+    ScalarType *coordinatePointers[NDimensions];
+
+    std::ostringstream oss;
+    oss << std::setprecision( precision );
+
+    for( SizeValueType first = 0; first < this->m_NumberOfPoints; first += this->m_ChunkSize )
+      {
+      const SizeValueType count = std::min( this->m_ChunkSize, this->m_NumberOfPoints - first );
+
+      block.resize( count * 3 );
+      for( SizeValueType n = 0; n < count * 3; n++ )
+        {
+        if( !this->ReadASCIIValue( position, block[n] ) )
+          {
+          itkExceptionMacro( "Unable to parse the point data in " << this->m_InputFileName );
+          }
+        }
+
+      for( unsigned int d = 0; d < NDimensions; d++ )
+        {
+        coordinates[d].resize( count );
+        coordinatePointers[d] = &coordinates[d][0];
+        for( SizeValueType n = 0; n < count; n++ )
+          {
+          coordinates[d][n] = static_cast<ScalarType>( block[n * 3 + d] );
+          }
+        }
+
+      this->m_PointMapper->MapPoints( coordinatePointers, count );
+
+      oss.str( "" );
+      for( SizeValueType n = 0; n < count; n++ )
+        {
+        for( unsigned int d = 0; d < 3; d++ )
+          {
+          oss << ( ( d < NDimensions ) ? static_cast<double>( coordinates[d][n] ) : block[n * 3 + d] )
+            << ( ( d < 2 ) ? " " : "\n" );
+          }
+        }
+      os << oss.str();
+      }
+
+    // Skip the white space following the last coordinate since every point
+    // is terminated by a line break.
+    while( position < this->m_Size && isspace( this->m_Buffer[position] ) )
+      {
+      position++;
+      }
+    return position;
+    }
+
+private:
+  StreamingVTKPolyDataTransformer( const Self& ); //purposely not implemented
+  void operator=( const Self& ); //purposely not implemented
+
+  std::string                                       m_InputFileName;
+  std::string                                       m_OutputFileName;
+  SizeValueType                                     m_ChunkSize;
+  SizeValueType                                     m_NumberOfPoints;
+  typename PointMapperType::Pointer                 m_PointMapper;
+
+  const char                                       *m_Buffer;
+  std::size_t                                       m_Size;
+};
+
+} // end namespace itk
+
+#endif